@@ -30,6 +30,7 @@ import glob
 import os
 import platform
 import shutil
+import struct
 import subprocess
 import sys
 
@@ -117,6 +118,16 @@ CWEBP_EXECUTABLE_NAME = 'cwebp' + EXECUTABLE_EXTENSION
 # Ranges from 0 to 100.
 WEBP_QUALITY = 90
 
+# Name of the PVRTexTool executable, used to cook KTX texture containers
+# (pre-generated mip chain, ETC2 compression). The engine prefers these over
+# webp at load time and uploads them with no CPU-side decode. KTX cooking is
+# skipped when the tool isn't installed.
+PVRTEXTOOL_EXECUTABLE_NAME = 'PVRTexToolCLI' + EXECUTABLE_EXTENSION
+
+# Texture format to compress KTX containers to. ETC2 with an alpha channel
+# decodes on every GLES3 device; older devices fall back to the webp path.
+KTX_TEXTURE_FORMAT = 'ETC2_RGBA,UBN,lRGB'
+
 
 class FlatbuffersConversionData(object):
   """Holds data needed to convert a set of json files to flatbuffer binaries.
@@ -177,6 +188,15 @@ def processed_texture_path(path, target_directory):
   return path.replace(RAW_ASSETS_PATH, target_directory).replace('png', 'webp')
 
 
+def processed_ktx_path(path, target_directory):
+  """Take the path to a raw png asset and convert it to target ktx path.
+
+  Args:
+    target_directory: Path to the target assets directory.
+  """
+  return path.replace(RAW_ASSETS_PATH, target_directory).replace('png', 'ktx')
+
+
 # PNG files to convert to webp.
 PNG_TEXTURES = glob.glob(os.path.join(RAW_TEXTURE_PATH, '*.png'))
 
@@ -186,6 +206,9 @@ FLATC = find_in_paths(FLATC_EXECUTABLE_NAME, FLATBUFFERS_PATHS)
 # Location of webp compression tool.
 CWEBP = find_in_paths(CWEBP_EXECUTABLE_NAME, CWEBP_PATHS)
 
+# Location of the KTX texture cooking tool, if installed.
+PVRTEXTOOL = distutils.spawn.find_executable(PVRTEXTOOL_EXECUTABLE_NAME)
+
 
 class BuildError(Exception):
   """Error indicating there was a problem building assets."""
@@ -242,6 +265,24 @@ def convert_png_image_to_webp(png, out, quality=80):
   run_subprocess(command)
 
 
+def convert_png_image_to_ktx(png, out):
+  """Cook the given png file into a KTX container.
+
+  The container holds a full pre-generated mip chain, compressed to
+  KTX_TEXTURE_FORMAT.
+
+  Args:
+    png: The path to the png file to cook into a ktx file.
+    out: The path of the ktx to write to.
+
+  Raises:
+    BuildError: Process return code was nonzero.
+  """
+  command = [PVRTEXTOOL, '-i', png, '-o', out, '-m', '-f', KTX_TEXTURE_FORMAT,
+             '-q', 'etcslow']
+  run_subprocess(command)
+
+
 def needs_rebuild(source, target):
   """Checks if the source file needs to be rebuilt.
 
@@ -300,6 +341,29 @@ def generate_webp_textures(target_directory):
     if needs_rebuild(png, out):
       convert_png_image_to_webp(png, out, WEBP_QUALITY)
 
+
+def generate_ktx_textures(target_directory):
+  """Cook KTX containers for all of the png files.
+
+  Skipped with a note when the cooking tool isn't installed; the engine
+  falls back to decoding the webp files at runtime.
+
+  Args:
+    target_directory: Path to the target assets directory.
+  """
+  if not PVRTEXTOOL:
+    sys.stderr.write('%s not found; skipping KTX texture cooking.\n' %
+                     PVRTEXTOOL_EXECUTABLE_NAME)
+    return
+  for png in PNG_TEXTURES:
+    out = processed_ktx_path(png, target_directory)
+    out_dir = os.path.dirname(out)
+    if not os.path.exists(out_dir):
+      os.makedirs(out_dir)
+    if needs_rebuild(png, out):
+      convert_png_image_to_ktx(png, out)
+
+
 def copy_assets(target_directory):
   """Copy modified assets to the target assets directory.
 
@@ -326,6 +390,75 @@ def copy_assets(target_directory):
              os.path.getmtime(source_filename))):
           shutil.copy2(source_filename, target_filename)
 
+# Name of the single-file asset bundle written into the assets directory.
+# Must match kAssetBundleFileName in src/pie_noon_game.cpp.
+ASSET_BUNDLE_NAME = 'asset_bundle.bin'
+
+# Alignment of each file's contents within the bundle, so that flatbuffers
+# can be parsed in place straight out of the mapping.
+ASSET_BUNDLE_ALIGNMENT = 16
+
+
+def generate_asset_bundle(target_directory):
+  """Pack every file under the assets directory into one bundle file.
+
+  The bundle is a 16 byte header ('PNBUNDLE', version, file count), a table
+  of (name_offset, name_length, data_offset, data_length) entries sorted by
+  name, a NUL-terminated string table of names relative to the assets
+  directory (always with '/' separators), and the concatenated file
+  contents. The game maps this one file at startup instead of opening each
+  asset individually; see LoadAssetBundle in src/utilities.cpp.
+
+  Args:
+    target_directory: Path to the target assets directory.
+  """
+  bundle_path = os.path.join(target_directory, ASSET_BUNDLE_NAME)
+  names = []
+  for dirpath, dirnames, files in os.walk(target_directory):
+    for name in files:
+      relative = os.path.relpath(os.path.join(dirpath, name),
+                                 target_directory)
+      relative = relative.replace(os.path.sep, '/')
+      if relative != ASSET_BUNDLE_NAME:
+        names.append(relative)
+  names.sort()
+
+  header_size = 16
+  entry_table_size = 16 * len(names)
+  string_table = b''
+  name_offsets = []
+  for name in names:
+    name_offsets.append(header_size + entry_table_size + len(string_table))
+    string_table += name.encode('utf-8') + b'\0'
+
+  data_offset = header_size + entry_table_size + len(string_table)
+  entries = b''
+  payload = b''
+  for i, name in enumerate(names):
+    with open(os.path.join(target_directory, name.replace('/', os.path.sep)),
+              'rb') as f:
+      data = f.read()
+    padding = -(data_offset + len(payload)) % ASSET_BUNDLE_ALIGNMENT
+    payload += b'\0' * padding
+    entries += struct.pack('<4I', name_offsets[i], len(name),
+                           data_offset + len(payload), len(data))
+    payload += data
+
+  with open(bundle_path, 'wb') as f:
+    f.write(struct.pack('<8sII', b'PNBUNDLE', 1, len(names)))
+    f.write(entries)
+    f.write(string_table)
+    f.write(payload)
+  sys.stdout.write('Bundled %d assets into %s.\n' % (len(names), bundle_path))
+
+
+def clean_asset_bundle():
+  """Delete the generated asset bundle."""
+  bundle_path = os.path.join(ASSETS_PATH, ASSET_BUNDLE_NAME)
+  if os.path.isfile(bundle_path):
+    os.remove(bundle_path)
+
+
 def clean_webp_textures():
   """Delete all the processed webp textures."""
   for webp in PNG_TEXTURES['output_files']:
@@ -333,6 +466,14 @@ def clean_webp_textures():
       os.remove(webp)
 
 
+def clean_ktx_textures():
+  """Delete all the cooked ktx textures."""
+  for png in PNG_TEXTURES:
+    ktx = processed_ktx_path(png, ASSETS_PATH)
+    if os.path.isfile(ktx):
+      os.remove(ktx)
+
+
 def clean_flatbuffer_binaries(target_directory):
   """Delete all the processed flatbuffer binaries.
 
@@ -350,6 +491,8 @@ def clean():
   """Delete all the processed files."""
   clean_flatbuffer_binaries()
   clean_webp_textures()
+  clean_ktx_textures()
+  clean_asset_bundle()
 
 
 def handle_build_error(error):
@@ -381,7 +524,7 @@ def main(argv):
   parser.add_argument('args', nargs=argparse.REMAINDER)
   args = parser.parse_args()
   target = args.args[1] if len(args.args) >= 2 else 'all'
-  if target not in ('all', 'flatbuffers', 'webp', 'clean'):
+  if target not in ('all', 'flatbuffers', 'webp', 'ktx', 'bundle', 'clean'):
     sys.stderr.write('No rule to build target %s.\n' % target)
 
   if target != 'clean':
@@ -398,6 +541,20 @@ def main(argv):
     except BuildError as error:
       handle_build_error(error)
       return 1
+  if target in ('all', 'ktx'):
+    try:
+      generate_ktx_textures(args.output)
+    except BuildError as error:
+      handle_build_error(error)
+      return 1
+  # The bundle must be generated last: it packs whatever the other targets
+  # left in the assets directory.
+  if target in ('all', 'bundle'):
+    try:
+      generate_asset_bundle(args.output)
+    except (IOError, OSError) as error:
+      sys.stderr.write('Error bundling assets: %s\n' % str(error))
+      return 1
   if target == 'clean':
     try:
       clean()
@@ -0,0 +1,201 @@
+#!/usr/bin/python
+# Copyright 2015 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Packs the textures of a set of materials into a single atlas sheet.
+
+Given a list of material JSON files under src/rawassets/materials, this
+script gathers the source images they reference, shelf-packs them into one
+sheet written to src/rawassets/textures, and rewrites each material to
+reference the sheet plus an 'atlas_regions' entry (see materials.fbs)
+describing the sub-rectangle the original image was packed into. Run
+build_assets.py afterwards to rebuild the material binaries and convert
+the sheet. Materials that share a sheet bind one texture at draw time
+instead of one per element, which collapses the menu's ~40 texture binds
+to a handful.
+
+Requires the Python Imaging Library (PIL or Pillow) to read and composite
+the source images.
+
+Example:
+  ./scripts/pack_texture_atlas.py --sheet ui_atlas \\
+      src/rawassets/materials/button_*.json
+"""
+
+import argparse
+import json
+import os
+import sys
+
+try:
+  from PIL import Image
+except ImportError:
+  Image = None
+
+# The project root directory, which is one level up from this script's
+# directory.
+PROJECT_ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__),
+                                            os.path.pardir))
+
+RAW_ASSETS_PATH = os.path.join(PROJECT_ROOT, 'src', 'rawassets')
+
+# Padding, in pixels, between packed images. One transparent pixel on each
+# side stops bilinear filtering from bleeding neighbouring regions into
+# each other.
+PADDING = 1
+
+
+class Error(Exception):
+  """Base error for problems found while packing."""
+
+
+def load_materials(material_paths):
+  """Parses material JSONs, returning (path, json) pairs.
+
+  Raises:
+    Error: if a material is already atlased or references no textures.
+  """
+  materials = []
+  for path in material_paths:
+    with open(path, 'r') as f:
+      material = json.load(f)
+    if material.get('atlas_regions'):
+      raise Error('%s is already atlased; run on the original materials.' %
+                  path)
+    if not material.get('texture_filenames'):
+      raise Error('%s references no textures.' % path)
+    materials.append((path, material))
+  return materials
+
+
+def gather_images(materials):
+  """Loads each distinct source image referenced by the materials.
+
+  Returns a dict of texture filename (as written in the material, e.g.
+  'textures/button_back.webp') to PIL image.
+  """
+  images = {}
+  for path, material in materials:
+    for texture in material['texture_filenames']:
+      if texture in images:
+        continue
+      image_path = os.path.join(RAW_ASSETS_PATH, texture)
+      # Materials reference the converted .webp; the source art next to it
+      # is the .png the conversion ran on.
+      png_path = os.path.splitext(image_path)[0] + '.png'
+      if os.path.exists(png_path):
+        image_path = png_path
+      if not os.path.exists(image_path):
+        raise Error('%s: can\'t find source image for %s' % (path, texture))
+      images[texture] = Image.open(image_path).convert('RGBA')
+  return images
+
+
+def next_power_of_two(n):
+  result = 1
+  while result < n:
+    result *= 2
+  return result
+
+
+def pack_images(images):
+  """Shelf-packs the images, tallest first, into a power-of-two sheet.
+
+  Returns (sheet_image, regions) where regions maps texture filename to
+  (x, y, width, height) in sheet pixels.
+  """
+  ordered = sorted(images.items(),
+                   key=lambda item: (-item[1].size[1], -item[1].size[0]))
+  sheet_width = next_power_of_two(
+      max(image.size[0] for _, image in ordered) + 2 * PADDING)
+  # Widen the sheet until the shelves pack into a sensible aspect ratio.
+  while True:
+    regions = {}
+    x = y = shelf_height = 0
+    for texture, image in ordered:
+      width, height = image.size
+      if x + width + 2 * PADDING > sheet_width:
+        y += shelf_height
+        x = shelf_height = 0
+      regions[texture] = (x + PADDING, y + PADDING, width, height)
+      x += width + 2 * PADDING
+      shelf_height = max(shelf_height, height + 2 * PADDING)
+    sheet_height = next_power_of_two(y + shelf_height)
+    if sheet_height <= sheet_width or sheet_width >= 2048:
+      break
+    sheet_width *= 2
+
+  sheet = Image.new('RGBA', (sheet_width, sheet_height), (0, 0, 0, 0))
+  for texture, image in ordered:
+    sheet.paste(image, regions[texture][:2])
+  return sheet, regions
+
+
+def rewrite_materials(materials, regions, sheet_name, sheet_size):
+  """Points each material at the sheet and records its atlas regions."""
+  sheet_texture = 'textures/%s.webp' % sheet_name
+  for path, material in materials:
+    atlas_regions = []
+    for texture in material['texture_filenames']:
+      x, y, width, height = regions[texture]
+      atlas_regions.append({
+          'u0': float(x) / sheet_size[0],
+          'v0': float(y) / sheet_size[1],
+          'u1': float(x + width) / sheet_size[0],
+          'v1': float(y + height) / sheet_size[1],
+          'width': width,
+          'height': height,
+      })
+    material['texture_filenames'] = (
+        [sheet_texture] * len(material['texture_filenames']))
+    material['atlas_regions'] = atlas_regions
+    with open(path, 'w') as f:
+      json.dump(material, f, indent=4, sort_keys=True)
+      f.write('\n')
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=
+                                   argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--sheet', default='ui_atlas',
+                      help='basename of the generated atlas sheet')
+  parser.add_argument('materials', nargs='+',
+                      help='material JSON files to pack')
+  args = parser.parse_args()
+
+  if not Image:
+    sys.stderr.write('pack_texture_atlas.py requires PIL or Pillow.\n')
+    return 1
+
+  try:
+    materials = load_materials(args.materials)
+    images = gather_images(materials)
+    sheet, regions = pack_images(images)
+  except Error as error:
+    sys.stderr.write('Error: %s\n' % error)
+    return 1
+
+  sheet_path = os.path.join(RAW_ASSETS_PATH, 'textures',
+                            '%s.png' % args.sheet)
+  sheet.save(sheet_path)
+  rewrite_materials(materials, regions, args.sheet, sheet.size)
+  sys.stdout.write('Packed %d images into %s (%dx%d); rewrote %d materials.\n'
+                   % (len(images), sheet_path, sheet.size[0], sheet.size[1],
+                      len(materials)))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -30,6 +30,7 @@ void AiController::Initialize(GameState* gamestate, const Config* config,
   character_id_ = character_id;
   time_to_next_action_ = 0;
   block_timer_ = 0;
+  frame_count_ = 0;
 }
 
 void AiController::AdvanceFrame(WorldTime delta_time) {
@@ -39,6 +40,30 @@ void AiController::AdvanceFrame(WorldTime delta_time) {
   ClearAllLogicalInputs();
   time_to_next_action_ -= delta_time;
 
+  // if we're blocking, keep blocking. (The state machine ignores inputs in
+  // states where blocking makes no sense, so this needn't re-check state.)
+  if (block_timer_ > 0) {
+    block_timer_ -= delta_time;
+    SetLogicalInputs(LogicalInputs_Deflect, true);
+    return;
+  }
+
+  // Stagger the thinking: each AI runs its decision logic on its own phase
+  // of ai_think_period_frames, so a mostly-AI lobby spreads the cost over
+  // the period instead of every AI thinking every frame. Timers still
+  // count down in real time above; a decision just lands on the AI's next
+  // tick, at most period - 1 frames late -- noise next to the configured
+  // time-between-actions variance.
+  ++frame_count_;
+  const unsigned int think_period =
+      std::max(1u, config_->ai_think_period_frames());
+  if ((frame_count_ + static_cast<unsigned int>(character_id_)) %
+          think_period != 0) {
+    return;
+  }
+
+  if (time_to_next_action_ > 0) return;
+
   // Check to make sure we're valid to be sending input.
   const Character* character = gamestate_->characters()[character_id_].get();
   auto character_state = character->State();
@@ -48,15 +73,6 @@ void AiController::AdvanceFrame(WorldTime delta_time) {
     return;
   }
 
-  // if we're blocking, keep blocking.
-  if (block_timer_ > 0) {
-    block_timer_ -= delta_time;
-    SetLogicalInputs(LogicalInputs_Deflect, true);
-    return;
-  }
-
-  if (time_to_next_action_ > 0) return;
-
   time_to_next_action_ = mathfu::RandomInRange<WorldTime>(
       config_->ai_minimum_time_between_actions(),
       config_->ai_maximum_time_between_actions());
@@ -52,6 +52,10 @@ class AiController : public Controller {
   GameState* gamestate_;  // Pointer to the gamestate object
   const Config* config_;  // Pointer to the config structure
   WorldTime time_to_next_action_;
+
+  // Frames advanced since Initialize; with character_id_ it picks this
+  // AI's phase of the config's ai_think_period_frames.
+  unsigned int frame_count_;
 };
 
 }  // pie_noon
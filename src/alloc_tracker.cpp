@@ -0,0 +1,80 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "alloc_tracker.h"
+
+namespace fpl {
+
+AllocTracker::TagStats AllocTracker::stats_[AllocTracker::kTagCount] = {};
+AllocTracker::Tag AllocTracker::current_tag_ = AllocTracker::kTagUntagged;
+
+const char *AllocTracker::TagName(Tag tag) {
+  static const char *kNames[kTagCount] = {"untagged", "textures", "fonts",
+                                          "entities", "audio"};
+  return kNames[tag];
+}
+
+void AllocTracker::Track(Tag tag, size_t bytes) {
+  TagStats &stats = stats_[tag];
+  stats.current += bytes;
+  if (stats.current > stats.high_water) stats.high_water = stats.current;
+  if (stats.budget != 0 && stats.current > stats.budget &&
+      !stats.over_budget) {
+    stats.over_budget = true;
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "alloc: %s over budget: %u KB used, budget %u KB",
+                TagName(tag), static_cast<uint32_t>(stats.current / 1024),
+                static_cast<uint32_t>(stats.budget / 1024));
+  }
+}
+
+void AllocTracker::Release(Tag tag, size_t bytes) {
+  TagStats &stats = stats_[tag];
+  assert(bytes <= stats.current);
+  stats.current -= bytes;
+  if (stats.budget != 0 && stats.current <= stats.budget) {
+    stats.over_budget = false;  // Re-arm the warning for the next excursion.
+  }
+}
+
+void AllocTracker::TrackScoped(size_t bytes) { Track(current_tag_, bytes); }
+
+void AllocTracker::ReleaseScoped(size_t bytes) {
+  Release(current_tag_, bytes);
+}
+
+size_t AllocTracker::CurrentBytes(Tag tag) { return stats_[tag].current; }
+
+size_t AllocTracker::HighWaterBytes(Tag tag) {
+  return stats_[tag].high_water;
+}
+
+void AllocTracker::SetBudget(Tag tag, size_t bytes) {
+  stats_[tag].budget = bytes;
+}
+
+void AllocTracker::LogStatus() {
+  for (int tag = 0; tag < kTagCount; ++tag) {
+    const TagStats &stats = stats_[tag];
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "alloc: %-8s current %6u KB  high water %6u KB  budget %6u KB",
+                TagName(static_cast<Tag>(tag)),
+                static_cast<uint32_t>(stats.current / 1024),
+                static_cast<uint32_t>(stats.high_water / 1024),
+                static_cast<uint32_t>(stats.budget / 1024));
+  }
+}
+
+}  // namespace fpl
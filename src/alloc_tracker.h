@@ -0,0 +1,97 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PIE_NOON_ALLOC_TRACKER_H
+#define PIE_NOON_ALLOC_TRACKER_H
+
+#include <cstddef>
+
+namespace fpl {
+
+// Tagged accounting of the game's big heap consumers. This is not a malloc
+// shim: subsystems explicitly report their large buffer allocations
+// (decoded textures, glyph cache pages, entity pools, sound banks), which
+// is cheap, works with GL-side estimates, and gives us attribution when a
+// 512MB device hits the OOM killer during the load burst.
+//
+// Per-tag budgets come from the config; crossing one logs a warning with
+// the offending tag's numbers. High-water marks survive frees so the
+// worst moment of a session can be read back at exit via LogStatus().
+//
+// Everything is static: allocations are reported from several modules and
+// there is exactly one heap to account for.
+class AllocTracker {
+ public:
+  enum Tag {
+    kTagUntagged = 0,  // Scoped reports with no ScopedAllocTag active.
+    kTagTextures,
+    kTagFonts,
+    kTagEntities,
+    kTagAudio,
+    kTagCount
+  };
+
+  static const char *TagName(Tag tag);
+
+  // Record 'bytes' allocated or freed under an explicit tag.
+  static void Track(Tag tag, size_t bytes);
+  static void Release(Tag tag, size_t bytes);
+
+  // Record under the innermost ScopedAllocTag. Used by generic containers
+  // (e.g. the entity VectorPools) that shouldn't hardcode a subsystem.
+  static void TrackScoped(size_t bytes);
+  static void ReleaseScoped(size_t bytes);
+
+  static size_t CurrentBytes(Tag tag);
+  static size_t HighWaterBytes(Tag tag);
+
+  // Budget in bytes; 0 (the default) disables the check. A warning is
+  // logged when a tag first crosses its budget, and again after it has
+  // dropped back under.
+  static void SetBudget(Tag tag, size_t bytes);
+
+  // Log one line per tag: current bytes, high-water mark and budget.
+  static void LogStatus();
+
+ private:
+  friend class ScopedAllocTag;
+
+  struct TagStats {
+    size_t current;
+    size_t high_water;
+    size_t budget;
+    bool over_budget;  // Warning already issued for the current excursion.
+  };
+
+  static TagStats stats_[kTagCount];
+  static Tag current_tag_;
+};
+
+// Attributes TrackScoped/ReleaseScoped reports to 'tag' for the lifetime
+// of the scope. Nests; the previous tag is restored on destruction.
+class ScopedAllocTag {
+ public:
+  explicit ScopedAllocTag(AllocTracker::Tag tag)
+      : previous_(AllocTracker::current_tag_) {
+    AllocTracker::current_tag_ = tag;
+  }
+  ~ScopedAllocTag() { AllocTracker::current_tag_ = previous_; }
+
+ private:
+  AllocTracker::Tag previous_;
+};
+
+}  // namespace fpl
+
+#endif  // PIE_NOON_ALLOC_TRACKER_H
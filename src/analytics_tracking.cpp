@@ -15,87 +15,185 @@
 #include "precompiled.h"
 #include "analytics_tracking.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace fpl {
 
-void SendTrackerEvent(const char *category, const char *action) {
+namespace {
+
+// One queued tracker event. Strings are copied into fixed-size buffers so
+// that enqueueing never allocates; every call site passes short literals.
+struct TrackerEvent {
+  char category[32];
+  char action[48];
+  char label[48];
+  int value;
+  int num_args;  // 2, 3 or 4: which SendTrackerEvent overload was called.
+};
+
+// Capacity of the event ring. Events arrive in small bursts (a handful per
+// state transition), so this is generous; if the ring somehow fills, extra
+// events are dropped rather than ever stalling the frame.
+static const size_t kQueueCapacity = 64;
+
+// How long the flush thread sleeps between drains. Events feed offline
+// analysis, so half a second of added latency is irrelevant.
+static const int kFlushIntervalMs = 500;
+
+void CopyField(char *dest, size_t dest_size, const char *source) {
+  strncpy(dest, source != nullptr ? source : "", dest_size);
+  dest[dest_size - 1] = '\0';
+}
+
+// Dispatch a single event to the platform tracker. On Android this crosses
+// JNI, which can take a millisecond or more per call on older devices --
+// the reason dispatch happens on the flush thread rather than the game
+// thread. SDL_AndroidGetJNIEnv attaches the calling thread to the JVM on
+// first use, so it is safe to call here.
+void SendTrackerEventNow(const TrackerEvent &event) {
 #ifdef __ANDROID__
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "SendTrackerEvent (%s, %s)\n",
-              category, action);
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+              "SendTrackerEvent (%s, %s, %s, %i)\n", event.category,
+              event.action, event.label, event.value);
   JNIEnv *env = reinterpret_cast<JNIEnv *>(SDL_AndroidGetJNIEnv());
   jobject activity = reinterpret_cast<jobject>(SDL_AndroidGetActivity());
   jclass fpl_class = env->GetObjectClass(activity);
-  jmethodID send_tracker_event = env->GetMethodID(
-      fpl_class, "SendTrackerEvent", "(Ljava/lang/String;Ljava/lang/String;)V");
-  jstring category_string = env->NewStringUTF(category);
-  jstring action_string = env->NewStringUTF(action);
-  env->CallVoidMethod(activity, send_tracker_event, category_string,
-                      action_string);
+  jstring category_string = env->NewStringUTF(event.category);
+  jstring action_string = env->NewStringUTF(event.action);
+  jstring label_string =
+      event.num_args >= 3 ? env->NewStringUTF(event.label) : nullptr;
+  switch (event.num_args) {
+    case 2: {
+      jmethodID send_tracker_event =
+          env->GetMethodID(fpl_class, "SendTrackerEvent",
+                           "(Ljava/lang/String;Ljava/lang/String;)V");
+      env->CallVoidMethod(activity, send_tracker_event, category_string,
+                          action_string);
+      break;
+    }
+    case 3: {
+      jmethodID send_tracker_event = env->GetMethodID(
+          fpl_class, "SendTrackerEvent",
+          "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
+      env->CallVoidMethod(activity, send_tracker_event, category_string,
+                          action_string, label_string);
+      break;
+    }
+    default: {
+      jmethodID send_tracker_event = env->GetMethodID(
+          fpl_class, "SendTrackerEvent",
+          "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;I)V");
+      env->CallVoidMethod(activity, send_tracker_event, category_string,
+                          action_string, label_string, event.value);
+      break;
+    }
+  }
+  if (label_string != nullptr) env->DeleteLocalRef(label_string);
   env->DeleteLocalRef(action_string);
   env->DeleteLocalRef(category_string);
   env->DeleteLocalRef(fpl_class);
   env->DeleteLocalRef(activity);
 #else
-  (void)category;
-  (void)action;
+  (void)event;
 #endif
 }
 
+// Single-producer (game thread) / single-consumer (flush thread) ring of
+// pending events. Enqueueing is one struct copy plus one atomic store; the
+// flush thread wakes every kFlushIntervalMs and dispatches whatever has
+// accumulated as one batch.
+class AnalyticsQueue {
+ public:
+  AnalyticsQueue() : head_(0), tail_(0), exit_(false) {
+    flush_thread_ = std::thread(&AnalyticsQueue::FlushLoop, this);
+  }
+
+  ~AnalyticsQueue() {
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      exit_ = true;
+    }
+    wake_.notify_one();
+    flush_thread_.join();
+    // Best effort: send anything still queued before the process goes away.
+    Drain();
+  }
+
+  void Enqueue(const TrackerEvent &event) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kQueueCapacity) {
+      // Full. Losing an analytics event beats blocking the frame loop.
+      return;
+    }
+    events_[head % kQueueCapacity] = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+ private:
+  void FlushLoop() {
+    // Analytics should never compete with the game for a core.
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (!exit_) {
+      wake_.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs));
+      Drain();
+    }
+  }
+
+  void Drain() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    while (tail != head_.load(std::memory_order_acquire)) {
+      SendTrackerEventNow(events_[tail % kQueueCapacity]);
+      ++tail;
+      tail_.store(tail, std::memory_order_release);
+    }
+  }
+
+  TrackerEvent events_[kQueueCapacity];
+  std::atomic<size_t> head_;  // Next slot to write. Advanced by producer.
+  std::atomic<size_t> tail_;  // Next slot to read. Advanced by consumer.
+  bool exit_;                 // Guarded by wake_mutex_.
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::thread flush_thread_;
+};
+
+// Created on first event; the flush thread is torn down (after a final
+// drain) when static destructors run at exit.
+AnalyticsQueue &Queue() {
+  static AnalyticsQueue queue;
+  return queue;
+}
+
+void QueueTrackerEvent(const char *category, const char *action,
+                       const char *label, int value, int num_args) {
+  TrackerEvent event;
+  CopyField(event.category, sizeof(event.category), category);
+  CopyField(event.action, sizeof(event.action), action);
+  CopyField(event.label, sizeof(event.label), label);
+  event.value = value;
+  event.num_args = num_args;
+  Queue().Enqueue(event);
+}
+
+}  // namespace
+
+void SendTrackerEvent(const char *category, const char *action) {
+  QueueTrackerEvent(category, action, nullptr, 0, 2);
+}
+
 void SendTrackerEvent(const char *category, const char *action,
                       const char *label) {
-#ifdef __ANDROID__
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "SendTrackerEvent (%s, %s, %s)\n",
-              category, action, label);
-  JNIEnv *env = reinterpret_cast<JNIEnv *>(SDL_AndroidGetJNIEnv());
-  jobject activity = reinterpret_cast<jobject>(SDL_AndroidGetActivity());
-  jclass fpl_class = env->GetObjectClass(activity);
-  jmethodID send_tracker_event = env->GetMethodID(
-      fpl_class, "SendTrackerEvent",
-      "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
-  jstring category_string = env->NewStringUTF(category);
-  jstring action_string = env->NewStringUTF(action);
-  jstring label_string = env->NewStringUTF(label);
-  env->CallVoidMethod(activity, send_tracker_event, category_string,
-                      action_string, label_string);
-  env->DeleteLocalRef(label_string);
-  env->DeleteLocalRef(action_string);
-  env->DeleteLocalRef(category_string);
-  env->DeleteLocalRef(fpl_class);
-  env->DeleteLocalRef(activity);
-#else
-  (void)category;
-  (void)action;
-  (void)label;
-#endif
+  QueueTrackerEvent(category, action, label, 0, 3);
 }
 
 void SendTrackerEvent(const char *category, const char *action,
                       const char *label, int value) {
-#ifdef __ANDROID__
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-              "SendTrackerEvent (%s, %s, %s, %i)\n", category, action, label,
-              value);
-  JNIEnv *env = reinterpret_cast<JNIEnv *>(SDL_AndroidGetJNIEnv());
-  jobject activity = reinterpret_cast<jobject>(SDL_AndroidGetActivity());
-  jclass fpl_class = env->GetObjectClass(activity);
-  jmethodID send_tracker_event = env->GetMethodID(
-      fpl_class, "SendTrackerEvent",
-      "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;I)V");
-  jstring category_string = env->NewStringUTF(category);
-  jstring action_string = env->NewStringUTF(action);
-  jstring label_string = env->NewStringUTF(label);
-  env->CallVoidMethod(activity, send_tracker_event, category_string,
-                      action_string, label_string, value);
-  env->DeleteLocalRef(label_string);
-  env->DeleteLocalRef(action_string);
-  env->DeleteLocalRef(category_string);
-  env->DeleteLocalRef(fpl_class);
-  env->DeleteLocalRef(activity);
-#else
-  (void)category;
-  (void)action;
-  (void)label;
-  (void)value;
-#endif
+  QueueTrackerEvent(category, action, label, value, 4);
 }
 
 }  // namespace fpl
@@ -17,6 +17,10 @@
 
 namespace fpl {
 
+// Record an analytics event. Events are queued and sent to the platform
+// tracker in batches from a low-priority background thread, so these are
+// cheap to call from the frame loop. The strings must be short (they are
+// copied into fixed-size buffers); all current callers pass literals.
 void SendTrackerEvent(const char *category, const char *action);
 
 void SendTrackerEvent(const char *category, const char *action,
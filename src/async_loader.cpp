@@ -34,7 +34,57 @@ class BookendAsyncResource : public AsyncResource {
 // static
 std::string BookendAsyncResource::kBookendFileName = "bookend";
 
-AsyncLoader::AsyncLoader() {
+AsyncDoneQueue::AsyncDoneQueue() : tail_(0), head_(0) {
+  for (size_t i = 0; i < kCapacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+    cells_[i].value = nullptr;
+  }
+}
+
+bool AsyncDoneQueue::Push(AsyncResource *res) {
+  size_t pos = tail_.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &cell = cells_[pos & (kCapacity - 1)];
+    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    const intptr_t dif =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (dif == 0) {
+      // The cell is free; try to claim it against the other producers.
+      if (tail_.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed)) {
+        cell.value = res;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (dif < 0) {
+      return false;  // Full: the consumer hasn't freed this cell yet.
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+AsyncResource *AsyncDoneQueue::Pop() {
+  const size_t pos = head_.load(std::memory_order_relaxed);
+  Cell &cell = cells_[pos & (kCapacity - 1)];
+  const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+  if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0) {
+    return nullptr;  // Empty: no producer has filled this cell yet.
+  }
+  AsyncResource *res = cell.value;
+  cell.sequence.store(pos + kCapacity, std::memory_order_release);
+  head_.store(pos + 1, std::memory_order_relaxed);
+  return res;
+}
+
+bool AsyncDoneQueue::Empty() const {
+  const size_t pos = head_.load(std::memory_order_relaxed);
+  const Cell &cell = cells_[pos & (kCapacity - 1)];
+  const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+  return static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0;
+}
+
+AsyncLoader::AsyncLoader() : outstanding_(0), finalize_budget_(0) {
   mutex_ = SDL_CreateMutex();
   job_semaphore_ = SDL_CreateSemaphore(0);
   assert(mutex_ && job_semaphore_);
@@ -42,7 +92,10 @@ AsyncLoader::AsyncLoader() {
 
 AsyncLoader::~AsyncLoader() {
   StopLoadingWhenComplete();
-  SDL_WaitThread(worker_thread_, nullptr);
+  for (size_t i = 0; i < worker_threads_.size(); ++i) {
+    SDL_WaitThread(worker_threads_[i], nullptr);
+  }
+  worker_threads_.clear();
 
   if (mutex_) {
     SDL_DestroyMutex(mutex_);
@@ -54,29 +107,60 @@ AsyncLoader::~AsyncLoader() {
   }
 }
 
-void AsyncLoader::QueueJob(AsyncResource *res) {
-  Lock([this, res]() { queue_.push_back(res); });
+void AsyncLoader::QueueJob(AsyncResource *res, int priority) {
+  res->priority_ = priority;
+  // The bookend never comes back over the done queue, so don't count it.
+  if (!BookendAsyncResource::IsBookend(*res)) {
+    outstanding_.fetch_add(1, std::memory_order_relaxed);
+  }
+  Lock([this, res]() {
+    // Keep the queue sorted by descending priority, preserving queueing
+    // order between jobs of equal priority.
+    auto it = queue_.begin();
+    while (it != queue_.end() && (*it)->priority_ >= res->priority_) ++it;
+    queue_.insert(it, res);
+  });
   SDL_SemPost(job_semaphore_);
 }
 
 void AsyncLoader::LoaderWorker() {
+  // Run below normal priority so the streamed-music decode thread inside
+  // the audio mixer keeps its core on dual-core devices. Asset loads are
+  // IO-bound and can absorb the extra latency; audible dropouts during
+  // kLoading cannot. Affects only the calling (worker) thread.
+  SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
   for (;;) {
-    auto res = LockReturn<AsyncResource *>(
-        [this]() { return queue_.empty() ? nullptr : queue_[0]; });
+    auto res = LockReturn<AsyncResource *>([this]() -> AsyncResource * {
+      if (queue_.empty()) return nullptr;
+      auto front = queue_[0];
+      // Leave the bookend in the queue so the other workers see it too.
+      if (BookendAsyncResource::IsBookend(*front)) return front;
+      queue_.erase(queue_.begin());
+      return front;
+    });
     if (!res) {
       SDL_SemWait(job_semaphore_);
       continue;
     }
     // Stop loading once we reach the bookend enqueued by
     // StopLoadingWhenComplete(). To start loading again, call StartLoading().
-    if (BookendAsyncResource::IsBookend(*res)) break;
+    if (BookendAsyncResource::IsBookend(*res)) {
+      // Wake the next worker so it exits as well.
+      SDL_SemPost(job_semaphore_);
+      break;
+    }
     SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "async load: %s",
                  res->filename_.c_str());
     res->Load();
-    Lock([this, res]() {
-      queue_.erase(queue_.begin());
-      done_.push_back(res);
-    });
+    // Hand the result back without touching the mutex. The ring is sized
+    // so this practically never spins; workers may block, the main thread
+    // never does. The decrement is ordered after the push so the main
+    // thread can trust outstanding_ == 0 to mean "all results visible".
+    while (!done_queue_.Push(res)) {
+      SDL_Delay(1);
+    }
+    outstanding_.fetch_sub(1, std::memory_order_release);
   }
 }
 
@@ -86,28 +170,56 @@ int AsyncLoader::LoaderThread(void *user_data) {
 }
 
 void AsyncLoader::StartLoading() {
-  worker_thread_ =
-      SDL_CreateThread(AsyncLoader::LoaderThread, "FPL Loader Thread", this);
-  assert(worker_thread_);
+  // Scale the worker pool with the hardware: leave a core for the main
+  // thread, but always run at least one worker. More than a few workers
+  // just contend on IO, so cap the pool.
+  static const int kMaxWorkers = 4;
+  const int num_workers =
+      mathfu::Clamp(SDL_GetCPUCount() - 1, 1, kMaxWorkers);
+  for (int i = 0; i < num_workers; ++i) {
+    auto thread =
+        SDL_CreateThread(AsyncLoader::LoaderThread, "FPL Loader Thread", this);
+    assert(thread);
+    worker_threads_.push_back(thread);
+  }
 }
 
 void AsyncLoader::StopLoadingWhenComplete() {
-  // When the loader thread hits the bookend, it will exit.
+  // When the loader thread hits the bookend, it will exit. Queue it at the
+  // lowest possible priority so it sorts behind any real work still pending.
+  static const int kBookendPriority = -(1 << 30);
   static BookendAsyncResource bookend;
-  QueueJob(&bookend);
+  QueueJob(&bookend, kBookendPriority);
 }
 
 bool AsyncLoader::TryFinalize() {
-  for (;;) {
-    auto res = LockReturn<AsyncResource *>(
-        [this]() { return done_.empty() ? nullptr : done_[0]; });
-    if (!res) break;
+  // Drain everything the workers have delivered since last frame into the
+  // main-thread-only pending list. This is the only rendezvous with the
+  // workers, and it's lock-free.
+  for (AsyncResource *res = done_queue_.Pop(); res; res = done_queue_.Pop()) {
+    finalize_pending_.push_back(res);
+  }
+  size_t uploaded = 0;
+  while (!finalize_pending_.empty()) {
+    // Finalize the highest priority completed resource first; loads finish
+    // in whatever order the workers get to them, not queueing order.
+    auto best = finalize_pending_.begin();
+    for (auto it = best + 1; it != finalize_pending_.end(); ++it) {
+      if ((*it)->priority_ > (*best)->priority_) best = it;
+    }
+    AsyncResource *res = *best;
+    finalize_pending_.erase(best);
     SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "finalize: %s",
                  res->filename_.c_str());
     res->Finalize();
-    Lock([this]() { done_.erase(done_.begin()); });
+    uploaded += res->FinalizeSize();
+    // Spill anything left over into the next frame once the upload budget is
+    // spent. We've made progress, so loading still completes eventually.
+    if (finalize_budget_ && uploaded >= finalize_budget_) break;
   }
-  return LockReturn<bool>([this]() { return queue_.empty(); });
+  return finalize_pending_.empty() &&
+         outstanding_.load(std::memory_order_acquire) == 0 &&
+         done_queue_.Empty();
 }
 
 }  // namespace fpl
@@ -15,6 +15,8 @@
 #ifndef FPL_ASYNC_LOADER_H
 #define FPL_ASYNC_LOADER_H
 
+#include <atomic>
+
 namespace fpl {
 
 class AsyncLoader;
@@ -23,50 +25,113 @@ class AsyncLoader;
 class AsyncResource {
  public:
   AsyncResource(const std::string &filename)
-      : filename_(filename), data_(nullptr) {}
+      : filename_(filename), data_(nullptr), priority_(0) {}
   virtual ~AsyncResource() {}
 
   // Load should perform the actual loading of filename_, and store the
-  // result in data_, or nullptr upon failure. It is called on the loader
+  // result in data_, or nullptr upon failure. It is called on a loader
   // thread, so should not access any program state outside of this object.
-  // Since there will be only one loader thread, any libraries called by Load
-  // need not be MT-safe as long as they're not also called by the main thread.
+  // Loads run concurrently on a pool of worker threads, so Load
+  // implementations, and the libraries they call, must be safe to run from
+  // several threads at once.
   virtual void Load() = 0;
 
   // This should implement the behavior of turning data_ into the actual
   // desired resource. Called on the main thread only.
   virtual void Finalize() = 0;
 
+  // An estimate of how many bytes Finalize will push to the GPU, once Load
+  // has completed. Used by AsyncLoader to spread uploads over several frames.
+  // The default of 0 means "cheap": such resources never consume budget.
+  virtual size_t FinalizeSize() const { return 0; }
+
   const std::string &filename() const { return filename_; }
 
  protected:
   std::string filename_;
   uint8_t *data_;
 
+  // Higher priority resources get loaded, and finalized, before lower ones.
+  // Set by AsyncLoader::QueueJob.
+  int priority_;
+
   friend class AsyncLoader;
 };
 
+// Bounded lock-free queue handing loaded-but-unfinalized resources from the
+// worker threads (multiple producers) to the main thread (single consumer).
+// An array ring where each cell carries a sequence number (Vyukov's bounded
+// MPMC queue, simplified for a single consumer), so TryFinalize on the main
+// thread never takes the loader mutex and never blocks on the workers.
+class AsyncDoneQueue {
+ public:
+  AsyncDoneQueue();
+
+  // Called by worker threads. Returns false when the ring is full, in which
+  // case the (blockable) worker should retry after a short wait.
+  bool Push(AsyncResource *res);
+
+  // Called by the main thread only. Returns nullptr when empty.
+  AsyncResource *Pop();
+
+  // Called by the main thread only.
+  bool Empty() const;
+
+ private:
+  // Must be a power of two, and comfortably larger than the number of
+  // resources that can complete between two TryFinalize calls.
+  static const size_t kCapacity = 256;
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    AsyncResource *value;
+  };
+
+  Cell cells_[kCapacity];
+  std::atomic<size_t> tail_;  // Next slot a producer claims.
+  std::atomic<size_t> head_;  // Next slot the consumer reads.
+};
+
 class AsyncLoader {
  public:
   AsyncLoader();
   ~AsyncLoader();
 
-  // Call this any number of times before StartLoading.
-  void QueueJob(AsyncResource *res);
+  // Call this any number of times before StartLoading. Jobs with a higher
+  // priority get loaded and finalized before lower priority ones; equal
+  // priorities keep their queueing order.
+  void QueueJob(AsyncResource *res, int priority = 0);
 
-  // Launches the loading thread.
+  // Launches the loading threads: one worker per spare core, to a small
+  // maximum, so texture decode scales with the hardware.
   void StartLoading();
 
-  // Cleans-up the background loading thread once all jobs have been completed.
-  // You can restart with StartLoading() if you like.
+  // Cleans-up the background loading threads once all jobs have been
+  // completed. You can restart with StartLoading() if you like.
   void StopLoadingWhenComplete();
 
   // Call this once per frame after StartLoading. Will call Finalize on any
   // resources that have finished loading. One it returns true, that means
   // the queue is empty, all resources have been processed, and the loading
-  // thread has terminated.
+  // threads have terminated.
+  // When a finalize budget is set, at most that many bytes (as reported by
+  // FinalizeSize) are uploaded per call, so a burst of completed textures
+  // gets amortized over several frames instead of hitching one.
   bool TryFinalize();
 
+  // Cap the bytes TryFinalize may upload to the GPU per call. At least one
+  // resource is always finalized, so loading still makes progress even if a
+  // single resource exceeds the budget. 0 (the default) means no cap.
+  void set_finalize_budget(size_t bytes_per_frame) {
+    finalize_budget_ = bytes_per_frame;
+  }
+
+  // Number of queued jobs the workers haven't handed back yet. Approximate
+  // while loading is in flight; intended for diagnostics.
+  int NumPendingJobs() const {
+    return outstanding_.load(std::memory_order_relaxed);
+  }
+
  private:
   void Lock(const std::function<void()> &body) {
     auto err = SDL_LockMutex(mutex_);
@@ -85,13 +150,32 @@ class AsyncLoader {
   void LoaderWorker();
   static int LoaderThread(void *user_data);
 
-  std::vector<AsyncResource *> queue_, done_;
+  // Jobs waiting to be picked up by a worker. Only this queue is protected
+  // by mutex_; once loaded, resources travel back over the lock-free
+  // done_queue_ instead.
+  std::vector<AsyncResource *> queue_;
+
+  // Loaded resources on their way to the main thread.
+  AsyncDoneQueue done_queue_;
+
+  // Resources drained from done_queue_ but not yet finalized (e.g. because
+  // the upload budget ran out). Main thread only.
+  std::vector<AsyncResource *> finalize_pending_;
+
+  // Number of queued resources that haven't been handed back over
+  // done_queue_ yet. Decremented (with release ordering) after the push, so
+  // once the main thread reads zero, everything is visible in done_queue_.
+  std::atomic<int> outstanding_;
+
+  // See set_finalize_budget.
+  size_t finalize_budget_;
 
-  // Keep handle to the worker thread around so that we can wait for it to
-  // finish before destroying the class.
-  SDL_Thread *worker_thread_;
+  // Keep handles to the worker threads around so that we can wait for them
+  // to finish before destroying the class.
+  std::vector<SDL_Thread *> worker_threads_;
 
-  // This lock protects ALL state in this class, i.e. the two vectors.
+  // Protects queue_. The main thread only takes this in QueueJob, never
+  // per-frame.
   SDL_mutex *mutex_;
 
   // Kick-off the worker thread when a new job arrives.
@@ -35,22 +35,20 @@ using mathfu::mat4;
 namespace fpl {
 namespace pie_noon {
 
-static const float kMaxPosition = 20.0f;
-
 Character::Character(
     CharacterId id, Controller* controller, const Config& config,
     const CharacterStateMachineDef* character_state_machine_def)
-    : config_(&config),
-      id_(id),
+    : position_(mathfu::kZeros3f),
       target_(0),
       health_(0),
       pie_damage_(0),
-      position_(mathfu::kZeros3f),
+      visible_(true),
       controller_(controller),
-      just_joined_game_(false),
       state_machine_(character_state_machine_def),
-      victory_state_(kResultUnknown),
-      visible_(true) {
+      id_(id),
+      config_(&config),
+      just_joined_game_(false),
+      victory_state_(kResultUnknown) {
   ResetStats();
 }
 
@@ -62,6 +60,7 @@ void Character::Reset(CharacterId target, CharacterHealth health,
   pie_damage_ = 0;
   position_ = position;
   state_machine_.Reset();
+  timeline_cursor_.Rewind();
   victory_state_ = kResultUnknown;
   visible_ = true;
 
@@ -70,6 +69,19 @@ void Character::Reset(CharacterId target, CharacterHealth health,
 
   face_angle_.InitializeWithTarget(init, engine,
                                    motive::Current1f(face_angle.ToRadians()));
+
+  // Start interpolation history at the reset transform so the first
+  // rendered frame doesn't blend from stale data.
+  CaptureRenderState();
+}
+
+void Character::SetFaceAngle(Angle angle, motive::MotiveEngine* engine) {
+  // Re-initialize the motivator at the new angle; the same init as Reset
+  // uses, so the angle holds until the next SetTarget.
+  motive::OvershootInit init;
+  OvershootInitFromFlatBuffers(*config_->face_angle_def(), &init);
+  face_angle_.InitializeWithTarget(init, engine,
+                                   motive::Current1f(angle.ToRadians()));
 }
 
 void Character::SetTarget(CharacterId target, Angle angle_to_target) {
@@ -127,63 +139,73 @@ AirbornePie::AirbornePie(CharacterId original_source, const Character& source,
                          const Character& target, WorldTime start_time,
                          WorldTime flight_time, CharacterHealth original_damage,
                          CharacterHealth damage, float start_height,
-                         float peak_height, int rotations,
-                         motive::MotiveEngine* engine)
+                         float peak_height, int rotations)
     : original_source_(original_source),
       source_(source.id()),
       target_(target.id()),
       start_time_(start_time),
       flight_time_(flight_time),
       original_damage_(original_damage),
-      damage_(damage) {
-  // x,z positions are within a reasonable bound.
-  // Rotations are anglular values.
-  const motive::SmoothInit position_init(
-      fpl::Range(-kMaxPosition, kMaxPosition), false);
-  const motive::SmoothInit rotation_init(fpl::Range(-kPi, kPi), true);
-
-  // Move x,z at constant speed from source to target.
-  const motive::MotiveTarget1f x_target(motive::CurrentToTargetConstVelocity1f(
-      source.position().x(), target.position().x(), flight_time));
-  const motive::MotiveTarget1f z_target(motive::CurrentToTargetConstVelocity1f(
-      source.position().z(), target.position().z(), flight_time));
-
-  // Move y along a trajectory that starts and ends at 'start_height' and
-  // tops out at 'peak_height' half way through.
-  // Since deceleration is constant, and velocity at the peak is zero,
-  // the average velocity from start to peak is,
-  //       0.5(start_velocity + 0)
-  //
-  // At peak, height is average velocity times travel time, so
-  //       peak_height = 0.5(start_velocity + 0)*peak_time
-  // Which implies,
-  //    start_velocity = 2 * delta_height / peak_time
-  const float peak_time = 0.5f * flight_time;
-  const float delta_height = peak_height - start_height;
-  const float start_velocity = 2.0f * delta_height / peak_time;
-  const motive::MotiveTarget1f y_target(motive::CurrentToTargetToTarget1f(
-      start_height, start_velocity,                  // Initial node.
-      peak_height, 0.0f, peak_time,                  // Peak node.
-      start_height, -start_velocity, flight_time));  // End node.
-
-  // The pie is rotated about Y a constant amount so that it's facing the
-  // target.
-  const vec3 vector_to_target = target.position() - source.position();
-  const Angle angle_to_target = Angle::FromXZVector(vector_to_target);
+      damage_(damage),
+      start_height_(start_height),
+      peak_height_(peak_height),
+      rotations_(rotations),
+      source_position_(source.position().x(), start_height,
+                       source.position().z()),
+      target_position_(target.position().x(), start_height,
+                       target.position().z()),
+      // The pie is rotated about Y a constant amount so that it's facing
+      // the target.
+      angle_to_target_(
+          Angle::FromXZVector(target.position() - source.position())) {
+  UpdateFlight(start_time);
+
+  // A pie launched mid-step has no history yet; interpolate from the
+  // launch transform.
+  CaptureRenderState();
+}
+
+void AirbornePie::UpdateFlight(WorldTime time) {
+  // The whole arc is closed form in the flight fraction 't': x and z move
+  // at constant velocity from source to target, y follows the
+  // constant-deceleration parabola that starts and ends at 'start_height'
+  // and tops out at 'peak_height' half way through, and both rotations are
+  // linear in time. Evaluating this directly traces the same path the
+  // matrix Motivator used to, without its per-pie spline bookkeeping.
+  const float t =
+      mathfu::Clamp(static_cast<float>(time - start_time_) /
+                        static_cast<float>(flight_time_),
+                    0.0f, 1.0f);
+  const float arc_height =
+      4.0f * (peak_height_ - start_height_) * t * (1.0f - t);
+  const vec3 position = vec3::Lerp(source_position_, target_position_, t) +
+                        vec3(0.0f, arc_height, 0.0f);
 
   // The pie rotates top to bottom a fixed number of times. Rotation speed
   // is constant.
-  const motive::MotiveTarget1f z_rotation_target(
-      motive::CurrentToTargetConstVelocity1f(0.0f, rotations * kTwoPi,
-                                             flight_time));
-
-  motive::MatrixInit init(5);
-  init.AddOp(motive::kTranslateX, position_init, x_target);
-  init.AddOp(motive::kTranslateY, position_init, y_target);
-  init.AddOp(motive::kTranslateZ, position_init, z_target);
-  init.AddOp(motive::kRotateAboutY, -angle_to_target.ToRadians());
-  init.AddOp(motive::kRotateAboutZ, rotation_init, z_rotation_target);
-  motivator_.Initialize(init, engine);
+  const float z_rotation = rotations_ * kTwoPi * t;
+  matrix_ = mat4::FromTranslationVector(position) *
+            mat4::FromRotationMatrix(
+                mathfu::mat3::RotationY(-angle_to_target_.ToRadians()) *
+                mathfu::mat3::RotationZ(z_rotation));
+}
+
+void AirbornePie::AdvanceAll(std::vector<std::unique_ptr<AirbornePie>>& pies,
+                             WorldTime time) {
+  for (auto it = pies.begin(); it != pies.end(); ++it) {
+    (*it)->UpdateFlight(time);
+  }
+}
+
+mat4 AirbornePie::InterpolatedMatrix(float alpha) const {
+  // Only the translation is blended. The rotation ops run at constant
+  // velocity, so snapping them to the current step is visually fine and
+  // avoids a quaternion decompose-and-blend.
+  mat4 matrix = Matrix();
+  const vec3 position = vec3::Lerp(previous_matrix_.TranslationVector3D(),
+                                   matrix.TranslationVector3D(), alpha);
+  matrix.GetColumn(3) = vec4(position, 1.0f);
+  return matrix;
 }
 
 void ApplyScoringRule(const ScoringRules* scoring_rules, ScoreEvent event,
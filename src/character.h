@@ -15,6 +15,8 @@
 #ifndef PIE_NOON_CHARACTER_H_
 #define PIE_NOON_CHARACTER_H_
 
+#include <vector>
+#include <memory>
 #include "motive/math/angle.h"
 #include "character_state_machine.h"
 #include "character_state_machine_def_generated.h"
@@ -50,6 +52,46 @@ enum PlayerStats {
 
 enum VictoryState { kResultUnknown, kVictorious, kFailure };
 
+// Tracks playback progress through the current state's timeline. Sound and
+// event keyframes fire exactly once as animation time passes them, so the
+// per-frame lookups in GameState::ProcessSounds/ProcessEvents can resume
+// from where the previous frame stopped instead of re-scanning the keyframe
+// arrays from the start. The cursor rewinds whenever the state machine
+// enters a new state (detected by the state start time changing).
+class TimelineCursor {
+ public:
+  TimelineCursor() { Rewind(); }
+
+  // Start over from the beginning of the timeline.
+  void Rewind() {
+    state_start_time_ = -1;
+    next_sound_index_ = 0;
+    next_event_index_ = 0;
+  }
+
+  // Rewind if the character has entered a new state since the last call.
+  void SyncToState(WorldTime state_start_time) {
+    if (state_start_time != state_start_time_) {
+      Rewind();
+      state_start_time_ = state_start_time;
+    }
+  }
+
+  int next_sound_index() const { return next_sound_index_; }
+  void set_next_sound_index(int index) { next_sound_index_ = index; }
+
+  int next_event_index() const { return next_event_index_; }
+  void set_next_event_index(int index) { next_event_index_ = index; }
+
+ private:
+  // Start time of the state the indices below are valid for.
+  WorldTime state_start_time_;
+
+  // Index of the first sound/event keyframe that has not fired yet.
+  int next_sound_index_;
+  int next_event_index_;
+};
+
 // The current state of the character. This class tracks information external
 // to the state machine, like health.
 class Character {
@@ -68,6 +110,10 @@ class Character {
   // target face angle.
   void TwitchFaceAngle(motive::TwitchDirection twitch);
 
+  // Snap the face angle to 'angle' with zero velocity. Used when restoring
+  // a snapshot; any in-flight turn is discarded.
+  void SetFaceAngle(Angle angle, motive::MotiveEngine* engine);
+
   // Force the character's target, not worrying about facing angle.
   void force_target(CharacterId target) { target_ = target; }
 
@@ -102,6 +148,16 @@ class Character {
   // just before (potentially) modifying the state.
   void UpdatePreviousState() { state_last_update_ = State(); }
 
+  // Snapshot the transform for render-side interpolation. Called at the top
+  // of every simulation step; when the game runs on a fixed timestep the
+  // renderer blends between this snapshot and the current values.
+  void CaptureRenderState() {
+    previous_position_ = position_;
+    previous_face_angle_ = FaceAngle();
+  }
+  mathfu::vec3 previous_position() const { return previous_position_; }
+  Angle previous_face_angle() const { return previous_face_angle_; }
+
   // Returns true if the character is still in the game.
   bool Active() const { return State() != StateId_KO; }
 
@@ -150,12 +206,26 @@ class Character {
   bool visible() const { return visible_; }
   void set_visible(bool visible) { visible_ = visible; }
 
+  TimelineCursor* timeline_cursor() { return &timeline_cursor_; }
+
  private:
-  // Constant configuration data.
-  const Config* config_;
+  // Members are grouped hot-to-cold: everything the simulation passes in
+  // GameState::AdvanceFrame touch every step comes first, so the
+  // per-character walks stream the leading cache lines and the
+  // stats/bookkeeping tail stays cold until a discrete event needs it.
+  // (The face-angle animation itself is just a handle here; its math runs
+  // in the Motive engine's own packed arrays.)
 
-  // Our own id.
-  CharacterId id_;
+  // World angle. Will eventually settle on the angle towards target_.
+  motive::Motivator1f face_angle_;
+
+  // Position of the character in world space.
+  mathfu::vec3 position_;
+
+  // Transform at the start of the current simulation step, for render-side
+  // interpolation. See CaptureRenderState().
+  mathfu::vec3 previous_position_;
+  Angle previous_face_angle_;
 
   // Character that we are currently aiming the pie at.
   CharacterId target_;
@@ -167,23 +237,32 @@ class Character {
   // If unloaded, 0.
   CharacterHealth pie_damage_;
 
-  // World angle. Will eventually settle on the angle towards target_.
-  motive::Motivator1f face_angle_;
+  // What state the character was in last update.
+  uint16_t state_last_update_;
 
-  // Position of the character in world space.
-  mathfu::vec3 position_;
+  // If the character should be visible.
+  bool visible_;
 
   // The controller used to translate inputs into game actions.
   Controller* controller_;
 
-  // Used to track if this character just joined the game.
-  bool just_joined_game_;
-
   // The current state of the character.
   CharacterStateMachine state_machine_;
 
-  // The stats we're collecting (see PlayerStats enum above).
-  uint64_t player_stats_[kMaxStats];
+  // Playback position in the current state's timeline.
+  TimelineCursor timeline_cursor_;
+
+  // Our own id.
+  CharacterId id_;
+
+  // Constant configuration data.
+  const Config* config_;
+
+  // Cold from here down: only touched by discrete events (joining,
+  // scoring, round end, stat upload).
+
+  // Used to track if this character just joined the game.
+  bool just_joined_game_;
 
   // The score of the current player for this round (separate from stats because
   // it is not a persisted value.
@@ -192,20 +271,21 @@ class Character {
   // If this character is one of the winners or losers of the match.
   VictoryState victory_state_;
 
-  // What state the character was in last update.
-  uint16_t state_last_update_;
-
-  // If the character should be visible.
-  bool visible_;
+  // The stats we're collecting (see PlayerStats enum above).
+  uint64_t player_stats_[kMaxStats];
 };
 
+// A pie in flight. The whole arc is determined at launch (source, target,
+// heights, rotation count), so the flight path is evaluated in closed form
+// from the world time rather than through a per-pie matrix Motivator; see
+// AdvanceAll().
 class AirbornePie {
  public:
   AirbornePie(CharacterId original_source, const Character& source,
               const Character& target, WorldTime start_time,
               WorldTime flight_time, CharacterHealth original_damage,
               CharacterHealth damage, float start_height, float peak_height,
-              int rotations, motive::MotiveEngine* engine);
+              int rotations);
 
   CharacterId original_source() const { return original_source_; }
   CharacterId source() const { return source_; }
@@ -214,10 +294,32 @@ class AirbornePie {
   WorldTime flight_time() const { return flight_time_; }
   CharacterHealth original_damage() const { return original_damage_; }
   CharacterHealth damage() const { return damage_; }
-  const mathfu::mat4& Matrix() const { return motivator_.Value(); }
-  mathfu::vec3 Position() const { return motivator_.Position(); }
+  const mathfu::mat4& Matrix() const { return matrix_; }
+  mathfu::vec3 Position() const { return matrix_.TranslationVector3D(); }
+
+  // Snapshot the transform for render-side interpolation, like
+  // Character::CaptureRenderState().
+  void CaptureRenderState() { previous_matrix_ = Matrix(); }
+
+  // Matrix() with its translation blended between the previous and current
+  // simulation steps. 'alpha' is the fraction of a step the renderer is
+  // ahead of the last simulated state, in [0, 1).
+  mathfu::mat4 InterpolatedMatrix(float alpha) const;
+
+  // Trajectory parameters, kept so a snapshot can recreate the pie.
+  float start_height() const { return start_height_; }
+  float peak_height() const { return peak_height_; }
+  int rotations() const { return rotations_; }
+
+  // Evaluate the flight path of every pie at 'time' in one pass. During the
+  // multiscreen pie rain this batch walk is considerably cheaper than the
+  // per-motivator bookkeeping it replaced.
+  static void AdvanceAll(std::vector<std::unique_ptr<AirbornePie>>& pies,
+                         WorldTime time);
 
  private:
+  void UpdateFlight(WorldTime time);
+
   CharacterId original_source_;
   CharacterId source_;
   CharacterId target_;
@@ -225,7 +327,22 @@ class AirbornePie {
   WorldTime flight_time_;
   CharacterHealth original_damage_;
   CharacterHealth damage_;
-  motive::MotivatorMatrix4f motivator_;
+  float start_height_;
+  float peak_height_;
+  int rotations_;
+
+  // Flight-path constants, computed at launch. Both endpoints sit at
+  // start_height; the parabolic arc is added on top.
+  mathfu::vec3 source_position_;
+  mathfu::vec3 target_position_;
+  Angle angle_to_target_;
+
+  // Current transform, written by AdvanceAll().
+  mathfu::mat4 matrix_;
+
+  // Transform at the start of the current simulation step. See
+  // CaptureRenderState().
+  mathfu::mat4 previous_matrix_;
 };
 
 // Return index of first item with time >= t.
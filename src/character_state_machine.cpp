@@ -20,12 +20,52 @@
 namespace fpl {
 namespace pie_noon {
 
+// Bits for CompiledTransition::mode_mask.
+static const uint8_t kGameModeSinglePlayer = 1 << 0;
+static const uint8_t kGameModeMultiscreen = 1 << 1;
+
 CharacterStateMachine::CharacterStateMachine(
     const CharacterStateMachineDef* const state_machine_def)
     : state_machine_def_(state_machine_def) {
+  CompileTransitions();
   Reset();
 }
 
+// Flatten every state's transition conditions out of the FlatBuffer into
+// contiguous PODs, so that Update touches no FlatBuffer accessors.
+// Transitions without a condition can never fire (see the original check in
+// Update) and are dropped here.
+void CharacterStateMachine::CompileTransitions() {
+  auto states = state_machine_def_->states();
+  transition_offsets_.reserve(states->Length() + 1);
+  for (auto state = states->begin(); state != states->end(); ++state) {
+    transition_offsets_.push_back(
+        static_cast<int>(compiled_transitions_.size()));
+    if (!state->transitions()) continue;
+    for (auto it = state->transitions()->begin();
+         it != state->transitions()->end(); ++it) {
+      const Condition* condition = it->condition();
+      if (!condition) continue;
+      CompiledTransition compiled;
+      compiled.is_down = condition->is_down();
+      compiled.is_up = condition->is_up();
+      compiled.went_down = condition->went_down();
+      compiled.went_up = condition->went_up();
+      compiled.time = condition->time();
+      compiled.end_time = condition->end_time();
+      compiled.target_state = it->target_state();
+      compiled.mode_mask =
+          condition->game_mode() == GameModeCondition_AnyMode
+              ? kGameModeSinglePlayer | kGameModeMultiscreen
+              : condition->game_mode() == GameModeCondition_MultiPlayerOnly
+                    ? kGameModeMultiscreen
+                    : kGameModeSinglePlayer;
+      compiled_transitions_.push_back(compiled);
+    }
+  }
+  transition_offsets_.push_back(static_cast<int>(compiled_transitions_.size()));
+}
+
 void CharacterStateMachine::Reset() {
   current_state_ =
       state_machine_def_->states()->Get(state_machine_def_->initial_state());
@@ -65,14 +105,19 @@ bool EvaluateCondition(const Condition* condition,
 }
 
 void CharacterStateMachine::Update(const ConditionInputs& inputs) {
-  if (!current_state_->transitions()) {
-    return;
-  }
-  for (auto it = current_state_->transitions()->begin();
-       it != current_state_->transitions()->end(); ++it) {
-    const Condition* condition = it->condition();
-    if (condition && EvaluateCondition(condition, inputs)) {
-      current_state_ = state_machine_def_->states()->Get(it->target_state());
+  const int state = current_state_->id();
+  const uint8_t mode_bit =
+      inputs.is_multiscreen ? kGameModeMultiscreen : kGameModeSinglePlayer;
+  const int end = transition_offsets_[state + 1];
+  for (int i = transition_offsets_[state]; i < end; ++i) {
+    const CompiledTransition& t = compiled_transitions_[i];
+    if ((inputs.is_down & t.is_down) == t.is_down &&
+        (~inputs.is_down & t.is_up) == t.is_up &&
+        (inputs.went_down & t.went_down) == t.went_down &&
+        (inputs.went_up & t.went_up) == t.went_up &&
+        inputs.animation_time >= t.time && inputs.animation_time < t.end_time &&
+        (t.mode_mask & mode_bit) != 0) {
+      current_state_ = state_machine_def_->states()->Get(t.target_state);
       current_state_start_time_ = inputs.current_time;
       return;
     }
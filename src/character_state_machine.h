@@ -16,6 +16,7 @@
 #define CHARACTER_STATE_MACHINE_
 
 #include <cstdint>
+#include <vector>
 #include "common.h"
 
 namespace fpl {
@@ -41,6 +42,27 @@ struct ConditionInputs {
   bool is_multiscreen;
 };
 
+// A transition's Condition flattened into plain integers at load time, so
+// the per-frame check is a few AND/compare ops with no FlatBuffer accessor
+// indirection. See CharacterStateMachine::CompileTransitions.
+struct CompiledTransition {
+  // Button bitmasks compared against ConditionInputs.
+  int32_t is_down;
+  int32_t is_up;
+  int32_t went_down;
+  int32_t went_up;
+
+  // Half-open animation time range in which the transition can fire.
+  int time;
+  int end_time;
+
+  // State to jump to when the condition passes.
+  uint16_t target_state;
+
+  // Bitwise-or of the kGameMode* bits this transition applies in.
+  uint8_t mode_mask;
+};
+
 class CharacterStateMachine {
  public:
   // Initializes a state machine with the given state machine definition.
@@ -66,9 +88,17 @@ class CharacterStateMachine {
   }
 
  private:
+  void CompileTransitions();
+
   const CharacterStateMachineDef* state_machine_def_;
   const CharacterState* current_state_;
   WorldTime current_state_start_time_;
+
+  // All states' transitions, flattened into one contiguous array.
+  // State s's transitions occupy indices
+  // [transition_offsets_[s], transition_offsets_[s + 1]).
+  std::vector<CompiledTransition> compiled_transitions_;
+  std::vector<int> transition_offsets_;
 };
 
 bool EvaluateCondition(const Condition* condition,
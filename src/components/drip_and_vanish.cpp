@@ -26,9 +26,12 @@ using mathfu::vec3;
 // and then slowly sinks, while shrinking.  It's used to govern behavior
 // for splatters on the background.
 void DripAndVanishComponent::UpdateAllEntities(entity::WorldTime delta_time) {
-  for (auto iter = entity_data_.begin(); iter != entity_data_.end(); ++iter) {
-    SceneObjectData* so_data = Data<SceneObjectData>(iter->entity);
-    DripAndVanishData* dv_data = GetEntityData(iter->entity);
+  // Splatters are created and deleted in bursts, so this pool fragments more
+  // than most; sweep with ForEachActive so the next element is prefetched
+  // while the current one is processed.
+  entity_data_.ForEachActive([this, delta_time](EntityData& entry) {
+    SceneObjectData* so_data = Data<SceneObjectData>(entry.entity);
+    DripAndVanishData* dv_data = &entry.data;
 
     dv_data->lifetime_remaining -= delta_time;
     if (dv_data->lifetime_remaining > 0) {
@@ -51,9 +54,9 @@ void DripAndVanishComponent::UpdateAllEntities(entity::WorldTime delta_time) {
         so_data->SetScale(relative_scale);
       }
     } else {
-      entity_manager_->DeleteEntity(iter->entity);
+      entity_manager_->DeleteEntity(entry.entity);
     }
-  }
+  });
 }
 
 void DripAndVanishComponent::AddFromRawData(entity::EntityRef& entity,
@@ -40,6 +40,28 @@ void PlayerCharacterComponent::UpdateAllEntities(
   }
 }
 
+void PlayerCharacterComponent::ApplyRenderInterpolation(float alpha) {
+  for (auto iter = entity_data_.begin(); iter != entity_data_.end(); ++iter) {
+    entity::EntityRef entity = iter->entity;
+    SceneObjectData* so_data = Data<SceneObjectData>(entity);
+    PlayerCharacterData* pc_data = GetEntityData(entity);
+    std::unique_ptr<Character>& character =
+        gamestate_ptr_->characters()[pc_data->character_id];
+
+    const Angle previous_angle = character->previous_face_angle();
+    const Angle face_angle =
+        previous_angle + (character->FaceAngle() - previous_angle) * alpha;
+    so_data->SetRotationAboutY((-face_angle).ToRadians());
+    so_data->SetTranslation(vec3::Lerp(character->previous_position(),
+                                       character->position(), alpha));
+
+    // Keep the UI arrow circle underfoot.
+    SceneObjectData* circle_so_data =
+        Data<SceneObjectData>(pc_data->base_circle);
+    circle_so_data->SetTranslation(so_data->Translation());
+  }
+}
+
 // Make sure the character is correctly positioned and facing the correct way:
 void PlayerCharacterComponent::UpdateCharacterFacing(entity::EntityRef entity) {
   SceneObjectData* so_data = Data<SceneObjectData>(entity);
@@ -148,6 +170,8 @@ int PlayerCharacterComponent::PopulatePieAccessories(entity::EntityRef entity,
       accessory_so_data->SetTranslation(offset);
 
       accessory_so_data->set_renderable_id(accessory.renderable());
+      accessory_so_data->set_batchable(
+          CanBatchRenderable(config_, accessory.renderable()));
       accessory_so_data->SetScale(mathfu::kOnes3f);
 
       num_accessories++;
@@ -226,6 +250,8 @@ int PlayerCharacterComponent::PopulateHealthAccessories(
         accessory_so_data->SetTranslation(offset);
 
         accessory_so_data->set_renderable_id(accessory->renderable());
+        accessory_so_data->set_batchable(
+            CanBatchRenderable(config_, accessory->renderable()));
         accessory_so_data->SetScale(vec3(scale.x(), scale.y(), 1));
 
         num_accessories++;
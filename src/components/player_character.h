@@ -45,6 +45,13 @@ class PlayerCharacterComponent : public entity::Component<PlayerCharacterData> {
   virtual void AddFromRawData(entity::EntityRef& entity, const void* data);
   virtual void UpdateAllEntities(entity::WorldTime delta_time);
   virtual void InitEntity(entity::EntityRef& entity);
+
+  // Rewrite each character's scene object transform as a blend between the
+  // previous and current simulation steps. Called by GameState just before
+  // the scene is populated when the game runs on a fixed timestep; the next
+  // step's update restores the authoritative values.
+  void ApplyRenderInterpolation(float alpha);
+
   void set_gamestate_ptr(GameState* gamestate_ptr) {
     gamestate_ptr_ = gamestate_ptr;
   }
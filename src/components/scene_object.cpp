@@ -90,70 +90,170 @@ void SceneObjectComponent::InitEntity(entity::EntityRef& entity) {
   data->Initialize(engine_);
 }
 
-void SceneObjectComponent::UpdateGlobalMatrix(
-    entity::EntityRef& entity,
-    std::vector<bool>& matrix_updated) {
-  const size_t data_index = GetEntityDataIndex(entity);
+SceneObjectComponent::TransformState SceneObjectComponent::UpdateGlobalMatrix(
+    size_t data_index,
+    std::vector<uint8_t>& transform_state) {
+  if (transform_state[data_index] != kTransformUnknown) {
+    return static_cast<TransformState>(transform_state[data_index]);
+  }
   SceneObjectData* data = GetEntityData(data_index);
 
-  if (data->HasParent()) {
-    // Recurse into parent if its matrix has not been calculated.
-    const size_t parent_index = GetEntityDataIndex(data->parent());
-    if (!matrix_updated[parent_index]) {
-      UpdateGlobalMatrix(data->parent(), matrix_updated);
+  TransformState state;
+  const entity::Entity* parent_entity = parent_entities_[data_index];
+  if (parent_entity != nullptr) {
+    const size_t parent_index =
+        parent_entity->GetComponentDataIndex(GetComponentId());
+    // Recurse into the parent first: we must recompute if either our local
+    // transform changed or the parent's global matrix did.
+    const TransformState parent_state =
+        UpdateGlobalMatrix(parent_index, transform_state);
+    if (parent_state == kTransformChanged || data->local_dirty()) {
+      // Multiply our local matrix by our parent's global matrix to get our
+      // global matrix.
+      SceneObjectData* parent = GetEntityData(parent_index);
+      data->set_global_matrix(parent->global_matrix() * data->LocalMatrix());
+      state = kTransformChanged;
+    } else {
+      state = kTransformClean;
     }
-
-    // Multiply our local matrix by our parent's global matrix to get our
-    // global matrix.
-    SceneObjectData* parent = GetEntityData(parent_index);
-    data->set_global_matrix(parent->global_matrix() * data->LocalMatrix());
-  } else {
-
+  } else if (data->local_dirty()) {
     // No parent means that our local matrix equals the global matrix.
     data->set_global_matrix(data->LocalMatrix());
+    state = kTransformChanged;
+  } else {
+    state = kTransformClean;
   }
 
-  // Remember that we've calculated this matrix so we don't try to calculate
-  // it again.
-  matrix_updated[data_index] = true;
+  data->clear_local_dirty();
+  // Remember this object's state so we neither recompute it nor re-derive
+  // it while resolving another child's parent chain.
+  transform_state[data_index] = static_cast<uint8_t>(state);
+  return state;
 }
 
 // Traverse scene hierarchy convert local matrices into global matrices.
+// Only subtrees whose transforms were touched since the last frame (the
+// local_dirty flag set by SceneObjectData's mutators) are recomputed; in
+// the menu and finished states the bulk of the scene is untouched and
+// skips the matrix math entirely.
 void SceneObjectComponent::UpdateGlobalMatrices() {
-  std::vector<bool> matrix_updated(entity_data_.Size(), false);
+  // Resolve every object's cached parent handle in one batched pass up
+  // front. The sweeps below then test a resolved pointer per object, and
+  // the hierarchy recursion works purely in pool indices, instead of
+  // paying a reference validity check at every parent access.
+  const size_t pool_size = entity_data_.Size();
+  parent_handles_.assign(pool_size, entity::kInvalidEntityHandle);
+  for (auto iter = entity_data_.begin(); iter != entity_data_.end(); ++iter) {
+    parent_handles_[iter.index()] = iter->data.parent_handle();
+  }
+  parent_entities_.resize(pool_size);
+  entity_manager_->ResolveEntities(parent_handles_.data(), pool_size,
+                                   parent_entities_.data());
 
-  // Loop through every entity and update its global matrix.
+  // First pass walks the pool contiguously and handles the common case:
+  // unparented objects, whose global matrix is just the local matrix the
+  // Motive engine already computed. Keeping this pass branch-light and
+  // sequential lets mathfu's SIMD paths (see pie_noon_enable_simd in
+  // CMakeLists.txt) stream the matrices through NEON/SSE registers.
+  transform_state_.assign(entity_data_.Size(), kTransformUnknown);
+  size_t num_parented = 0;
   for (auto iter = entity_data_.begin(); iter != entity_data_.end(); ++iter) {
+    // Static objects keep the global matrix computed when the cache was
+    // last rebuilt.
+    if (iter->data.static_scene() && static_cache_valid_) {
+      transform_state_[iter.index()] = kTransformClean;
+      continue;
+    }
+    if (parent_entities_[iter.index()] != nullptr) {
+      ++num_parented;
+      continue;
+    }
+    if (iter->data.local_dirty()) {
+      iter->data.set_global_matrix(iter->data.LocalMatrix());
+      iter->data.clear_local_dirty();
+      transform_state_[iter.index()] = kTransformChanged;
+    } else {
+      transform_state_[iter.index()] = kTransformClean;
+    }
+  }
+  if (num_parented == 0) return;
 
-    // The update process is recursive, so we may have already calculated a
-    // matrix by the time we get there. If so, skip over it.
-    if (!matrix_updated[iter.index()] && iter->data.visible()) {
-      UpdateGlobalMatrix(iter->entity, matrix_updated);
+  // Parented objects--a small minority--still need hierarchy resolution,
+  // which is recursive. Everything handled above is already marked, so the
+  // recursion only ever walks parent chains.
+  for (auto iter = entity_data_.begin(); iter != entity_data_.end(); ++iter) {
+    if (transform_state_[iter.index()] == kTransformUnknown &&
+        iter->data.visible()) {
+      UpdateGlobalMatrix(iter.index(), transform_state_);
     }
   }
 }
 
-bool SceneObjectComponent::VisibleInHierarchy(
-    const entity::EntityRef& entity) const {
-  const SceneObjectData* data = GetEntityData(entity);
-  if (!data->HasParent()) {
-    return data->visible();
-  } else {
-    return data->visible() && VisibleInHierarchy(data->parent());
-  }
+bool SceneObjectComponent::VisibleInHierarchy(size_t data_index) const {
+  const SceneObjectData* data = GetEntityData(data_index);
+  if (!data->visible()) return false;
+  const entity::Entity* parent_entity = parent_entities_[data_index];
+  return parent_entity == nullptr ||
+         VisibleInHierarchy(
+             parent_entity->GetComponentDataIndex(GetComponentId()));
 }
 
 void SceneObjectComponent::PopulateScene(SceneDescription* scene) {
   UpdateGlobalMatrices();
 
+  const bool rebuild_static_cache = !static_cache_valid_;
+  if (rebuild_static_cache) {
+    static_renderables_.clear();
+    static_quads_.clear();
+    ++static_cache_version_;
+  }
+
   for (auto iter = entity_data_.begin(); iter != entity_data_.end(); ++iter) {
     entity::EntityRef entity = iter->entity;
-    if (VisibleInHierarchy(entity)) {
-      SceneObjectData* data = GetEntityData(entity);
-      scene->renderables().push_back(std::unique_ptr<Renderable>(new Renderable(
-          data->renderable_id(), data->global_matrix(), data->tint())));
+    SceneObjectData* data = GetEntityData(entity);
+
+    // Static objects (arena props, mostly) are snapshotted into the cache
+    // and replayed below, so per-frame population only walks the dynamic
+    // objects: characters, accessories, and pies.
+    if (data->static_scene()) {
+      if (rebuild_static_cache && VisibleInHierarchy(iter.index())) {
+        std::vector<Renderable>& cache =
+            data->batchable() ? static_quads_ : static_renderables_;
+        Renderable renderable(data->renderable_id(), data->global_matrix(),
+                              data->tint());
+        // Quads already batch; the merge flag only matters for the
+        // individually-drawn renderables.
+        renderable.set_merged_static(data->merge_static() &&
+                                     !data->batchable());
+        cache.push_back(renderable);
+      }
+      continue;
     }
+
+    if (VisibleInHierarchy(iter.index())) {
+      if (data->batchable()) {
+        // Flat quads get collected into per-material instance batches and
+        // drawn in bulk, instead of one draw call each.
+        scene->AddQuadInstance(data->renderable_id(), data->global_matrix(),
+                               data->tint());
+      } else {
+        scene->AddRenderable(data->renderable_id(), data->global_matrix(),
+                             data->tint());
+      }
+    }
+  }
+
+  // Replay the cached static objects. Quad batches are rebuilt per frame,
+  // so cached quads still get appended to this frame's batches.
+  for (size_t i = 0; i < static_quads_.size(); ++i) {
+    const Renderable& quad = static_quads_[i];
+    scene->AddQuadInstance(quad.id(), quad.world_matrix(), quad.color());
+  }
+  for (size_t i = 0; i < static_renderables_.size(); ++i) {
+    scene->AddRenderable(static_renderables_[i]);
   }
+  scene->set_static_version(static_cache_version_);
+  static_cache_valid_ = true;
 }
 
 }  // pie noon
@@ -34,9 +34,14 @@ class SceneObjectData {
  public:
   SceneObjectData()
       : global_matrix_(mathfu::mat4::Identity()),
+        parent_handle_(entity::kInvalidEntityHandle),
         tint_(mathfu::kOnes4f),
         renderable_id_(0),
-        visible_(true) {
+        visible_(true),
+        batchable_(false),
+        static_scene_(false),
+        merge_static_(false),
+        local_dirty_(true) {
   }
   void Initialize(motive::MotiveEngine* engine);
 
@@ -54,47 +59,73 @@ class SceneObjectData {
   // See comment on TransformMatrixOperations for more information.
   // TODO: Allow callers to set up their own transformation pipeline, instead
   // of using this fixed one.
+  // Each mutator marks the local transform dirty; the global matrix pass
+  // only recomputes objects (and their children) that were touched since
+  // the last frame. The transform can only change through these mutators,
+  // so an untouched object's matrices are guaranteed current.
   void SetRotation(const mathfu::vec3& rotation) {
     transform_.SetChildValue3f(kRotateAboutX, rotation);
+    local_dirty_ = true;
   }
   void SetRotationAboutX(float angle) {
     transform_.SetChildValue1f(kRotateAboutX, angle);
+    local_dirty_ = true;
   }
   void SetRotationAboutY(float angle) {
     transform_.SetChildValue1f(kRotateAboutY, angle);
+    local_dirty_ = true;
   }
   void SetRotationAboutZ(float angle) {
     transform_.SetChildValue1f(kRotateAboutZ, angle);
+    local_dirty_ = true;
   }
   void SetRotationAboutAxis(float angle, Axis axis) {
     transform_.SetChildValue1f(kRotateAboutX + axis, angle);
+    local_dirty_ = true;
   }
   void SetPreRotation(const mathfu::vec3& rotation) {
     transform_.SetChildValue3f(kPreRotateAboutX, rotation);
+    local_dirty_ = true;
   }
   void SetPreRotationAboutX(float angle) {
     transform_.SetChildValue1f(kPreRotateAboutX, angle);
+    local_dirty_ = true;
   }
   void SetPreRotationAboutY(float angle) {
     transform_.SetChildValue1f(kPreRotateAboutY, angle);
+    local_dirty_ = true;
   }
   void SetPreRotationAboutZ(float angle) {
     transform_.SetChildValue1f(kPreRotateAboutZ, angle);
+    local_dirty_ = true;
   }
   void SetPreRotationAboutAxis(float angle, Axis axis) {
     transform_.SetChildValue1f(kPreRotateAboutX + axis, angle);
+    local_dirty_ = true;
   }
   void SetTranslation(const mathfu::vec3& translation) {
     transform_.SetChildValue3f(kTranslateX, translation);
+    local_dirty_ = true;
   }
   void SetScale(const mathfu::vec3& scale) {
     transform_.SetChildValue3f(kScaleX, scale);
+    local_dirty_ = true;
+  }
+  void SetScaleX(float scale) {
+    transform_.SetChildValue1f(kScaleX, scale);
+    local_dirty_ = true;
+  }
+  void SetScaleY(float scale) {
+    transform_.SetChildValue1f(kScaleY, scale);
+    local_dirty_ = true;
+  }
+  void SetScaleZ(float scale) {
+    transform_.SetChildValue1f(kScaleZ, scale);
+    local_dirty_ = true;
   }
-  void SetScaleX(float scale) { transform_.SetChildValue1f(kScaleX, scale); }
-  void SetScaleY(float scale) { transform_.SetChildValue1f(kScaleY, scale); }
-  void SetScaleZ(float scale) { transform_.SetChildValue1f(kScaleZ, scale); }
   void SetOriginPoint(const mathfu::vec3& origin) {
     transform_.SetChildValue3f(kTranslateToOriginX, -origin);
+    local_dirty_ = true;
   }
 
   // Get components of the transformation from object-to-local space.
@@ -121,7 +152,15 @@ class SceneObjectData {
   bool HasParent() const { return parent_.IsValid(); }
   entity::EntityRef& parent() { return parent_; }
   const entity::EntityRef& parent() const { return parent_; }
-  void set_parent(entity::EntityRef& parent) { parent_ = parent; }
+  entity::EntityHandle parent_handle() const { return parent_handle_; }
+  void set_parent(entity::EntityRef& parent) {
+    parent_ = parent;
+    parent_handle_ = parent.ToHandle();
+    local_dirty_ = true;
+  }
+
+  bool local_dirty() const { return local_dirty_; }
+  void clear_local_dirty() { local_dirty_ = false; }
 
   mathfu::vec4 tint() const { return mathfu::vec4(tint_); }
   void set_tint(const mathfu::vec4& tint) { tint_ = tint; }
@@ -132,6 +171,15 @@ class SceneObjectData {
   bool visible() const { return visible_; }
   void set_visible(bool visible) { visible_ = visible; }
 
+  bool batchable() const { return batchable_; }
+  void set_batchable(bool batchable) { batchable_ = batchable; }
+
+  bool static_scene() const { return static_scene_; }
+  void set_static_scene(bool static_scene) { static_scene_ = static_scene; }
+
+  bool merge_static() const { return merge_static_; }
+  void set_merge_static(bool merge_static) { merge_static_ = merge_static; }
+
  private:
   // Basic matrix operations from with 'transform_.Value()' is calculated.
   // These operations are applied last-to-first to convert the object from
@@ -170,6 +218,12 @@ class SceneObjectData {
   // space already.
   entity::EntityRef parent_;
 
+  // Compact handle to 'parent_', cached by set_parent so the per-frame
+  // hierarchy passes can batch-resolve every parent in one sweep (see
+  // SceneObjectComponent::UpdateGlobalMatrices) instead of validating the
+  // full reference at each access.
+  entity::EntityHandle parent_handle_;
+
   // Color of object.
   mathfu::vec4_packed tint_;
 
@@ -178,25 +232,92 @@ class SceneObjectData {
 
   // Whether object is currently on-screen or not.
   bool visible_;
+
+  // Whether the object is a flat quad that can be drawn through the
+  // instanced quad batch path (no shadow, stick, or cardboard backing).
+  // Set for accessories like pies, health icons, and splatter decals.
+  bool batchable_;
+
+  // Whether the object's transform only changes in response to discrete
+  // events (e.g. a prop shake), rather than every frame. Static objects are
+  // cached by PopulateScene and skipped until the cache is invalidated with
+  // SceneObjectComponent::InvalidateStaticScene().
+  bool static_scene_;
+
+  // Stronger than static_scene_: the transform can never change at all
+  // once the entity is placed (e.g. a prop with no shake motivator), so
+  // the renderer may bake the object's geometry into a combined
+  // world-space mesh. Only meaningful when static_scene_ is also set. See
+  // ShakeablePropComponent::AddFromRawData for where it is derived.
+  bool merge_static_;
+
+  // Whether any mutator above has run since the last global matrix update.
+  // Starts true so a freshly added object gets its matrix computed.
+  bool local_dirty_;
 };
 
 // A sceneobject is "a thing I want to place in the scene and move around."
 // So it contains basic drawing info.
-class SceneObjectComponent : public entity::Component<SceneObjectData> {
+// SceneObjectData is big (a whole Motivator plus matrices) and every active
+// one is touched every frame, so store it in the structure-of-arrays pool:
+// the per-frame walks then stream pure component data, with the pool's list
+// bookkeeping packed elsewhere.
+class SceneObjectComponent
+    : public entity::Component<SceneObjectData, VectorPoolSoA> {
  public:
   explicit SceneObjectComponent(motive::MotiveEngine* engine)
-      : engine_(engine) {}
+      : engine_(engine), static_cache_valid_(false), static_cache_version_(0) {}
   virtual void AddFromRawData(entity::EntityRef& entity, const void* data);
   virtual void InitEntity(entity::EntityRef& entity);
   void PopulateScene(SceneDescription* scene);
 
+  // Force static scene objects to be re-gathered on the next PopulateScene.
+  // Call whenever a static object's transform, tint, or visibility changes
+  // (see ShakeablePropComponent), or when static entities are added/removed.
+  void InvalidateStaticScene() { static_cache_valid_ = false; }
+
  private:
-  void UpdateGlobalMatrix(entity::EntityRef& entity,
-                          std::vector<bool>& matrix_calculated);
+  // Per-frame transform state, tracked per pool index during
+  // UpdateGlobalMatrices. 'Clean' means the global matrix is already
+  // current from a previous frame; 'Changed' means it was recomputed this
+  // frame, so children must recompute too.
+  enum TransformState {
+    kTransformUnknown = 0,
+    kTransformClean,
+    kTransformChanged
+  };
+
+  TransformState UpdateGlobalMatrix(size_t data_index,
+                                    std::vector<uint8_t>& transform_state);
   void UpdateGlobalMatrices();
-  bool VisibleInHierarchy(const entity::EntityRef& entity) const;
+  bool VisibleInHierarchy(size_t data_index) const;
 
   motive::MotiveEngine* engine_;
+
+  // Scratch for UpdateGlobalMatrices, holding TransformState values; a
+  // member so the allocation is reused across frames.
+  std::vector<uint8_t> transform_state_;
+
+  // Per-pool-index parent resolution, refreshed at the top of
+  // UpdateGlobalMatrices: every object's cached parent handle is gathered
+  // into parent_handles_ and resolved with one
+  // EntityManager::ResolveEntities pass into parent_entities_. The
+  // hierarchy sweeps then test a pointer per object rather than paying a
+  // reference validity check at each access. Members so the allocations
+  // are reused across frames.
+  std::vector<entity::EntityHandle> parent_handles_;
+  std::vector<entity::Entity*> parent_entities_;
+
+  // Snapshot of the static objects' render data, reused frame to frame so
+  // population only walks the dynamic objects. Rebuilt when invalidated.
+  bool static_cache_valid_;
+  std::vector<Renderable> static_renderables_;
+  std::vector<Renderable> static_quads_;
+
+  // Incremented every time the cache above is rebuilt, and published to
+  // the scene via SceneDescription::set_static_version so the renderer
+  // knows when geometry baked from the cache is stale.
+  uint32_t static_cache_version_;
 };
 
 }  // pie_noon
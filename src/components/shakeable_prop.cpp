@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <assert.h>
+#include <math.h>
 #include "scene_object.h"
 #include "shakeable_prop.h"
 #include "utilities.h"
@@ -24,8 +25,14 @@ using mathfu::mat4;
 namespace fpl {
 namespace pie_noon {
 
+// A prop whose shake rotation moves less than this per frame (in radians)
+// is considered at rest; its scene object keeps whatever rotation was last
+// written, which is visually indistinguishable from fully settled.
+static const float kShakeRestThreshold = 0.0005f;
+
 void ShakeablePropComponent::UpdateAllEntities(
     entity::WorldTime /*delta_time*/) {
+  bool any_moved = false;
   for (auto iter = entity_data_.begin(); iter != entity_data_.end(); ++iter) {
     entity::EntityRef entity = iter->entity;
     ShakeablePropData* sp_data = GetEntityData(iter->entity);
@@ -33,10 +40,32 @@ void ShakeablePropComponent::UpdateAllEntities(
     assert(so_data != nullptr && sp_data != nullptr);
 
     if (sp_data->motivator.Valid()) {
-      so_data->SetPreRotationAboutAxis(sp_data->motivator.Value(),
-                                       sp_data->axis);
+      // Props spend almost all of their time at rest, so only touch the
+      // scene object (and so invalidate the static scene cache) while the
+      // shake is actually moving.
+      const float rotation = sp_data->motivator.Value();
+      if (fabs(rotation - sp_data->last_rotation) > kShakeRestThreshold) {
+        so_data->SetPreRotationAboutAxis(rotation, sp_data->axis);
+        sp_data->last_rotation = rotation;
+        any_moved = true;
+      }
     }
   }
+  if (any_moved) {
+    entity_manager_->GetComponent<SceneObjectComponent>()
+        ->InvalidateStaticScene();
+  }
+}
+
+entity::ComponentInterface::UpdateAccess
+ShakeablePropComponent::DeclareUpdateAccess() const {
+  // The update only copies each prop's shake motivator into its scene
+  // object's pre-rotation, so it can overlap any component that stays out
+  // of scene object data.
+  UpdateAccess access;
+  access.parallel_safe = true;
+  access.writes.push_back(ComponentDataUnion_SceneObjectDef);
+  return access;
 }
 
 // Add the basic renderable component to the entity, if it doesn't have it
@@ -44,6 +73,11 @@ void ShakeablePropComponent::UpdateAllEntities(
 void ShakeablePropComponent::InitEntity(entity::EntityRef& entity) {
   entity_manager_->AddEntityToComponent(entity,
                                         ComponentDataUnion_SceneObjectDef);
+
+  // Props sit still except during a shake, so their scene objects qualify
+  // for the static scene cache. UpdateAllEntities invalidates the cache
+  // whenever a shake moves them.
+  Data<SceneObjectData>(entity)->set_static_scene(true);
 }
 
 void ShakeablePropComponent::AddFromRawData(entity::EntityRef& entity,
@@ -68,6 +102,15 @@ void ShakeablePropComponent::AddFromRawData(entity::EntityRef& entity,
 
     entity_data->motivator.Initialize(scaled_shake_init, engine_);
   }
+
+  // A prop with no motivator or a zero shake scale can never move: nothing
+  // else ever touches a prop's transform, so it keeps its load-time world
+  // matrix for the life of the scene. Mark it so the renderer can bake its
+  // geometry into the merged static meshes (see
+  // PieNoonGame::UpdateMergedStaticProps).
+  Data<SceneObjectData>(entity)->set_merge_static(
+      sp_data->shake_motivator() == MotivatorSpecification_None ||
+      entity_data->shake_scale == 0.0f);
 }
 
 // Preload specifications for motivators from the config file.
@@ -29,15 +29,21 @@ namespace fpl {
 namespace pie_noon {
 
 struct ShakeablePropData {
-  ShakeablePropData() {}
+  ShakeablePropData() : last_rotation(0.0f) {}
   float shake_scale;
   Axis axis;
   motive::Motivator1f motivator;
+
+  // The shake rotation last written to the scene object. Used to detect
+  // when a prop has come to rest, so the static scene cache only gets
+  // invalidated while props are actually moving.
+  float last_rotation;
 };
 
 class ShakeablePropComponent : public entity::Component<ShakeablePropData> {
  public:
   virtual void UpdateAllEntities(entity::WorldTime delta_time);
+  virtual UpdateAccess DeclareUpdateAccess() const;
   virtual void AddFromRawData(entity::EntityRef& entity, const void* data);
   virtual void InitEntity(entity::EntityRef& entity);
   virtual void CleanupEntity(entity::EntityRef& entity);
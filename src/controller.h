@@ -63,6 +63,13 @@ class Controller {
   // Clear all the currently set logical inputs.
   void ClearAllLogicalInputs();
 
+  // Clear just the one-frame edge bits, leaving is_down intact. Replay
+  // playback uses this in place of the controller's own AdvanceFrame.
+  void ClearTransientInputs() {
+    went_down_ = 0;
+    went_up_ = 0;
+  }
+
  protected:
   // A bitfield of currently active logical input bits.
   uint32_t is_down_;
@@ -0,0 +1,203 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "dynamic_resolution.h"
+
+namespace fpl {
+
+// One controller step, per axis. Coarse enough that the scale settles
+// instead of dithering between adjacent sizes every few frames.
+static const float kScaleStep = 1.0f / 16.0f;
+
+// Smoothing factor for the GPU frame time EMA. Light smoothing: the
+// timer queries already lag a few frames, so heavy filtering here would
+// just slow the response further.
+static const float kTimeSmoothing = 0.25f;
+
+// After stepping down, wait this many frames before stepping again, so
+// the lagging timer-query feedback can reflect the new resolution first.
+static const int kDropCooldownFrames = 8;
+
+// Step back up only after this many consecutive frames comfortably under
+// target, and only while under this fraction of it. Recovery is slow on
+// purpose: flipping back to a resolution that just missed budget causes
+// visible scale oscillation.
+static const int kRaiseAfterFrames = 120;
+static const float kRaiseHeadroom = 0.85f;
+
+DynamicResolution::DynamicResolution()
+    : renderer_(nullptr),
+      blit_shader_(nullptr),
+      target_ms_(0.0f),
+      min_scale_(1.0f),
+      scale_(1.0f),
+      smoothed_ms_(0.0f),
+      frames_under_budget_(0),
+      drop_cooldown_(0),
+      fbo_(0),
+      color_texture_(0),
+      depth_buffer_(0),
+      target_size_(mathfu::kZeros2i),
+      scene_size_(mathfu::kZeros2i),
+      enabled_(false) {}
+
+DynamicResolution::~DynamicResolution() { DestroyRenderTarget(); }
+
+void DynamicResolution::Initialize(Renderer *renderer, Shader *blit_shader,
+                                   float target_ms, float min_scale) {
+  assert(renderer != nullptr && blit_shader != nullptr && target_ms > 0.0f);
+  renderer_ = renderer;
+  blit_shader_ = blit_shader;
+  target_ms_ = target_ms;
+  min_scale_ = mathfu::Clamp(min_scale, kScaleStep, 1.0f);
+  enabled_ = renderer->SupportsGpuTimerQueries();
+  if (!enabled_) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Dynamic resolution disabled: no GPU timer queries.");
+  }
+}
+
+bool DynamicResolution::BeginScenePass() {
+  if (!enabled_ || scale_ >= 1.0f) return false;
+
+  const vec2i window_size = renderer_->window_size();
+  if (window_size.x() <= 0 || window_size.y() <= 0) return false;
+  if (fbo_ == 0 || window_size.x() != target_size_.x() ||
+      window_size.y() != target_size_.y()) {
+    if (!CreateRenderTarget(window_size)) return false;
+  }
+
+  scene_size_ = vec2i(
+      std::max(1, static_cast<int>(target_size_.x() * scale_)),
+      std::max(1, static_cast<int>(target_size_.y() * scale_)));
+
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fbo_));
+  GL_CALL(glViewport(0, 0, scene_size_.x(), scene_size_.y()));
+  GL_CALL(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
+  GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+  return true;
+}
+
+void DynamicResolution::EndScenePass() {
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  GL_CALL(glViewport(0, 0, target_size_.x(), target_size_.y()));
+
+  // Stretch the rendered sub-rectangle over the window. Texture v = 0 is
+  // the bottom of the scene and clip-space y = -1 the bottom of the
+  // window, so no flip is needed.
+  renderer_->SetBlendMode(kBlendModeOff);
+  renderer_->DepthTest(false);
+  renderer_->color() = mathfu::kOnes4f;
+  renderer_->model_view_projection() = mat4::Identity();
+  blit_shader_->Set(*renderer_);
+  Renderer::BindTexture(0, color_texture_);
+  const vec2 uv_max(
+      scene_size_.x() / static_cast<float>(target_size_.x()),
+      scene_size_.y() / static_cast<float>(target_size_.y()));
+  Mesh::RenderAAQuadAlongX(vec3(-1.0f, -1.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f),
+                           vec2(0.0f, 0.0f), uv_max);
+  renderer_->DepthTest(true);
+}
+
+void DynamicResolution::AdvanceFrame(float gpu_frame_ms) {
+  if (!enabled_ || gpu_frame_ms <= 0.0f) return;
+
+  smoothed_ms_ = smoothed_ms_ <= 0.0f
+                     ? gpu_frame_ms
+                     : smoothed_ms_ +
+                           (gpu_frame_ms - smoothed_ms_) * kTimeSmoothing;
+
+  if (drop_cooldown_ > 0) --drop_cooldown_;
+
+  if (smoothed_ms_ > target_ms_) {
+    frames_under_budget_ = 0;
+    if (drop_cooldown_ == 0 && scale_ > min_scale_) {
+      scale_ = std::max(min_scale_, scale_ - kScaleStep);
+      drop_cooldown_ = kDropCooldownFrames;
+    }
+  } else if (smoothed_ms_ < target_ms_ * kRaiseHeadroom) {
+    if (++frames_under_budget_ >= kRaiseAfterFrames && scale_ < 1.0f) {
+      scale_ = std::min(1.0f, scale_ + kScaleStep);
+      frames_under_budget_ = 0;
+    }
+  } else {
+    // In the dead band between headroom and target: hold the scale.
+    frames_under_budget_ = 0;
+  }
+}
+
+bool DynamicResolution::CreateRenderTarget(const vec2i &size) {
+  DestroyRenderTarget();
+
+  GL_CALL(glGenTextures(1, &color_texture_));
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, color_texture_));
+  Renderer::InvalidateGlStateShadow();
+  // Linear filtering is the upscale: no extra shader work per pixel.
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x(), size.y(), 0,
+                       GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+
+  GL_CALL(glGenRenderbuffers(1, &depth_buffer_));
+  GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_));
+  GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16,
+                                size.x(), size.y()));
+  GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+  GL_CALL(glGenFramebuffers(1, &fbo_));
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fbo_));
+  GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                 GL_TEXTURE_2D, color_texture_, 0));
+  GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                    GL_RENDERBUFFER, depth_buffer_));
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Can't create dynamic resolution framebuffer (status 0x%x), "
+                 "disabling dynamic resolution.",
+                 status);
+    DestroyRenderTarget();
+    enabled_ = false;
+    return false;
+  }
+
+  target_size_ = size;
+  return true;
+}
+
+void DynamicResolution::DestroyRenderTarget() {
+  if (fbo_) {
+    GL_CALL(glDeleteFramebuffers(1, &fbo_));
+    fbo_ = 0;
+  }
+  if (depth_buffer_) {
+    GL_CALL(glDeleteRenderbuffers(1, &depth_buffer_));
+    depth_buffer_ = 0;
+  }
+  if (color_texture_) {
+    GL_CALL(glDeleteTextures(1, &color_texture_));
+    // Deleting a texture unbinds it wherever it was bound.
+    Renderer::InvalidateGlStateShadow();
+    color_texture_ = 0;
+  }
+  target_size_ = mathfu::kZeros2i;
+}
+
+}  // namespace fpl
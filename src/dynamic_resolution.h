@@ -0,0 +1,98 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "renderer.h"
+
+namespace fpl {
+
+// Dynamic resolution scaling. When the GPU falls behind (thermal
+// throttling, weaker-than-configured device), the 3D scene pass renders
+// into a sub-rectangle of an offscreen target and a final blit stretches
+// it over the window, while the UI keeps rendering at native resolution.
+// The sub-rectangle's size is steered by the renderer's GPU timer-query
+// feedback toward a target frame time, so throttling degrades to mild
+// softness instead of dropped frames.
+//
+// The offscreen target is allocated once at window size; a scale change
+// only moves the viewport, so adaptation is free. At full scale the
+// offscreen pass is skipped entirely and rendering is exactly as before.
+// Timer-query results resolve a few frames after submission, so the
+// controller reacts with a few frames of latency; it steps down quickly
+// and recovers slowly to keep the scale from oscillating.
+class DynamicResolution {
+ public:
+  DynamicResolution();
+  ~DynamicResolution();
+
+  // Arm scaling. 'blit_shader' draws the upscale quad (a plain textured
+  // shader); it and 'renderer' must outlive this object. 'target_ms' is
+  // the GPU frame time to steer toward and 'min_scale' the lowest axis
+  // scale the controller may pick. Without Initialize (or when the driver
+  // has no timer queries to steer from), BeginScenePass always declines.
+  void Initialize(Renderer *renderer, Shader *blit_shader, float target_ms,
+                  float min_scale);
+
+  // When a reduced-resolution pass is warranted, binds the offscreen
+  // target, clears it, and sets the viewport to the scaled sub-rectangle;
+  // the caller then renders the scene normally and must call
+  // EndScenePass. Returns false -- default framebuffer untouched, no
+  // EndScenePass expected -- when scaling is off, at full scale, or the
+  // offscreen target can't be created.
+  bool BeginScenePass();
+
+  // Rebinds the default framebuffer, restores the full-window viewport
+  // and stretches the scene sub-rectangle over it.
+  void EndScenePass();
+
+  // Feed back the most recent GPU frame time and let the controller
+  // adjust the scale. Call once per frame; 0 (timings not resolved yet)
+  // is ignored.
+  void AdvanceFrame(float gpu_frame_ms);
+
+  // Current per-axis scale factor, in [min_scale, 1].
+  float scale() const { return scale_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DynamicResolution);
+
+  // (Re)create the offscreen color + depth target at the given size.
+  // Returns false (and disables scaling) if the framebuffer can't be
+  // completed.
+  bool CreateRenderTarget(const vec2i &size);
+  void DestroyRenderTarget();
+
+  Renderer *renderer_;
+  Shader *blit_shader_;
+  float target_ms_;
+  float min_scale_;
+
+  float scale_;
+  float smoothed_ms_;        // EMA of the fed-back GPU frame times.
+  int frames_under_budget_;  // Consecutive frames comfortably under target.
+  int drop_cooldown_;        // Frames left before another step down.
+
+  GLuint fbo_;
+  GLuint color_texture_;
+  GLuint depth_buffer_;
+  vec2i target_size_;  // Allocated offscreen target size.
+  vec2i scene_size_;   // Sub-rectangle the scene pass rendered to.
+  bool enabled_;
+};
+
+}  // namespace fpl
+
+#endif  // DYNAMIC_RESOLUTION_H
@@ -28,8 +28,11 @@ namespace entity {
 // Component class.
 // All components should should extend this class.  The type T is used to
 // specify the structure of the data that needs to be associated with each
-// entity.
-template <typename T>
+// entity.  PoolType selects the storage layout for that data: the default
+// VectorPool interleaves data and pool bookkeeping, while VectorPoolSoA
+// keeps the data densely packed, which is worth it for large component
+// structs that get walked every frame.
+template <typename T, template <typename> class PoolType = VectorPool>
 class Component : public ComponentInterface {
  public:
   // Structure associated with each entity.
@@ -39,7 +42,7 @@ class Component : public ComponentInterface {
     EntityRef entity;
     T data;
   };
-  typedef typename VectorPool<EntityData>::Iterator EntityIterator;
+  typedef typename PoolType<EntityData>::Iterator EntityIterator;
 
   Component() : entity_manager_(nullptr) {}
 
@@ -150,6 +153,14 @@ class Component : public ComponentInterface {
     }
   }
 
+  // Re-sort the pool's free list so future allocations keep the data dense.
+  virtual void DefragmentStorage() { entity_data_.SortFreeList(); }
+
+  // Grow the data pool ahead of a known burst of AddEntity calls.
+  virtual void ReserveEntityData(size_t count) {
+    entity_data_.ReserveAdditional(count);
+  }
+
   // Utility function for getting the component data for a specific component.
   template <typename ComponentDataType>
   ComponentDataType* Data(EntityRef& entity) {
@@ -214,7 +225,7 @@ class Component : public ComponentInterface {
     return entity->GetComponentDataIndex(GetComponentId());
   }
 
-  VectorPool<EntityData> entity_data_;
+  PoolType<EntityData> entity_data_;
   EntityManager* entity_manager_;
 };
 
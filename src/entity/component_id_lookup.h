@@ -34,18 +34,23 @@ template <typename T> struct ComponentIdLookup {};
 // type that the component was specialized for.)
 // Id is the unique identifier that is associated with the component.
 #define FPL_ENTITY_REGISTER_COMPONENT(ComponentType, DataType, Id) \
-  FPL_ENTITY_REGISTER_COMPONENT_ID(ComponentType, Id) \
-  FPL_ENTITY_REGISTER_COMPONENT_ID(DataType, Id)
+  FPL_ENTITY_REGISTER_COMPONENT_ID(ComponentType, ComponentType, Id) \
+  FPL_ENTITY_REGISTER_COMPONENT_ID(DataType, ComponentType, Id)
 
 // This macro handles the lower level job of generating code to associate data
 // with a type.  It is usually invoked by FPL_REGISTER_COMPONENT, rather than
 // invoking it directly.  (Since registration of a component requires multiple
 // datatype/ID registrations.)
-#define FPL_ENTITY_REGISTER_COMPONENT_ID(DataType, Id) \
+// In addition to the id, the specialization records the concrete component
+// class, so that templated accessors like EntityManager::GetComponentData
+// can cast straight to it and reach the component's inline, non-virtual
+// data accessors instead of going through ComponentInterface.
+#define FPL_ENTITY_REGISTER_COMPONENT_ID(DataType, ComponentType, Id) \
   namespace fpl { \
   namespace entity { \
   template<> struct ComponentIdLookup<DataType> { \
     static const int kComponentId = Id; \
+    typedef ComponentType Component; \
   }; \
   } \
   }
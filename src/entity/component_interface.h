@@ -15,6 +15,8 @@
 #ifndef FPL_BASE_COMPONENT_H_
 #define FPL_BASE_COMPONENT_H_
 
+#include <vector>
+
 #include "entity.h"
 #include "entity_common.h"
 #include "entity_manager.h"
@@ -32,6 +34,20 @@ typedef VectorPool<entity::Entity>::VectorPoolReference EntityRef;
 // type it is.
 class ComponentInterface {
  public:
+  // Describes what a component's UpdateAllEntities touches, so the entity
+  // manager can overlap updates that cannot conflict. A component always
+  // writes its own data; 'reads' and 'writes' list the *other* components'
+  // data it touches through the entity manager. Components that leave
+  // 'parallel_safe' false (the default) are conservatively treated as
+  // conflicting with everything, e.g. because their update deletes entities
+  // or touches non-component state.
+  struct UpdateAccess {
+    UpdateAccess() : parallel_safe(false) {}
+    bool parallel_safe;
+    std::vector<ComponentId> reads;
+    std::vector<ComponentId> writes;
+  };
+
   virtual ~ComponentInterface() {}
 
   // Add an entity to the component.  (Note - usually you'll want to use
@@ -42,12 +58,24 @@ class ComponentInterface {
   virtual void RemoveEntity(EntityRef& entity) = 0;
   // Update all entities that contain this component.
   virtual void UpdateAllEntities(WorldTime delta_time) = 0;
+  // Declare what UpdateAllEntities reads and writes; see UpdateAccess above.
+  // The default declaration keeps the component on the serial path.
+  virtual UpdateAccess DeclareUpdateAccess() const { return UpdateAccess(); }
   // Clear all entity data, effectively disassociating this component
   // from any entities.  (Note that this does NOT change entities, so they may
   // still think we have data for them.)  Normally this isn't something you
   // want to invoke directly.  It's usually used by things like Entity.Clear(),
   // when something wants to nuke all the data everywhere and start over.
   virtual void ClearEntityData() = 0;
+  // Tidy the component's storage after a burst of entity deletions, so
+  // that future allocations refill it in a cache-friendly order. Never
+  // moves live data; safe to call at any time. See
+  // VectorPool::SortFreeList. The default does nothing.
+  virtual void DefragmentStorage() {}
+  // Pre-size the component's storage for 'count' upcoming entity
+  // additions, so a known burst of additions grows the underlying pool at
+  // most once instead of element by element. The default does nothing.
+  virtual void ReserveEntityData(size_t /*count*/) {}
   // Return the entity data as a void* pointer.  (The caller is responsible for
   // casting it into something useful.)
   virtual void* GetEntityDataAsVoid(const EntityRef&) = 0;
@@ -13,22 +13,65 @@
 // limitations under the License.
 
 #include <assert.h>
+#include "alloc_tracker.h"
 #include "component_id_lookup.h"
 #include "entity_manager.h"
 
 namespace fpl {
 namespace entity {
 
-EntityManager::EntityManager() : entity_factory_(nullptr) {
+EntityManager::EntityManager()
+    : entity_factory_(nullptr),
+      update_schedule_dirty_(true),
+      update_jobs_in_flight_(0),
+      update_delta_time_(0),
+      update_workers_exit_(false) {
   for (int i = 0; i < kMaxComponentCount; i++) {
     components_[i] = nullptr;
   }
 }
 
+EntityManager::~EntityManager() {
+  {
+    std::unique_lock<std::mutex> lock(update_mutex_);
+    update_workers_exit_ = true;
+  }
+  update_job_available_.notify_all();
+  for (size_t i = 0; i < update_workers_.size(); ++i) {
+    update_workers_[i].join();
+  }
+}
+
 EntityRef EntityManager::AllocateNewEntity() {
+  ScopedAllocTag tag(AllocTracker::kTagEntities);
   return EntityRef(entities_.GetNewElement(kAddToFront));
 }
 
+void EntityManager::ReserveEntities(size_t count) {
+  ScopedAllocTag tag(AllocTracker::kTagEntities);
+  entities_.ReserveAdditional(count);
+}
+
+void EntityManager::AllocateNewEntities(int count,
+                                        const ComponentId* component_ids,
+                                        int num_component_ids,
+                                        std::vector<EntityRef>* out) {
+  ScopedAllocTag tag(AllocTracker::kTagEntities);
+  entities_.ReserveAdditional(count);
+  for (int i = 0; i < num_component_ids; i++) {
+    ComponentInterface* component = GetComponent(component_ids[i]);
+    assert(component != nullptr);
+    component->ReserveEntityData(count);
+  }
+  for (int i = 0; i < count; i++) {
+    EntityRef entity = AllocateNewEntity();
+    for (int j = 0; j < num_component_ids; j++) {
+      components_[component_ids[j]]->AddEntityGenerically(entity);
+    }
+    out->push_back(entity);
+  }
+}
+
 // Note: This function doesn't actually delete the entity immediately -
 // it just marks it for deletion, and it gets cleaned out at the end of the
 // next AdvanceFrame.
@@ -48,13 +91,27 @@ void EntityManager::DeleteEntityImmediately(EntityRef entity) {
   entities_.FreeElement(entity);
 }
 
+// A frame that deletes at least this many entities (the end of a
+// multiscreen round tears down dozens at once) leaves the pools' free lists
+// in deletion order, so re-sort them. Small trickles of deletions aren't
+// worth the O(pool size) walk.
+static const size_t kDefragmentDeletionThreshold = 16;
+
 void EntityManager::DeleteMarkedEntities() {
-  for (size_t i = 0; i < entities_to_delete_.size(); i++) {
+  const size_t num_deleted = entities_to_delete_.size();
+  for (size_t i = 0; i < num_deleted; i++) {
     EntityRef entity = entities_to_delete_[i];
     RemoveAllComponents(entity);
     entities_.FreeElement(entity);
   }
   entities_to_delete_.resize(0);
+
+  if (num_deleted >= kDefragmentDeletionThreshold) {
+    entities_.SortFreeList();
+    for (ComponentId i = 0; i < kMaxComponentCount; i++) {
+      if (components_[i]) components_[i]->DefragmentStorage();
+    }
+  }
 }
 
 void EntityManager::RemoveAllComponents(EntityRef entity) {
@@ -69,6 +126,9 @@ void EntityManager::AddEntityToComponent(EntityRef entity,
                                          ComponentId component_id) {
   ComponentInterface* component = GetComponent(component_id);
   assert(component != nullptr);
+  // Component data pools grow inside AddEntityGenerically; attribute that
+  // growth to the entity system.
+  ScopedAllocTag tag(AllocTracker::kTagEntities);
   component->AddEntityGenerically(entity);
 }
 
@@ -80,6 +140,7 @@ void EntityManager::RegisterComponentHelper(ComponentInterface* new_component,
   components_[id] = new_component;
   new_component->SetEntityManager(this);
   new_component->Init();
+  update_schedule_dirty_ = true;
 }
 
 void* EntityManager::GetComponentDataAsVoid(EntityRef entity,
@@ -96,10 +157,133 @@ const void* EntityManager::GetComponentDataAsVoid(
              : nullptr;
 }
 
+// Returns true if 'value' appears in 'list'.
+static bool Contains(const std::vector<ComponentId>& list, ComponentId value) {
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (list[i] == value) return true;
+  }
+  return false;
+}
+
+// Two updates conflict when either writes data the other reads or writes.
+static bool AccessesConflict(const ComponentInterface::UpdateAccess& a,
+                             const ComponentInterface::UpdateAccess& b) {
+  for (size_t i = 0; i < a.writes.size(); ++i) {
+    if (Contains(b.writes, a.writes[i]) || Contains(b.reads, a.writes[i])) {
+      return true;
+    }
+  }
+  for (size_t i = 0; i < b.writes.size(); ++i) {
+    if (Contains(a.reads, b.writes[i])) return true;
+  }
+  return false;
+}
+
+void EntityManager::BuildUpdateSchedule() {
+  update_waves_.clear();
+  struct ScheduledComponent {
+    ComponentInterface* component;
+    ComponentInterface::UpdateAccess access;
+    size_t wave;
+  };
+  std::vector<ScheduledComponent> scheduled;
+  for (ComponentId id = 0; id < kMaxComponentCount; ++id) {
+    if (!components_[id]) continue;
+    ScheduledComponent entry;
+    entry.component = components_[id];
+    entry.access = components_[id]->DeclareUpdateAccess();
+    // A component always writes its own data.
+    entry.access.writes.push_back(id);
+    // Place the component in the wave after its last conflicting
+    // predecessor, so conflicting components never share a wave and keep
+    // their registration order relative to each other. Components that
+    // aren't parallel-safe conflict with everything.
+    entry.wave = 0;
+    for (size_t i = 0; i < scheduled.size(); ++i) {
+      const bool conflict =
+          !entry.access.parallel_safe || !scheduled[i].access.parallel_safe ||
+          AccessesConflict(scheduled[i].access, entry.access);
+      if (conflict && scheduled[i].wave >= entry.wave) {
+        entry.wave = scheduled[i].wave + 1;
+      }
+    }
+    if (entry.wave >= update_waves_.size()) {
+      update_waves_.resize(entry.wave + 1);
+    }
+    update_waves_[entry.wave].push_back(entry.component);
+    scheduled.push_back(entry);
+  }
+  update_schedule_dirty_ = false;
+}
+
+void EntityManager::StartUpdateWorkers() {
+  // Leave a core for the calling thread (which works through jobs as well),
+  // and cap the pool; component counts are small.
+  static const size_t kMaxUpdateWorkers = 3;
+  size_t num_workers = std::thread::hardware_concurrency();
+  num_workers = num_workers > 1 ? num_workers - 1 : 0;
+  if (num_workers > kMaxUpdateWorkers) num_workers = kMaxUpdateWorkers;
+  for (size_t i = 0; i < num_workers; ++i) {
+    update_workers_.push_back(std::thread(&EntityManager::UpdateWorker, this));
+  }
+}
+
+void EntityManager::UpdateWorker() {
+  std::unique_lock<std::mutex> lock(update_mutex_);
+  for (;;) {
+    while (!update_workers_exit_ && update_job_queue_.empty()) {
+      update_job_available_.wait(lock);
+    }
+    if (update_workers_exit_) return;
+    ComponentInterface* job = update_job_queue_.back();
+    update_job_queue_.pop_back();
+    lock.unlock();
+    job->UpdateAllEntities(update_delta_time_);
+    lock.lock();
+    if (--update_jobs_in_flight_ == 0) update_wave_done_.notify_all();
+  }
+}
+
+void EntityManager::RunUpdateWave(const std::vector<ComponentInterface*>& wave,
+                                  WorldTime delta_time) {
+  // Single-component waves run inline; there's nothing to overlap.
+  if (wave.size() <= 1) {
+    for (size_t i = 0; i < wave.size(); ++i) {
+      wave[i]->UpdateAllEntities(delta_time);
+    }
+    return;
+  }
+  if (update_workers_.empty()) StartUpdateWorkers();
+  {
+    std::unique_lock<std::mutex> lock(update_mutex_);
+    update_job_queue_ = wave;
+    update_jobs_in_flight_ = wave.size();
+    update_delta_time_ = delta_time;
+  }
+  update_job_available_.notify_all();
+  // The calling thread works through jobs too, rather than just blocking.
+  for (;;) {
+    ComponentInterface* job = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(update_mutex_);
+      if (update_job_queue_.empty()) break;
+      job = update_job_queue_.back();
+      update_job_queue_.pop_back();
+    }
+    job->UpdateAllEntities(delta_time);
+    std::unique_lock<std::mutex> lock(update_mutex_);
+    if (--update_jobs_in_flight_ == 0) update_wave_done_.notify_all();
+  }
+  std::unique_lock<std::mutex> lock(update_mutex_);
+  while (update_jobs_in_flight_ != 0) update_wave_done_.wait(lock);
+}
+
 void EntityManager::UpdateComponents(WorldTime delta_time) {
-  // Update all the registered components.
-  for (size_t i = 0; i < kMaxComponentCount; i++) {
-    if (components_[i]) components_[i]->UpdateAllEntities(delta_time);
+  // Update all the registered components, a wave of mutually independent
+  // components at a time.
+  if (update_schedule_dirty_) BuildUpdateSchedule();
+  for (size_t i = 0; i < update_waves_.size(); ++i) {
+    RunUpdateWave(update_waves_[i], delta_time);
   }
   DeleteMarkedEntities();
 }
@@ -113,6 +297,7 @@ void EntityManager::Clear() {
     components_[i] = nullptr;
   }
   entities_.Clear();
+  update_schedule_dirty_ = true;
 }
 
 EntityRef EntityManager::CreateEntityFromData(const void* data) {
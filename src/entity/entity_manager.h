@@ -15,6 +15,11 @@
 #ifndef FPL_ENTITY_MANAGER_H_
 #define FPL_ENTITY_MANAGER_H_
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "component_id_lookup.h"
 #include "component_interface.h"
 #include "entity.h"
@@ -26,6 +31,14 @@ namespace entity {
 
 typedef VectorPool<Entity>::VectorPoolReference EntityRef;
 
+// Compact generation+index handle into the entity pool, made with
+// EntityRef::ToHandle() and resolved with EntityManager::ResolveEntities.
+// See VectorPool::PoolHandleType for the aliasing caveats; prefer handles
+// for per-frame resolution caches and EntityRef for long-term ownership.
+typedef VectorPool<Entity>::PoolHandleType EntityHandle;
+static const EntityHandle kInvalidEntityHandle =
+    VectorPool<Entity>::kInvalidHandle;
+
 class EntityFactoryInterface;
 class ComponentInterface;
 
@@ -40,22 +53,32 @@ class ComponentInterface;
 class EntityManager {
  public:
   EntityManager();
+  ~EntityManager();
   typedef VectorPool<Entity> EntityStorageContainer;
 
   // Helper function for marshalling data from a component.
   // Returns nullptr if it couldn't find it for any reason.
+  // The component class is known at compile time (recorded alongside the id
+  // by FPL_ENTITY_REGISTER_COMPONENT), so this casts straight to it and
+  // inlines the pool lookup, with no virtual dispatch. Code that only has a
+  // runtime ComponentId (e.g. the entity factory) still goes through
+  // GetComponentDataAsVoid.
   template <typename T>
   T* GetComponentData(EntityRef& entity) {
-    return static_cast<T*>(GetComponentDataAsVoid(
-        entity, ComponentIdLookup<T>::kComponentId));
+    typedef typename ComponentIdLookup<T>::Component ComponentType;
+    ComponentType* component = static_cast<ComponentType*>(
+        components_[ComponentIdLookup<T>::kComponentId]);
+    return component != nullptr ? component->GetEntityData(entity) : nullptr;
   }
 
   // Helper function for marshalling data from a component.
   // Returns nullptr if it couldn't find it for any reason.
   template <typename T>
   const T* GetComponentData(const EntityRef& entity) const {
-    return static_cast<const T*>(GetComponentDataAsVoid(
-        entity, ComponentIdLookup<T>::kComponentId));
+    typedef typename ComponentIdLookup<T>::Component ComponentType;
+    const ComponentType* component = static_cast<const ComponentType*>(
+        components_[ComponentIdLookup<T>::kComponentId]);
+    return component != nullptr ? component->GetEntityData(entity) : nullptr;
   }
 
   // Helper function for getting a particular component, given its datatype.
@@ -95,6 +118,19 @@ class EntityManager {
   // Returns an entityref to the new entity.
   EntityRef AllocateNewEntity();
 
+  // Pre-size the entity pool for 'count' upcoming allocations, so a known
+  // burst of AllocateNewEntity calls grows the pool at most once instead of
+  // entity by entity.
+  void ReserveEntities(size_t count);
+
+  // Allocates 'count' entities in one batch, registering each with every
+  // component in the 'component_ids' array (of length 'num_component_ids').
+  // Capacity is reserved in the entity pool and in each listed component up
+  // front, so the burst triggers at most one buffer growth per pool rather
+  // than one per entity. The new entities are appended to 'out'.
+  void AllocateNewEntities(int count, const ComponentId* component_ids,
+                           int num_component_ids, std::vector<EntityRef>* out);
+
   // Deletes an entity, removing it from our list, and clearing any component
   // data associated with it.
   // Note: Deletion is deferred until the end of the frame.  If you want to
@@ -120,6 +156,9 @@ class EntityManager {
 
   // Iterates through all registered components, and causes them to update.
   // delta_time represents the timestep since last update.
+  // Components whose declared read/write sets can't conflict (see
+  // ComponentInterface::UpdateAccess) are updated concurrently on worker
+  // threads; conflicting components update in registration order, as before.
   void UpdateComponents(WorldTime delta_time);
 
   // Clears all data from all components, then dumps the list of components
@@ -149,6 +188,16 @@ class EntityManager {
   // update routines.
   void AddEntityToComponent(EntityRef entity, ComponentId component_id);
 
+  // Resolves 'count' entity handles in one pass: out[i] receives the
+  // Entity for handles[i], or nullptr if that handle is stale or
+  // kInvalidEntityHandle. Returns the number of live handles. Intended for
+  // systems that cache handles to other entities and re-resolve them once
+  // per frame, instead of validating a full EntityRef at every access.
+  size_t ResolveEntities(const EntityHandle* handles, size_t count,
+                         Entity** out) {
+    return entities_.ResolveHandles(handles, count, out);
+  }
+
  private:
   // Does all the real work of registering a component, aside from template fun.
   // In particular, verifies that the requested ID isn't already in use,
@@ -174,6 +223,21 @@ class EntityManager {
 
   // Delete all the entities we have marked for deletion.
   void DeleteMarkedEntities();
+
+  // Group registered components into 'waves' of mutually non-conflicting
+  // updates, based on their declared access sets. Called lazily by
+  // UpdateComponents after component registration changes.
+  void BuildUpdateSchedule();
+  // Run one wave: multi-component waves are distributed over the worker
+  // threads (the calling thread participates); single-component waves run
+  // inline.
+  void RunUpdateWave(const std::vector<ComponentInterface*>& wave,
+                     WorldTime delta_time);
+  // Lazily spin up the persistent worker threads.
+  void StartUpdateWorkers();
+  // Worker thread body: pulls component updates from update_job_queue_.
+  void UpdateWorker();
+
   // Storage of all the entities currently tracked by the entitymanager
   EntityStorageContainer entities_;
 
@@ -185,6 +249,21 @@ class EntityManager {
   // Factory used for spawning new entities from data.  Provided by the
   // calling program.
   EntityFactoryInterface* entity_factory_;
+
+  // Update scheduler state. The waves are rebuilt whenever a component is
+  // registered; the worker pool is created on first use and lives until the
+  // manager is destroyed. update_mutex_ guards the job queue and in-flight
+  // count below.
+  std::vector<std::vector<ComponentInterface*>> update_waves_;
+  bool update_schedule_dirty_;
+  std::vector<std::thread> update_workers_;
+  std::mutex update_mutex_;
+  std::condition_variable update_job_available_;
+  std::condition_variable update_wave_done_;
+  std::vector<ComponentInterface*> update_job_queue_;
+  size_t update_jobs_in_flight_;
+  WorldTime update_delta_time_;
+  bool update_workers_exit_;
 };
 
 class EntityFactoryInterface {
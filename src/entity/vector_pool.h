@@ -17,8 +17,18 @@
 
 #include <stddef.h>
 #include <vector>
+#include "alloc_tracker.h"
 #include "assert.h"
 
+// Hint to pull 'address' toward the cache ahead of use; a no-op on
+// compilers without a prefetch intrinsic. Used by the pool sweeps below to
+// hide memory latency once a pool's used list has become scattered.
+#if defined(__GNUC__)
+#define FPL_VECTOR_POOL_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define FPL_VECTOR_POOL_PREFETCH(address) ((void)(address))
+#endif
+
 namespace fpl {
 
 enum AllocationLocation { kAddToFront, kAddToBack };
@@ -33,6 +43,30 @@ class VectorPool {
  public:
   class Iterator;
 
+  // Compact handle into the pool: the low kHandleIndexBits bits hold the
+  // element index, and the high bits hold a generation tag (the low bits of
+  // the element's unique_id at the time the handle was made). A handle is
+  // a quarter the size of a VectorPoolReference, is trivially copyable, and
+  // can be validated with a single masked compare--which makes arrays of
+  // handles cheap to resolve in bulk (see ResolveHandles).
+  //
+  // The tradeoff versus VectorPoolReference is that only
+  // kHandleGenerationMask's worth of the unique_id is kept, so a stale
+  // handle can alias a live element once its slot has been reused
+  // kHandleGenerationMask times. Use handles for caches that are re-derived
+  // from authoritative references periodically (e.g. once per frame);
+  // keep VectorPoolReference for long-term ownership.
+  typedef uint32_t PoolHandleType;
+
+  static const PoolHandleType kInvalidHandle = 0;
+  static const uint32_t kHandleIndexBits = 20;
+  static const uint32_t kHandleIndexMask = (1u << kHandleIndexBits) - 1;
+  // Bits of unique_id carried in the handle as the generation tag. Live
+  // elements never have all of these bits zero (see AllocateUniqueId), so
+  // a zero tag--as in kInvalidHandle, or a freed slot's kInvalidId--never
+  // matches a live element.
+  static const uint32_t kHandleGenerationMask = 0xFFFu;
+
   // ---------------------------
   // Reference object for pointing into the vector pool.
   // Basically works as a pointer for vector pool elements, except
@@ -132,6 +166,17 @@ class VectorPool {
     // Returns an iterator pointing at the element we're referencing
     Iterator ToIterator() const { return Iterator(container_, index_); }
 
+    // Packs this reference into a compact handle (see PoolHandleType).
+    // Returns kInvalidHandle if the reference is default-constructed or no
+    // longer valid.
+    PoolHandleType ToHandle() const {
+      if (!IsValid()) return kInvalidHandle;
+      assert(index_ <= kHandleIndexMask);
+      return static_cast<PoolHandleType>(
+          ((unique_id_ & kHandleGenerationMask) << kHandleIndexBits) |
+          index_);
+    }
+
     // Returns the raw index into the underlying vector for this object.
     size_t index() { return index_; }
 
@@ -268,7 +313,9 @@ class VectorPool {
       RemoveFromList(index);  // remove it from the list of free elements.
     } else {
       index = elements_.size();
+      const size_t old_capacity = elements_.capacity();
       elements_.push_back(VectorPoolElement());
+      TrackCapacityGrowth(old_capacity);
     }
     switch (alloc_location) {
       case kAddToFront:
@@ -339,20 +386,113 @@ class VectorPool {
   // an end condition when iterating over the active elements.
   Iterator end() { return Iterator(this, kLastUsed); }
 
+  // Call func(data) on every active element, in list order. Equivalent to a
+  // begin()/end() loop, but prefetches the element after the current one
+  // while func runs, which hides much of the memory latency once the used
+  // list has become scattered across the array (e.g. after the mass entity
+  // deletion at the end of a multiscreen round). The next element is read
+  // before func is called, so func may safely free the element it is given.
+  template <typename Func>
+  void ForEachActive(Func func) {
+    size_t index = elements_[kFirstUsed].next;
+    while (index != kLastUsed) {
+      const size_t next = elements_[index].next;
+      if (next != kLastUsed) {
+        FPL_VECTOR_POOL_PREFETCH(&elements_[next].data);
+      }
+      func(elements_[index].data);
+      index = next;
+    }
+  }
+
+  // Relink the free list in ascending index order. A burst of deletions
+  // leaves the free list in deletion order, so the holes get refilled in an
+  // order that scatters the used list across memory. Sorting the free list
+  // makes subsequent allocations fill the lowest holes first, which keeps
+  // sweeps over the used list close to sequential again. This is the safe
+  // form of compaction for this pool: active elements are never moved, so
+  // outstanding references, iterators, and indices all remain valid.
+  void SortFreeList() {
+    elements_[kFirstFree].next = kLastFree;
+    elements_[kLastFree].prev = kFirstFree;
+    // Walk backwards with AddToListFront so the list ends up ascending.
+    for (size_t i = elements_.size(); i-- > kTotalReserved;) {
+      if (elements_[i].unique_id == kInvalidId) {
+        AddToListFront(i, kFirstFree);
+      }
+    }
+  }
+
   // Expands the vector until it is at least new_size.  If the vector
   // already contains at least new_size elements, then there is no effect.
   void Reserve(size_t new_size) {
     size_t current_size = elements_.size();
     if (current_size >= new_size) return;
 
+    const size_t old_capacity = elements_.capacity();
     elements_.resize(new_size);
+    TrackCapacityGrowth(old_capacity);
     for (; current_size < new_size; current_size++) {
       elements_[current_size].unique_id = kInvalidId;
       AddToListFront(current_size, kFirstFree);
     }
   }
 
+  // Ensure at least 'count' further elements can be allocated without
+  // growing the underlying vector. Existing free slots count toward the
+  // total, so calling this before every burst doesn't grow the pool past
+  // its high-water mark.
+  void ReserveAdditional(size_t count) {
+    Reserve(kTotalReserved + active_count_ + count);
+  }
+
+  // Resolves a compact handle (see PoolHandleType) to a data pointer, or
+  // nullptr if the handle is invalid or the element it named has been
+  // freed. A single masked compare against the element's unique_id; no
+  // reference construction or assert.
+  T* ResolveHandle(PoolHandleType handle) {
+    const size_t index = handle & kHandleIndexMask;
+    const UniqueIdType generation =
+        static_cast<UniqueIdType>(handle >> kHandleIndexBits);
+    const bool live =
+        generation != 0 && index < elements_.size() &&
+        (elements_[index].unique_id & kHandleGenerationMask) == generation;
+    return live ? &elements_[index].data : nullptr;
+  }
+
+  // Resolves 'count' handles in one pass: out[i] receives the element for
+  // handles[i], or nullptr if that handle is stale or kInvalidHandle.
+  // Returns the number of live handles. The loop body is branch-free
+  // (bounds and generation checks combine into a select), so resolving a
+  // whole array costs one predictable sweep rather than a validity branch
+  // per access at each use site.
+  size_t ResolveHandles(const PoolHandleType* handles, size_t count,
+                        T** out) {
+    const size_t size = elements_.size();
+    size_t num_live = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const size_t index = handles[i] & kHandleIndexMask;
+      const UniqueIdType generation =
+          static_cast<UniqueIdType>(handles[i] >> kHandleIndexBits);
+      const bool live =
+          generation != 0 && index < size &&
+          (elements_[index].unique_id & kHandleGenerationMask) == generation;
+      out[i] = live ? &elements_[index].data : nullptr;
+      num_live += live ? 1 : 0;
+    }
+    return num_live;
+  }
+
  private:
+  // Report vector growth to the allocation tracker, attributed to whatever
+  // ScopedAllocTag is active (the entity system tags its pools).
+  void TrackCapacityGrowth(size_t old_capacity) {
+    if (elements_.capacity() > old_capacity) {
+      AllocTracker::TrackScoped((elements_.capacity() - old_capacity) *
+                                sizeof(VectorPoolElement));
+    }
+  }
+
   // Utility function for removing an element from whatever list it is a part
   // of.  Should always be followed by AddToList, to reassign it, so we don't
   // lose track of it.
@@ -411,7 +551,11 @@ class VectorPool {
     // untility function to make sure it rolls over correctly.
     UniqueIdType result = next_unique_id_;
     next_unique_id_++;
-    if (next_unique_id_ == kInvalidId) next_unique_id_++;
+    // Skip ids whose low kHandleGenerationMask bits are all zero: those
+    // bits double as the handle generation tag, and a zero tag is reserved
+    // for marking freed slots and kInvalidHandle. (This also skips
+    // kInvalidId itself on rollover.)
+    if ((next_unique_id_ & kHandleGenerationMask) == 0) next_unique_id_++;
     return result;
   }
 
@@ -420,6 +564,377 @@ class VectorPool {
   UniqueIdType next_unique_id_;
 };
 
+// Structure-of-arrays variant of VectorPool, with the same API.
+//
+// VectorPool interleaves each element's data with the pool's list
+// bookkeeping (next/prev/unique_id), so iterating over the data of a large
+// component type drags the bookkeeping words through the cache, and walking
+// the used/free lists drags the component data through the cache. This
+// variant splits the two into parallel arrays: 'data_' holds nothing but
+// contiguous T's, which is what per-frame passes like
+// Component::UpdateAllEntities actually touch.
+//
+// Prefer this for components that are large, numerous, and updated every
+// frame; VectorPool remains the better choice for small element types,
+// where the split just doubles the allocation count.
+template <typename T>
+class VectorPoolSoA {
+  friend class Iterator;
+  friend class VectorPoolReference;
+  typedef uint32_t UniqueIdType;
+
+ public:
+  class Iterator;
+
+  // Compact handle into the pool; see VectorPool::PoolHandleType for the
+  // layout, the validity guarantees, and the intended use.
+  typedef uint32_t PoolHandleType;
+
+  static const PoolHandleType kInvalidHandle = 0;
+  static const uint32_t kHandleIndexBits = 20;
+  static const uint32_t kHandleIndexMask = (1u << kHandleIndexBits) - 1;
+  static const uint32_t kHandleGenerationMask = 0xFFFu;
+
+  // Equivalent of VectorPool::VectorPoolReference; see there for the
+  // documentation of each member.
+  class VectorPoolReference {
+    friend class VectorPoolSoA<T>;
+    friend class Iterator;
+
+   public:
+    VectorPoolReference() : container_(nullptr), index_(0), unique_id_(0) {}
+
+    VectorPoolReference(VectorPoolSoA<T>* container, size_t index)
+        : container_(container), index_(index) {
+      unique_id_ = container->links_[index].unique_id;
+    }
+
+    bool operator==(const VectorPoolReference& other) const {
+      return container_ == other.container_ && index_ == other.index_;
+    }
+
+    bool operator!=(const VectorPoolReference& other) const {
+      return !operator==(other);
+    }
+
+    bool IsValid() const {
+      return container_ != nullptr &&
+             index_ < container_->links_.size() &&
+             container_->links_[index_].unique_id == unique_id_;
+    }
+
+    T* operator->() {
+      assert(IsValid());
+      return &container_->data_[index_];
+    }
+
+    const T* operator->() const {
+      return const_cast<VectorPoolReference*>(this)->operator->();
+    }
+
+    T& operator*() {
+      assert(IsValid());
+      return container_->data_[index_];
+    }
+
+    const T& operator*() const {
+      return const_cast<VectorPoolReference*>(this)->operator*();
+    }
+
+    T* ToPointer() { return IsValid() ? &container_->data_[index_] : nullptr; }
+
+    const T* ToPointer() const {
+      return const_cast<VectorPoolReference*>(this)->ToPointer();
+    }
+
+    Iterator ToIterator() const { return Iterator(container_, index_); }
+
+    PoolHandleType ToHandle() const {
+      if (!IsValid()) return kInvalidHandle;
+      assert(index_ <= kHandleIndexMask);
+      return static_cast<PoolHandleType>(
+          ((unique_id_ & kHandleGenerationMask) << kHandleIndexBits) |
+          index_);
+    }
+
+    size_t index() { return index_; }
+
+   private:
+    VectorPoolSoA<T>* container_;
+    size_t index_;
+    UniqueIdType unique_id_;
+  };
+
+  // Equivalent of VectorPool::Iterator; see there for the documentation of
+  // each member. Note that advancing only touches the links array, so
+  // traversal doesn't pull element data into the cache until dereferenced.
+  class Iterator {
+    friend class VectorPoolSoA<T>;
+
+   public:
+    Iterator(VectorPoolSoA<T>* container, size_t index)
+        : container_(container), index_(index) {}
+    ~Iterator() {}
+
+    bool operator==(const Iterator& other) const {
+      return container_ == other.container_ && index_ == other.index_;
+    }
+
+    bool operator!=(const Iterator& other) const { return !operator==(other); }
+
+    Iterator& operator++() {
+      index_ = container_->links_[index_].next;
+      return (*this);
+    }
+
+    Iterator operator++(int) {
+      Iterator temp = *this;
+      ++(*this);
+      return temp;
+    }
+
+    Iterator& operator--() {
+      index_ = container_->links_[index_].prev;
+      return (*this);
+    }
+
+    Iterator operator--(int) {
+      Iterator temp = *this;
+      --(*this);
+      return temp;
+    }
+
+    T& operator*() { return container_->data_[index_]; }
+
+    T* operator->() { return &container_->data_[index_]; }
+
+    VectorPoolReference ToReference() const {
+      return VectorPoolReference(container_, index_);
+    }
+
+    size_t index() const { return index_; }
+
+   private:
+    VectorPoolSoA<T>* container_;
+    size_t index_;
+  };
+
+  // ---------------------------
+
+  static const size_t kOutOfBounds = static_cast<size_t>(-1);
+  static const UniqueIdType kInvalidId = 0;
+
+  // The cold half of each element: the doubly linked used/free lists and
+  // the liveness id, packed away from the data they describe.
+  struct PoolLink {
+    PoolLink() : next(kOutOfBounds), prev(kOutOfBounds), unique_id(kInvalidId) {}
+    size_t next;
+    size_t prev;
+    UniqueIdType unique_id;
+  };
+
+  // List demarcation elements, as in VectorPool.
+  static const size_t kFirstUsed = 0;
+  static const size_t kLastUsed = 1;
+  static const size_t kFirstFree = 2;
+  static const size_t kLastFree = 3;
+  static const size_t kTotalReserved = 4;
+
+  VectorPoolSoA() : active_count_(0), next_unique_id_(kInvalidId + 1) {
+    Clear();
+  }
+
+  T* GetElementData(size_t index) {
+    assert(index < data_.size());
+    return &data_[index];
+  }
+
+  const T* GetElementData(size_t index) const {
+    assert(index < data_.size());
+    return &data_[index];
+  }
+
+  VectorPoolReference GetNewElement(AllocationLocation alloc_location) {
+    size_t index;
+    if (links_[kFirstFree].next != kLastFree) {
+      index = links_[kFirstFree].next;
+      RemoveFromList(index);  // remove it from the list of free elements.
+    } else {
+      index = links_.size();
+      links_.push_back(PoolLink());
+      data_.push_back(T());
+    }
+    switch (alloc_location) {
+      case kAddToFront:
+        AddToListFront(index, kFirstUsed);
+        break;
+      case kAddToBack:
+        AddToListBack(index, kLastUsed);
+        break;
+      default:
+        assert(0);
+    }
+    active_count_++;
+    // Placement new, to make sure we always give back a cleanly constructed
+    // element:
+    new (&data_[index]) T;
+    links_[index].unique_id = AllocateUniqueId();
+    return VectorPoolReference(this, index);
+  }
+
+  void FreeElement(size_t index) {
+    RemoveFromList(index);
+    AddToListFront(index, kFirstFree);
+    links_[index].unique_id = kInvalidId;
+    active_count_--;
+  }
+
+  void FreeElement(VectorPoolReference element) {
+    if (element.IsValid()) {
+      FreeElement(element.index_);
+    }
+  }
+
+  Iterator FreeElement(Iterator iter) {
+    Iterator temp = iter++;
+    FreeElement(temp.index_);
+    return iter;
+  }
+
+  size_t Size() const { return links_.size(); }
+
+  size_t active_count() const { return active_count_; }
+
+  void Clear() {
+    links_.resize(kTotalReserved);
+    data_.resize(kTotalReserved);
+    links_[kFirstUsed].next = kLastUsed;
+    links_[kLastUsed].prev = kFirstUsed;
+    links_[kFirstFree].next = kLastFree;
+    links_[kLastFree].prev = kFirstFree;
+    active_count_ = 0;
+  }
+
+  Iterator begin() { return Iterator(this, links_[kFirstUsed].next); }
+
+  Iterator end() { return Iterator(this, kLastUsed); }
+
+  // See VectorPool::ForEachActive. Traversal stays in the links array; only
+  // the visited (and prefetched) elements' data is pulled into the cache.
+  template <typename Func>
+  void ForEachActive(Func func) {
+    size_t index = links_[kFirstUsed].next;
+    while (index != kLastUsed) {
+      const size_t next = links_[index].next;
+      if (next != kLastUsed) {
+        FPL_VECTOR_POOL_PREFETCH(&data_[next]);
+      }
+      func(data_[index]);
+      index = next;
+    }
+  }
+
+  // See VectorPool::SortFreeList.
+  void SortFreeList() {
+    links_[kFirstFree].next = kLastFree;
+    links_[kLastFree].prev = kFirstFree;
+    for (size_t i = links_.size(); i-- > kTotalReserved;) {
+      if (links_[i].unique_id == kInvalidId) {
+        AddToListFront(i, kFirstFree);
+      }
+    }
+  }
+
+  void Reserve(size_t new_size) {
+    size_t current_size = links_.size();
+    if (current_size >= new_size) return;
+
+    links_.resize(new_size);
+    data_.resize(new_size);
+    for (; current_size < new_size; current_size++) {
+      links_[current_size].unique_id = kInvalidId;
+      AddToListFront(current_size, kFirstFree);
+    }
+  }
+
+  // See VectorPool::ReserveAdditional.
+  void ReserveAdditional(size_t count) {
+    Reserve(kTotalReserved + active_count_ + count);
+  }
+
+  // See VectorPool::ResolveHandle. The generation compare only touches the
+  // links array; the data array is read just for the returned pointer.
+  T* ResolveHandle(PoolHandleType handle) {
+    const size_t index = handle & kHandleIndexMask;
+    const UniqueIdType generation =
+        static_cast<UniqueIdType>(handle >> kHandleIndexBits);
+    const bool live =
+        generation != 0 && index < links_.size() &&
+        (links_[index].unique_id & kHandleGenerationMask) == generation;
+    return live ? &data_[index] : nullptr;
+  }
+
+  // See VectorPool::ResolveHandles.
+  size_t ResolveHandles(const PoolHandleType* handles, size_t count,
+                        T** out) {
+    const size_t size = links_.size();
+    size_t num_live = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const size_t index = handles[i] & kHandleIndexMask;
+      const UniqueIdType generation =
+          static_cast<UniqueIdType>(handles[i] >> kHandleIndexBits);
+      const bool live =
+          generation != 0 && index < size &&
+          (links_[index].unique_id & kHandleGenerationMask) == generation;
+      out[i] = live ? &data_[index] : nullptr;
+      num_live += live ? 1 : 0;
+    }
+    return num_live;
+  }
+
+ private:
+  void RemoveFromList(size_t index) {
+    assert(index < links_.size() && index >= kTotalReserved);
+    PoolLink& link = links_[index];
+    links_[link.prev].next = link.next;
+    links_[link.next].prev = link.prev;
+  }
+
+  void AddToListFront(size_t index, size_t start_index) {
+    assert(index < links_.size() && index >= kTotalReserved);
+    PoolLink& list_start = links_[start_index];
+    links_[list_start.next].prev = index;
+    links_[index].prev = start_index;
+    links_[index].next = list_start.next;
+    list_start.next = index;
+  }
+
+  void AddToListBack(size_t index, size_t end_index) {
+    assert(index < links_.size() && index >= kTotalReserved);
+    PoolLink& list_end = links_[end_index];
+    links_[list_end.prev].next = index;
+    links_[index].next = end_index;
+    links_[index].prev = list_end.prev;
+    list_end.prev = index;
+  }
+
+  UniqueIdType AllocateUniqueId() {
+    UniqueIdType result = next_unique_id_;
+    next_unique_id_++;
+    // See VectorPool::AllocateUniqueId: keep the handle generation bits of
+    // live ids nonzero.
+    if ((next_unique_id_ & kHandleGenerationMask) == 0) next_unique_id_++;
+    return result;
+  }
+
+  // Parallel arrays: data_[i]'s bookkeeping lives in links_[i]. The two are
+  // always kept the same size.
+  std::vector<PoolLink> links_;
+  std::vector<T> data_;
+  size_t active_count_;
+  UniqueIdType next_unique_id_;
+};
+
 }  // fpl
 
 #endif  // VECTOR_POOL_H
@@ -23,10 +23,46 @@
 #include <hb-ft.h>
 
 #include "font_manager.h"
+#include "async_loader.h"
+#include "mesh.h"
 #include "utilities.h"
 
 namespace fpl {
 
+// The bytes of one font file, loaded through the AsyncLoader. The worker
+// thread only reads the file; the FreeType/HarfBuzz objects are created in
+// Finalize on the main thread, where all other FontManager work happens.
+class FontFaceResource : public AsyncResource {
+ public:
+  FontFaceResource(const std::string &filename, FontManager *manager)
+      : AsyncResource(filename), manager_(manager), done_(false) {}
+  virtual ~FontFaceResource() {}
+
+  virtual void Load() {
+    if (!LoadFile(filename_.c_str(), &font_data_)) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Can't load font resource: %s\n",
+                   filename_.c_str());
+      font_data_.clear();
+    }
+  }
+
+  virtual void Finalize() {
+    if (!font_data_.empty()) {
+      // Hand the bytes to the manager; it keeps them alive for FreeType.
+      manager_->font_data_.swap(font_data_);
+      manager_->InitializeFace(filename_.c_str());
+    }
+    done_ = true;
+  }
+
+  bool done() const { return done_; }
+
+ private:
+  FontManager *manager_;
+  std::string font_data_;
+  bool done_;
+};
+
 // Singleton object of FreeType&Harfbuzz.
 FT_Library *FontManager::ft_;
 hb_buffer_t *FontManager::harfbuzz_buf_;
@@ -35,7 +71,9 @@ FontManager::FontManager()
     : renderer_(nullptr),
       face_initialized_(false),
       current_atlas_revision_(0),
-      current_pass_(0) {
+      current_pass_(0),
+      buffer_cache_budget_(kDefaultBufferCacheBudget),
+      frame_count_(0) {
   Initialize();
 
   // Initialize glyph cache.
@@ -47,7 +85,9 @@ FontManager::FontManager(const mathfu::vec2i &cache_size)
     : renderer_(nullptr),
       face_initialized_(false),
       current_atlas_revision_(0),
-      current_pass_(0) {
+      current_pass_(0),
+      buffer_cache_budget_(kDefaultBufferCacheBudget),
+      frame_count_(0) {
   Initialize();
 
   // Initialize glyph cache.
@@ -81,13 +121,22 @@ void FontManager::Terminate() {
 }
 
 FontBuffer *FontManager::GetBuffer(const char *text, const float ysize) {
+  // No face yet (an OpenAsync() load may still be in flight); callers
+  // treat nullptr as "draw nothing this frame".
+  if (!face_initialized_) return nullptr;
+
   // Adjust y size if the size selector is set.
   int32_t converted_ysize = ConvertSize(ysize);
   float scale = ysize / static_cast<float>(converted_ysize);
 
+  // Digit strings churn through distinct values (scores, countdown timers),
+  // so they live in their own bounded cache and recycle retired buffers.
+  const bool digits = IsDigitString(text);
+  auto &buffer_map = digits ? map_digit_buffers_ : map_buffers_;
+
   // Check cache if we already have a FontBuffer generated.
-  auto it = map_buffers_.find(text);
-  if (it != map_buffers_.end()) {
+  auto it = buffer_map.find(text);
+  if (it != buffer_map.end()) {
     auto t = it->second.find(ysize);
     if (t != it->second.end()) {
       // Update current pass.
@@ -95,6 +144,9 @@ FontBuffer *FontManager::GetBuffer(const char *text, const float ysize) {
         t->second->set_pass(current_pass_);
       }
 
+      // Refresh the recency stamp used for cache eviction.
+      t->second->set_last_use_frame(frame_count_);
+
       // Update UV of the buffer
       auto ret = UpdateUV(converted_ysize, t->second.get());
       return ret;
@@ -106,18 +158,25 @@ FontBuffer *FontManager::GetBuffer(const char *text, const float ysize) {
   // Set freetype settings.
   FT_Set_Pixel_Sizes(face_, 0, converted_ysize);
 
-  // Layout text.
-  auto string_width = LayoutText(text) * scale;
-
-  // Retrieve layout info.
-  uint32_t glyph_count;
-  hb_glyph_info_t *glyph_info =
-      hb_buffer_get_glyph_infos(harfbuzz_buf_, &glyph_count);
-  hb_glyph_position_t *glyph_pos =
-      hb_buffer_get_glyph_positions(harfbuzz_buf_, &glyph_count);
-
-  // Create FontBuffer with derived string length.
-  std::unique_ptr<FontBuffer> buffer(new FontBuffer(glyph_count));
+  // Layout text, using the shaped-run cache when possible. Digit strings
+  // are assembled from cached per-character runs instead of re-shaping the
+  // whole string.
+  const ShapedRun *run = digits ? ShapeDigitString(text, converted_ysize)
+                                : ShapeText(text, converted_ysize);
+  auto string_width = run->string_width * scale;
+  const std::vector<ShapedGlyph> &glyphs = run->glyphs;
+  uint32_t glyph_count = static_cast<uint32_t>(glyphs.size());
+
+  // Create a FontBuffer with derived string length, reusing a retired digit
+  // buffer (and its GL buffer objects) when one is available.
+  std::unique_ptr<FontBuffer> buffer;
+  if (digits && !digit_buffer_pool_.empty()) {
+    buffer = std::move(digit_buffer_pool_.back());
+    digit_buffer_pool_.pop_back();
+    buffer->Reset();
+  } else {
+    buffer.reset(new FontBuffer(glyph_count));
+  }
 
   // Initialize font metrics parameters.
   int32_t base_line = ysize * face_->ascender / face_->units_per_EM;
@@ -127,17 +186,21 @@ FontBuffer *FontManager::GetBuffer(const char *text, const float ysize) {
   FT_GlyphSlot glyph = face_->glyph;
 
   for (size_t i = 0; i < glyph_count; ++i) {
-    auto code_point = glyph_info[i].codepoint;
+    auto code_point = glyphs[i].code_point;
     auto cache = GetCachedEntry(code_point, converted_ysize);
     if (cache == nullptr) {
-      // Cleanup buffer contents.
-      hb_buffer_clear_contents(harfbuzz_buf_);
+      // Don't leak a recycled buffer's GL objects on the retry path.
+      if (digits) {
+        digit_buffer_pool_.push_back(std::move(buffer));
+      }
       return nullptr;
     }
 
-    // Add the code point to the buffer. This information is used when
-    // re-fetching UV information when the texture atlas is updated.
+    // Add the code point and its cache page to the buffer. This information
+    // is used when re-fetching UV information when the texture atlas is
+    // updated.
     buffer->get_code_points()->push_back(code_point);
+    buffer->get_pages()->push_back(cache->get_page());
 
     // Calculate internal/external leading value and expand a buffer if
     // necessary.
@@ -166,8 +229,8 @@ FontBuffer *FontManager::GetBuffer(const char *text, const float ysize) {
     buffer->set_revision(glyph_cache_->get_revision());
 
     // Advance positions.
-    pos += mathfu::vec2(glyph_pos[i].x_advance, -glyph_pos[i].y_advance) *
-           scale / kFreeTypeUnit;
+    pos += mathfu::vec2(glyphs[i].x_advance, -glyphs[i].y_advance) * scale /
+           kFreeTypeUnit;
   }
 
   // Setup size.
@@ -181,16 +244,16 @@ FontBuffer *FontManager::GetBuffer(const char *text, const float ysize) {
     buffer->set_pass(current_pass_);
   }
 
-  // Cleanup buffer contents.
-  hb_buffer_clear_contents(harfbuzz_buf_);
+  // Stamp recency for cache eviction.
+  buffer->set_last_use_frame(frame_count_);
 
   // Verify the buffer.
   assert(buffer->Verify());
 
   // Insert the created entry to the hash map.
-  auto insert =
-      map_buffers_[text].insert(std::pair<int32_t, std::unique_ptr<FontBuffer>>(
-          ysize, std::move(buffer)));
+  auto insert = buffer_map[text].insert(
+      std::pair<int32_t, std::unique_ptr<FontBuffer>>(ysize,
+                                                      std::move(buffer)));
   return insert.first->second.get();
 }
 
@@ -212,8 +275,9 @@ FontBuffer *FontManager::UpdateUV(const int32_t ysize, FontBuffer *buffer) {
         return nullptr;
       }
 
-      // Update UV.
+      // Update UV & the entry's cache page.
       buffer->UpdateUV(i, cache->get_uv());
+      buffer->get_pages()->at(i) = cache->get_page();
 
       // Update revision.
       buffer->set_revision(glyph_cache_->get_revision());
@@ -224,6 +288,10 @@ FontBuffer *FontManager::UpdateUV(const int32_t ysize, FontBuffer *buffer) {
 
 FontTexture *FontManager::GetTexture(const char *text,
                                      const float original_ysize) {
+  // No face yet (an OpenAsync() load may still be in flight); callers
+  // treat nullptr as "draw nothing this frame".
+  if (!face_initialized_) return nullptr;
+
   // Round up y size if the size selector is set.
   int32_t ysize = ConvertSize(original_ysize);
 
@@ -239,15 +307,11 @@ FontTexture *FontManager::GetTexture(const char *text,
   // Set freetype settings.
   FT_Set_Pixel_Sizes(face_, 0, ysize);
 
-  // Layout text.
-  auto string_width = LayoutText(text);
-
-  // Retrieve layout info.
-  uint32_t glyph_count;
-  hb_glyph_info_t *glyph_info =
-      hb_buffer_get_glyph_infos(harfbuzz_buf_, &glyph_count);
-  hb_glyph_position_t *glyph_pos =
-      hb_buffer_get_glyph_positions(harfbuzz_buf_, &glyph_count);
+  // Layout text, using the shaped-run cache when possible.
+  const ShapedRun *run = ShapeText(text, ysize);
+  auto string_width = run->string_width;
+  const std::vector<ShapedGlyph> &glyphs = run->glyphs;
+  uint32_t glyph_count = static_cast<uint32_t>(glyphs.size());
 
   // Calculate texture size. The texture may be expanded later depending on
   // glyph sizes.
@@ -272,7 +336,7 @@ FontTexture *FontManager::GetTexture(const char *text,
 
     // Load glyph using harfbuzz layout information.
     // Note that harfbuzz takes care of ligatures.
-    if ((err = FT_Load_Glyph(face_, glyph_info[i].codepoint, FT_LOAD_RENDER))) {
+    if ((err = FT_Load_Glyph(face_, glyphs[i].code_point, FT_LOAD_RENDER))) {
       // Error. This could happen typically the loaded font does not support
       // particular glyph.
       SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Can't load glyph %c FT_Error:%d\n",
@@ -308,7 +372,7 @@ FontTexture *FontManager::GetTexture(const char *text,
     }
 
     // Advance positions.
-    pos += mathfu::vec2(glyph_pos[i].x_advance, -glyph_pos[i].y_advance) /
+    pos += mathfu::vec2(glyphs[i].x_advance, -glyphs[i].y_advance) /
            kFreeTypeUnit;
   }
 
@@ -326,9 +390,6 @@ FontTexture *FontManager::GetTexture(const char *text,
   // Setup font metrics.
   tex->set_metrics(initial_metrics);
 
-  // Cleanup buffer contents.
-  hb_buffer_clear_contents(harfbuzz_buf_);
-
   // Put to the dic.
   map_textures_[text][ysize].reset(tex);
 
@@ -394,6 +455,23 @@ bool FontManager::Open(const char *font_name) {
     return false;
   }
 
+  return InitializeFace(font_name);
+}
+
+void FontManager::OpenAsync(const char *font_name, AsyncLoader *loader) {
+  assert(!face_initialized_);
+  if (FontLoadPending()) return;
+  // The manager must outlive the load: there is no way to cancel a job
+  // the loader's workers may already be reading.
+  pending_face_.reset(new FontFaceResource(font_name, this));
+  loader->QueueJob(pending_face_.get());
+}
+
+bool FontManager::FontLoadPending() const {
+  return pending_face_ != nullptr && !pending_face_->done();
+}
+
+bool FontManager::InitializeFace(const char *font_name) {
   // Open the font.
   FT_Error err;
   if ((err = FT_New_Memory_Face(
@@ -427,6 +505,12 @@ bool FontManager::Close() {
   map_textures_.clear();
 
   map_buffers_.clear();
+  map_digit_buffers_.clear();
+  digit_buffer_pool_.clear();
+
+  // Shaped runs depend on the current font face. Drop them with it.
+  map_shaped_runs_.clear();
+  shaped_run_lru_.clear();
 
   hb_font_destroy(harfbuzz_font_);
 
@@ -434,6 +518,10 @@ bool FontManager::Close() {
 
   font_data_.clear();
 
+  // The load finished (the face was initialized), so the loader is done
+  // with the resource.
+  pending_face_.reset();
+
   face_initialized_ = false;
 
   return true;
@@ -442,6 +530,107 @@ bool FontManager::Close() {
 void FontManager::StartLayoutPass() {
   // Reset pass.
   current_pass_ = 0;
+
+  // Advance the recency clock and trim the buffer cache. This is the one
+  // point where no FontBuffer is referenced from outside: the previous
+  // frame's render pass has finished and this frame's layout pass hasn't
+  // requested anything yet.
+  ++frame_count_;
+  EvictBuffersOverBudget();
+
+  // Once the digit buffer cache is over budget, retire all of its buffers
+  // to the reuse pool. It's safe to do wholesale here: no buffer is
+  // referenced until the layout pass requests it again, and anything still
+  // displayed is simply rebuilt into a recycled buffer.
+  if (map_digit_buffers_.size() > kMaxDigitBuffers) {
+    for (auto &sizes : map_digit_buffers_) {
+      for (auto &entry : sizes.second) {
+        if (digit_buffer_pool_.size() >= kMaxDigitBuffers) break;
+        digit_buffer_pool_.push_back(std::move(entry.second));
+      }
+    }
+    map_digit_buffers_.clear();
+  }
+}
+
+void FontManager::EvictBuffersOverBudget() {
+  if (buffer_cache_budget_ == 0) {
+    return;
+  }
+
+  // Total up the cache. The map holds one entry per (string, size) ever
+  // rendered, so this walk is exactly the footprint being bounded.
+  size_t total = 0;
+  for (auto &sizes : map_buffers_) {
+    for (auto &entry : sizes.second) {
+      total += entry.second->ByteSize();
+    }
+  }
+  if (total <= buffer_cache_budget_) {
+    return;
+  }
+
+  // Collect eviction candidates, skipping buffers requested last frame:
+  // they are likely still on screen and would just be rebuilt immediately.
+  struct Candidate {
+    uint32_t last_use;
+    size_t bytes;
+    const std::string *text;
+    int32_t ysize;
+  };
+  std::vector<Candidate> candidates;
+  for (auto &sizes : map_buffers_) {
+    for (auto &entry : sizes.second) {
+      if (entry.second->last_use_frame() + 1 >= frame_count_) {
+        continue;
+      }
+      Candidate candidate = {entry.second->last_use_frame(),
+                             entry.second->ByteSize(), &sizes.first,
+                             entry.first};
+      candidates.push_back(candidate);
+    }
+  }
+
+  // Evict least recently requested buffers first until back under budget.
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.last_use < b.last_use;
+            });
+  for (size_t i = 0;
+       i < candidates.size() && total > buffer_cache_budget_; ++i) {
+    auto it = map_buffers_.find(*candidates[i].text);
+    it->second.erase(candidates[i].ysize);
+    if (it->second.empty()) {
+      map_buffers_.erase(it);
+    }
+    total -= candidates[i].bytes;
+  }
+}
+
+void FontManager::EnsureAtlasTextures() {
+  if (renderer_ == nullptr) return;
+
+  for (int32_t page = static_cast<int32_t>(atlas_textures_.size());
+       page < glyph_cache_->get_num_pages(); ++page) {
+    std::unique_ptr<Texture> texture(new Texture(*renderer_));
+    texture.get()->LoadFromMemory(glyph_cache_->get_buffer(page),
+                                  glyph_cache_->get_size(), kFormatLuminance,
+                                  false);
+
+    // Disable mipmap for the atlas texture.
+    texture.get()->Set(0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    atlas_textures_.push_back(std::move(texture));
+  }
+}
+
+void FontManager::RenderBuffer(FontBuffer *buffer) {
+  auto &ranges = buffer->GetPageRanges();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    atlas_textures_[ranges[i].page].get()->Set(0);
+    buffer->RenderPageRange(ranges[i]);
+  }
 }
 
 void FontManager::UpdatePass(const bool start_subpass) {
@@ -449,17 +638,29 @@ void FontManager::UpdatePass(const bool start_subpass) {
   glyph_cache_->Update();
 
   if (glyph_cache_->get_dirty_state() && current_pass_ <= 0) {
-    auto rect = glyph_cache_->get_dirty_rect();
-    atlas_texture_.get()->Set(0);
+    // The cache allocates pages lazily, so new pages (and their atlas
+    // textures) can appear any time glyphs were cached.
+    EnsureAtlasTextures();
 
+    // Upload one glTexSubImage2D per dirty row span of each page. The cache
+    // coalesces touching spans, so rows that didn't change are never
+    // re-uploaded.
     // In OpenGL ES2.0, width and pitch of the src buffer needs to match. So
-    // that we are updating entire row at once.
+    // that we are updating entire rows at once.
     // TODO: Optimize glTexSubImage2D call in ES3.0 capable platform.
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rect.y(),
-                    glyph_cache_.get()->get_size().x(), rect.w() - rect.y(),
-                    GL_LUMINANCE, GL_UNSIGNED_BYTE,
-                    glyph_cache_.get()->get_buffer() +
-                        glyph_cache_.get()->get_size().x() * rect.y());
+    const int32_t cache_width = glyph_cache_.get()->get_size().x();
+    for (int32_t page = 0; page < glyph_cache_->get_num_pages(); ++page) {
+      auto &spans = glyph_cache_->get_dirty_spans(page);
+      if (spans.empty()) continue;
+      atlas_textures_[page].get()->Set(0);
+      for (size_t i = 0; i < spans.size(); ++i) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, spans[i].x(), cache_width,
+                        spans[i].y() - spans[i].x(), GL_LUMINANCE,
+                        GL_UNSIGNED_BYTE,
+                        glyph_cache_.get()->get_buffer(page) +
+                            cache_width * spans[i].x());
+      }
+    }
     current_atlas_revision_ = glyph_cache_->get_revision();
     glyph_cache_->set_dirty_state(false);
   }
@@ -509,6 +710,85 @@ uint32_t FontManager::LayoutText(const char *text) {
   return string_width;
 }
 
+const FontManager::ShapedRun *FontManager::ShapeText(const char *text,
+                                                     int32_t ysize) {
+  // The shaping result depends on both the string and the pixel size the
+  // face is currently set to, so the key combines them.
+  std::string key(text);
+  key += '\x1f';
+  key += std::to_string(ysize);
+
+  auto it = map_shaped_runs_.find(key);
+  if (it != map_shaped_runs_.end()) {
+    // Move the entry to the back of the LRU list.
+    shaped_run_lru_.splice(shaped_run_lru_.end(), shaped_run_lru_,
+                           it->second.it_lru);
+    return &it->second;
+  }
+
+  // Shape the text through harfbuzz and snapshot the result.
+  auto string_width = LayoutText(text);
+
+  uint32_t glyph_count;
+  hb_glyph_info_t *glyph_info =
+      hb_buffer_get_glyph_infos(harfbuzz_buf_, &glyph_count);
+  hb_glyph_position_t *glyph_pos =
+      hb_buffer_get_glyph_positions(harfbuzz_buf_, &glyph_count);
+
+  ShapedRun &run = map_shaped_runs_[key];
+  run.string_width = string_width;
+  run.glyphs.resize(glyph_count);
+  for (uint32_t i = 0; i < glyph_count; ++i) {
+    run.glyphs[i].code_point = glyph_info[i].codepoint;
+    run.glyphs[i].x_advance = glyph_pos[i].x_advance;
+    run.glyphs[i].y_advance = glyph_pos[i].y_advance;
+  }
+  run.it_lru = shaped_run_lru_.insert(shaped_run_lru_.end(), key);
+
+  // Cleanup buffer contents.
+  hb_buffer_clear_contents(harfbuzz_buf_);
+
+  // Evict the least recently used run once the cache is over budget.
+  // unordered_map references stay valid when other entries are erased.
+  if (map_shaped_runs_.size() > kMaxShapedRuns) {
+    map_shaped_runs_.erase(shaped_run_lru_.front());
+    shaped_run_lru_.pop_front();
+  }
+
+  return &run;
+}
+
+bool FontManager::IsDigitString(const char *text) {
+  if (*text == '\0') return false;
+  for (const char *p = text; *p != '\0'; ++p) {
+    const char c = *p;
+    if (!(('0' <= c && c <= '9') || c == ':' || c == '.' || c == '-' ||
+          c == '+' || c == '%' || c == '/' || c == ' ')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const FontManager::ShapedRun *FontManager::ShapeDigitString(const char *text,
+                                                            int32_t ysize) {
+  digit_run_.glyphs.clear();
+  uint32_t width = 0;  // In 1/64 px FreeType units.
+  char single[2] = {0, 0};
+  for (const char *p = text; *p != '\0'; ++p) {
+    // Single-character runs land in the shaped-run cache, so each digit or
+    // separator goes through HarfBuzz only once per glyph size.
+    single[0] = *p;
+    const ShapedRun *run = ShapeText(single, ysize);
+    for (size_t i = 0; i < run->glyphs.size(); ++i) {
+      digit_run_.glyphs.push_back(run->glyphs[i]);
+      width += run->glyphs[i].x_advance;
+    }
+  }
+  digit_run_.string_width = width / kFreeTypeUnit;
+  return &digit_run_;
+}
+
 bool FontManager::UpdateMetrics(const FT_GlyphSlot g,
                                 const FontMetrics &current_metrics,
                                 FontMetrics *new_metrics) {
@@ -602,4 +882,72 @@ void FontBuffer::UpdateUV(const int32_t index, const vec4 &uv) {
   vertices_[index * 4 + 3].uv_ = uv.zw();
 }
 
+FontBuffer::~FontBuffer() {
+  if (vbo_) {
+    GL_CALL(glDeleteBuffers(1, &vbo_));
+    GL_CALL(glDeleteBuffers(1, &ibo_));
+  }
+}
+
+const std::vector<FontBuffer::PageRange> &FontBuffer::GetPageRanges() {
+  // Rewrite the buffer objects only when the vertex data changed: the first
+  // render, or a glyph atlas flush caused UpdateUV to rewrite the UVs
+  // (which bumps revision_).
+  if (static_cast<int64_t>(revision_) != uploaded_revision_) {
+    if (!vbo_) {
+      GL_CALL(glGenBuffers(1, &vbo_));
+      GL_CALL(glGenBuffers(1, &ibo_));
+    }
+
+    // Group glyph quad indices by atlas page so each page in use becomes a
+    // single contiguous draw. Most strings resolve to one page.
+    std::vector<uint16_t> sorted_indices;
+    sorted_indices.reserve(indices_.size());
+    page_ranges_.clear();
+    const size_t glyph_count = pages_.size();
+    for (size_t i = 0; i < glyph_count; ++i) {
+      auto page = pages_[i];
+
+      // Skip pages that already have a range.
+      bool grouped = false;
+      for (size_t j = 0; j < page_ranges_.size(); ++j) {
+        if (page_ranges_[j].page == page) {
+          grouped = true;
+          break;
+        }
+      }
+      if (grouped) continue;
+
+      PageRange range;
+      range.page = page;
+      range.start_index = static_cast<int32_t>(sorted_indices.size());
+      for (size_t j = i; j < glyph_count; ++j) {
+        if (pages_[j] != page) continue;
+        for (int32_t k = 0; k < kIndiciesPerCodePoint; ++k) {
+          sorted_indices.push_back(indices_[j * kIndiciesPerCodePoint + k]);
+        }
+      }
+      range.index_count =
+          static_cast<int32_t>(sorted_indices.size()) - range.start_index;
+      page_ranges_.push_back(range);
+    }
+
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo_));
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(FontVertex),
+                         vertices_.data(), GL_DYNAMIC_DRAW));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_));
+    GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         sorted_indices.size() * sizeof(uint16_t),
+                         sorted_indices.data(), GL_DYNAMIC_DRAW));
+    uploaded_revision_ = revision_;
+  }
+  return page_ranges_;
+}
+
+void FontBuffer::RenderPageRange(const PageRange &range) {
+  static const Attribute kFormat[] = {kPosition3f, kTexCoord2f, kEND};
+  Mesh::RenderArrayBuffered(GL_TRIANGLES, range.index_count, kFormat,
+                            sizeof(FontVertex), vbo_, ibo_, range.start_index);
+}
+
 }  // namespace fpl
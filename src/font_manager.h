@@ -29,9 +29,11 @@ struct hb_buffer_t;
 namespace fpl {
 
 // Forward decl.
+class AsyncLoader;
 class FontTexture;
 class FontBuffer;
 class FontMetrics;
+class FontFaceResource;
 
 // Constant to convert FreeType unit to pixel unit.
 // In FreeType & Harfbuzz, the position value unit is 1/64 px whereas
@@ -66,6 +68,18 @@ class FontManager {
   // a file open error, an invalid file format etc.
   bool Open(const char *font_name);
 
+  // Open a font face without blocking the caller: the file bytes are read
+  // on one of 'loader's worker threads, and the FreeType/HarfBuzz objects
+  // are created when the loader finalizes the load on the main thread.
+  // Until then FontLoaded() stays false and GetTexture()/GetBuffer()
+  // return nullptr, so callers skip or substitute the text instead of
+  // stalling a frame on a multi-megabyte face file. Queue it during the
+  // loading screen to have the face warm before the first string renders.
+  void OpenAsync(const char *font_name, AsyncLoader *loader);
+
+  // Returns true while an OpenAsync() load is still in flight.
+  bool FontLoadPending() const;
+
   // Discard font face that has been opened via Open().
   bool Close();
 
@@ -85,15 +99,9 @@ class FontManager {
   void SetRenderer(Renderer &renderer) {
     renderer_ = &renderer;
 
-    // Initialize the font atlas texture.
-    atlas_texture_.reset(new Texture(renderer));
-    atlas_texture_.get()->LoadFromMemory(glyph_cache_->get_buffer(),
-                                         glyph_cache_->get_size(),
-                                         kFormatLuminance, false);
-
-    // Disable mipmap for the atlas texture.
-    atlas_texture_.get()->Set(0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // Initialize font atlas textures for the cache pages allocated so far.
+    atlas_textures_.clear();
+    EnsureAtlasTextures();
   }
 
   // Returns if a font has been loaded.
@@ -117,12 +125,40 @@ class FontManager {
   // Call this API while in a layout pass when the glyph cache is fragmented.
   void FlushAndUpdate() { UpdatePass(true); }
 
+  // Discard every cached FontBuffer (and its GL buffer objects).
+  // Buffers are otherwise kept for the lifetime of the FontManager so that
+  // unchanged labels cost nothing to re-render; call this when the UI's
+  // strings change wholesale (e.g. a language switch) or after displaying a
+  // large amount of transient text, to bound the cache's size.
+  void ClearBufferCache() {
+    map_buffers_.clear();
+    map_digit_buffers_.clear();
+    digit_buffer_pool_.clear();
+  }
+
+  // Cap the approximate bytes the FontBuffer cache may hold (CPU arrays
+  // plus uploaded GL copies). When over budget, the least recently
+  // requested buffers are evicted at the next StartLayoutPass(); buffers
+  // requested in the previous frame are never evicted, since they are
+  // likely still on screen. 0 disables eviction.
+  void set_buffer_cache_budget(size_t bytes) { buffer_cache_budget_ = bytes; }
+
   // Indicate a start of new render pass. Call the API each time the user starts
   // a render pass.
   void StartRenderPass() { UpdatePass(false); }
 
-  // Getter of the font atlas texture.
-  Texture *GetAtlasTexture() { return atlas_texture_.get(); }
+  // Getter of a font atlas texture. The glyph cache is made of multiple
+  // pages, each backed by its own atlas texture; glyph cache entries record
+  // which page they live in.
+  Texture *GetAtlasTexture(int32_t page = 0) {
+    return atlas_textures_[page].get();
+  }
+
+  // Render the given FontBuffer with the currently bound shader.
+  // Glyph quads are drawn grouped by atlas page, binding each page's texture
+  // in turn; a string whose glyphs all share one page costs a single draw
+  // call.
+  void RenderBuffer(FontBuffer *buffer);
 
   // The user can supply a size selector function to adjust glyph sizes when
   // storing a glyph cache entry.
@@ -137,9 +173,39 @@ class FontManager {
   }
 
  private:
+  // FontFaceResource hands its loaded bytes back through InitializeFace.
+  friend class FontFaceResource;
+
   // Pass indicating rendering pass.
   static const int32_t kRenderPass = -1;
 
+  // Maximum # of entries in the shaped-run cache before LRU eviction.
+  static const size_t kMaxShapedRuns = 256;
+
+  // Maximum # of cached digit-string FontBuffers, and of retired buffers
+  // kept in the reuse pool.
+  static const size_t kMaxDigitBuffers = 32;
+
+  // Default byte budget of the FontBuffer cache; see
+  // set_buffer_cache_budget(). Generous for menu text, small next to the
+  // texture working set.
+  static const size_t kDefaultBufferCacheBudget = 4 * 1024 * 1024;
+
+  // A single shaped glyph: the font-file code point HarfBuzz chose, plus
+  // its pen advances in 1/64 px FreeType units.
+  struct ShapedGlyph {
+    uint32_t code_point;
+    int32_t x_advance;
+    int32_t y_advance;
+  };
+
+  // Cached result of shaping one string at one glyph size.
+  struct ShapedRun {
+    std::vector<ShapedGlyph> glyphs;
+    uint32_t string_width;
+    std::list<std::string>::iterator it_lru;
+  };
+
   // Initialize static data associated with the class.
   static void Initialize();
 
@@ -155,10 +221,36 @@ class FontManager {
                            const FontMetrics &new_metrics,
                            std::unique_ptr<uint8_t[]> *image);
 
+  // Create the FreeType face and HarfBuzz font from the bytes already in
+  // font_data_. The synchronous Open() and the async path both end here;
+  // must run on the main thread.
+  bool InitializeFace(const char *font_name);
+
   // Layout text and update harfbuzz_buf_.
   // Returns the width of the text layout in pixels.
   uint32_t LayoutText(const char *text);
 
+  // Shape 'text' at the given glyph size, or return the cached result.
+  // Shaping (HarfBuzz) is the most expensive step of text layout, and a
+  // string re-shapes identically no matter where it is placed, so results
+  // are cached with LRU eviction -- independent of the vertex-level
+  // FontBuffer cache, which also bakes in glyph cache UVs.
+  // The returned pointer is valid until the next ShapeText() call.
+  const ShapedRun *ShapeText(const char *text, int32_t ysize);
+
+  // Returns true when text consists only of ASCII digits and the separator
+  // characters scores and timers use. Such strings take the fast path in
+  // ShapeDigitString() and the recycled digit buffer cache.
+  static bool IsDigitString(const char *text);
+
+  // Shape a digit string by concatenating cached single-character runs.
+  // Digits and their separators shape independently of their neighbors (no
+  // ligatures or contextual forms, and the font's figures are tabular), so
+  // the concatenation matches shaping the whole string -- without running
+  // HarfBuzz for every new score or countdown value.
+  // The returned pointer is valid until the next Shape*() call.
+  const ShapedRun *ShapeDigitString(const char *text, int32_t ysize);
+
   // Calculate internal/external leading value and expand a buffer if
   // necessary.
   // Returns true if the size of metrics has been changed.
@@ -189,9 +281,20 @@ class FontManager {
   // Returns nullptr if one of UV values couldn't be updated.
   FontBuffer *UpdateUV(const int32_t ysize, FontBuffer *buffer);
 
+  // Create atlas textures for glyph cache pages that don't have one yet.
+  // Pages are allocated lazily by the cache, so new pages can show up any
+  // time glyphs are cached.
+  void EnsureAtlasTextures();
+
   // Convert requested glyph size using SizeSelector if it's set.
   int32_t ConvertSize(const int32_t size);
 
+  // Evict least recently requested FontBuffers until the cache fits its
+  // budget again. Only safe between frames (called from StartLayoutPass):
+  // buffers requested during a layout pass may still be referenced by the
+  // same frame's render pass.
+  void EvictBuffersOverBudget();
+
   // Renderer instance.
   Renderer *renderer_;
 
@@ -209,6 +312,11 @@ class FontManager {
   // flag indicating if a font file has loaded.
   bool face_initialized_;
 
+  // In-flight OpenAsync() load, if any. Owned here: the loader only
+  // borrows queued resources, it never frees them. Kept until the next
+  // Open*()/Close() once the load has finished.
+  std::unique_ptr<FontFaceResource> pending_face_;
+
   // Texture cache for a rendered string image.
   // Using the std::string & its' vertical size in pixels (int32_t) as keys.
   // The map is used for GetTexture() API.
@@ -223,6 +331,29 @@ class FontManager {
                      std::unordered_map<int32_t, std::unique_ptr<FontBuffer>>>
       map_buffers_;
 
+  // Cache of FontBuffers for digit-only strings, kept separate from
+  // map_buffers_ because these texts (scores, countdown timers) churn
+  // through distinct values quickly. Bounded: once over budget,
+  // StartLayoutPass() retires the whole map into digit_buffer_pool_.
+  std::unordered_map<std::string,
+                     std::unordered_map<int32_t, std::unique_ptr<FontBuffer>>>
+      map_digit_buffers_;
+
+  // Retired digit FontBuffers waiting to be reused, so a new value takes
+  // over an old value's GL buffer objects instead of creating fresh ones.
+  std::vector<std::unique_ptr<FontBuffer>> digit_buffer_pool_;
+
+  // Scratch result of ShapeDigitString(); a member so the allocation is
+  // reused.
+  ShapedRun digit_run_;
+
+  // Shaped-run cache. Keyed by the text plus its glyph size (the same
+  // string shapes differently at different pixel sizes). See ShapeText().
+  std::unordered_map<std::string, ShapedRun> map_shaped_runs_;
+
+  // Keys of map_shaped_runs_, least recently used first.
+  std::list<std::string> shaped_run_lru_;
+
   // Singleton instance of Freetype library.
   static FT_Library *ft_;
 
@@ -235,8 +366,9 @@ class FontManager {
   // Current atlas texture's contents revision.
   uint32_t current_atlas_revision_;
 
-  // Unique pointer to a font atlas texture.
-  std::unique_ptr<Texture> atlas_texture_;
+  // Font atlas textures, one per glyph cache page. Created lazily alongside
+  // the cache's pages.
+  std::vector<std::unique_ptr<Texture>> atlas_textures_;
 
   // Current pass counter.
   // Current implementation only supports up to 2 passes in a rendering cycle.
@@ -244,6 +376,13 @@ class FontManager {
 
   // Size selector function object used to adjust a glyph size.
   std::function<int32_t(const int32_t)> size_selector_;
+
+  // Byte budget of the FontBuffer cache; see set_buffer_cache_budget().
+  size_t buffer_cache_budget_;
+
+  // Counts StartLayoutPass() calls; stamped onto FontBuffers as they are
+  // requested, giving EvictBuffersOverBudget its recency order.
+  uint32_t frame_count_;
 };
 
 // Font texture class inherits Texture publicly.
@@ -380,15 +519,35 @@ class FontBuffer {
   static const int32_t kIndiciesPerCodePoint = 6;
   static const int32_t kVerticesPerCodePoint = 4;
 
-  FontBuffer() : revision_(0) {}
+  // A contiguous slice of the uploaded index buffer whose glyphs all live in
+  // one glyph cache page. FontManager::RenderBuffer() binds the page's atlas
+  // texture and draws each range in turn.
+  struct PageRange {
+    int32_t page;
+    int32_t start_index;
+    int32_t index_count;
+  };
+
+  FontBuffer()
+      : revision_(0),
+        last_use_frame_(0),
+        vbo_(0),
+        ibo_(0),
+        uploaded_revision_(-1) {}
 
   // Constructor with a buffer sizse.
-  FontBuffer(uint32_t size) : revision_(0) {
+  FontBuffer(uint32_t size)
+      : revision_(0),
+        last_use_frame_(0),
+        vbo_(0),
+        ibo_(0),
+        uploaded_revision_(-1) {
     indices_.reserve(size * kIndiciesPerCodePoint);
     vertices_.reserve(size * kVerticesPerCodePoint);
     code_points_.reserve(size);
+    pages_.reserve(size);
   }
-  ~FontBuffer() {}
+  ~FontBuffer();
 
   // Setter/Getter of the metrics parameter of the font texture.
   const FontMetrics &metrics() const { return metrics_; }
@@ -406,6 +565,11 @@ class FontBuffer {
   std::vector<uint32_t> *get_code_points() { return &code_points_; }
   const std::vector<uint32_t> *get_code_points() const { return &code_points_; }
 
+  // Getter of the per-glyph cache page array (parallel to the code points
+  // array).
+  std::vector<int32_t> *get_pages() { return &pages_; }
+  const std::vector<int32_t> *get_pages() const { return &pages_; }
+
   // Getter/Setter of the size of the string.
   const vec2i &get_size() const { return size_; }
   void set_size(const vec2i &size) { size_ = size; }
@@ -424,6 +588,22 @@ class FontBuffer {
   int32_t get_pass() const { return pass_; }
   void set_pass(const int32_t pass) { pass_ = pass; }
 
+  // Getter/Setter of the last frame (FontManager's layout pass counter)
+  // this buffer was requested in. Drives LRU eviction of the buffer cache.
+  uint32_t last_use_frame() const { return last_use_frame_; }
+  void set_last_use_frame(const uint32_t frame) { last_use_frame_ = frame; }
+
+  // Approximate bytes this buffer holds: the CPU-side arrays plus the
+  // uploaded GL copies of the vertices and indices.
+  size_t ByteSize() const {
+    return sizeof(FontBuffer) +
+           (vertices_.capacity() + vertices_.size()) * sizeof(FontVertex) +
+           (indices_.capacity() + indices_.size()) * sizeof(uint16_t) +
+           code_points_.capacity() * sizeof(uint32_t) +
+           pages_.capacity() * sizeof(int32_t) +
+           page_ranges_.capacity() * sizeof(PageRange);
+  }
+
   // Add 4 vertices used for a glyph rendering to the vertex array.
   void AddVertices(const vec2 &pos, const int32_t base_line, const float scale,
                    const GlyphCacheEntry &entry);
@@ -433,10 +613,36 @@ class FontBuffer {
   // bottom right of UV value s wz component of the vector.
   void UpdateUV(const int32_t index, const vec4 &uv);
 
+  // Clear the buffer's contents so it can be refilled with a new string,
+  // keeping the GL buffer objects and the vectors' capacity. The next
+  // GetPageRanges() call re-uploads.
+  void Reset() {
+    indices_.clear();
+    vertices_.clear();
+    code_points_.clear();
+    pages_.clear();
+    metrics_ = FontMetrics();
+    uploaded_revision_ = -1;
+  }
+
+  // Retrieve the buffer's page ranges, re-uploading the GL buffer objects
+  // first if the vertex data changed since the last upload (first use, or a
+  // glyph atlas flush rewrote the UVs). Indices are uploaded grouped by
+  // glyph cache page, so each returned range is one contiguous draw.
+  // FontBuffers are cached across frames, so a label whose text hasn't
+  // changed streams no vertex data.
+  const std::vector<PageRange> &GetPageRanges();
+
+  // Draw one page range with the currently bound shader/texture. Callers
+  // are expected to have the range's atlas page texture bound; most users
+  // should go through FontManager::RenderBuffer() instead.
+  void RenderPageRange(const PageRange &range);
+
   // Verify sizes of arrays used in the buffer are correct.
   bool Verify() {
     assert(vertices_.size() == code_points_.size() * kVerticesPerCodePoint);
     assert(indices_.size() == code_points_.size() * kIndiciesPerCodePoint);
+    assert(pages_.size() == code_points_.size());
     return true;
   }
 
@@ -458,6 +664,14 @@ class FontBuffer {
   // entries when the glyph cache is flushed.
   std::vector<uint32_t> code_points_;
 
+  // Glyph cache page of each glyph, parallel to code_points_. Used to group
+  // the index buffer by atlas page when uploading.
+  std::vector<int32_t> pages_;
+
+  // Index ranges of the uploaded index buffer, one per atlas page in use.
+  // Rebuilt whenever the buffer objects are re-uploaded.
+  std::vector<PageRange> page_ranges_;
+
   // Size of the string in pixels.
   vec2i size_;
 
@@ -468,6 +682,19 @@ class FontBuffer {
 
   // Pass id. Each pass should have it's own texture atlas contents.
   int32_t pass_;
+
+  // Last layout pass this buffer was requested in; see last_use_frame().
+  uint32_t last_use_frame_;
+
+  // GL buffer objects holding the vertices/indices, created lazily on first
+  // Render().
+  GLuint vbo_;
+  GLuint ibo_;
+
+  // Value of revision_ when the buffer objects were last written. -1 until
+  // the first upload; widened to int64_t so it can never alias a real
+  // revision.
+  int64_t uploaded_revision_;
 };
 
 }  // namespace fpl
@@ -60,6 +60,7 @@ bool FullScreenFader::Render(const WorldTime& time) {
   }
 
   // Render the overlay in front on the screen.
+  renderer_->BeginGpuZone("gpu fader");
   renderer_->model_view_projection() =
       ortho_mat_ * mat4::FromTranslationVector(vec3(0.0f, 0.0f, 0.1f));
   renderer_->color() = vec4(0.0f, 0.0f, 0.0f, alpha);
@@ -68,6 +69,7 @@ bool FullScreenFader::Render(const WorldTime& time) {
   Mesh::RenderAAQuadAlongX(vec3(0.0f, static_cast<float>(extents_.y()), 0.0f),
                            vec3(static_cast<float>(extents_.x()), 0.0f, 0.0f),
                            vec2(0.0f, 1.0f), vec2(1.0f, 0.0f));
+  renderer_->EndGpuZone();
   return opaque;
 }
 
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 #include <math.h>
+#include <algorithm>
+#include <thread>
 #include "precompiled.h"
 #include "analytics_tracking.h"
 #include "audio_config_generated.h"
@@ -64,20 +66,6 @@ static const char* kLabelSizeDelta = "Size delta";
 static const mat4 kRotate90DegreesAboutXAxis(1, 0, 0, 0, 0, 0, 1, 0, 0, -1, 0,
                                              0, 0, 0, 0, 1);
 
-// The data on a pie that just hit a player this frame
-struct ReceivedPie {
-  CharacterId original_source_id;
-  CharacterId source_id;
-  CharacterId target_id;
-  CharacterHealth original_damage;
-  CharacterHealth damage;
-};
-
-struct EventData {
-  std::vector<ReceivedPie> received_pies;
-  CharacterHealth pie_damage;
-};
-
 // Look up a value in a vector based upon pie damage.
 template <typename T>
 static T EnumerationValueForPieDamage(
@@ -94,13 +82,27 @@ entity::EntityRef PieNoonEntityFactory::CreateEntityFromData(
     const void* data, entity::EntityManager* entity_manager) {
   const EntityDefinition* def = static_cast<const EntityDefinition*>(data);
   assert(def != nullptr);
+
+  // Resolve the definition's component list once, the first time an entity
+  // is spawned from it: walking the FlatBuffers vector and dispatching the
+  // union type to a component is the same work for every spawn, so
+  // repeated spawns (splats, during pie-impact frames) reuse the cached
+  // component/instance pairs and only pay for AddFromRawData itself.
+  Archetype& archetype = archetypes_[data];
+  if (archetype.empty()) {
+    archetype.reserve(def->component_list()->size());
+    for (size_t i = 0; i < def->component_list()->size(); i++) {
+      const ComponentDefInstance* instance = def->component_list()->Get(i);
+      entity::ComponentInterface* component =
+          entity_manager->GetComponent(instance->data_type());
+      assert(component != nullptr);
+      archetype.push_back(std::make_pair(component, instance));
+    }
+  }
+
   entity::EntityRef entity = entity_manager->AllocateNewEntity();
-  for (size_t i = 0; i < def->component_list()->size(); i++) {
-    const ComponentDefInstance* currentInstance = def->component_list()->Get(i);
-    entity::ComponentInterface* component =
-        entity_manager->GetComponent(currentInstance->data_type());
-    assert(component != nullptr);
-    component->AddFromRawData(entity, currentInstance);
+  for (size_t i = 0; i < archetype.size(); i++) {
+    archetype[i].first->AddFromRawData(entity, archetype[i].second);
   }
   return entity;
 }
@@ -109,9 +111,14 @@ GameState::GameState()
     : time_(0),
       config_(nullptr),
       arrangement_(nullptr),
+      particle_spawn_count_(0),
+      render_interpolant_(1.0f),
+      sounds_this_frame_(0),
+      sound_occlusion_valid_(false),
       sceneobject_component_(&engine_),
       multiplayer_director_(nullptr),
       is_multiscreen_(false) {
+  InvalidateActiveCharacterCount();
 #ifdef ANDROID_CARDBOARD
   is_in_cardboard_ = false;
 #endif
@@ -198,6 +205,8 @@ void GameState::Reset() { Reset(analytics_mode_); }
 // Reset the game back to initial configuration.
 void GameState::Reset(AnalyticsMode analytics_mode) {
   time_ = 0;
+  particle_spawn_count_ = 0;
+  InvalidateActiveCharacterCount();
 #ifdef ANDROID_CARDBOARD
   // Use a different config for defining the scene if in Cardboard
   const Config* layout_config = is_in_cardboard_ ? cardboard_config_ : config_;
@@ -247,6 +256,25 @@ void GameState::Reset(AnalyticsMode analytics_mode) {
         &engine_);
   }
 
+  // Character positions never change between Resets (snapshot restore
+  // puts them back on the same arrangement slots), so the pairwise facing
+  // angles are fixed for the whole match. Precompute them once here;
+  // AngleBetweenCharacters is called per character pair per frame and the
+  // atan2 shows up in 8-player profiles.
+  angle_table_.resize(num_ids * num_ids);
+  for (CharacterId source = 0; source < num_ids; ++source) {
+    for (CharacterId target = 0; target < num_ids; ++target) {
+      angle_table_[source * num_ids + target] = Angle::FromXZVector(
+          characters_[target]->position() - characters_[source]->position());
+    }
+  }
+
+  // Full volume until the occlusion buckets are recomputed; that needs
+  // valid scene-object matrices, so it's deferred to the first component
+  // update of the match (see AdvanceFrame).
+  sound_occlusion_gain_.assign(characters_.size(), 1.0f);
+  sound_occlusion_valid_ = false;
+
 #ifdef ANDROID_CARDBOARD
   // When in cardboard, we want to make the first character invisible
   // as that is where the camera will be located
@@ -255,12 +283,26 @@ void GameState::Reset(AnalyticsMode analytics_mode) {
   }
 #endif
 
-  // Create player character entities:
-  for (CharacterId id = 0; id < static_cast<CharacterId>(characters_.size());
-       ++id) {
-    entity::EntityRef entity = entity_manager_.AllocateNewEntity();
+  // Create player character entities as one batch. Each one fans out into
+  // a base circle plus kMaxAccessories accessory entities inside
+  // PlayerCharacterComponent::InitEntity, all registered with the scene
+  // object component, so reserve the whole burst in the affected pools up
+  // front instead of growing them one entity at a time.
+  const int num_characters = static_cast<int>(characters_.size());
+  entity_manager_.ReserveEntities(num_characters * (2 + kMaxAccessories));
+  sceneobject_component_.ReserveEntityData(num_characters *
+                                           (2 + kMaxAccessories));
+  static const entity::ComponentId kCharacterComponents[] = {
+      ComponentDataUnion_PlayerCharacterDef};
+  std::vector<entity::EntityRef> character_entities;
+  character_entities.reserve(num_characters);
+  entity_manager_.AllocateNewEntities(
+      num_characters, kCharacterComponents,
+      static_cast<int>(PIE_ARRAYSIZE(kCharacterComponents)),
+      &character_entities);
+  for (CharacterId id = 0; id < num_characters; ++id) {
     PlayerCharacterData* pc_data =
-        player_character_component_.AddEntity(entity);
+        player_character_component_.GetEntityData(character_entities[id]);
     pc_data->character_id = id;
   }
 
@@ -275,6 +317,7 @@ void GameState::EnterJoiningMode() {
        ++id) {
     characters_[id]->state_machine()->SetCurrentState(StateId_Joining, time_);
   }
+  InvalidateActiveCharacterCount();
 }
 
 WorldTime GameState::GetAnimationTime(const Character& character) const {
@@ -282,25 +325,102 @@ WorldTime GameState::GetAnimationTime(const Character& character) const {
 }
 
 void GameState::ProcessSounds(pindrop::AudioEngine* audio_engine,
-                              const Character& character,
-                              WorldTime delta_time) const {
+                              Character* character, WorldTime delta_time) {
+  // Gate this character's sounds by distance from the camera, and count
+  // everything started against the per-step budget. In 8-player games the
+  // mixer runs out of channels and pindrop starts churning priorities, so
+  // off-camera impacts are dropped here before they cost any decode or
+  // mix work. The timeline cursor still advances past culled keyframes,
+  // so nothing re-fires when the character comes back into range.
+  const float cull_distance = config_->sound_cull_distance();
+  const int max_sounds = config_->max_sounds_per_frame();
+  // A null audio engine (the headless sim driver) mutes everything; the
+  // timeline cursor still advances so playback state stays consistent.
+  const bool in_range =
+      audio_engine != nullptr &&
+      (cull_distance <= 0.0f ||
+       (camera_.Position() - character->position()).LengthSquared() <=
+           cull_distance * cull_distance);
   // Process sounds in timeline.
-  const Timeline* const timeline = character.CurrentTimeline();
+  const Timeline* const timeline = character->CurrentTimeline();
   if (!timeline) return;
 
-  const WorldTime anim_time = GetAnimationTime(character);
+  const WorldTime anim_time = GetAnimationTime(*character);
   const auto sounds = timeline->sounds();
-  const int start_index = TimelineIndexAfterTime(sounds, 0, anim_time);
-  const int end_index =
-      TimelineIndexAfterTime(sounds, start_index, anim_time + delta_time);
-  for (int i = start_index; i < end_index; ++i) {
-    const TimelineSound& timeline_sound = *sounds->Get(i);
-    audio_engine->PlaySound(timeline_sound.sound()->c_str());
+  if (sounds) {
+    // Resume scanning from where the previous frame's scan stopped; the
+    // cursor rewinds itself when the state machine changed state.
+    TimelineCursor* cursor = character->timeline_cursor();
+    cursor->SyncToState(character->state_machine()->current_state_start_time());
+    const int length = static_cast<int>(sounds->Length());
+    int i = cursor->next_sound_index();
+    while (i < length && sounds->Get(i)->time() < anim_time) ++i;
+    for (; i < length && sounds->Get(i)->time() < anim_time + delta_time; ++i) {
+      if (in_range && (max_sounds == 0 || sounds_this_frame_ < max_sounds)) {
+        pindrop::Channel channel =
+            audio_engine->PlaySound(sounds->Get(i)->sound()->c_str());
+        // Occlusion LOD: sounds from behind prop clusters start at a
+        // bucketed lower gain. Besides the attenuation itself, pindrop
+        // weighs gain into channel priority, so these are the first
+        // sounds it steals when the mixer runs out of channels.
+        const float gain = SoundOcclusionGain(character->id());
+        if (gain < 1.0f && channel.Valid()) channel.SetGain(gain);
+        ++sounds_this_frame_;
+      }
+    }
+    cursor->set_next_sound_index(i);
   }
 
   // If the character is trying to turn, play the turn sound.
-  if (RequestedTurn(character.id())) {
-    audio_engine->PlaySound("Turning");
+  if (in_range && (max_sounds == 0 || sounds_this_frame_ < max_sounds) &&
+      RequestedTurn(character->id())) {
+    pindrop::Channel channel = audio_engine->PlaySound("Turning");
+    const float gain = SoundOcclusionGain(character->id());
+    if (gain < 1.0f && channel.Valid()) channel.SetGain(gain);
+    ++sounds_this_frame_;
+  }
+}
+
+// Recompute the per-character occlusion gains; see sound_occlusion_gain_.
+// Counts the shakeable props within the config's occlusion radius of the
+// segment from the camera to each character, and picks that bucket's gain
+// from sound_occlusion_attenuation (the last entry covers every heavier
+// cluster). An empty attenuation list or zero radius disables the LOD.
+void GameState::UpdateSoundOcclusion() {
+  sound_occlusion_gain_.assign(characters_.size(), 1.0f);
+  const auto* attenuation = config_->sound_occlusion_attenuation();
+  const float radius = config_->sound_occlusion_radius();
+  if (attenuation == nullptr || attenuation->Length() == 0 ||
+      radius <= 0.0f) {
+    return;  // Everything mixes at full volume.
+  }
+  const float radius_squared = radius * radius;
+  const vec3 camera_position = camera_.Position();
+  const int num_buckets = static_cast<int>(attenuation->Length());
+  for (size_t i = 0; i < characters_.size(); ++i) {
+    const vec3 to_character = characters_[i]->position() - camera_position;
+    const float segment_length_squared = to_character.LengthSquared();
+    int occluders = 0;
+    for (auto iter = shakeable_prop_component_.begin();
+         iter != shakeable_prop_component_.end(); ++iter) {
+      const SceneObjectData* so_data =
+          entity_manager_.GetComponentData<SceneObjectData>(iter->entity);
+      assert(so_data != nullptr);
+      const vec3 to_prop = so_data->GlobalPosition() - camera_position;
+      // Distance from the prop to the camera-character segment.
+      const float t = segment_length_squared <= 0.0f
+                          ? 0.0f
+                          : mathfu::Clamp(vec3::DotProduct(to_prop,
+                                                           to_character) /
+                                              segment_length_squared,
+                                          0.0f, 1.0f);
+      if ((to_prop - to_character * t).LengthSquared() <= radius_squared) {
+        ++occluders;
+      }
+    }
+    const int bucket = std::min(occluders, num_buckets - 1);
+    sound_occlusion_gain_[i] =
+        mathfu::Clamp(attenuation->Get(bucket), 0.0f, 1.0f);
   }
 }
 
@@ -324,7 +444,7 @@ void GameState::CreatePie(CharacterId original_source_id, CharacterId source_id,
   pies_.push_back(std::unique_ptr<AirbornePie>(new AirbornePie(
       original_source_id, *characters_[source_id], *characters_[target_id],
       time_, config_->pie_flight_time(), original_damage, damage,
-      config_->pie_initial_height(), peak_height, rotations, &engine_)));
+      config_->pie_initial_height(), peak_height, rotations)));
 }
 
 CharacterId GameState::DetermineDeflectionTarget(const ReceivedPie& pie) const {
@@ -452,7 +572,9 @@ void GameState::ProcessEvent(pindrop::AudioEngine* audio_engine,
             config_->blocked_sound_id_for_pie_damage()->Length() - 1);
         const auto& sound_name =
             config_->blocked_sound_id_for_pie_damage()->Get(index);
-        audio_engine->PlaySound(sound_name->c_str());
+        if (audio_engine != nullptr) {
+          audio_engine->PlaySound(sound_name->c_str());
+        }
 
         const CharacterHealth deflected_pie_damage =
             pie.damage + config_->pie_damage_change_when_deflected();
@@ -503,6 +625,11 @@ void GameState::AddSplatterToProp(entity::EntityRef prop) {
     auto so_data = entity_manager_.GetComponentData<SceneObjectData>(splatter);
 
     so_data->set_renderable_id(id_list[mathfu::RandomInRange(0, 3)]);
+    // Splats are flat quads, so route them through the instanced quad batch:
+    // however many splats accumulate across the props, they cost at most one
+    // draw call per splatter material each frame.
+    so_data->set_batchable(
+        CanBatchRenderable(config_, so_data->renderable_id()));
     so_data->set_parent(prop);
 
     vec3 min_range = LoadVec3(config_->splatter_range_min());
@@ -532,15 +659,21 @@ void GameState::ProcessEvents(pindrop::AudioEngine* audio_engine,
 
   const WorldTime anim_time = GetAnimationTime(*character);
   const auto events = timeline->events();
-  const int start_index = TimelineIndexAfterTime(events, 0, anim_time);
-  const int end_index =
-      TimelineIndexAfterTime(events, start_index, anim_time + delta_time);
-
-  for (int i = start_index; i < end_index; ++i) {
+  if (!events) return;
+
+  // Resume scanning from where the previous frame's scan stopped; the
+  // cursor rewinds itself when the state machine changed state.
+  TimelineCursor* cursor = character->timeline_cursor();
+  cursor->SyncToState(character->state_machine()->current_state_start_time());
+  const int length = static_cast<int>(events->Length());
+  int i = cursor->next_event_index();
+  while (i < length && events->Get(i)->time() < anim_time) ++i;
+  for (; i < length && events->Get(i)->time() < anim_time + delta_time; ++i) {
     const TimelineEvent* event = events->Get(i);
     event_data->pie_damage = event->modifier();
     ProcessEvent(audio_engine, character, event->event(), *event_data);
   }
+  cursor->set_next_event_index(i);
 }
 
 void GameState::PopulateConditionInputs(ConditionInputs* condition_inputs,
@@ -680,6 +813,21 @@ void GameState::DetermineWinnersAndLosers() {
 }
 
 int GameState::NumActiveCharacters(bool human_only) const {
+  // Cached: the answer only changes when something invalidates it (state
+  // machine updates, joins, resets, snapshot restores), and it's asked for
+  // several times per frame. The assert cross-checks the cache against a
+  // fresh scan in debug builds, so a missed invalidation point shows up
+  // immediately instead of as a wrong win screen.
+  const int index = human_only ? 1 : 0;
+  if (!num_active_valid_[index]) {
+    num_active_characters_[index] = CountActiveCharacters(human_only);
+    num_active_valid_[index] = true;
+  }
+  assert(num_active_characters_[index] == CountActiveCharacters(human_only));
+  return num_active_characters_[index];
+}
+
+int GameState::CountActiveCharacters(bool human_only) const {
   int num_active = 0;
   for (size_t i = 0; i < characters_.size(); ++i) {
     const auto& character = characters_[i];
@@ -752,11 +900,10 @@ CharacterId GameState::CalculateCharacterTarget(CharacterId id) const {
 // The angle between two characters.
 Angle GameState::AngleBetweenCharacters(CharacterId source_id,
                                         CharacterId target_id) const {
-  const auto& source = characters_[source_id];
-  const auto& target = characters_[target_id];
-  const vec3 vector_to_target = target->position() - source->position();
-  const Angle angle_to_target = Angle::FromXZVector(vector_to_target);
-  return angle_to_target;
+  // Read from the table precomputed in Reset; positions are fixed for the
+  // whole match, so no trig is needed here.
+  assert(angle_table_.size() == characters_.size() * characters_.size());
+  return angle_table_[source_id * characters_.size() + target_id];
 }
 
 // Angle to the character's target.
@@ -841,7 +988,9 @@ void GameState::CreatePieSplatter(pindrop::AudioEngine* audio_engine,
   const CharacterHealth index = mathfu::Clamp<CharacterHealth>(
       damage, 0, config_->hit_sound_id_for_pie_damage()->Length() - 1);
   const auto& sound_name = config_->hit_sound_id_for_pie_damage()->Get(index);
-  audio_engine->PlaySound(sound_name->c_str());
+  if (audio_engine != nullptr) {
+    audio_engine->PlaySound(sound_name->c_str());
+  }
 }
 
 // Creates confetti when a character presses buttons on the join screen.
@@ -855,7 +1004,66 @@ void GameState::CreateJoinConfettiBurst(const Character& character) {
       vec4(character_color.x(), character_color.y(), character_color.z(), 1));
 }
 
-// Spawns a particle at the given position, using a particle definition.
+// Counter-based random stream for particle emission. Draw n of stream
+// (seed, index) hashes to the same value no matter which thread makes it
+// or what any other stream drew before it, so a burst initialized in
+// parallel is bit-identical to the same burst initialized serially,
+// regardless of thread count. The mixer is the murmur3 finalizer.
+class ParticleRandomStream {
+ public:
+  ParticleRandomStream(uint32_t seed, uint32_t index)
+      : seed_(seed), counter_(index * 0x9e3779b9u) {}
+
+  // Random float in [min, max).
+  float InRange(float min, float max) { return min + Next01() * (max - min); }
+
+  // Random int in [min, max). Returns min when the range is empty.
+  int32_t InRange(int32_t min, int32_t max) {
+    if (max <= min) return min;
+    return min +
+           static_cast<int32_t>(NextUint() % static_cast<uint32_t>(max - min));
+  }
+
+  // Random vector with each component in [min, max).
+  vec3 InRangeVec3(const vec3& min, const vec3& max) {
+    return vec3(InRange(min.x(), max.x()), InRange(min.y(), max.y()),
+                InRange(min.z(), max.z()));
+  }
+
+ private:
+  // Random float in [0, 1), from the top 24 bits of the next hash.
+  float Next01() { return (NextUint() >> 8) * (1.0f / 16777216.0f); }
+
+  uint32_t NextUint() {
+    uint32_t h = seed_ + counter_;
+    ++counter_;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+  }
+
+  uint32_t seed_;
+  uint32_t counter_;
+};
+
+// Particle bursts with at least this many particles per thread are
+// initialized in parallel; below it, forking and joining helpers costs
+// more than the initialization it would spread.
+static const int kMinParticlesPerSpawnThread = 64;
+
+// Upper bound on the threads (including the caller) initializing one
+// burst. Bursts are capped at the particle pool size, so wider fan-out
+// than this never recoups its wakeups.
+static const int kMaxSpawnThreads = 4;
+
+// Spawns a burst of particles at the given position, using a particle
+// definition. Each particle's randomness is a pure function of the burst
+// seed and its index within the burst, so the initialization loop can be
+// split anywhere without changing the result; big bursts (every player
+// joining at once) are spread across helper threads.
 void GameState::SpawnParticles(const mathfu::vec3& position,
                                const ParticleDef* def, const int particle_count,
                                const mathfu::vec4& base_tint) {
@@ -869,43 +1077,87 @@ void GameState::SpawnParticles(const mathfu::vec3& position,
   const vec3 max_position_offset = LoadVec3(def->max_position_offset());
   const vec3 min_orientation_offset = LoadVec3(def->min_orientation_offset());
   const vec3 max_orientation_offset = LoadVec3(def->max_orientation_offset());
+  const vec3 acceleration = LoadVec3(def->acceleration());
+
+  int created = 0;
+  Particle* const particles =
+      particle_manager_.CreateParticles(particle_count, &created);
+  // If we got back a null, it means new particles can't be spawned right now.
+  if (particles == nullptr) {
+    return;
+  }
 
-  for (int i = 0; i < particle_count; i++) {
-    Particle* p = particle_manager_.CreateParticle();
-    // if we got back a null, it means new particles can't be spawned right now.
-    if (p == nullptr) {
-      break;
+  // One seed per burst; the per-particle streams decorrelate the indices.
+  const uint32_t seed = ++particle_spawn_count_;
+
+  const auto init_range = [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      Particle* p = particles + i;
+      ParticleRandomStream random(seed, static_cast<uint32_t>(i));
+      p->set_base_scale(
+          def->preserve_aspect()
+              ? vec3(random.InRange(min_scale.x(), max_scale.x()))
+              : random.InRangeVec3(min_scale, max_scale));
+      p->set_base_velocity(random.InRangeVec3(min_velocity, max_velocity));
+      p->set_acceleration(acceleration);
+      p->set_renderable_id(def->renderable()->Get(
+          random.InRange(0, static_cast<int32_t>(def->renderable()->size()))));
+      const vec4 tint = LoadVec4(def->tint()->Get(
+          random.InRange(0, static_cast<int32_t>(def->tint()->size()))));
+      p->set_base_tint(vec4(tint.x() * base_tint.x(), tint.y() * base_tint.y(),
+                            tint.z() * base_tint.z(),
+                            tint.w() * base_tint.w()));
+      p->set_duration(static_cast<float>(
+          random.InRange(def->min_duration(), def->max_duration())));
+      p->set_base_position(position + random.InRangeVec3(min_position_offset,
+                                                         max_position_offset));
+      p->set_base_orientation(
+          random.InRangeVec3(min_orientation_offset, max_orientation_offset));
+      p->set_rotational_velocity(
+          random.InRangeVec3(min_angular_velocity, max_angular_velocity));
+      p->set_duration_of_shrink_out(
+          static_cast<TimeStep>(def->shrink_duration()));
+      p->set_duration_of_fade_out(static_cast<TimeStep>(def->fade_duration()));
     }
-    p->set_base_scale(
-        def->preserve_aspect()
-            ? vec3(mathfu::RandomInRange(min_scale.x(), max_scale.x()))
-            : vec3::RandomInRange(min_scale, max_scale));
-
-    p->set_base_velocity(vec3::RandomInRange(min_velocity, max_velocity));
-    p->set_acceleration(LoadVec3(def->acceleration()));
-    p->set_renderable_id(def->renderable()->Get(
-        mathfu::RandomInRange<int>(0, def->renderable()->size())));
-    mathfu::vec4 tint = LoadVec4(
-        def->tint()->Get(mathfu::RandomInRange<int>(0, def->tint()->size())));
-    p->set_base_tint(
-        mathfu::vec4(tint.x() * base_tint.x(), tint.y() * base_tint.y(),
-                     tint.z() * base_tint.z(), tint.w() * base_tint.w()));
-    p->set_duration(static_cast<float>(mathfu::RandomInRange<int32_t>(
-        def->min_duration(), def->max_duration())));
-    p->set_base_position(position + vec3::RandomInRange(min_position_offset,
-                                                        max_position_offset));
-    p->set_base_orientation(
-        vec3::RandomInRange(min_orientation_offset, max_orientation_offset));
-    p->set_rotational_velocity(
-        vec3::RandomInRange(min_angular_velocity, max_angular_velocity));
-    p->set_duration_of_shrink_out(
-        static_cast<TimeStep>(def->shrink_duration()));
-    p->set_duration_of_fade_out(static_cast<TimeStep>(def->fade_duration()));
+  };
+
+  const int num_threads =
+      std::min(kMaxSpawnThreads, created / kMinParticlesPerSpawnThread);
+  if (num_threads <= 1) {
+    init_range(0, created);
+    return;
+  }
+  // Bursts are rare events (pie impacts, players joining) and there is no
+  // shared worker pool to borrow, so fork transient helpers; the calling
+  // thread takes the first chunk.
+  std::vector<std::thread> helpers;
+  helpers.reserve(num_threads - 1);
+  const int chunk = (created + num_threads - 1) / num_threads;
+  for (int t = 1; t < num_threads; ++t) {
+    helpers.push_back(
+        std::thread(init_range, t * chunk, std::min((t + 1) * chunk, created)));
+  }
+  init_range(0, chunk);
+  for (size_t t = 0; t < helpers.size(); ++t) {
+    helpers[t].join();
   }
 }
 
 void GameState::AdvanceFrame(WorldTime delta_time,
                              pindrop::AudioEngine* audio_engine) {
+  // Snapshot transforms from the previous step so that PopulateScene can
+  // blend between them and the values this step produces. Only matters when
+  // the game runs on a fixed timestep; see set_render_interpolant().
+  for (size_t i = 0; i < characters_.size(); ++i) {
+    characters_[i]->CaptureRenderState();
+  }
+  // Controllers may have been reassigned (players joining) since last
+  // step; the cached active counts can't see that, so start fresh.
+  InvalidateActiveCharacterCount();
+  for (auto it = pies_.begin(); it != pies_.end(); ++it) {
+    (*it)->CaptureRenderState();
+  }
+
   // Increment the world time counter. This happens at the start of the
   // function so that functions that reference the current world time will
   // include the delta_time. For example, GetAnimationTime needs to compare
@@ -924,7 +1176,15 @@ void GameState::AdvanceFrame(WorldTime delta_time,
   }
 
   // Damage is queued up per character then applied during event processing.
-  std::vector<EventData> event_data(characters_.size());
+  // The scratch buffers persist across frames so this, the hottest sim
+  // loop, does no heap allocation in steady state: clear() keeps each
+  // vector's capacity, and the pie count those vectors grow to is bounded
+  // by the config's pie limits.
+  event_data_.resize(characters_.size());
+  for (size_t i = 0; i < event_data_.size(); ++i) {
+    event_data_[i].received_pies.clear();
+    event_data_[i].pie_damage = 0;
+  }
 
   // Update controller to gather state machine inputs.
   for (size_t i = 0; i < characters_.size(); ++i) {
@@ -967,7 +1227,7 @@ void GameState::AdvanceFrame(WorldTime delta_time,
       ReceivedPie received_pie = {pie->original_source(), pie->source(),
                                   pie->target(), pie->original_damage(),
                                   pie->damage()};
-      event_data[pie->target()].received_pies.push_back(received_pie);
+      event_data_[pie->target()].received_pies.push_back(received_pie);
       character->controller()->SetLogicalInputs(LogicalInputs_JustHit, true);
       if (character->State() != StateId_Blocking)
         CreatePieSplatter(audio_engine, *character, pie->damage());
@@ -1005,34 +1265,133 @@ void GameState::AdvanceFrame(WorldTime delta_time,
     const motive::TwitchDirection twitch = FakeResponseToTurn(character->id());
     character->TwitchFaceAngle(twitch);
   }
+  // The state machine updates above may have KO'd or revived characters.
+  InvalidateActiveCharacterCount();
 
   // Look to timeline to see what's happening. Make it happen.
   for (unsigned int i = 0; i < characters_.size(); ++i) {
-    ProcessEvents(audio_engine, characters_[i].get(), &event_data[i],
+    ProcessEvents(audio_engine, characters_[i].get(), &event_data_[i],
                   delta_time);
   }
 
   for (unsigned int i = 0; i < characters_.size(); ++i) {
     ProcessConditionalEvents(audio_engine, characters_[i].get(),
-                             &event_data[i]);
+                             &event_data_[i]);
   }
 
   // Play the sounds that need to be played at this point in time.
+  sounds_this_frame_ = 0;
   for (unsigned int i = 0; i < characters_.size(); ++i) {
-    ProcessSounds(audio_engine, *characters_[i].get(), delta_time);
+    ProcessSounds(audio_engine, characters_[i].get(), delta_time);
   }
 
   // Update entities.
   entity_manager_.UpdateComponents(delta_time);
 
+  // Scene-object matrices are valid from here on; compute this match's
+  // audio occlusion buckets on the first step that has them.
+  if (!sound_occlusion_valid_) {
+    UpdateSoundOcclusion();
+    sound_occlusion_valid_ = true;
+  }
+
   // Update all Motivators. Motivator updates are done in bulk for scalability.
   // Must come after entity_manager_'s update because matrix Motivators are
   // modified by Components.
   engine_.AdvanceFrame(delta_time);
 
+  // Advance every pie's flight path in one batch, now that this step's
+  // world time is final.
+  AirbornePie::AdvanceAll(pies_, time_);
+
   camera_.AdvanceFrame(delta_time);
 }
 
+void GameState::SaveSnapshot(GameStateSnapshot* snapshot) {
+  snapshot->time = time_;
+  snapshot->countdown_timer = countdown_timer_;
+  snapshot->camera_base = camera_base_;
+
+  // resize() only allocates the first time through; from then on the
+  // counts are stable and this writes in place.
+  snapshot->characters.resize(characters_.size());
+  for (size_t i = 0; i < characters_.size(); ++i) {
+    Character& character = *characters_[i];
+    GameStateSnapshot::CharacterSnapshot& s = snapshot->characters[i];
+    s.target = character.target();
+    s.health = character.health();
+    s.pie_damage = character.pie_damage();
+    s.position = character.position();
+    s.face_angle = character.FaceAngle().ToRadians();
+    s.state_id = character.State();
+    s.state_start_time = character.state_machine()->current_state_start_time();
+    s.next_sound_index = character.timeline_cursor()->next_sound_index();
+    s.next_event_index = character.timeline_cursor()->next_event_index();
+    s.score = character.score();
+    s.victory_state = character.victory_state();
+    s.just_joined_game = character.just_joined_game();
+    s.visible = character.visible();
+  }
+
+  snapshot->pies.resize(pies_.size());
+  for (size_t i = 0; i < pies_.size(); ++i) {
+    const AirbornePie& pie = *pies_[i];
+    GameStateSnapshot::PieSnapshot& s = snapshot->pies[i];
+    s.original_source = pie.original_source();
+    s.source = pie.source();
+    s.target = pie.target();
+    s.start_time = pie.start_time();
+    s.flight_time = pie.flight_time();
+    s.original_damage = pie.original_damage();
+    s.damage = pie.damage();
+    s.start_height = pie.start_height();
+    s.peak_height = pie.peak_height();
+    s.rotations = pie.rotations();
+  }
+}
+
+void GameState::RestoreSnapshot(const GameStateSnapshot& snapshot) {
+  assert(snapshot.characters.size() == characters_.size());
+  InvalidateActiveCharacterCount();
+  time_ = snapshot.time;
+  countdown_timer_ = snapshot.countdown_timer;
+  camera_base_ = snapshot.camera_base;
+
+  for (size_t i = 0; i < characters_.size(); ++i) {
+    Character* character = characters_[i].get();
+    const GameStateSnapshot::CharacterSnapshot& s = snapshot.characters[i];
+    character->force_target(s.target);
+    character->set_health(s.health);
+    character->set_pie_damage(s.pie_damage);
+    character->set_position(s.position);
+    character->SetFaceAngle(Angle(s.face_angle), &engine_);
+    character->state_machine()->SetCurrentState(s.state_id,
+                                                s.state_start_time);
+    character->timeline_cursor()->SyncToState(s.state_start_time);
+    character->timeline_cursor()->set_next_sound_index(s.next_sound_index);
+    character->timeline_cursor()->set_next_event_index(s.next_event_index);
+    character->set_score(s.score);
+    character->set_victory_state(s.victory_state);
+    character->set_just_joined_game(s.just_joined_game);
+    character->set_visible(s.visible);
+    // Don't re-fire state change events for the restored state.
+    character->UpdatePreviousState();
+  }
+
+  // Relaunch pies along their recorded trajectories. Character positions
+  // were restored above, so the rebuilt flight paths match the originals
+  // exactly; landing is resolved from start_time + flight_time against the
+  // restored clock, so hits land exactly as recorded.
+  pies_.clear();
+  for (size_t i = 0; i < snapshot.pies.size(); ++i) {
+    const GameStateSnapshot::PieSnapshot& s = snapshot.pies[i];
+    pies_.push_back(std::unique_ptr<AirbornePie>(new AirbornePie(
+        s.original_source, *characters_[s.source], *characters_[s.target],
+        s.start_time, s.flight_time, s.original_damage, s.damage,
+        s.start_height, s.peak_height, s.rotations)));
+  }
+}
+
 void GameState::PreGameLogging() const {
   SendTrackerEvent(is_multiscreen() ? kCategoryGameMSX : kCategoryGame,
                    kActionStartedGame, EnumNameGameMode(config_->game_mode()),
@@ -1076,11 +1435,19 @@ class CharacterDepthComparer {
 
 // Add anything in the list of particles into the scene description:
 void GameState::AddParticlesToScene(SceneDescription* scene) const {
-  auto plist = particle_manager_.get_particle_list();
-  for (auto it = plist.begin(); it != plist.end(); ++it) {
-    scene->renderables().push_back(std::unique_ptr<Renderable>(
-        new Renderable((*it)->renderable_id(), (*it)->CalculateMatrix(),
-                       (*it)->CurrentTint())));
+  const std::vector<Particle>& particles = particle_manager_.particles();
+  for (size_t i = 0; i < particles.size(); ++i) {
+    const Particle& particle = particles[i];
+    if (CanBatchRenderable(config_, particle.renderable_id())) {
+      // Splatter and confetti quads draw as one instanced batch per
+      // renderable id instead of one draw call per particle.
+      scene->AddQuadInstance(particle.renderable_id(),
+                             particle.CalculateMatrix(),
+                             particle.CurrentTint());
+    } else {
+      scene->AddRenderable(particle.renderable_id(), particle.CalculateMatrix(),
+                           particle.CurrentTint());
+    }
   }
 }
 
@@ -1089,6 +1456,11 @@ void GameState::PopulateScene(SceneDescription* scene) {
   // Camera.
   scene->set_camera(CameraMatrix());
   AddParticlesToScene(scene);
+  // When rendering between fixed simulation steps, rewrite the character
+  // scene objects with blended transforms before their matrices are built.
+  if (render_interpolant_ < 1.0f) {
+    player_character_component_.ApplyRenderInterpolation(render_interpolant_);
+  }
   sceneobject_component_.PopulateScene(scene);
 
   // Add all lights from configuration file to the scene.
@@ -1096,18 +1468,20 @@ void GameState::PopulateScene(SceneDescription* scene) {
   // light in the scene.
   const auto lights = config_->light_positions();
   for (auto it = lights->begin(); it != lights->end(); ++it) {
-    const vec3 light_position = LoadVec3(*it);
-    scene->lights().push_back(std::unique_ptr<vec3>(new vec3(light_position)));
+    scene->AddLight(LoadVec3(*it));
   }
 
   // Pies.
   if (config_->draw_pies()) {
     for (auto it = pies_.begin(); it != pies_.end(); ++it) {
       auto& pie = *it;
-      scene->renderables().push_back(std::unique_ptr<Renderable>(new Renderable(
+      const mat4 pie_matrix = render_interpolant_ < 1.0f
+                                  ? pie->InterpolatedMatrix(render_interpolant_)
+                                  : pie->Matrix();
+      scene->AddRenderable(
           EnumerationValueForPieDamage<uint16_t>(
               pie->damage(), *(config_->renderable_id_for_pie_damage())),
-          pie->Matrix())));
+          pie_matrix);
     }
   }
 
@@ -1119,30 +1493,44 @@ void GameState::PopulateScene(SceneDescription* scene) {
     for (int i = 0; i < 8; ++i) {
       const mat4 axis_dot =
           mat4::FromTranslationVector(vec3(static_cast<float>(i), 0.0f, 0.0f));
-      scene->renderables().push_back(std::unique_ptr<Renderable>(
-          new Renderable(RenderableId_PieSmall, axis_dot)));
+      scene->AddRenderable(RenderableId_PieSmall, axis_dot);
     }
     for (int i = 0; i < 4; ++i) {
       const mat4 axis_dot =
           mat4::FromTranslationVector(vec3(0.0f, 0.0f, static_cast<float>(i)));
-      scene->renderables().push_back(std::unique_ptr<Renderable>(
-          new Renderable(RenderableId_PieSmall, axis_dot)));
+      scene->AddRenderable(RenderableId_PieSmall, axis_dot);
     }
     for (int i = 0; i < 2; ++i) {
       const mat4 axis_dot =
           mat4::FromTranslationVector(vec3(0.0f, static_cast<float>(i), 0.0f));
-      scene->renderables().push_back(std::unique_ptr<Renderable>(
-          new Renderable(RenderableId_PieSmall, axis_dot)));
+      scene->AddRenderable(RenderableId_PieSmall, axis_dot);
     }
   }
 
   // Draw one renderable right in the middle of the world, for debugging.
   // Rotate about z-axis so that it faces the camera.
   if (config_->draw_fixed_renderable() != RenderableId_Invalid) {
-    scene->renderables().push_back(std::unique_ptr<Renderable>(new Renderable(
+    scene->AddRenderable(
         static_cast<uint16_t>(config_->draw_fixed_renderable()),
         mat4::FromRotationMatrix(
-            Quat::FromAngleAxis(kPi, mathfu::kAxisY3f).ToMatrix()))));
+            Quat::FromAngleAxis(kPi, mathfu::kAxisY3f).ToMatrix()));
+  }
+
+  // Distance-based level-of-detail: cutouts beyond the threshold render
+  // only their front quad, dropping the cardboard back and popsicle stick.
+  // At the distances where this kicks in (e.g. the pulled-back multiscreen
+  // camera) those parts are a pixel or two wide anyway.
+  const float lod_distance = config_->cardboard_far_lod_distance();
+  if (lod_distance > 0.0f) {
+    const float lod_distance_sq = lod_distance * lod_distance;
+    const vec3 camera_position = camera().Position();
+    std::vector<Renderable>& renderables = scene->renderables();
+    for (size_t i = 0; i < renderables.size(); ++i) {
+      const vec3 position =
+          renderables[i].world_matrix().TranslationVector3D();
+      renderables[i].set_far_lod(
+          (position - camera_position).LengthSquared() > lod_distance_sq);
+    }
   }
 }
 
@@ -15,8 +15,9 @@
 #ifndef GAME_STATE_H_
 #define GAME_STATE_H_
 
-#include <vector>
+#include <map>
 #include <memory>
+#include <vector>
 #include "character.h"
 #include "components/drip_and_vanish.h"
 #include "components/player_character.h"
@@ -43,14 +44,84 @@ namespace pie_noon {
 
 struct Config;
 struct CharacterArrangement;
-struct EventData;
-struct ReceivedPie;
 class MultiplayerDirector;
 
+// The data on a pie that just hit a player this frame.
+struct ReceivedPie {
+  CharacterId original_source_id;
+  CharacterId source_id;
+  CharacterId target_id;
+  CharacterHealth original_damage;
+  CharacterHealth damage;
+};
+
+struct EventData {
+  std::vector<ReceivedPie> received_pies;
+  CharacterHealth pie_damage;
+};
+
 class PieNoonEntityFactory : public entity::EntityFactoryInterface {
  public:
   virtual entity::EntityRef CreateEntityFromData(
       const void* data, entity::EntityManager* entity_manager);
+
+ private:
+  // One entry per component of an entity definition, with the union type
+  // already dispatched to the component that consumes it. Resolved once
+  // per definition, so runtime spawns (splats during pie-impact frames)
+  // skip the FlatBuffers component-list traversal and component lookup.
+  typedef std::vector<std::pair<entity::ComponentInterface*,
+                                const ComponentDefInstance*>> Archetype;
+
+  // Archetypes keyed by definition pointer. Definitions live in the config
+  // buffer, and retired config buffers are deliberately kept mapped after
+  // a hot reload, so pointer identity is a stable key; a reloaded config
+  // simply warms up new entries.
+  std::map<const void*, Archetype> archetypes_;
+};
+
+// Compact checkpoint of the gameplay-deterministic state: everything that
+// decides who gets hit and when. Cosmetic state driven by the motive
+// engine (prop shake springs, particles, in-flight turn velocity, camera
+// movements) is deliberately left out; after a restore it re-settles over
+// a few frames. The vectors grow to the player/pie counts on first use and
+// are reused from then on, so taking a snapshot every frame does not
+// allocate.
+struct GameStateSnapshot {
+  struct CharacterSnapshot {
+    CharacterId target;
+    CharacterHealth health;
+    CharacterHealth pie_damage;
+    mathfu::vec3 position;
+    float face_angle;  // In radians.
+    uint16_t state_id;
+    WorldTime state_start_time;
+    int next_sound_index;
+    int next_event_index;
+    int score;
+    VictoryState victory_state;
+    bool just_joined_game;
+    bool visible;
+  };
+
+  struct PieSnapshot {
+    CharacterId original_source;
+    CharacterId source;
+    CharacterId target;
+    WorldTime start_time;
+    WorldTime flight_time;
+    CharacterHealth original_damage;
+    CharacterHealth damage;
+    float start_height;
+    float peak_height;
+    int rotations;
+  };
+
+  WorldTime time;
+  int countdown_timer;
+  GameCameraState camera_base;
+  std::vector<CharacterSnapshot> characters;
+  std::vector<PieSnapshot> pies;
 };
 
 class GameState {
@@ -71,6 +142,16 @@ class GameState {
   // Update controller and state machine for each character.
   void AdvanceFrame(WorldTime delta_time, pindrop::AudioEngine* audio_engine);
 
+  // Write the current gameplay state into 'snapshot', reusing its storage.
+  void SaveSnapshot(GameStateSnapshot* snapshot);
+
+  // Rewind the gameplay state to 'snapshot'. The snapshot must have been
+  // taken on this GameState since the last Reset (character count and
+  // state machine definitions must match). Pies are relaunched along their
+  // recorded trajectories, so their on-screen position may differ briefly;
+  // hit resolution only depends on the recorded times and is exact.
+  void RestoreSnapshot(const GameStateSnapshot& snapshot);
+
   // To be run before starting a game and after ending one to log data about
   // gameplay.
   void PreGameLogging() const;
@@ -79,6 +160,12 @@ class GameState {
   // Fill in the position of the characters and pies.
   void PopulateScene(SceneDescription* scene);
 
+  // Set how far into the next simulation step rendering is, in [0, 1).
+  // PopulateScene blends character and pie transforms between the previous
+  // and current steps by this fraction. Only the fixed-timestep loop in
+  // PieNoonGame::Run sets this; it defaults to 1 (no interpolation).
+  void set_render_interpolant(float alpha) { render_interpolant_ = alpha; }
+
   // Angle between two characters.
   Angle AngleBetweenCharacters(CharacterId source_id,
                                CharacterId target_id) const;
@@ -154,8 +241,16 @@ class GameState {
 #endif
 
  private:
-  void ProcessSounds(pindrop::AudioEngine* audio_engine,
-                     const Character& character, WorldTime delta_time) const;
+  void ProcessSounds(pindrop::AudioEngine* audio_engine, Character* character,
+                     WorldTime delta_time);
+  void UpdateSoundOcclusion();
+  // The character's occlusion gain, or full volume before the buckets for
+  // this roster have ever been computed.
+  float SoundOcclusionGain(CharacterId id) const {
+    return id < static_cast<CharacterId>(sound_occlusion_gain_.size())
+               ? sound_occlusion_gain_[id]
+               : 1.0f;
+  }
   void CreatePie(CharacterId original_source_id, CharacterId source_id,
                  CharacterId target_id, CharacterHealth original_damage,
                  CharacterHealth damage);
@@ -191,6 +286,14 @@ class GameState {
                       const mathfu::vec4& base_tint = mathfu::vec4(1, 1, 1, 1));
   void ShakeProps(float percent, const mathfu::vec3& damage_position);
   void AddSplatterToProp(entity::EntityRef prop);
+  int CountActiveCharacters(bool human_only) const;
+  // Discard the cached active-character counts. Called wherever character
+  // states, health or controllers can change: the state machine update,
+  // Reset, joining mode and snapshot restore.
+  void InvalidateActiveCharacterCount() const {
+    num_active_valid_[0] = false;
+    num_active_valid_[1] = false;
+  }
 
   WorldTime time_;
   // countdown_time_ is in seconds and is derived from the length of the game
@@ -205,8 +308,52 @@ class GameState {
   const Config* config_;
   const CharacterArrangement* arrangement_;
   ParticleManager particle_manager_;
+
+  // Number of particle bursts spawned since the last Reset. Seeds the
+  // per-burst random streams in SpawnParticles, so replaying the same
+  // input sequence replays the same particles. See SpawnParticles.
+  uint32_t particle_spawn_count_;
+
   AnalyticsMode analytics_mode_;
 
+  // Fraction of a simulation step that rendering is ahead of the last
+  // simulated state; transforms are blended between the previous and
+  // current steps by this amount in PopulateScene. 1 renders the current
+  // state directly, which is what the variable-timestep path uses.
+  float render_interpolant_;
+
+  // Timeline sounds started so far this simulation step, counted against
+  // the config's max_sounds_per_frame budget. Reset in AdvanceFrame.
+  int sounds_this_frame_;
+
+  // Per-character event scratch, cleared and reused every step so the
+  // event pipeline does no per-frame heap allocation. See AdvanceFrame.
+  std::vector<EventData> event_data_;
+
+  // Cached NumActiveCharacters results, indexed by its human_only
+  // argument. The count is queried several times per frame (win checks,
+  // HUD, confetti) but only changes when a state machine, controller or
+  // snapshot restore does, so it's rescanned at most once between
+  // invalidations. Mutable because the caching accessor is const.
+  mutable int num_active_characters_[2];
+  mutable bool num_active_valid_[2];
+
+  // Pairwise character facing angles, indexed [source * num_ids + target].
+  // Positions are fixed from Reset until the next Reset, so this is
+  // precomputed there instead of running atan2 per pair per frame.
+  std::vector<Angle> angle_table_;
+
+  // Audio occlusion LOD: per-character gain applied to timeline sounds,
+  // from how many shakeable props sit near the camera-to-character line,
+  // quantized to the config's sound_occlusion_attenuation buckets. Lower
+  // gain also lowers the channel's effective priority inside pindrop, so
+  // occluded sounds are what the mixer drops first under channel
+  // pressure. Character slots and prop bases don't move during a match,
+  // so this is computed once per Reset -- deferred one component update,
+  // until the scene-object matrices are valid.
+  std::vector<float> sound_occlusion_gain_;
+  bool sound_occlusion_valid_;
+
   // Entity manager that tracks all of our entities.
   entity::EntityManager entity_manager_;
   // Entity factory for creating entities from flatbuffers:
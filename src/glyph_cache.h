@@ -15,11 +15,14 @@
 #ifndef GLYPH_CACH_H
 #define GLYPH_CACH_H
 
+#include <algorithm>
 #include <map>
 #include <unordered_map>
 #include <list>
+#include <vector>
 
 #include "SDL_log.h"
+#include "alloc_tracker.h"
 #include "common.h"
 #include "mathfu/constants.h"
 
@@ -36,6 +39,13 @@ namespace fpl {
 // caching perfomance estimating same size of glphys tends to be stored in a
 // cache at same time. (e.g. Caching a string in a same size.)
 //
+// The cache is made of up to kGlyphCacheMaxPages pages, each a separate
+// buffer of the requested cache size. Rows live in a page and entries record
+// which page holds their image. Only the first page is allocated up front;
+// when every page is full and no row can be evicted, a new page is allocated
+// instead of failing, so a burst of distinct glyphs (e.g. switching between
+// Latin and CJK strings) grows capacity rather than forcing a global flush.
+//
 // When looking up a cached entry, the API looks up unordered_map which is O(1)
 // operation.
 // If there is no cached entry for given code point, the caller needs to invoke
@@ -63,6 +73,12 @@ const int32_t kGlyphCacheHeightRound = 4;
 const int32_t kGlyphCachePaddingX = 1;
 const int32_t kGlyphCachePaddingY = 1;
 
+// Maximum # of cache pages. Each page is a separate buffer (and a separate
+// atlas texture in FontManager) of the cache size. Pages past the first one
+// are allocated lazily when the cache runs out of space, so cache pressure
+// grows capacity instead of triggering global flushes.
+const int32_t kGlyphCacheMaxPages = 4;
+
 // Cache entry for a glyph.
 class GlyphCacheEntry {
  public:
@@ -71,7 +87,7 @@ class GlyphCacheEntry {
       uint64_t, std::unique_ptr<GlyphCacheEntry>>::iterator iterator;
   typedef std::list<GlyphCacheRow>::iterator iterator_row;
 
-  GlyphCacheEntry() : code_point_(0), size_(0, 0), offset_(0, 0) {}
+  GlyphCacheEntry() : code_point_(0), size_(0, 0), offset_(0, 0), page_(0) {}
 
   // Setter/Getter of code point.
   // Code point is an entry in a font file, not a direct transform of Unicode.
@@ -90,6 +106,11 @@ class GlyphCacheEntry {
   mathfu::vec4 get_uv() const { return uv_; }
   void set_uv(const mathfu::vec4& uv) { uv_ = uv; }
 
+  // Setter/Getter of the cache page the glyph image is stored in.
+  // The UV value is relative to that page's buffer.
+  int32_t get_page() const { return page_; }
+  void set_page(const int32_t page) { page_ = page; }
+
  private:
   // Friend class, GlyphCache needs an access to internal variables of the
   // class.
@@ -108,6 +129,9 @@ class GlyphCacheEntry {
   // Glyph image's UV in the texture atlas.
   mathfu::vec4 uv_;
 
+  // Index of the cache page holding the glyph image.
+  int32_t page_;
+
   // Iterator to the row entry.
   GlyphCacheEntry::iterator_row it_row;
 
@@ -125,12 +149,15 @@ class GlyphCacheEntry {
 // GlyphCacheRow is an internal class for GlyphCache.
 class GlyphCacheRow {
  public:
-  GlyphCacheRow() { Initialize(0, mathfu::vec2i(0, 0)); }
+  GlyphCacheRow() : page_(0) { Initialize(0, mathfu::vec2i(0, 0)); }
   // Constructor with an arguments.
-  // y_pos : vertical position of the row in the buffer.
+  // page : index of the cache page the row lives in.
+  // y_pos : vertical position of the row in the page's buffer.
   // witdh : width of the row. Typically same value of the buffer width.
   // height : height of the row.
-  GlyphCacheRow(const int32_t y_pos, const mathfu::vec2i& size) {
+  GlyphCacheRow(const int32_t page, const int32_t y_pos,
+                const mathfu::vec2i& size)
+      : page_(page) {
     Initialize(y_pos, size);
   }
   ~GlyphCacheRow() {}
@@ -175,6 +202,10 @@ class GlyphCacheRow {
   int32_t get_y_pos() const { return y_pos_; }
   void set_y_pos(const int32_t y_pos) { y_pos_ = y_pos; }
 
+  // Getter of the cache page the row lives in. A row never migrates
+  // between pages, including across Initialize() calls when it's flushed.
+  int32_t get_page() const { return page_; }
+
   // Getter of cached glyphs.
   int32_t get_num_glyphs() const { return cached_entries_.size(); }
 
@@ -215,9 +246,12 @@ class GlyphCacheRow {
   // Size of the row.
   mathfu::vec2i size_;
 
-  // Vertical position of the row in the entire cache buffer.
+  // Vertical position of the row in the page's cache buffer.
   uint32_t y_pos_;
 
+  // Index of the cache page the row lives in.
+  int32_t page_;
+
   // Iterator to the row LRU list.
   std::list<GlyphCacheEntry::iterator_row>::iterator it_lru_row_;
 
@@ -242,22 +276,18 @@ class GlyphCache {
     size_.x() = mathfu::RoundUpToPowerOf2(size.x());
     size_.y() = mathfu::RoundUpToPowerOf2(size.y());
 
-    // Allocate the glyph cache buffer.
-    // A buffer format can be 8/32 bpp (32 bpp is mostly used for Emoji).
-    buffer_.reset(new T[size_.x() * size_.y()]);
-
-    // Clearing allocated buffer.
-    const int32_t kCacheClearValue = 0x0;
-    memset(buffer_.get(), kCacheClearValue, size_.x() * size_.y() * sizeof(T));
-
-    // Create first (empty) row entry.
-    InsertNewRow(0, size_, list_row_.end());
+    // Allocate the first cache page. Additional pages (up to
+    // kGlyphCacheMaxPages) are allocated lazily when the cache fills up.
+    AllocatePage();
 
 #ifdef GLYPH_CACHE_STATS
     ResetStats();
 #endif
   }
-  ~GlyphCache(){};
+  ~GlyphCache() {
+    AllocTracker::Release(AllocTracker::kTagFonts,
+                          buffers_.size() * PageBytes());
+  };
 
   // Look up a cached entries.
   // Return value: A pointer to a cached glyph entry.
@@ -353,7 +383,7 @@ class GlyphCache {
                   req_height, it_row));
           it_row->set_it_row_height_map(it_map);
 
-          InsertNewRow(original_y_pos + req_height,
+          InsertNewRow(it_row->get_page(), original_y_pos + req_height,
                        mathfu::vec2i(size_.x(), original_height - req_height),
                        list_row_.end());
         }
@@ -372,7 +402,8 @@ class GlyphCache {
           it_row->Reserve(it_entry, mathfu::vec2i(req_width, req_height)),
           it_row->get_y_pos());
 
-      // Store given image into the buffer.
+      // Store given image into the row's page buffer.
+      ret->set_page(it_row->get_page());
       CopyImage(pos, image, it_entry->second.get());
 
       // Update UV of the entry.
@@ -408,11 +439,17 @@ class GlyphCache {
           return Set(image, y_size, entry);
         }
       }
+
+      // No row can be evicted either. Grow the cache by a page rather than
+      // forcing the caller into a global flush, until the page budget runs
+      // out.
+      if (AllocatePage()) {
+        return Set(image, y_size, entry);
+      }
 #ifdef GLYPH_CACHE_STATS
       stats_set_fail_++;
 #endif
       // TODO: Try to flush multiple rows and merge them to free up space.
-      // TODO: Evaluate re-allocate solution.
       // Now we don't have any space in the cache.
       // It's caller's responsivility to recover from the situation.
       // Possible work arounds are:
@@ -426,6 +463,7 @@ class GlyphCache {
   }
 
   // Flush all cache entries.
+  // Pages allocated so far are kept: capacity stays grown across flushes.
   bool Flush() {
 #ifdef GLYPH_CACHE_STATS
     ResetStats();
@@ -438,10 +476,12 @@ class GlyphCache {
     // Update cache revision.
     revision_ = counter_;
 
-    // Create first (empty) row entry.
-    InsertNewRow(0, size_, list_row_.end());
+    // Create first (empty) row entry in each allocated page.
+    for (int32_t page = 0; page < get_num_pages(); ++page) {
+      InsertNewRow(page, 0, size_, list_row_.end());
+    }
 
-    dirty_ = false;
+    set_dirty_state(false);
 
     return true;
   }
@@ -455,17 +495,17 @@ class GlyphCache {
   // Debug API to show cache statistics.
   void Status() {
 #ifdef GLYPH_CACHE_STATS
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Cache size: %dx%d", size_.x(),
-                size_.y());
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Cache size: %dx%d pages:%d",
+                size_.x(), size_.y(), get_num_pages());
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Cache hit: %d / %d", stats_hit_,
                 stats_lookup_);
 
     auto total_glyph = 0;
     for (auto row : list_row_) {
       SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                  "Row start:%d height:%d glyphs:%d counter:%d",
-                  row.get_y_pos(), row.get_size().y(), row.get_num_glyphs(),
-                  row.get_last_used_counter());
+                  "Row page:%d start:%d height:%d glyphs:%d counter:%d",
+                  row.get_page(), row.get_y_pos(), row.get_size().y(),
+                  row.get_num_glyphs(), row.get_last_used_counter());
       total_glyph += row.get_num_glyphs();
     }
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Cached glyphs: %d", total_glyph);
@@ -481,21 +521,73 @@ class GlyphCache {
 
   // Getter/Setter of dirty state.
   bool get_dirty_state() const { return dirty_; };
-  void set_dirty_state(const bool dirty) { dirty_ = dirty; }
+  void set_dirty_state(const bool dirty) {
+    dirty_ = dirty;
+    if (!dirty) {
+      for (size_t i = 0; i < dirty_spans_.size(); ++i) {
+        dirty_spans_[i].clear();
+      }
+    }
+  }
 
-  // Getter of dirty rect.
-  const mathfu::vec4i& get_dirty_rect() const { return dirty_rect_; }
+  // Getter of a page's dirty row spans. Each span is a half-open
+  // [begin, end) range of buffer rows that changed since the dirty state
+  // was last cleared. Spans are pairwise disjoint and non-adjacent:
+  // touching spans get coalesced as they are added, so each span costs
+  // exactly one texture upload.
+  const std::vector<mathfu::vec2i>& get_dirty_spans(const int32_t page) const {
+    return dirty_spans_[page];
+  }
 
-  // Getter of allocated glyph cache buffer.
-  const T* get_buffer() const { return buffer_.get(); }
+  // Getter of an allocated glyph cache page buffer.
+  const T* get_buffer(const int32_t page) const {
+    return buffers_[page].get();
+  }
 
-  // Getter of the cache size.
+  // Getter of # of allocated cache pages.
+  int32_t get_num_pages() const {
+    return static_cast<int32_t>(buffers_.size());
+  }
+
+  // Getter of the cache size (of a single page).
   const mathfu::vec2i& get_size() const { return size_; }
 
  private:
+  // Heap size of one cache page.
+  size_t PageBytes() const {
+    return static_cast<size_t>(size_.x()) * static_cast<size_t>(size_.y()) *
+           sizeof(T);
+  }
+
+  // Allocate a new cache page.
+  // Returns false once kGlyphCacheMaxPages pages exist.
+  bool AllocatePage() {
+    if (get_num_pages() >= kGlyphCacheMaxPages) {
+      return false;
+    }
+
+    // Allocate the glyph cache buffer.
+    // A buffer format can be 8/32 bpp (32 bpp is mostly used for Emoji).
+    std::unique_ptr<T[]> buffer(new T[size_.x() * size_.y()]);
+    AllocTracker::Track(AllocTracker::kTagFonts, PageBytes());
+
+    // Clearing allocated buffer.
+    const int32_t kCacheClearValue = 0x0;
+    memset(buffer.get(), kCacheClearValue, size_.x() * size_.y() * sizeof(T));
+
+    buffers_.push_back(std::move(buffer));
+    dirty_spans_.push_back(std::vector<mathfu::vec2i>());
+
+    // Create first (empty) row entry of the page.
+    InsertNewRow(get_num_pages() - 1, 0, size_, list_row_.end());
+    return true;
+  }
+
   // Insert new row to the row list with a given size.
-  // It tries to merge 2 rows if next row is also empty one.
-  void InsertNewRow(const int32_t y_pos, const mathfu::vec2i& size,
+  // It tries to merge 2 rows if next row is also an empty one in the same
+  // page.
+  void InsertNewRow(const int32_t page, const int32_t y_pos,
+                    const mathfu::vec2i& size,
                     const GlyphCacheEntry::iterator_row pos) {
     // First, check if we can merge the requested row with next row to free up
     // more spaces.
@@ -503,7 +595,8 @@ class GlyphCache {
     // to check previous row entry to merge.
     if (pos != list_row_.end()) {
       auto next_entry = std::next(pos);
-      if (next_entry->get_num_glyphs() == 0) {
+      if (next_entry->get_num_glyphs() == 0 &&
+          next_entry->get_page() == page) {
         // We can merge them.
         mathfu::vec2i next_size = next_entry->get_size();
         next_size.y() += size.y();
@@ -515,7 +608,7 @@ class GlyphCache {
     }
 
     // Insert new row.
-    auto it = list_row_.insert(pos, GlyphCacheRow(y_pos, size));
+    auto it = list_row_.insert(pos, GlyphCacheRow(page, y_pos, size));
     auto it_lru_row = lru_row_.insert(lru_row_.end(), it);
     auto it_map = map_row_.insert(
         std::pair<int32_t, GlyphCacheEntry::iterator_row>(size.y(), it));
@@ -542,29 +635,42 @@ class GlyphCache {
 #endif
   }
 
-  // Copy glyph image into the buffer.
+  // Copy glyph image into the entry's page buffer.
   void CopyImage(const mathfu::vec2i& pos, const T* const image,
                  const GlyphCacheEntry* entry) {
-    auto buffer = buffer_.get();
+    auto buffer = buffers_[entry->get_page()].get();
     auto size = entry->get_size().x() * sizeof(T);
     for (int32_t y = 0; y < entry->get_size().y(); ++y) {
       memcpy(buffer + pos.x() + (pos.y() + y) * size_.x(),
              image + y * entry->get_size().x(), size);
     }
-    UpdateDirtyRect(mathfu::vec4i(pos, pos + entry->get_size()));
+    UpdateDirtyRect(entry->get_page(),
+                    mathfu::vec4i(pos, pos + entry->get_size()));
   }
 
-  // Update dirty rect.
-  void UpdateDirtyRect(const mathfu::vec4i& rect) {
-    if (!dirty_) {
-      // Initialize dirty rect.
-      dirty_rect_ = mathfu::vec4i(size_, mathfu::kZeros2i);
-    }
-
+  // Mark the page's rows covered by 'rect' dirty.
+  // Tracking dirty rows as separate spans (rather than one bounding rect)
+  // keeps glyphs landing at opposite ends of the cache from forcing an
+  // upload of all the unchanged rows in between.
+  void UpdateDirtyRect(const int32_t page, const mathfu::vec4i& rect) {
     dirty_ = true;
-    dirty_rect_ =
-        mathfu::vec4i(mathfu::vec2i::Min(dirty_rect_.xy(), rect.xy()),
-                      mathfu::vec2i::Max(dirty_rect_.zw(), rect.zw()));
+
+    int32_t begin = rect.y();
+    int32_t end = rect.w();
+
+    // Absorb every existing span the new one overlaps or touches. Spans are
+    // pairwise disjoint, so one pass picks them all up.
+    auto& spans = dirty_spans_[page];
+    for (size_t i = 0; i < spans.size();) {
+      if (begin <= spans[i].y() && end >= spans[i].x()) {
+        begin = std::min(begin, spans[i].x());
+        end = std::max(end, spans[i].y());
+        spans.erase(spans.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+    spans.push_back(mathfu::vec2i(begin, end));
   }
 
 #ifdef GLYPH_CACHE_STATS
@@ -583,11 +689,11 @@ class GlyphCache {
   // cycle.
   uint32_t counter_;
 
-  // Size of the glyph cache. Rounded to power of 2.
+  // Size of a single glyph cache page. Rounded to power of 2.
   mathfu::vec2i size_;
 
-  // Cache buffer;
-  std::unique_ptr<T> buffer_;
+  // Cache page buffers, allocated lazily up to kGlyphCacheMaxPages.
+  std::vector<std::unique_ptr<T[]>> buffers_;
 
   // Hash map to the cache entries
   // This map is the primary place to look up the cache entries.
@@ -622,8 +728,8 @@ class GlyphCache {
   // atlas texture needs to be uploaded.
   bool dirty_;
 
-  // Dirty region in the buffer.
-  mathfu::vec4i dirty_rect_;
+  // Dirty row spans per page. See get_dirty_spans().
+  std::vector<std::vector<mathfu::vec2i>> dirty_spans_;
 
 #ifdef GLYPH_CACHE_STATS
   // Variables to track usage stats.
@@ -20,7 +20,10 @@
 namespace fpl {
 
 GPGManager::GPGManager()
-    : state_(kStart), do_ui_login_(false), delayed_login_(false) {}
+    : state_(kStart),
+      do_ui_login_(false),
+      delayed_login_(false),
+      update_pending_(true) {}
 
 pthread_mutex_t GPGManager::events_mutex_ = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t GPGManager::achievements_mutex_ = PTHREAD_MUTEX_INITIALIZER;
@@ -28,6 +31,7 @@ pthread_mutex_t GPGManager::players_mutex_ = PTHREAD_MUTEX_INITIALIZER;
 
 bool GPGManager::Initialize(bool ui_login) {
   state_ = kStart;
+  update_pending_ = true;
   do_ui_login_ = ui_login;
   event_data_initialized_ = false;
   achievement_data_initialized_ = false;
@@ -55,14 +59,15 @@ bool GPGManager::Initialize(bool ui_login) {
           .SetOnAuthActionStarted([this](gpg::AuthOperation op) {
             state_ =
                 state_ == kAuthUILaunched ? kAuthUIStarted : kAutoAuthStarted;
+            update_pending_ = true;
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                        "GPG: Sign in started! (%d)", state_);
+                        "GPG: Sign in started! (%d)", state_.load());
           })
           .SetOnAuthActionFinished([this](gpg::AuthOperation op,
                                           gpg::AuthStatus status) {
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                         "GPG: Sign in finished with a result of %d (%d)",
-                        status, state_);
+                        status, state_.load());
             if (op == gpg::AuthOperation::SIGN_IN) {
               state_ =
                   status == gpg::AuthStatus::VALID
@@ -84,6 +89,7 @@ bool GPGManager::Initialize(bool ui_login) {
               SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                           "GPG: unknown auth op %d", op);
             }
+            update_pending_ = true;
           })
           .Create(platform_configuration);
 
@@ -103,6 +109,11 @@ void GPGManager::Update() {
   return;
 #endif
   assert(game_services_);
+  // On the many frames where neither a callback nor game code changed
+  // anything, a single relaxed load is the whole update. A stale read just
+  // delays the pickup by a frame.
+  if (!update_pending_.load(std::memory_order_relaxed)) return;
+  update_pending_.store(false, std::memory_order_relaxed);
   switch (state_) {
     case kStart:
     case kAutoAuthStarted:
@@ -120,6 +131,8 @@ void GPGManager::Update() {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "GPG: skipping StartAuthorizationUI");
         state_ = kAuthUIFailed;
+        // The new state may have work (a delayed login); run again.
+        update_pending_ = true;
       }
       break;
     case kAuthUILaunched:
@@ -134,14 +147,77 @@ void GPGManager::Update() {
         delayed_login_ = false;
         state_ = kManualSignBackIn;
         do_ui_login_ = true;
+        update_pending_ = true;
       }
       break;
     case kAuthed:
-      // We're good. TODO: Now start actually using gpg functionality...
+      // We're good; drain anything game code queued since the last frame
+      // (or while we were signed out).
+      FlushSubmissions();
       break;
   }
 }
 
+// If the queue somehow grows past this (it shouldn't, with coalescing),
+// drop further submissions rather than grow without bound while signed out.
+static const size_t kMaxPendingSubmissions = 64;
+
+void GPGManager::QueueSubmission(PendingSubmission::Type type,
+                                 const std::string &id, uint64_t amount) {
+#ifdef NO_GPG
+  return;
+#endif
+  for (size_t i = 0; i < submission_queue_.size(); i++) {
+    PendingSubmission &pending = submission_queue_[i];
+    if (pending.type == type && pending.id == id) {
+      // Increments accumulate; a repeated unlock or reveal is a no-op.
+      if (type == PendingSubmission::kEventIncrement ||
+          type == PendingSubmission::kAchievementIncrement) {
+        pending.amount += amount;
+      }
+      update_pending_ = true;
+      return;
+    }
+  }
+  if (submission_queue_.size() >= kMaxPendingSubmissions) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "GPG: submission queue full, dropping %s", id.c_str());
+    return;
+  }
+  PendingSubmission pending;
+  pending.type = type;
+  pending.id = id;
+  pending.amount = amount;
+  submission_queue_.push_back(pending);
+  update_pending_ = true;
+}
+
+void GPGManager::FlushSubmissions() {
+  if (submission_queue_.empty()) return;
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+              "GPG: flushing %d queued submissions",
+              static_cast<int>(submission_queue_.size()));
+  for (size_t i = 0; i < submission_queue_.size(); i++) {
+    const PendingSubmission &pending = submission_queue_[i];
+    switch (pending.type) {
+      case PendingSubmission::kEventIncrement:
+        game_services_->Events().Increment(pending.id, pending.amount);
+        break;
+      case PendingSubmission::kAchievementUnlock:
+        game_services_->Achievements().Unlock(pending.id);
+        break;
+      case PendingSubmission::kAchievementIncrement:
+        game_services_->Achievements().Increment(
+            pending.id, static_cast<uint32_t>(pending.amount));
+        break;
+      case PendingSubmission::kAchievementReveal:
+        game_services_->Achievements().Reveal(pending.id);
+        break;
+    }
+  }
+  submission_queue_.clear();
+}
+
 bool GPGManager::LoggedIn() {
 #ifdef NO_GPG
   return false;
@@ -169,17 +245,14 @@ void GPGManager::ToggleSignIn() {
     do_ui_login_ = true;
   } else {
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                "GPG: Ignoring log in/out in state %d", state_);
+                "GPG: Ignoring log in/out in state %d", state_.load());
     delayed_login_ = true;
   }
+  update_pending_ = true;
 }
 
 void GPGManager::IncrementEvent(const char *event_id, uint64_t score) {
-#ifdef NO_GPG
-  return;
-#endif
-  if (!LoggedIn()) return;
-  game_services_->Events().Increment(event_id, score);
+  QueueSubmission(PendingSubmission::kEventIncrement, event_id, score);
 }
 
 // This is still somewhat game-specific.  (Because it assumes that your
@@ -221,31 +294,25 @@ void GPGManager::ShowLeaderboards(const GPGIds *ids, size_t id_len) {
 
 // Unlocks a given achievement.
 void GPGManager::UnlockAchievement(std::string achievement_id) {
-  if (LoggedIn()) {
-    game_services_->Achievements().Unlock(achievement_id);
-  }
+  QueueSubmission(PendingSubmission::kAchievementUnlock, achievement_id, 0);
 }
 
 // Increments an incremental achievement.
 void GPGManager::IncrementAchievement(std::string achievement_id) {
-  if (LoggedIn()) {
-    game_services_->Achievements().Increment(achievement_id);
-  }
+  // One queued increment of n steps is equivalent to n single increments.
+  QueueSubmission(PendingSubmission::kAchievementIncrement, achievement_id, 1);
 }
 
 // Increments an incremental achievement by an amount.
 void GPGManager::IncrementAchievement(std::string achievement_id,
                                       uint32_t steps) {
-  if (LoggedIn()) {
-    game_services_->Achievements().Increment(achievement_id, steps);
-  }
+  QueueSubmission(PendingSubmission::kAchievementIncrement, achievement_id,
+                  steps);
 }
 
 // Reveals a given achievement.
 void GPGManager::RevealAchievement(std::string achievement_id) {
-  if (LoggedIn()) {
-    game_services_->Achievements().Reveal(achievement_id);
-  }
+  QueueSubmission(PendingSubmission::kAchievementReveal, achievement_id, 0);
 }
 
 // Updates local player stats with values from the server:
@@ -15,6 +15,8 @@
 #ifndef GPG_MANAGER_H
 #define GPG_MANAGER_H
 
+#include <atomic>
+
 #include "common.h"
 #include "pthread.h"
 #include "gpg/achievement_manager.h"
@@ -77,12 +79,38 @@ class GPGManager {
 
   uint64_t GetEventValue(std::string event_id);
   bool IsAchievementUnlocked(std::string achievement_id);
+
+  // Queue an achievement submission. These never touch gpg:: inline (whose
+  // calls can stall on a token refresh); they append to a queue that
+  // Update() flushes once authentication is complete, so calling them from
+  // a game-state transition never blocks the frame. Submissions made while
+  // signed out are held and flushed after sign-in.
   void UnlockAchievement(std::string achievement_id);
   void IncrementAchievement(std::string achievement_id);
   void IncrementAchievement(std::string achievement_id, uint32_t steps);
   void RevealAchievement(std::string achievement_id);
 
  private:
+  // A deferred leaderboard-event or achievement submission.
+  struct PendingSubmission {
+    enum Type {
+      kEventIncrement,
+      kAchievementUnlock,
+      kAchievementIncrement,
+      kAchievementReveal
+    };
+    Type type;
+    std::string id;
+    uint64_t amount;
+  };
+
+  // Append to the submission queue, coalescing with an existing entry of
+  // the same type and id (increments sum; unlocks and reveals dedupe).
+  void QueueSubmission(PendingSubmission::Type type, const std::string &id,
+                       uint64_t amount);
+
+  // Issue every queued submission to gpg. Call only when authed.
+  void FlushSubmissions();
   // These are the states the manager can be in, in sequential order they
   // are expected to happen.
   enum AsyncState {
@@ -96,7 +124,9 @@ class GPGManager {
     kAuthed,
   };
 
-  AsyncState state_;
+  // Current state of the auth flow. Written by the gpg auth callbacks
+  // (arbitrary thread) as well as the game thread, so it's atomic.
+  std::atomic<AsyncState> state_;
   bool do_ui_login_;
   bool delayed_login_;
   std::unique_ptr<gpg::GameServices> game_services_;
@@ -115,6 +145,16 @@ class GPGManager {
   std::map<std::string, gpg::Event> event_data_;
   std::unique_ptr<gpg::Player> player_data_;
   std::vector<gpg::Achievement> achievement_data_;
+
+  // Submissions waiting for the next flush. Only touched from the main
+  // thread (game code and Update), so no lock is needed. Coalescing keeps
+  // it to at most one entry per (type, id).
+  std::vector<PendingSubmission> submission_queue_;
+
+  // Set whenever a callback or game code changes something Update() acts
+  // on; lets Update() return with a single relaxed load on the many frames
+  // where nothing has happened.
+  std::atomic<bool> update_pending_;
 };
 
 }  // fpl
@@ -18,10 +18,67 @@
 
 namespace fpl {
 
+// Transport-level ping/pong frames: a 4-byte magic followed by the 4-byte
+// SDL tick count of the pinger, which the pong echoes back. Game payloads
+// are FlatBuffers, whose first four bytes are a root offset that is always
+// tiny for our message sizes, so the magics cannot collide with real
+// traffic.
+static const uint32_t kPingMagic = 0x674E6950;  // "PiNg", little-endian.
+static const uint32_t kPongMagic = 0x674E6F50;  // "PoNg", little-endian.
+static const size_t kPingFrameSize = 2 * sizeof(uint32_t);
+
+// How often Update() probes each connected instance.
+static const uint32_t kPingIntervalMs = 1000;
+
+// EWMA weight of a new RTT sample (1/8, the classic TCP choice).
+static const float kRTTSmoothing = 0.125f;
+
+static std::vector<uint8_t> MakePingFrame(uint32_t magic, uint32_t timestamp) {
+  std::vector<uint8_t> frame(kPingFrameSize);
+  memcpy(&frame[0], &magic, sizeof(magic));
+  memcpy(&frame[sizeof(magic)], &timestamp, sizeof(timestamp));
+  return frame;
+}
+
 GPGMultiplayer::GPGMultiplayer()
-    : message_mutex_(PTHREAD_MUTEX_INITIALIZER),
+    : last_ping_ticks_(0),
+      update_pending_(false),
       instance_mutex_(PTHREAD_MUTEX_INITIALIZER),
-      state_mutex_(PTHREAD_MUTEX_INITIALIZER) {}
+      state_mutex_(PTHREAD_MUTEX_INITIALIZER) {
+  // The inbound queue always holds at least a stub node.
+  MessageNode* stub = new MessageNode();
+  incoming_head_.store(stub, std::memory_order_relaxed);
+  incoming_tail_ = stub;
+}
+
+GPGMultiplayer::~GPGMultiplayer() {
+  ClearIncomingMessages();
+  delete incoming_tail_;  // The remaining stub node.
+}
+
+void GPGMultiplayer::PushIncomingMessage(MessageNode* node) {
+  // Vyukov MPSC push: claim the head slot, then link the previous head to
+  // the new node. A consumer arriving between the two stores sees a null
+  // next pointer and treats the queue as momentarily empty, which is fine;
+  // the message shows up on its next drain.
+  MessageNode* prev = incoming_head_.exchange(node, std::memory_order_acq_rel);
+  prev->next.store(node, std::memory_order_release);
+}
+
+GPGMultiplayer::MessageNode* GPGMultiplayer::PopIncomingMessage() {
+  // Single consumer: only the game thread touches incoming_tail_.
+  MessageNode* tail = incoming_tail_;
+  MessageNode* next = tail->next.load(std::memory_order_acquire);
+  if (next == nullptr) return nullptr;
+  incoming_tail_ = next;
+  delete tail;
+  return next;
+}
+
+void GPGMultiplayer::ClearIncomingMessages() {
+  while (PopIncomingMessage() != nullptr) {
+  }
+}
 
 bool GPGMultiplayer::Initialize(const std::string& service_id) {
   state_ = kIdle;
@@ -94,9 +151,7 @@ void GPGMultiplayer::ResetToIdle() {
   discovered_instances_.clear();
   pthread_mutex_unlock(&instance_mutex_);
 
-  pthread_mutex_lock(&message_mutex_);
-  while (!incoming_messages_.empty()) incoming_messages_.pop();
-  pthread_mutex_unlock(&message_mutex_);
+  ClearIncomingMessages();
 }
 
 void GPGMultiplayer::DisconnectInstance(const std::string& instance_id) {
@@ -235,6 +290,14 @@ void GPGMultiplayer::RejectAllConnectionRequests() {
 
 // Call me once a frame!
 void GPGMultiplayer::Update() {
+  // Fast path for single-player: while idle with no transition queued,
+  // this one relaxed load replaces the lock and dispatch below. A stale
+  // read just delays the pickup by a frame; QueueNextState() re-arms the
+  // flag from any thread.
+  if (state() == kIdle && !update_pending_.load(std::memory_order_relaxed)) {
+    return;
+  }
+
   pthread_mutex_lock(&state_mutex_);  // unlocked in two places below
   if (!next_states_.empty()) {
     // Transition at most one state per frame.
@@ -246,6 +309,9 @@ void GPGMultiplayer::Update() {
                  next_state);
     TransitionState(state(), next_state);
   } else {
+    // Transition queue drained; let the idle fast path engage. Clearing
+    // under the same mutex QueueNextState() holds means no wakeup is lost.
+    update_pending_.store(false, std::memory_order_relaxed);
     pthread_mutex_unlock(&state_mutex_);
   }
 
@@ -363,6 +429,105 @@ void GPGMultiplayer::Update() {
       break;
     }
   }
+
+  if (IsConnected()) {
+    UpdateRTTProbes();
+  }
+}
+
+void GPGMultiplayer::UpdateRTTProbes() {
+  // Answer the pings we owe. The pong carries the pinger's timestamp back
+  // untouched, so only the pinger's clock is ever compared with itself.
+  // Answering from here instead of the listener callback keeps all sends on
+  // the game thread, at the cost of up to a frame of added latency, which
+  // both sides pay about equally and the percentile absorbs.
+  std::vector<std::pair<std::string, uint32_t>> pongs;
+  pthread_mutex_lock(&instance_mutex_);
+  pongs.swap(pending_pongs_);
+  pthread_mutex_unlock(&instance_mutex_);
+  for (size_t i = 0; i < pongs.size(); ++i) {
+    SendMessage(pongs[i].first, MakePingFrame(kPongMagic, pongs[i].second),
+                false);
+  }
+
+  // Probe every connected instance once per interval. Unreliable is fine:
+  // a lost probe just means no sample this round.
+  const uint32_t now = SDL_GetTicks();
+  if (now - last_ping_ticks_ >= kPingIntervalMs) {
+    last_ping_ticks_ = now;
+    pthread_mutex_lock(&instance_mutex_);
+    std::vector<std::string> instances = connected_instances_;
+    pthread_mutex_unlock(&instance_mutex_);
+    for (size_t i = 0; i < instances.size(); ++i) {
+      // Skip the placeholder slots of disconnected instances.
+      if (instances[i].empty()) continue;
+      SendMessage(instances[i], MakePingFrame(kPingMagic, now), false);
+    }
+  }
+}
+
+bool GPGMultiplayer::HandlePingFrame(const std::string& instance_id,
+                                     const std::vector<uint8_t>& payload) {
+  if (payload.size() != kPingFrameSize) return false;
+  uint32_t magic, timestamp;
+  memcpy(&magic, &payload[0], sizeof(magic));
+  memcpy(&timestamp, &payload[sizeof(magic)], sizeof(timestamp));
+  if (magic == kPingMagic) {
+    pthread_mutex_lock(&instance_mutex_);
+    pending_pongs_.push_back(std::make_pair(instance_id, timestamp));
+    pthread_mutex_unlock(&instance_mutex_);
+    return true;
+  }
+  if (magic == kPongMagic) {
+    const uint32_t rtt = SDL_GetTicks() - timestamp;
+    pthread_mutex_lock(&instance_mutex_);
+    RecordRTTSample(instance_id, static_cast<int>(rtt));
+    pthread_mutex_unlock(&instance_mutex_);
+    return true;
+  }
+  return false;
+}
+
+void GPGMultiplayer::RecordRTTSample(const std::string& instance_id,
+                                     int rtt_ms) {
+  RTTEstimate& estimate = rtt_estimates_[instance_id];
+  estimate.samples[estimate.next_sample] = rtt_ms;
+  estimate.next_sample = (estimate.next_sample + 1) % RTTEstimate::kWindow;
+  if (estimate.sample_count < RTTEstimate::kWindow) estimate.sample_count++;
+  estimate.smoothed_ms =
+      estimate.smoothed_ms < 0.0f
+          ? static_cast<float>(rtt_ms)
+          : estimate.smoothed_ms +
+                kRTTSmoothing * (static_cast<float>(rtt_ms) -
+                                 estimate.smoothed_ms);
+}
+
+int GPGMultiplayer::GetInstanceRTT(const std::string& instance_id) {
+  pthread_mutex_lock(&instance_mutex_);
+  auto it = rtt_estimates_.find(instance_id);
+  const int ret = (it == rtt_estimates_.end() || it->second.sample_count == 0)
+                      ? -1
+                      : static_cast<int>(it->second.smoothed_ms + 0.5f);
+  pthread_mutex_unlock(&instance_mutex_);
+  return ret;
+}
+
+int GPGMultiplayer::GetInstanceRTT95(const std::string& instance_id) {
+  int ret = -1;
+  pthread_mutex_lock(&instance_mutex_);
+  auto it = rtt_estimates_.find(instance_id);
+  if (it != rtt_estimates_.end() && it->second.sample_count > 0) {
+    int sorted[RTTEstimate::kWindow];
+    const int n = it->second.sample_count;
+    memcpy(sorted, it->second.samples, n * sizeof(int));
+    std::sort(sorted, sorted + n);
+    // Nearest-rank percentile, rounding toward the max: conservative for
+    // timeouts.
+    const int rank = (95 * n + 99) / 100;
+    ret = sorted[rank - 1];
+  }
+  pthread_mutex_unlock(&instance_mutex_);
+  return ret;
 }
 
 void GPGMultiplayer::TransitionState(MultiplayerState old_state,
@@ -506,6 +671,9 @@ void GPGMultiplayer::TransitionState(MultiplayerState old_state,
 void GPGMultiplayer::QueueNextState(MultiplayerState next_state) {
   pthread_mutex_lock(&state_mutex_);
   next_states_.push(next_state);
+  // Re-arm Update()'s idle fast path. The mutex orders the queue contents;
+  // the flag is only a hint, so relaxed is enough.
+  update_pending_.store(true, std::memory_order_relaxed);
   pthread_mutex_unlock(&state_mutex_);
 }
 
@@ -540,19 +708,16 @@ void GPGMultiplayer::BroadcastMessage(const std::vector<uint8_t>& payload,
 }
 
 bool GPGMultiplayer::HasMessage() {
-  pthread_mutex_lock(&message_mutex_);
-  bool empty = incoming_messages_.empty();
-  pthread_mutex_unlock(&message_mutex_);
-  return !empty;
+  // Consumer-side peek; only meaningful from the game thread.
+  return incoming_tail_->next.load(std::memory_order_acquire) != nullptr;
 }
 
 GPGMultiplayer::SenderAndMessage GPGMultiplayer::GetNextMessage() {
-  if (HasMessage()) {
-    pthread_mutex_lock(&message_mutex_);
-    auto message = incoming_messages_.front();
-    incoming_messages_.pop();
-    pthread_mutex_unlock(&message_mutex_);
-    return message;
+  MessageNode* node = PopIncomingMessage();
+  if (node != nullptr) {
+    // Move the payload out rather than copying it; the node stays behind
+    // as the queue's stub.
+    return std::move(node->message);
   } else {
     SenderAndMessage blank{"", {}};
     return blank;
@@ -665,9 +830,12 @@ void GPGMultiplayer::ConnectionResponseCallback(
 void GPGMultiplayer::MessageReceivedCallback(
     const std::string& instance_id, std::vector<uint8_t> const& payload,
     bool is_reliable) {
-  pthread_mutex_lock(&message_mutex_);
-  incoming_messages_.push({instance_id, payload});
-  pthread_mutex_unlock(&message_mutex_);
+  // RTT probe frames are transport-internal; don't surface them.
+  if (HandlePingFrame(instance_id, payload)) return;
+
+  // One copy out of the library-owned buffer into the node; after this the
+  // payload moves through to the game code without further copies.
+  PushIncomingMessage(new MessageNode(instance_id, payload));
 }
 
 // Callback on host or client when a connected instance disconnects.
@@ -689,6 +857,8 @@ void GPGMultiplayer::DisconnectedCallback(const std::string& instance_id) {
       connected_instances_[idx] = "";
       UpdateConnectedInstances();
     }
+    // Stale estimates shouldn't greet a reconnecting instance.
+    rtt_estimates_.erase(instance_id);
     pthread_mutex_unlock(&instance_mutex_);
     // When the state is kConnectedWithDisconnections, we start advertising
     // again and allow only the disconnected instances to reconnect.
@@ -702,6 +872,7 @@ void GPGMultiplayer::DisconnectedCallback(const std::string& instance_id) {
       connected_instances_.erase(i);
       UpdateConnectedInstances();
     }
+    rtt_estimates_.erase(instance_id);
     pthread_mutex_unlock(&instance_mutex_);
     if (IsConnected() && GetNumConnectedPlayers() == 0) {
       QueueNextState(kIdle);
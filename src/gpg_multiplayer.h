@@ -52,6 +52,7 @@
 #ifndef GPG_MULTIPLAYER_H
 #define GPG_MULTIPLAYER_H
 
+#include <atomic>
 #include <list>
 #include <map>
 #include <queue>
@@ -96,8 +97,9 @@ class GPGMultiplayer {
     kDialogWaiting,
   };
 
-  // Initializes mutexes only.
+  // Initializes mutexes and the inbound message queue only.
   GPGMultiplayer();
+  ~GPGMultiplayer();
 
   // Initialize the connection manager, set up callbacks, etc.
   // Call this before doing anything else but after initializing
@@ -189,8 +191,10 @@ class GPGMultiplayer {
   // You would then call GetNextMessage() to retrieve the next message.
   bool HasMessage();
 
-  // Get the latest incoming message, or a blank sender and message if there are
-  // none.
+  // Get the latest incoming message, or a blank sender and message if there
+  // are none. The payload is moved out of the queue, not copied, so the
+  // returned vector can be handed straight to a FlatBuffer verifier.
+  // Call only from the game thread (single consumer).
   SenderAndMessage GetNextMessage();
 
   // Returns true if a player has just reconnected.
@@ -226,8 +230,27 @@ class GPGMultiplayer {
   // If true, we allow disconnected users to reconnect.
   bool allow_reconnecting() const { return allow_reconnecting_; }
 
+  // Smoothed round-trip time to a connected instance, in milliseconds, or
+  // -1 before the first sample. Measured with small unreliable ping/pong
+  // frames that Update() exchanges about once a second; game code never
+  // sees the frames.
+  int GetInstanceRTT(const std::string& instance_id);
+
+  // Conservative round-trip time: the 95th percentile of the recent sample
+  // window, in milliseconds, or -1 before the first sample. Use this when
+  // deriving timeouts, so one lucky fast probe doesn't shrink them.
+  int GetInstanceRTT95(const std::string& instance_id);
+
  private:
-  typedef std::queue<SenderAndMessage> MessageQueue;
+  // Node in the lock-free inbound message queue. Producers are the GPG
+  // listener threads, the single consumer is the game thread.
+  struct MessageNode {
+    MessageNode() : next(nullptr) {}
+    MessageNode(const std::string& sender, std::vector<uint8_t> const& payload)
+        : message(sender, payload), next(nullptr) {}
+    SenderAndMessage message;
+    std::atomic<MessageNode*> next;
+  };
 
   // Listens for hosts that are advertising.
   class DiscoveryListener : public gpg::IEndpointDiscoveryListener {
@@ -280,6 +303,20 @@ class GPGMultiplayer {
     std::function<void(const std::string&)> disconnected_callback_;
   };
 
+  // Per-instance round-trip time tracking; see GetInstanceRTT(). Lock
+  // instance_mutex_ before using.
+  struct RTTEstimate {
+    // Recent samples kept for the percentile query.
+    static const int kWindow = 16;
+
+    RTTEstimate() : sample_count(0), next_sample(0), smoothed_ms(-1.0f) {}
+
+    int samples[kWindow];
+    int sample_count;  // Saturates at kWindow.
+    int next_sample;   // Ring write index.
+    float smoothed_ms;  // EWMA; negative until the first sample.
+  };
+
   // Enter a new state, exiting the previous one first.
   void TransitionState(MultiplayerState old_state, MultiplayerState new_state);
 
@@ -313,6 +350,33 @@ class GPGMultiplayer {
   bool DisplayConnectionDialog(const char* title, const char* question_text,
                                const char* yes_text, const char* no_text);
 
+  // Link a new node onto the inbound queue. Safe to call from any thread;
+  // never blocks the game thread.
+  void PushIncomingMessage(MessageNode* node);
+
+  // Detach the oldest queued message, or return nullptr if none. The
+  // returned node stays owned by the queue (it becomes the new stub); the
+  // caller should move its message out. Call only from the game thread.
+  MessageNode* PopIncomingMessage();
+
+  // Drop all queued messages. Call only from the game thread.
+  void ClearIncomingMessages();
+
+  // If payload is one of our transport-level ping/pong frames, consume it
+  // (record the sample or queue the pong we owe) and return true; such
+  // frames must not reach the game's message queue. Called from the
+  // listener threads.
+  bool HandlePingFrame(const std::string& instance_id,
+                       const std::vector<uint8_t>& payload);
+
+  // Answer pongs we owe and probe the connected instances once per
+  // interval. Called from Update() so every send stays on the game thread.
+  void UpdateRTTProbes();
+
+  // Record one round-trip sample for an instance. Make sure instance_mutex_
+  // is locked when calling.
+  void RecordRTTSample(const std::string& instance_id, int rtt_ms);
+
   // Update connected_instances_reverse_ to match to connected_instances_.
   // Make sure instance_mutex_ is locked when calling.
   void UpdateConnectedInstances();
@@ -359,8 +423,32 @@ class GPGMultiplayer {
   // so the user code can send them a game state update.
   std::queue<int> reconnected_players_;
 
-  // List of incoming messages. Lock message_mutex_ before using.
-  MessageQueue incoming_messages_;
+  // Round-trip estimates keyed by instance ID. Lock instance_mutex_ before
+  // using.
+  std::map<std::string, RTTEstimate> rtt_estimates_;
+
+  // Pongs owed to instances that pinged us: (instance ID, the timestamp
+  // their ping carried). Filled by the listener threads, drained by
+  // Update(). Lock instance_mutex_ before using.
+  std::vector<std::pair<std::string, uint32_t>> pending_pongs_;
+
+  // When (SDL ticks) we last pinged the connected instances.
+  uint32_t last_ping_ticks_;
+
+  // Set whenever QueueNextState() queues a transition, from any thread.
+  // Lets Update() skip its lock and state dispatch with a single relaxed
+  // load while we sit in kIdle during single-player play; active states
+  // never take the fast path since they poll dialogs and drive the RTT
+  // probes.
+  std::atomic<bool> update_pending_;
+
+  // Inbound messages, kept in a Vyukov-style intrusive MPSC queue so the
+  // listener threads never contend with the game thread's per-frame drain.
+  // incoming_head_ is where producers link new nodes; incoming_tail_ is the
+  // consumer's stub/last-consumed node and is touched only by the game
+  // thread.
+  std::atomic<MessageNode*> incoming_head_;
+  MessageNode* incoming_tail_;
 
   // Our current state.
   MultiplayerState state_;
@@ -370,9 +458,6 @@ class GPGMultiplayer {
   std::string my_instance_name_;
   int max_connected_players_allowed_;  // 0 to allow any number
 
-  // Mutex for the incoming_messages_ queue.
-  pthread_mutex_t message_mutex_;
-
   // Mutex for instance management: connected_instances_, pending_instances_,
   // discovered_instances, and instance_names_.
   pthread_mutex_t instance_mutex_;
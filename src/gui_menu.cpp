@@ -21,7 +21,21 @@
 namespace fpl {
 namespace pie_noon {
 
-GuiMenu::GuiMenu() {}
+GuiMenu::GuiMenu()
+    : menu_def_(nullptr),
+      static_fbo_(0),
+      static_texture_(0),
+      static_layer_size_(mathfu::kZeros2i),
+      static_layer_valid_(false),
+      composite_shader_(nullptr) {}
+
+GuiMenu::~GuiMenu() { DestroyStaticLayer(); }
+
+// Highlighted buttons pulse every frame and pressed buttons swap materials,
+// so they are drawn live on top of the baked static layer.
+static bool IsDynamicButton(TouchscreenButton& button) {
+  return button.is_highlighted() || button.button().is_down();
+}
 
 static const char* TextureName(const ButtonTexture& button_texture) {
   const bool touch_screen =
@@ -37,6 +51,8 @@ static inline size_t ArrayLength(const T* array) {
 
 void GuiMenu::Setup(const UiGroup* menu_def, MaterialManager* matman) {
   ClearRecentSelections();
+  static_layer_valid_ = false;
+  StashActivePage();
   if (menu_def == nullptr) {
     button_list_.resize(0);
     image_list_.resize(0);
@@ -44,12 +60,29 @@ void GuiMenu::Setup(const UiGroup* menu_def, MaterialManager* matman) {
     return;  // Nothing to set up.  Just clearing things out.
   }
   assert(menu_def->cannonical_window_height() > 0);
+  menu_def_ = menu_def;
+  current_focus_ = menu_def->starting_selection();
+
+  // Recycle the page if this menu has been visited before: swap its lists
+  // back in and reset the per-visit state, skipping the rebuild (and all
+  // its allocations) below.
+  auto pooled = page_pool_.find(menu_def);
+  if (pooled != page_pool_.end()) {
+    MenuPage& page = pooled->second;
+    button_list_.swap(page.buttons);
+    image_list_.swap(page.images);
+    for (int i = 0; i < kHitGridDim * kHitGridDim; ++i) {
+      hit_grid_[i].swap(page.hit_grid[i]);
+    }
+    page_pool_.erase(pooled);
+    ReactivatePage();
+    return;
+  }
+
   const size_t length_button_list = ArrayLength(menu_def->button_list());
   const size_t length_image_list = ArrayLength(menu_def->static_image_list());
-  menu_def_ = menu_def;
   button_list_.resize(length_button_list);
   image_list_.resize(length_image_list);
-  current_focus_ = menu_def->starting_selection();
   // Empty the queue.
 
   for (size_t i = 0; i < length_button_list; i++) {
@@ -115,6 +148,81 @@ void GuiMenu::Setup(const UiGroup* menu_def, MaterialManager* matman) {
     image_list_[i].Initialize(image_def, materials, shader,
                               menu_def_->cannonical_window_height());
   }
+
+  // Shader used to composite the baked static layer onto the screen.
+  composite_shader_ = matman->LoadShader("shaders/textured");
+
+  RebuildHitGrid();
+}
+
+void GuiMenu::StashActivePage() {
+  if (menu_def_ == nullptr) return;
+  MenuPage& page = page_pool_[menu_def_];
+  page.buttons.swap(button_list_);
+  page.images.swap(image_list_);
+  for (int i = 0; i < kHitGridDim * kHitGridDim; ++i) {
+    page.hit_grid[i].swap(hit_grid_[i]);
+  }
+  // Nulling the def makes a second stash (e.g. Setup(nullptr) followed by
+  // another Setup) a no-op instead of clobbering the pooled page with the
+  // now-empty active lists.
+  menu_def_ = nullptr;
+  button_list_.clear();
+  image_list_.clear();
+  for (int i = 0; i < kHitGridDim * kHitGridDim; ++i) {
+    hit_grid_[i].clear();
+  }
+}
+
+void GuiMenu::ReactivatePage() {
+  for (size_t i = 0; i < button_list_.size(); ++i) {
+    button_list_[i].ResetState();
+  }
+  for (size_t i = 0; i < image_list_.size(); ++i) {
+    image_list_[i].ResetState();
+  }
+}
+
+void GuiMenu::ClearPagePool() {
+  page_pool_.clear();
+}
+
+void GuiMenu::RebuildHitGrid() {
+  for (int i = 0; i < kHitGridDim * kHitGridDim; ++i) {
+    hit_grid_[i].clear();
+  }
+  for (size_t i = 0; i < button_list_.size(); ++i) {
+    const ButtonDef* def = button_list_[i].button_def();
+    if (def == nullptr) continue;
+    // Buttons are laid out in normalized [0,1] screen coordinates, so the
+    // range of cells a rectangle touches doesn't depend on window size.
+    const int x0 = mathfu::Clamp(
+        static_cast<int>(def->top_left()->x() * kHitGridDim), 0,
+        kHitGridDim - 1);
+    const int y0 = mathfu::Clamp(
+        static_cast<int>(def->top_left()->y() * kHitGridDim), 0,
+        kHitGridDim - 1);
+    const int x1 = mathfu::Clamp(
+        static_cast<int>(def->bottom_right()->x() * kHitGridDim), 0,
+        kHitGridDim - 1);
+    const int y1 = mathfu::Clamp(
+        static_cast<int>(def->bottom_right()->y() * kHitGridDim), 0,
+        kHitGridDim - 1);
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        hit_grid_[y * kHitGridDim + x].push_back(static_cast<uint16_t>(i));
+      }
+    }
+  }
+}
+
+int GuiMenu::HitGridCell(const mathfu::vec2i& position,
+                         const mathfu::vec2& window_size) const {
+  if (window_size.x() <= 0.0f || window_size.y() <= 0.0f) return -1;
+  const int x = static_cast<int>(position.x() * kHitGridDim / window_size.x());
+  const int y = static_cast<int>(position.y() * kHitGridDim / window_size.y());
+  if (x < 0 || x >= kHitGridDim || y < 0 || y >= kHitGridDim) return -1;
+  return y * kHitGridDim + x;
 }
 
 // Force the material manager to load all the textures and shaders
@@ -159,9 +267,28 @@ void GuiMenu::AdvanceFrame(WorldTime delta_time, InputSystem* input,
                            const vec2& window_size) {
   // Start every frame with a clean list of events.
   ClearRecentSelections();
+
+  // Resolve each down pointer to buttons through the hit grid, instead of
+  // testing every pointer against every button's rectangle.
+  button_down_.assign(button_list_.size(), 0);
+  for (size_t i = 0; i < input->pointers_.size(); ++i) {
+    const Pointer& pointer = input->pointers_[i];
+    const Button& pointer_button = input->GetPointerButton(pointer.id);
+    if (!pointer_button.is_down() && !pointer_button.went_down()) continue;
+    const int cell = HitGridCell(pointer.mousepos, window_size);
+    if (cell < 0) continue;
+    const std::vector<uint16_t>& candidates = hit_grid_[cell];
+    for (size_t c = 0; c < candidates.size(); ++c) {
+      if (button_list_[candidates[c]].WillCapturePointer(pointer,
+                                                         window_size)) {
+        button_down_[candidates[c]] = 1;
+      }
+    }
+  }
+
   for (size_t i = 0; i < button_list_.size(); i++) {
     TouchscreenButton& current_button = button_list_[i];
-    current_button.AdvanceFrame(delta_time, input, window_size);
+    current_button.AdvanceFrame(delta_time, button_down_[i] != 0);
     current_button.set_is_highlighted(current_focus_ == current_button.GetId());
 
     if (current_button.IsTriggered()) {
@@ -205,6 +332,75 @@ MenuSelection GuiMenu::GetRecentSelection() {
 }
 
 void GuiMenu::Render(Renderer* renderer) {
+  // Without a compositing shader (Setup() hasn't run, or the device's
+  // framebuffer support turned out lacking), render everything directly.
+  if (composite_shader_ == nullptr) {
+    RenderDirect(renderer);
+    return;
+  }
+
+  // (Re)create the static layer on first use and on window resizes.
+  const mathfu::vec2i window_size = renderer->window_size();
+  if (static_fbo_ == 0 || window_size.x() != static_layer_size_.x() ||
+      window_size.y() != static_layer_size_.y()) {
+    if (!CreateStaticLayer(window_size)) {
+      RenderDirect(renderer);
+      return;
+    }
+  }
+
+  // Re-bake the static layer only when a baked element changed; an idle
+  // menu skips straight to the composite below.
+  if (StaticLayerStale()) {
+    BakeStaticLayer(renderer);
+  }
+
+  // Composite the baked layer as a single textured quad. The layer was
+  // rendered bottom-up (GL framebuffer convention), so v is flipped.
+  renderer->color() = mathfu::kOnes4f;
+  composite_shader_->Set(*renderer);
+  Renderer::BindTexture(0, static_texture_);
+  Mesh::RenderAAQuadAlongX(
+      vec3(0.0f, 0.0f, 0.0f),
+      vec3(static_cast<float>(window_size.x()),
+           static_cast<float>(window_size.y()), 0.0f),
+      vec2(0, 1), vec2(1, 0));
+
+  // Draw animating buttons live, on top of the baked layer.
+  for (size_t i = 0; i < button_list_.size(); i++) {
+    if (IsDynamicButton(button_list_[i])) {
+      button_list_[i].Render(*renderer);
+    } else {
+      // Baked elements' materials aren't bound while the layer is
+      // composited, but they're still on screen and the next bake needs
+      // them; keep them stamped as in-use so the texture residency sweep
+      // doesn't evict them out from under us.
+      const auto& ups = button_list_[i].up_materials();
+      for (size_t j = 0; j < ups.size(); j++) {
+        if (ups[j]) ups[j]->MarkUsed();
+      }
+      if (button_list_[i].down_material()) {
+        button_list_[i].down_material()->MarkUsed();
+      }
+    }
+  }
+
+  // Overlay images (splats, turn labels etc.) are animated by game code and
+  // must stay above the buttons, so they render live as well.
+  for (size_t i = 0; i < image_list_.size(); i++) {
+    if (image_list_[i].image_def()->render_after_buttons()) {
+      image_list_[i].Render(*renderer);
+    } else {
+      // Baked; see the button loop above.
+      const auto& materials = image_list_[i].materials();
+      for (size_t j = 0; j < materials.size(); j++) {
+        if (materials[j]) materials[j]->MarkUsed();
+      }
+    }
+  }
+}
+
+void GuiMenu::RenderDirect(Renderer* renderer) {
   // Render touch controls, as long as the touch-controller is active.
   for (size_t i = 0; i < image_list_.size(); i++) {
     if (!image_list_[i].image_def()->render_after_buttons())
@@ -219,6 +415,131 @@ void GuiMenu::Render(Renderer* renderer) {
   }
 }
 
+bool GuiMenu::CreateStaticLayer(const mathfu::vec2i& size) {
+  DestroyStaticLayer();
+
+  GL_CALL(glGenTextures(1, &static_texture_));
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, static_texture_));
+  Renderer::InvalidateGlStateShadow();
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x(), size.y(), 0,
+                       GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+
+  GL_CALL(glGenFramebuffers(1, &static_fbo_));
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, static_fbo_));
+  GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                 GL_TEXTURE_2D, static_texture_, 0));
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Can't create menu static layer framebuffer (status 0x%x), "
+                 "falling back to immediate rendering.",
+                 status);
+    DestroyStaticLayer();
+    composite_shader_ = nullptr;
+    return false;
+  }
+
+  static_layer_size_ = size;
+  static_layer_valid_ = false;
+  return true;
+}
+
+void GuiMenu::DestroyStaticLayer() {
+  if (static_fbo_) {
+    GL_CALL(glDeleteFramebuffers(1, &static_fbo_));
+    static_fbo_ = 0;
+  }
+  if (static_texture_) {
+    GL_CALL(glDeleteTextures(1, &static_texture_));
+    // Deleting a texture unbinds it wherever it was bound.
+    Renderer::InvalidateGlStateShadow();
+    static_texture_ = 0;
+  }
+  static_layer_size_ = mathfu::kZeros2i;
+  static_layer_valid_ = false;
+}
+
+bool GuiMenu::StaticLayerStale() {
+  if (!static_layer_valid_ ||
+      baked_button_states_.size() != button_list_.size() ||
+      baked_image_states_.size() != image_list_.size()) {
+    return true;
+  }
+  for (size_t i = 0; i < button_list_.size(); i++) {
+    TouchscreenButton& button = button_list_[i];
+    const ButtonRenderState& baked = baked_button_states_[i];
+    if (baked.dynamic != IsDynamicButton(button) ||
+        baked.visible != button.is_visible() ||
+        baked.active != button.is_active() ||
+        baked.up_material != button.current_up_material() ||
+        baked.color != button.color()) {
+      return true;
+    }
+  }
+  for (size_t i = 0; i < image_list_.size(); i++) {
+    StaticImage& image = image_list_[i];
+    const ImageRenderState& baked = baked_image_states_[i];
+    if (baked.visible != image.is_visible() ||
+        baked.material_index != image.current_material_index() ||
+        baked.scale != image.scale() ||
+        baked.position != image.texture_position() ||
+        baked.color != image.color()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GuiMenu::BakeStaticLayer(Renderer* renderer) {
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, static_fbo_));
+  GL_CALL(glViewport(0, 0, static_layer_size_.x(), static_layer_size_.y()));
+  GL_CALL(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+  GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
+
+  // Bake the under-button images and every non-animating button.
+  for (size_t i = 0; i < image_list_.size(); i++) {
+    if (!image_list_[i].image_def()->render_after_buttons())
+      image_list_[i].Render(*renderer);
+  }
+  for (size_t i = 0; i < button_list_.size(); i++) {
+    if (!IsDynamicButton(button_list_[i])) button_list_[i].Render(*renderer);
+  }
+
+  GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  GL_CALL(glViewport(0, 0, renderer->window_size().x(),
+                     renderer->window_size().y()));
+
+  // Snapshot the states the bake was made from.
+  baked_button_states_.resize(button_list_.size());
+  for (size_t i = 0; i < button_list_.size(); i++) {
+    TouchscreenButton& button = button_list_[i];
+    ButtonRenderState& baked = baked_button_states_[i];
+    baked.dynamic = IsDynamicButton(button);
+    baked.visible = button.is_visible();
+    baked.active = button.is_active();
+    baked.up_material = button.current_up_material();
+    baked.color = button.color();
+  }
+  baked_image_states_.resize(image_list_.size());
+  for (size_t i = 0; i < image_list_.size(); i++) {
+    StaticImage& image = image_list_[i];
+    ImageRenderState& baked = baked_image_states_[i];
+    baked.visible = image.is_visible();
+    baked.material_index = image.current_material_index();
+    baked.scale = image.scale();
+    baked.position = image.texture_position();
+    baked.color = image.color();
+  }
+  static_layer_valid_ = true;
+}
+
 // Accepts logical inputs, and navigates based on it.
 void GuiMenu::HandleControllerInput(uint32_t logical_input,
                                     ControllerId controller_id) {
@@ -42,6 +42,7 @@ struct MenuSelection {
 class GuiMenu {
  public:
   GuiMenu();
+  ~GuiMenu();
 
   void AdvanceFrame(WorldTime delta_time, InputSystem* input,
                     const vec2& window_size);
@@ -58,10 +59,65 @@ class GuiMenu {
   StaticImage* FindImageById(ButtonId id);
   const UiGroup* menu_def() const { return menu_def_; }
 
+  // Drop every pooled menu page. Call when the config buffer is reloaded:
+  // pooled pages hold pointers into the buffer they were built from and
+  // would otherwise linger, pinned to the retired buffer, forever.
+  void ClearPagePool();
+
  private:
+  // Snapshot of the state that determines how a button draws. Compared
+  // against the live state each frame to detect when the baked static layer
+  // went stale.
+  struct ButtonRenderState {
+    bool dynamic;
+    bool visible;
+    bool active;
+    size_t up_material;
+    mathfu::vec4 color;
+  };
+
+  // Snapshot of the state that determines how a static image draws.
+  struct ImageRenderState {
+    bool visible;
+    int material_index;
+    mathfu::vec2 scale;
+    mathfu::vec2 position;
+    mathfu::vec4 color;
+  };
+
   void ClearRecentSelections();
   void UpdateFocus(const flatbuffers::Vector<uint16_t>* destination_list);
 
+  // Rebuild the hit grid from the current button list. Button rectangles
+  // are defined in normalized screen coordinates, so the grid is window
+  // size independent and only changes when the menu layout does.
+  void RebuildHitGrid();
+
+  // The grid cell a pointer position falls into, or -1 when the position
+  // is outside the window.
+  int HitGridCell(const mathfu::vec2i& position,
+                  const mathfu::vec2& window_size) const;
+
+  // Render every element immediately, without the retained static layer.
+  // Fallback path when the layer can't be created.
+  void RenderDirect(Renderer* renderer);
+
+  // (Re)create the static layer FBO & texture at the given size.
+  // Returns false (and disables the retained path) if the framebuffer can't
+  // be completed on this device.
+  bool CreateStaticLayer(const mathfu::vec2i& size);
+
+  // Release the static layer's GL objects.
+  void DestroyStaticLayer();
+
+  // Returns true if any baked element's render state changed since the last
+  // bake, requiring the static layer to be re-rendered.
+  bool StaticLayerStale();
+
+  // Render the non-animating menu elements into the static layer texture
+  // and snapshot the states they were baked with.
+  void BakeStaticLayer(Renderer* renderer);
+
   const UiGroup* menu_def_;
   InputSystem* input_;
   ButtonId current_focus_;
@@ -69,6 +125,49 @@ class GuiMenu {
   std::vector<TouchscreenButton> button_list_;
   std::vector<StaticImage> image_list_;
 
+  // Retained static layer: the menu's background images and non-animating
+  // buttons, rendered once into an offscreen texture and composited each
+  // frame. Only buttons that are pressed or highlighted (and overlay
+  // images) are drawn live, so an idle menu costs a single textured quad.
+  GLuint static_fbo_;
+  GLuint static_texture_;
+  mathfu::vec2i static_layer_size_;
+  bool static_layer_valid_;
+  Shader* composite_shader_;
+  std::vector<ButtonRenderState> baked_button_states_;
+  std::vector<ImageRenderState> baked_image_states_;
+
+  // Pre-baked screen-space hit grid: each cell lists the indices of the
+  // buttons whose rectangle overlaps it, so resolving a pointer costs one
+  // cell lookup plus a test against the (typically zero or one) candidates
+  // instead of a scan over every button per pointer. Rebuilt by Setup().
+  static const int kHitGridDim = 8;
+  std::vector<uint16_t> hit_grid_[kHitGridDim * kHitGridDim];
+
+  // Everything Setup() builds from one UiGroup. Pages are built on the
+  // first visit to a menu and recycled on later visits, so a menu
+  // transition is a handful of vector swaps and a state reset instead of a
+  // rebuild with its per-button allocations.
+  struct MenuPage {
+    std::vector<TouchscreenButton> buttons;
+    std::vector<StaticImage> images;
+    std::vector<uint16_t> hit_grid[kHitGridDim * kHitGridDim];
+  };
+
+  // Move the active lists back into the pool under the current menu_def_.
+  void StashActivePage();
+
+  // Reset the per-visit state of a just-recycled page (button presses,
+  // highlights, visibility, colors) to what a fresh Setup() produces.
+  void ReactivatePage();
+
+  // Pages from previously visited menus, keyed by their definition.
+  std::map<const UiGroup*, MenuPage> page_pool_;
+
+  // Per-frame scratch for which buttons a pointer landed on, kept as a
+  // member so AdvanceFrame doesn't allocate.
+  std::vector<uint8_t> button_down_;
+
   // Total Worldtime since the menu was initialized.
   // Used for animating selections and such.
   WorldTime time_elapsed_;
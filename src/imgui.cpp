@@ -92,10 +92,13 @@ class InternalState : public Group {
         matman_(matman),
         input_(input),
         fontman_(fontman),
+        layout_pass_hash_(0),
+        restored_from_cache_(false),
         pointer_max_active_index_(-1),
         gamepad_has_focus_element(false),
         gamepad_event(EVENT_HOVER) {
     SetScale();
+    ResetSequenceHash();
 
     // Cache the state of multiple pointers, so we have to do less work per
     // interactive element.
@@ -146,6 +149,82 @@ class InternalState : public Group {
     return mathfu::Vector<int, D>(v * pixel_scale_ + 0.5f);
   }
 
+  // FNV-1a style combine of the calls that shape the widget sequence.
+  // Every call that affects layout (widgets, groups, margins, positioning)
+  // feeds the hash, in both the layout and the render pass; two passes with
+  // equal hashes laid out / rendered the same sequence of widgets.
+  void HashCombine(uint64_t v) {
+    sequence_hash_ = (sequence_hash_ ^ v) * 0x100000001b3ULL;
+  }
+  void HashPointer(const void *p) {
+    // Ids are compared by pointer identity (see EqualId()), so hashing the
+    // pointer value is as strong as the comparison the GUI itself uses.
+    HashCombine(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(p)));
+  }
+  void HashFloat(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    HashCombine(bits);
+  }
+  void HashString(const char *s) {
+    // Label text is hashed by content, not pointer: HUD-style labels
+    // reformat text into the same buffer each frame, and a layout cached
+    // against the pointer would go stale without noticing.
+    for (; *s; ++s) HashCombine(static_cast<uint8_t>(*s));
+    HashCombine('\0');
+  }
+  void ResetSequenceHash() {
+    sequence_hash_ = 0xcbf29ce484222325ULL;  // FNV-1a offset basis.
+    auto window_size = matman_.renderer().window_size();
+    HashCombine(window_size.x());
+    HashCombine(window_size.y());
+  }
+
+  // Reuse the layout computed by the previous frame when its widget
+  // sequence and canvas were identical, so Run() can skip the layout pass
+  // entirely. Returns false when there is no valid cached layout.
+  bool RestoreCachedLayout() {
+    if (!layout_cache_.valid ||
+        layout_cache_.window_size != matman_.renderer().window_size()) {
+      return false;
+    }
+    elements_ = layout_cache_.elements;
+    canvas_size_ = layout_cache_.canvas_size;
+    virtual_resolution_ = layout_cache_.virtual_resolution;
+    pixel_scale_ = layout_cache_.pixel_scale;
+    restored_from_cache_ = true;
+    StartRenderPass();
+    return true;
+  }
+
+  // Save this frame's layout for reuse next frame, or invalidate the cache
+  // if the GUI turned out not to be static.
+  void UpdateLayoutCache() {
+    if (restored_from_cache_) {
+      // The sequence we just rendered must match the layout we reused; a
+      // mismatch means the GUI changed this frame (the same one-frame
+      // discrepancy event handlers already cause between the two passes),
+      // so drop the cache and lay out from scratch next frame.
+      if (sequence_hash_ != layout_cache_.hash) layout_cache_.valid = false;
+    } else if (sequence_hash_ == layout_pass_hash_ &&
+               sequence_hash_ == layout_cache_.previous_run_hash) {
+      // Cache only once the sequence is stable: both passes agreed and the
+      // previous Run() saw the same sequence. The stability requirement also
+      // keeps two different GUIs alternating within a frame from thrashing
+      // this single-slot cache into rendering with each other's layout.
+      layout_cache_.valid = true;
+      layout_cache_.hash = sequence_hash_;
+      layout_cache_.elements = elements_;
+      layout_cache_.canvas_size = canvas_size_;
+      layout_cache_.virtual_resolution = virtual_resolution_;
+      layout_cache_.pixel_scale = pixel_scale_;
+      layout_cache_.window_size = matman_.renderer().window_size();
+    } else {
+      layout_cache_.valid = false;
+    }
+    layout_cache_.previous_run_hash = sequence_hash_;
+  }
+
   // Initialize the scaling factor for the virtual resolution.
   void SetScale() {
     auto scale = vec2(matman_.renderer().window_size()) / virtual_resolution_;
@@ -173,6 +252,10 @@ class InternalState : public Group {
   // (screen).
   void PositionUI(const vec2i &canvas_size, float virtual_resolution,
                   Alignment horizontal, Alignment vertical) {
+    HashCombine(canvas_size.x());
+    HashCombine(canvas_size.y());
+    HashFloat(virtual_resolution);
+    HashCombine(static_cast<uint64_t>(horizontal) << 2 | vertical);
     if (layout_pass_) {
       canvas_size_ = canvas_size;
       virtual_resolution_ = virtual_resolution;
@@ -189,6 +272,11 @@ class InternalState : public Group {
     // If you hit this assert, you are missing an EndGroup().
     assert(!group_stack_.size());
 
+    // Remember the layout pass' sequence hash and start a fresh one for the
+    // render pass; the two must agree for the layout to be cacheable.
+    layout_pass_hash_ = sequence_hash_;
+    ResetSequenceHash();
+
     // Update font manager if they need to upload font atlas texture.
     fontman_.StartRenderPass();
 
@@ -257,6 +345,8 @@ class InternalState : public Group {
 
   // An image element.
   void Image(const char *texture_name, float ysize) {
+    HashPointer(texture_name);
+    HashFloat(ysize);
     auto tex = matman_.FindTexture(texture_name);
     assert(tex);  // You need to have called LoadTexture before.
     if (layout_pass_) {
@@ -279,6 +369,9 @@ class InternalState : public Group {
   }
   // Text label.
   void Label(const char *text, float ysize) {
+    HashString(text);
+    HashFloat(ysize);
+
     // Set text color.
     matman_.renderer().color() = text_color_;
 
@@ -310,18 +403,16 @@ class InternalState : public Group {
       auto element = NextElement(text);
       if (element) {
         auto position = Position(*element);
-        fontman_.GetAtlasTexture()->Set(0);
 
         font_shader_->Set(matman_.renderer());
         font_shader_->SetUniform("pos_offset",
                                  vec3(position.x(), position.y(), 0.f));
 
-        const Attribute kFormat[] = {kPosition3f, kTexCoord2f, kEND};
-        Mesh::RenderArray(
-            GL_TRIANGLES, buffer->get_indices()->size(), kFormat,
-            sizeof(FontVertex),
-            reinterpret_cast<const char *>(buffer->get_vertices()->data()),
-            buffer->get_indices()->data());
+        // The buffer's vertices live in a persistent VBO that is only
+        // rewritten when the text's glyphs changed, so unchanged labels
+        // stream no vertex data. The font manager binds the atlas page(s)
+        // the buffer's glyphs live in.
+        fontman_.RenderBuffer(buffer);
 
         Advance(element->size);
       }
@@ -362,6 +453,9 @@ class InternalState : public Group {
   // An element that has sub-elements. Tracks its state in an instance of
   // Layout, that is pushed/popped from the stack as needed.
   void StartGroup(bool vertical, Alignment align, int spacing, const char *id) {
+    HashPointer(id);
+    HashCombine(static_cast<uint64_t>(spacing) << 3 |
+                static_cast<uint64_t>(align) << 1 | (vertical ? 1 : 0));
     Group layout(vertical, align, spacing, elements_.size());
     group_stack_.push_back(*this);
     if (layout_pass_) {
@@ -383,6 +477,7 @@ class InternalState : public Group {
   void EndGroup() {
     // If you hit this assert, you have one too many EndGroup().
     assert(group_stack_.size());
+    HashCombine('E');
 
     auto size = size_;
     auto margin = margin_.xy() + margin_.zw();
@@ -402,6 +497,10 @@ class InternalState : public Group {
 
   void SetMargin(const Margin &margin) {
     margin_ = VirtualToPhysical(margin.borders);
+    HashCombine(margin_.x());
+    HashCombine(margin_.y());
+    HashCombine(margin_.z());
+    HashCombine(margin_.w());
   }
 
   void RecordId(const char *id, int i) { persistent_.pointer_element[i] = id; }
@@ -529,6 +628,13 @@ class InternalState : public Group {
   float virtual_resolution_;
   float pixel_scale_;
 
+  // Hash of the widget sequence seen by the current pass, plus the value it
+  // had at the end of the layout pass. See HashCombine().
+  uint64_t sequence_hash_;
+  uint64_t layout_pass_hash_;
+  // True when this Run() reused last frame's layout instead of laying out.
+  bool restored_from_cache_;
+
   MaterialManager &matman_;
   InputSystem &input_;
   FontManager &fontman_;
@@ -564,9 +670,36 @@ class InternalState : public Group {
     // directed to this element, e.g. for a text edit widget
     const char *keyboard_focus;
   } persistent_;
+
+  // Layout memoized across frames. When the widget sequence and canvas are
+  // unchanged from the previous frame (the common case for static screens
+  // like the pause menu), Run() restores this instead of executing the
+  // layout pass, halving GUI CPU cost.
+  static struct LayoutCache {
+    LayoutCache()
+        : valid(false),
+          hash(0),
+          previous_run_hash(0),
+          canvas_size(mathfu::kZeros2i),
+          virtual_resolution(0.0f),
+          pixel_scale(0.0f),
+          window_size(mathfu::kZeros2i) {}
+
+    bool valid;
+    uint64_t hash;
+    // Hash of the sequence the previous Run() rendered, whether or not it
+    // was cached; used to require cross-frame stability before caching.
+    uint64_t previous_run_hash;
+    std::vector<Element> elements;
+    vec2i canvas_size;
+    float virtual_resolution;
+    float pixel_scale;
+    vec2i window_size;
+  } layout_cache_;
 };
 
 InternalState::PersistentState InternalState::persistent_;
+InternalState::LayoutCache InternalState::layout_cache_;
 
 void Run(MaterialManager &matman, FontManager &fontman, InputSystem &input,
          const std::function<void()> &gui_definition) {
@@ -574,11 +707,15 @@ void Run(MaterialManager &matman, FontManager &fontman, InputSystem &input,
   InternalState internal_state(matman, fontman, input);
 
   // Run two passes, one for layout, one for rendering.
-  // First pass:
-  gui_definition();
-
-  // Second pass:
-  internal_state.StartRenderPass();
+  // When the previous frame's layout is still valid (identical widget
+  // sequence & canvas), it is reused and the layout pass skipped entirely.
+  if (!internal_state.RestoreCachedLayout()) {
+    // First pass:
+    gui_definition();
+
+    // Second pass:
+    internal_state.StartRenderPass();
+  }
 
   // Set up an ortho camera for all 2D elements, with (0, 0) in the top left,
   // and the bottom right the windows size in pixels.
@@ -594,6 +731,7 @@ void Run(MaterialManager &matman, FontManager &fontman, InputSystem &input,
 
   gui_definition();
 
+  internal_state.UpdateLayoutCache();
   internal_state.CheckGamePadFocus();
 }
 
@@ -38,6 +38,12 @@ void InputSystem::Initialize() {
   // Set callback to hear about lifecycle events on mobile devices.
   SDL_SetEventFilter(HandleAppEvents, this);
 
+  // Capture pointer events on the thread that delivers them, so a touch
+  // that lands while a frame is in flight is applied at the next
+  // AdvanceFrame with its true arrival time instead of waiting out an
+  // extra poll. See PointerEventWatch and DrainPointerEvents.
+  SDL_AddEventWatch(PointerEventWatch, this);
+
   // Initialize time.
   start_time_ = SDL_GetTicks();
   // Ensure first frame doesn't get a crazy delta.
@@ -118,28 +124,131 @@ void InputSystem::AdvanceFrame(vec2i *window_size) {
 #ifdef ANDROID_CARDBOARD
   cardboard_input_.AdvanceFrame();
 #endif  // ANDROID_CARDBOARD
+  // When the game is parked on a static screen, the main loop arms an
+  // idle wait: block here for the first event (or the timeout) before
+  // draining the queue, so an untouched menu sleeps in the OS instead of
+  // spinning. A key press or touch ends the wait immediately.
+  if (idle_wait_time_ > 0) {
+    SDL_WaitEventTimeout(nullptr, idle_wait_time_);
+    idle_wait_time_ = 0;
+  }
+
   // Poll events until Q is empty.
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
+    last_event_time_ = millis;
     switch (event.type) {
       case SDL_QUIT:
         exit_requested_ = true;
         break;
       case SDL_KEYDOWN:
       case SDL_KEYUP: {
-        GetButton(event.key.keysym.sym).Update(event.key.state == SDL_PRESSED);
+        GetButton(event.key.keysym.sym)
+            .Update(event.key.state == SDL_PRESSED,
+                    static_cast<int>(event.key.timestamp));
         break;
       }
+      // Pointer events were already captured by PointerEventWatch when
+      // they entered the queue; DrainPointerEvents below applies them.
+      // Handling them here as well would double every transition.
+      case SDL_FINGERDOWN:
+      case SDL_FINGERUP:
+      case SDL_FINGERMOTION:
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+      case SDL_MOUSEMOTION:
+        break;
+      case SDL_WINDOWEVENT: {
+        switch (event.window.event) {
+          case SDL_WINDOWEVENT_RESIZED:
+            *window_size = vec2i(event.window.data1, event.window.data2);
+            break;
+        }
+        break;
+      }
+      case SDL_JOYAXISMOTION:
+      case SDL_JOYBUTTONDOWN:
+      case SDL_JOYBUTTONUP:
+      case SDL_JOYHATMOTION:
+      case SDL_JOYDEVICEADDED:
+      case SDL_JOYDEVICEREMOVED: {
+        HandleJoystickEvent(event);
+        break;
+      }
+      case SDL_TEXTEDITING:
+      case SDL_TEXTINPUT:
+        break;
+      default: {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "----Unknown SDL event!\n");
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "----Event ID: %d!\n",
+                    event.type);
+      }
+    }
+  }
+
+  // Apply pointer events last: the ring also holds anything that arrived
+  // while the loop above was still draining the queue, so the newest
+  // touches make it into this frame rather than the next one.
+  DrainPointerEvents(window_size);
+}
+
+// static
+int InputSystem::PointerEventWatch(void *userdata, SDL_Event *event) {
+  switch (event->type) {
+    case SDL_FINGERDOWN:
+    case SDL_FINGERUP:
+    case SDL_FINGERMOTION:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEMOTION:
+      break;
+    default:
+      // Not a pointer event; leave it for the frame-boundary poll.
+      return 1;
+  }
+  auto input_system = reinterpret_cast<InputSystem *>(userdata);
+  const int write = SDL_AtomicGet(&input_system->pointer_event_write_);
+  const int read = SDL_AtomicGet(&input_system->pointer_event_read_);
+  if (write - read >= kPointerEventRingSize) {
+    // Full. Drop the event; the poll loop skips pointer events, so it is
+    // gone for good. The ring holds more transitions than ten fingers can
+    // produce in a frame, so in practice this means the main thread has
+    // stalled for a long time and input is stale anyway.
+    SDL_AtomicAdd(&input_system->pointer_events_dropped_, 1);
+    return 1;
+  }
+  input_system->pointer_events_[write & (kPointerEventRingSize - 1)] = *event;
+  // SDL_AtomicSet is a full barrier, so the slot contents above are
+  // visible before the new write index.
+  SDL_AtomicSet(&input_system->pointer_event_write_, write + 1);
+  return 1;
+}
+
+void InputSystem::DrainPointerEvents(vec2i *window_size) {
+  const int dropped = SDL_AtomicSet(&pointer_events_dropped_, 0);
+  if (dropped > 0) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "InputSystem: dropped %d pointer events (ring full)\n",
+                dropped);
+  }
+  const int write = SDL_AtomicGet(&pointer_event_write_);
+  int read = SDL_AtomicGet(&pointer_event_read_);
+  for (; read != write; ++read) {
+    const SDL_Event &event =
+        pointer_events_[read & (kPointerEventRingSize - 1)];
+    switch (event.type) {
 #ifdef PLATFORM_MOBILE
       case SDL_FINGERDOWN: {
         int i = UpdateDragPosition(event.tfinger, event.type, *window_size);
-        GetPointerButton(i).Update(true);
+        GetPointerButton(i).Update(true,
+                                   static_cast<int>(event.tfinger.timestamp));
         break;
       }
       case SDL_FINGERUP: {
         int i = FindPointer(event.tfinger.fingerId);
         RemovePointer(i);
-        GetPointerButton(i).Update(false);
+        GetPointerButton(i).Update(false,
+                                   static_cast<int>(event.tfinger.timestamp));
         break;
       }
       case SDL_FINGERMOTION: {
@@ -159,7 +268,8 @@ void InputSystem::AdvanceFrame(vec2i *window_size) {
       case SDL_MOUSEBUTTONDOWN:
       case SDL_MOUSEBUTTONUP: {
         GetPointerButton(event.button.button - 1)
-            .Update(event.button.state == SDL_PRESSED);
+            .Update(event.button.state == SDL_PRESSED,
+                    static_cast<int>(event.button.timestamp));
         pointers_[0].mousepos = vec2i(event.button.x, event.button.y);
         pointers_[0].used = true;
         break;
@@ -169,33 +279,10 @@ void InputSystem::AdvanceFrame(vec2i *window_size) {
         pointers_[0].mousepos = vec2i(event.button.x, event.button.y);
         break;
       }
-      case SDL_WINDOWEVENT: {
-        switch (event.window.event) {
-          case SDL_WINDOWEVENT_RESIZED:
-            *window_size = vec2i(event.window.data1, event.window.data2);
-            break;
-        }
-        break;
-      }
-      case SDL_JOYAXISMOTION:
-      case SDL_JOYBUTTONDOWN:
-      case SDL_JOYBUTTONUP:
-      case SDL_JOYHATMOTION:
-      case SDL_JOYDEVICEADDED:
-      case SDL_JOYDEVICEREMOVED: {
-        HandleJoystickEvent(event);
-        break;
-      }
-      case SDL_TEXTEDITING:
-      case SDL_TEXTINPUT:
-        break;
-      default: {
-        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "----Unknown SDL event!\n");
-        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "----Event ID: %d!\n",
-                    event.type);
-      }
     }
+    last_event_time_ = last_millis_;
   }
+  SDL_AtomicSet(&pointer_event_read_, read);
 }
 
 void InputSystem::HandleJoystickEvent(SDL_Event event) {
@@ -214,7 +301,8 @@ void InputSystem::HandleJoystickEvent(SDL_Event event) {
     case SDL_JOYBUTTONUP:
       GetJoystick(event.jbutton.which)
           .GetButton(event.jbutton.button)
-          .Update(event.jbutton.state == SDL_PRESSED);
+          .Update(event.jbutton.state == SDL_PRESSED,
+                  static_cast<int>(event.jbutton.timestamp));
       break;
     case SDL_JOYHATMOTION:
       GetJoystick(event.jhat.which)
@@ -365,13 +453,22 @@ void InputSystem::CloseOpenJoysticks() {
   }
 }
 
-void Button::Update(bool down) {
+void Button::Update(bool down, int event_millis) {
   if (!is_down_ && down) {
     went_down_ = true;
   } else if (is_down_ && !down) {
     went_up_ = true;
+  } else {
+    // No transition: key repeat or a duplicate state report. Don't record
+    // an event for it.
+    is_down_ = down;
+    return;
   }
   is_down_ = down;
+  ButtonEvent event;
+  event.millis = event_millis;
+  event.down = down;
+  events_.push_back(event);
 }
 
 Button &Joystick::GetButton(size_t button_index) {
@@ -38,22 +38,41 @@ using mathfu::vec2i;
 typedef int AndroidInputDeviceId;
 #endif
 
+// A single button transition, stamped with the time of the SDL event that
+// caused it (SDL_GetTicks clock, in milliseconds). Transitions whose event
+// time isn't known are stamped 0, which sorts them to the start of the
+// frame.
+struct ButtonEvent {
+  int millis;
+  bool down;
+};
+
 // Used to record state for fingers, mousebuttons, keys and gamepad buttons.
 // Allows you to know if a button went up/down this frame.
 class Button {
  public:
   Button() : is_down_(false) { AdvanceFrame(); }
-  void AdvanceFrame() { went_down_ = went_up_ = false; }
-  void Update(bool down);
+  void AdvanceFrame() {
+    went_down_ = went_up_ = false;
+    events_.clear();
+  }
+  void Update(bool down, int event_millis = 0);
 
   bool is_down() const { return is_down_; }
   bool went_down() const { return went_down_; }
   bool went_up() const { return went_up_; }
 
+  // Every transition this button made this frame, in the order the events
+  // arrived. Recovers the sub-frame ordering and timing that the
+  // went_down/went_up flags collapse (e.g. a press and release within one
+  // frame, or which of two buttons was pressed first).
+  const std::vector<ButtonEvent> &events() const { return events_; }
+
  private:
   bool is_down_;
   bool went_down_;
   bool went_up_;
+  std::vector<ButtonEvent> events_;
 };
 
 // This enum extends the SDL_Keycode (an int) which represent all keyboard
@@ -234,8 +253,13 @@ class InputSystem {
         last_millis_(0),
         start_time_(0),
         frames_(0),
-        minimized_frame_(0) {
+        minimized_frame_(0),
+        idle_wait_time_(0),
+        last_event_time_(0) {
     pointers_.assign(kMaxSimultanuousPointers, Pointer());
+    SDL_AtomicSet(&pointer_event_write_, 0);
+    SDL_AtomicSet(&pointer_event_read_, 0);
+    SDL_AtomicSet(&pointer_events_dropped_, 0);
   }
 
   static const int kMaxSimultanuousPointers = 10;  // All current touch screens.
@@ -310,9 +334,29 @@ class InputSystem {
   int minimized_frame() const { return minimized_frame_; }
   int frames() const { return frames_; }
 
+  // Ask the next AdvanceFrame to block in SDL's event wait for up to
+  // 'milliseconds' before polling, instead of returning immediately. Any
+  // arriving event ends the wait at once, so this trades no input latency.
+  // One-shot: the caller re-arms it each frame it believes the screen is
+  // static (see the idle governor in PieNoonGame::Run).
+  void set_idle_wait_time(int milliseconds) { idle_wait_time_ = milliseconds; }
+
+  // Time (in SDL_GetTicks() milliseconds) the last event was polled.
+  // Lets the caller decide how long the player has been idle.
+  int last_event_time() const { return last_event_time_; }
+
  private:
   std::vector<SDL_Joystick *> open_joystick_list;
   static int HandleAppEvents(void *userdata, SDL_Event *event);
+  // Event watch installed with SDL_AddEventWatch. Runs on whichever thread
+  // pushes the event (the platform UI thread for touch), copying pointer
+  // events into the ring below the moment they arrive instead of waiting
+  // for the next frame-boundary poll.
+  static int PointerEventWatch(void *userdata, SDL_Event *event);
+  // Applies everything the watch has captured, including events that
+  // arrived while AdvanceFrame was still draining the SDL queue. Sole
+  // consumer of the ring; the poll loop skips pointer events entirely.
+  void DrainPointerEvents(vec2i *window_size);
   size_t FindPointer(SDL_FingerID id);
   size_t UpdateDragPosition(const SDL_TouchFingerEvent &e, uint32_t event_type,
                             const vec2i &window_size);
@@ -355,6 +399,25 @@ class InputSystem {
   // Most recent frame at which we were minimized or maximized.
   int minimized_frame_;
 
+  // How long the next AdvanceFrame may block waiting for an event, in
+  // milliseconds. Cleared after each use; see set_idle_wait_time().
+  int idle_wait_time_;
+
+  // When the last SDL event was polled, in SDL_GetTicks() milliseconds.
+  int last_event_time_;
+
+  // Single-producer, single-consumer ring of pointer (touch and mouse)
+  // events. PointerEventWatch writes on the event thread, AdvanceFrame
+  // reads on the main thread; the indices are monotonically increasing
+  // and masked into the (power-of-two sized) array, so no lock is needed.
+  // Sized for far more transitions than ten fingers can produce in one
+  // frame; overflow drops the event and bumps the counter below.
+  static const int kPointerEventRingSize = 256;
+  SDL_Event pointer_events_[kPointerEventRingSize];
+  SDL_atomic_t pointer_event_write_;
+  SDL_atomic_t pointer_event_read_;
+  SDL_atomic_t pointer_events_dropped_;
+
  public:
   static const int kMillisecondsPerSecond = 1000;
 };
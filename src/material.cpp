@@ -13,18 +13,58 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#include "alloc_tracker.h"
 #include "material.h"
 #include "renderer.h"
+#include "utilities.h"
 
 namespace fpl {
 
+// Returns true if the filename points at an offline-cooked KTX container
+// rather than an image that needs runtime decode.
+static bool IsKTXFile(const std::string &filename) {
+  static const char kExtension[] = ".ktx";
+  const size_t ext_length = sizeof(kExtension) - 1;
+  return filename.length() >= ext_length &&
+         filename.compare(filename.length() - ext_length, ext_length,
+                          kExtension) == 0;
+}
+
+// Rough GL-side storage for an uploaded texture: 16bpp (the in-game
+// formats are 5551/565) plus a third for the mip chain.
+static size_t GlSizeEstimate(const vec2i &size, bool has_alpha) {
+  (void)has_alpha;
+  const size_t base =
+      static_cast<size_t>(size.x()) * static_cast<size_t>(size.y()) * 2;
+  return base + base / 3;
+}
+
 void Texture::Load() {
+  if (IsKTXFile(filename_)) {
+    // Cooked containers upload as-is, so just pull the raw bytes into
+    // memory; there's nothing to decode.
+    std::string file;
+    if (LoadFile(filename_.c_str(), &file)) {
+      ktx_length_ = file.length();
+      data_ = static_cast<uint8_t *>(malloc(ktx_length_));
+      memcpy(data_, file.c_str(), ktx_length_);
+      tracked_bytes_ = ktx_length_;
+      AllocTracker::Track(AllocTracker::kTagTextures, tracked_bytes_);
+    } else {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "texture load: %s: %s",
+                   filename_.c_str(), renderer_->last_error().c_str());
+    }
+    return;
+  }
   data_ =
       renderer_->LoadAndUnpackTexture(filename_.c_str(), &size_, &has_alpha_);
   if (!data_) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "texture load: %s: %s",
                  filename_.c_str(), renderer_->last_error().c_str());
+    return;
   }
+  tracked_bytes_ = FinalizeSize();
+  AllocTracker::Track(AllocTracker::kTagTextures, tracked_bytes_);
 }
 
 void Texture::LoadFromMemory(const uint8_t *data, const vec2i size,
@@ -33,25 +73,49 @@ void Texture::LoadFromMemory(const uint8_t *data, const vec2i size,
   has_alpha_ = has_alpha;
   desired_ = format;
   id_ = renderer_->CreateTexture(data, size_, has_alpha_, desired_);
+  tracked_bytes_ = GlSizeEstimate(size_, has_alpha_);
+  AllocTracker::Track(AllocTracker::kTagTextures, tracked_bytes_);
 }
 
 void Texture::Finalize() {
   if (data_) {
-    id_ = renderer_->CreateTexture(data_, size_, has_alpha_, desired_);
+    if (ktx_length_ > 0) {
+      id_ = renderer_->CreateTextureFromKTX(data_, ktx_length_, &size_,
+                                            &has_alpha_);
+      if (!id_) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "texture finalize: %s: %s",
+                     filename_.c_str(), renderer_->last_error().c_str());
+      }
+      ktx_length_ = 0;
+    } else {
+      id_ = renderer_->CreateTexture(data_, size_, has_alpha_, desired_);
+    }
     free(data_);
     data_ = nullptr;
+    // Swap the decode buffer's bytes for the GL-side estimate.
+    AllocTracker::Release(AllocTracker::kTagTextures, tracked_bytes_);
+    tracked_bytes_ = id_ ? GlSizeEstimate(size_, has_alpha_) : 0;
+    AllocTracker::Track(AllocTracker::kTagTextures, tracked_bytes_);
   }
+  // Even a failed load clears the flag, so the residency sweep may retry.
+  load_pending_ = false;
 }
 
+uint32_t Texture::bind_frame_count_ = 0;
+
 void Texture::Set(size_t unit) {
-  GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
-  GL_CALL(glBindTexture(GL_TEXTURE_2D, id_));
+  last_bind_frame_ = bind_frame_count_;
+  Renderer::BindTexture(unit, id_);
 }
 
 void Texture::Delete() {
   if (id_) {
     GL_CALL(glDeleteTextures(1, &id_));
+    // Deleting a texture unbinds it from any unit it was bound to.
+    Renderer::InvalidateGlStateShadow();
     id_ = 0;
+    AllocTracker::Release(AllocTracker::kTagTextures, tracked_bytes_);
+    tracked_bytes_ = 0;
   }
 }
 
@@ -64,4 +128,8 @@ void Material::DeleteTextures() {
   for (size_t i = 0; i < textures_.size(); i++) textures_[i]->Delete();
 }
 
+void Material::MarkUsed() {
+  for (size_t i = 0; i < textures_.size(); i++) textures_[i]->MarkUsed();
+}
+
 }  // namespace fpl
@@ -48,7 +48,11 @@ class Texture : public AsyncResource {
         size_(mathfu::kZeros2i),
         uv_(vec4(0.0f, 0.0f, 1.0f, 1.0f)),
         has_alpha_(false),
-        desired_(kFormatAuto) {}
+        desired_(kFormatAuto),
+        ktx_length_(0),
+        tracked_bytes_(0),
+        last_bind_frame_(0),
+        load_pending_(false) {}
   Texture(Renderer &renderer)
       : AsyncResource(""),
         renderer_(&renderer),
@@ -56,7 +60,11 @@ class Texture : public AsyncResource {
         size_(mathfu::kZeros2i),
         uv_(vec4(0.0f, 0.0f, 1.0f, 1.0f)),
         has_alpha_(false),
-        desired_(kFormatAuto) {}
+        desired_(kFormatAuto),
+        ktx_length_(0),
+        tracked_bytes_(0),
+        last_bind_frame_(0),
+        load_pending_(false) {}
   ~Texture() { Delete(); }
 
   virtual void Load();
@@ -64,6 +72,15 @@ class Texture : public AsyncResource {
                               const TextureFormat format, const bool has_alpha);
   virtual void Finalize();
 
+  // GPU upload estimate for AsyncLoader's per-frame finalize budget. KTX
+  // containers upload verbatim; decoded images upload as RGBA or RGB.
+  virtual size_t FinalizeSize() const {
+    return ktx_length_ ? ktx_length_
+                       : static_cast<size_t>(size_.x()) *
+                             static_cast<size_t>(size_.y()) *
+                             (has_alpha_ ? 4 : 3);
+  }
+
   void Set(size_t unit);
   void Delete();
 
@@ -76,6 +93,30 @@ class Texture : public AsyncResource {
 
   void set_desired_format(TextureFormat format) { desired_ = format; }
 
+  // Frame (against the shared bind counter below) this texture was last
+  // bound or marked used. Drives LRU eviction in MaterialManager.
+  uint32_t last_bind_frame() const { return last_bind_frame_; }
+
+  // Stamp the texture as used this frame without binding it. For retained
+  // rendering (e.g. GuiMenu's static layer) where a material stays on
+  // screen for many frames after its last actual bind.
+  void MarkUsed() { last_bind_frame_ = bind_frame_count_; }
+
+  // True while a load of this texture is queued on the async loader but
+  // not yet finalized, so the residency sweep doesn't queue it twice.
+  bool load_pending() const { return load_pending_; }
+  void set_load_pending(bool load_pending) { load_pending_ = load_pending; }
+
+  // Bytes currently charged to AllocTracker for this texture; once
+  // finalized, that's the GL-side storage estimate.
+  size_t tracked_bytes() const { return tracked_bytes_; }
+
+  // Shared frame counter that Set() stamps binds with. A static, because
+  // binds happen deep inside Material::Set, far from any manager; advanced
+  // once per frame by MaterialManager::AdvanceTextureResidencyFrame.
+  static uint32_t bind_frame_count() { return bind_frame_count_; }
+  static void AdvanceBindFrame() { ++bind_frame_count_; }
+
  private:
   Renderer *renderer_;
 
@@ -84,6 +125,20 @@ class Texture : public AsyncResource {
   vec4 uv_;
   bool has_alpha_;
   TextureFormat desired_;
+
+  // When non-zero, data_ holds an offline-cooked KTX container of this many
+  // bytes (rather than decoded pixels), and Finalize uploads it as-is.
+  size_t ktx_length_;
+
+  // Bytes currently reported to AllocTracker for this texture: the decode
+  // buffer while loading, then an estimate of the GL-side storage.
+  size_t tracked_bytes_;
+
+  // See last_bind_frame() and load_pending().
+  uint32_t last_bind_frame_;
+  bool load_pending_;
+
+  static uint32_t bind_frame_count_;
 };
 
 class Material {
@@ -102,9 +157,46 @@ class Material {
 
   void DeleteTextures();
 
+  // Stamp all of this material's textures as used this frame; see
+  // Texture::MarkUsed.
+  void MarkUsed();
+
+  // Mark texture i as a region of a packed atlas sheet. uv is the
+  // sub-rectangle in normalized coordinates, (u0, v0) top-left and
+  // (u1, v1) bottom-right; size is the original image size in pixels.
+  // The atlas Texture itself is shared between materials, so the region
+  // lives here rather than on the Texture.
+  void SetAtlasRegion(size_t i, const vec4 &uv, const vec2i &size) {
+    if (i >= region_uvs_.size()) {
+      region_uvs_.resize(i + 1, vec4(0.0f, 0.0f, 1.0f, 1.0f));
+      region_sizes_.resize(i + 1, mathfu::kZeros2i);
+    }
+    region_uvs_[i] = uv;
+    region_sizes_[i] = size;
+  }
+
+  // UV sub-rectangle for texture i: the atlas region if there is one,
+  // the whole texture otherwise.
+  const vec4 uv(size_t i) const {
+    return i < region_uvs_.size() ? region_uvs_[i]
+                                  : vec4(0.0f, 0.0f, 1.0f, 1.0f);
+  }
+
+  // On-screen pixel size for texture i: the original image size for atlas
+  // regions, the texture's own size otherwise.
+  const vec2i image_size(size_t i) const {
+    return i < region_sizes_.size() && region_sizes_[i].x() > 0
+               ? region_sizes_[i]
+               : textures_[i]->size();
+  }
+
  private:
   std::vector<Texture *> textures_;
   BlendMode blend_mode_;
+
+  // Parallel to textures_; only populated for atlased materials.
+  std::vector<vec4> region_uvs_;
+  std::vector<vec2i> region_sizes_;
 };
 
 }  // namespace fpl
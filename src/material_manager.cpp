@@ -38,17 +38,105 @@ Shader *MaterialManager::FindShader(const char *basename) {
   return FindInMap(shader_map_, basename);
 }
 
+// FNV-1a, folding 'text' into 'hash'. Seed with kHashSeed. Used for shader
+// cache keys, so it must be stable across runs.
+static uint64_t HashString(const std::string &text, uint64_t hash) {
+  for (size_t i = 0; i < text.length(); ++i) {
+    hash = (hash ^ static_cast<uint8_t>(text[i])) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+static const uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+
+// Where a cached program binary for the given key lives: under SDL's
+// per-user writable path, since the assets directory may be read-only
+// (e.g. inside an apk). Returns "" if no writable path is available.
+static std::string ShaderCacheFilename(uint64_t key) {
+  auto pref_path = SDL_GetPrefPath("google", "pienoon");
+  if (!pref_path) return "";
+  char name[32];
+  snprintf(name, sizeof(name), "shader_%016llx.bin",
+           static_cast<unsigned long long>(key));
+  std::string filename = std::string(pref_path) + name;
+  SDL_free(pref_path);
+  return filename;
+}
+
+// Saves 'contents' to 'filename', returning false on error.
+static bool SaveFile(const char *filename, const std::string &contents) {
+  auto handle = SDL_RWFromFile(filename, "wb");
+  if (!handle) return false;
+  size_t wlen =
+      static_cast<size_t>(SDL_RWwrite(handle, contents.c_str(), 1,
+                                      contents.length()));
+  SDL_RWclose(handle);
+  return wlen == contents.length();
+}
+
 Shader *MaterialManager::LoadShader(const char *basename) {
-  auto shader = FindShader(basename);
+  return LoadShader(basename, std::vector<std::string>());
+}
+
+Shader *MaterialManager::LoadShader(const char *basename,
+                                    const std::vector<std::string> &defines) {
+  // Each define list is its own entry in shader_map_; '#' can't appear in
+  // a real file name, so variant keys never collide with plain basenames.
+  std::string key = basename;
+  for (size_t i = 0; i < defines.size(); ++i) {
+    key += '#' + defines[i];
+  }
+  auto shader = FindShader(key.c_str());
   if (shader) return shader;
+  std::string define_block;
+  for (size_t i = 0; i < defines.size(); ++i) {
+    define_block += "#define " + defines[i] + "\n";
+  }
   std::string vs_file, ps_file;
   std::string filename = std::string(basename) + ".glslv";
   if (LoadFile(filename.c_str(), &vs_file)) {
     filename = std::string(basename) + ".glslf";
     if (LoadFile(filename.c_str(), &ps_file)) {
+      // Specialize both stages. Prepending keeps source line numbers in
+      // driver error messages nearly right and means the program binary
+      // cache below keys on the specialized source, so every variant gets
+      // its own cache slot for free.
+      vs_file = define_block + vs_file;
+      ps_file = define_block + ps_file;
+      // Warm starts skip GLSL compilation entirely: look for a program
+      // binary cached by a previous run. The key covers both sources and
+      // the driver version, so edited shaders and driver updates miss (and
+      // overwrite) cleanly.
+      std::string cache_filename;
+      if (renderer_.SupportsProgramBinary()) {
+        const uint64_t key = HashString(
+            renderer_.DriverVersionString(),
+            HashString(ps_file, HashString(vs_file, kHashSeed)));
+        cache_filename = ShaderCacheFilename(key);
+        std::string binary;
+        if (!cache_filename.empty() &&
+            LoadFile(cache_filename.c_str(), &binary)) {
+          // LoadFile appends a zero byte that's not part of the file.
+          shader =
+              renderer_.CreateShaderFromBinary(binary.data(),
+                                               binary.length() - 1);
+          if (shader) {
+            shader_map_[key] = shader;
+            return shader;
+          }
+          SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                      "Driver rejected cached binary for %s; recompiling",
+                      basename);
+        }
+      }
       shader = renderer_.CompileAndLinkShader(vs_file.c_str(), ps_file.c_str());
       if (shader) {
-        shader_map_[basename] = shader;
+        shader_map_[key] = shader;
+        if (!cache_filename.empty()) {
+          std::string binary;
+          if (renderer_.GetProgramBinary(shader->program(), &binary)) {
+            SaveFile(cache_filename.c_str(), binary);
+          }
+        }
       } else {
         SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Shader Error:\n%s\n",
                      renderer_.last_error().c_str());
@@ -66,13 +154,31 @@ Texture *MaterialManager::FindTexture(const char *filename) {
   return FindInMap(texture_map_, filename);
 }
 
+// Returns true if 'filename' can be opened for reading.
+static bool FileExists(const char *filename) {
+  auto handle = SDL_RWFromFile(filename, "rb");
+  if (!handle) return false;
+  SDL_RWclose(handle);
+  return true;
+}
+
 Texture *MaterialManager::LoadTexture(const char *filename,
-                                      TextureFormat format) {
+                                      TextureFormat format, int priority) {
+  // Prefer an offline-cooked KTX container (pre-generated mip chain,
+  // GPU-ready compression) over runtime image decode whenever the asset
+  // pipeline has produced one next to the source image.
+  std::string cooked(filename);
+  const auto dot = cooked.find_last_of('.');
+  if (dot != std::string::npos && cooked.substr(dot + 1) != "ktx") {
+    cooked.replace(dot + 1, std::string::npos, "ktx");
+    if (FileExists(cooked.c_str())) filename = cooked.c_str();
+  }
   auto tex = FindTexture(filename);
   if (tex) return tex;
   tex = new Texture(renderer_, filename);
   tex->set_desired_format(format);
-  loader_.QueueJob(tex);
+  tex->set_load_pending(true);
+  loader_.QueueJob(tex, priority);
   texture_map_[filename] = tex;
   return tex;
 }
@@ -81,19 +187,92 @@ void MaterialManager::StartLoadingTextures() { loader_.StartLoading(); }
 
 bool MaterialManager::TryFinalize() { return loader_.TryFinalize(); }
 
+// Textures bound this frame or the one before are off limits to eviction:
+// the previous frame's bindings may still be referenced by the GL frame
+// in flight.
+static const uint32_t kEvictionFrameGrace = 2;
+
+void MaterialManager::AdvanceTextureResidencyFrame() {
+  // Pick up anything the workers finished since last frame; reloads (and
+  // prefetched materials) upload here even in states that never call
+  // TryFinalize themselves. A no-op when nothing is in flight.
+  loader_.TryFinalize();
+
+  const uint32_t frame = Texture::bind_frame_count();
+
+  // Requeue evicted textures that came back on screen: no GL storage, no
+  // load in flight, but bound this frame. The loader workers persist for
+  // the whole session, so queueing the job is all it takes.
+  for (auto it = texture_map_.begin(); it != texture_map_.end(); ++it) {
+    Texture *tex = it->second;
+    if (!tex->id() && !tex->load_pending() &&
+        tex->last_bind_frame() == frame && !tex->filename().empty()) {
+      tex->set_load_pending(true);
+      loader_.QueueJob(tex);
+    }
+  }
+
+  if (gpu_texture_budget_ != 0) {
+    size_t total = 0;
+    for (auto it = texture_map_.begin(); it != texture_map_.end(); ++it) {
+      if (it->second->id()) total += it->second->tracked_bytes();
+    }
+    if (total > gpu_texture_budget_) {
+      // Evict least-recently-bound first, until back under budget.
+      // Textures without a filename (built from memory) can't be reloaded,
+      // so they're never evicted.
+      struct Candidate {
+        uint32_t last_bind;
+        Texture *texture;
+      };
+      std::vector<Candidate> candidates;
+      for (auto it = texture_map_.begin(); it != texture_map_.end(); ++it) {
+        Texture *tex = it->second;
+        if (!tex->id() || tex->filename().empty()) continue;
+        if (tex->last_bind_frame() + kEvictionFrameGrace > frame) continue;
+        Candidate candidate = {tex->last_bind_frame(), tex};
+        candidates.push_back(candidate);
+      }
+      std::sort(candidates.begin(), candidates.end(),
+                [](const Candidate &a, const Candidate &b) {
+                  return a.last_bind < b.last_bind;
+                });
+      for (size_t i = 0;
+           i < candidates.size() && total > gpu_texture_budget_; ++i) {
+        total -= candidates[i].texture->tracked_bytes();
+        candidates[i].texture->Delete();
+      }
+    }
+  }
+
+  Texture::AdvanceBindFrame();
+}
+
 Material *MaterialManager::FindMaterial(const char *filename) {
   return FindInMap(material_map_, filename);
 }
 
-Material *MaterialManager::LoadMaterial(const char *filename) {
+Material *MaterialManager::LoadMaterial(const char *filename, int priority) {
   auto mat = FindMaterial(filename);
   if (mat) return mat;
-  std::string flatbuf;
-  if (LoadFile(filename, &flatbuf)) {
-    flatbuffers::Verifier verifier(
-        reinterpret_cast<const uint8_t *>(flatbuf.c_str()), flatbuf.length());
-    assert(matdef::VerifyMaterialBuffer(verifier));
-    auto matdef = matdef::GetMaterial(flatbuf.c_str());
+  // The material definition is only needed while we build the Material, so
+  // map it in place rather than copying it through a string.
+  MappedFile flatbuf;
+  if (LoadFileMapped(filename, &flatbuf)) {
+    // Verification chases every offset in the buffer; skip it when this
+    // exact buffer already passed in an earlier run. Hashing is a straight
+    // byte scan, far cheaper than the verifier's bounds-checked walk.
+    const uint64_t hash = HashBufferContents(flatbuf.data(), flatbuf.length());
+    if (!BufferPreviouslyVerified(hash)) {
+      flatbuffers::Verifier verifier(
+          reinterpret_cast<const uint8_t *>(flatbuf.data()), flatbuf.length());
+      if (!matdef::VerifyMaterialBuffer(verifier)) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Corrupt material: %s", filename);
+        return nullptr;
+      }
+      RememberVerifiedBuffer(hash);
+    }
+    auto matdef = matdef::GetMaterial(flatbuf.data());
     mat = new Material();
     mat->set_blend_mode(static_cast<BlendMode>(matdef->blendmode()));
     for (size_t i = 0; i < matdef->texture_filenames()->size(); i++) {
@@ -101,9 +280,17 @@ Material *MaterialManager::LoadMaterial(const char *filename) {
           matdef->desired_format() && i < matdef->desired_format()->size()
               ? static_cast<TextureFormat>(matdef->desired_format()->Get(i))
               : kFormatAuto;
-      auto tex =
-          LoadTexture(matdef->texture_filenames()->Get(i)->c_str(), format);
+      auto tex = LoadTexture(matdef->texture_filenames()->Get(i)->c_str(),
+                             format, priority);
       mat->textures().push_back(tex);
+      // Atlased materials reference a shared sheet texture plus the
+      // sub-rectangle their image was packed into.
+      if (matdef->atlas_regions() && i < matdef->atlas_regions()->size()) {
+        auto region = matdef->atlas_regions()->Get(i);
+        mat->SetAtlasRegion(
+            i, vec4(region->u0(), region->v0(), region->u1(), region->v1()),
+            vec2i(region->width(), region->height()));
+      }
     }
     material_map_[filename] = mat;
     return mat;
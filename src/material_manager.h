@@ -23,7 +23,8 @@ namespace fpl {
 
 class MaterialManager {
  public:
-  MaterialManager(Renderer &renderer) : renderer_(renderer) {}
+  MaterialManager(Renderer &renderer)
+      : renderer_(renderer), gpu_texture_budget_(0) {}
 
   // Returns a previously loaded shader object, or nullptr.
   Shader *FindShader(const char *basename);
@@ -31,15 +32,23 @@ class MaterialManager {
   // and .glslf to the basename, compiling and linking them.
   // If this returns nullptr, the error can be found in Renderer::last_error().
   Shader *LoadShader(const char *basename);
+  // As above, but specializes the shader with the given preprocessor
+  // symbols: "#define <symbol>" is prepended to both stages before
+  // compiling. Each distinct define list links and caches its own program,
+  // so features can be compiled out per variant instead of branched on at
+  // runtime. The variants of one basename share nothing but the source
+  // files.
+  Shader *LoadShader(const char *basename,
+                     const std::vector<std::string> &defines);
 
   // Returns a previously created texture, or nullptr.
   Texture *FindTexture(const char *filename);
   // Queue's a texture for loading if it hasn't been loaded already.
   // Currently only supports TGA/WebP format files.
   // Returned texture isn't usable until TryFinalize() succeeds and the id
-  // is non-zero.
-  Texture *LoadTexture(const char *filename,
-                       TextureFormat format = kFormatAuto);
+  // is non-zero. Higher priority textures load and finalize first.
+  Texture *LoadTexture(const char *filename, TextureFormat format = kFormatAuto,
+                       int priority = 0);
   // LoadTextures doesn't actually load anything, this will start the async
   // loading of all files, and decompression.
   void StartLoadingTextures();
@@ -48,12 +57,42 @@ class MaterialManager {
   // Textures with a 0 id will have failed to load.
   bool TryFinalize();
 
+  // Cap how many texture bytes TryFinalize uploads per call, amortizing
+  // finalization over several frames. 0 means no cap.
+  void set_finalize_budget(size_t bytes_per_frame) {
+    loader_.set_finalize_budget(bytes_per_frame);
+  }
+
+  // Number of queued async load jobs the loader's workers haven't handed
+  // back yet. Approximate while loading is in flight; for diagnostics.
+  int NumPendingLoadJobs() const { return loader_.NumPendingJobs(); }
+
+  // The async loader behind this manager. Other systems (e.g. FontManager)
+  // may queue their own AsyncResources on it; they are finalized by the
+  // same per-frame TryFinalize() calls as the textures.
+  AsyncLoader &loader() { return loader_; }
+
+  // Cap on resident GPU texture bytes. While the total is over it, the
+  // least recently bound textures get their GL storage evicted; an evicted
+  // texture that's bound again reloads transparently through the async
+  // path. Menu and gameplay textures never show at the same time, so
+  // whichever set fell out of use is what ages out. 0 (the default)
+  // disables eviction.
+  void set_gpu_texture_budget(size_t bytes) { gpu_texture_budget_ = bytes; }
+
+  // One residency step: finalizes finished reloads, requeues evicted
+  // textures that were bound since the last call, evicts the least
+  // recently bound textures while over budget, and advances the bind-frame
+  // counter. Call once per frame.
+  void AdvanceTextureResidencyFrame();
+
   // Returns a previously loaded material, or nullptr.
   Material *FindMaterial(const char *filename);
   // Loads a material, which is a compiled FlatBuffer file with
-  // root Material. This loads all resources contained there-in.
+  // root Material. This loads all resources contained there-in, queueing its
+  // textures at the given priority.
   // If this returns nullptr, the error can be found in Renderer::last_error().
-  Material *LoadMaterial(const char *filename);
+  Material *LoadMaterial(const char *filename, int priority = 0);
 
   // Deletes all OpenGL textures contained in this material, and removes the
   // textures and the material from material manager. Any subsequent requests
@@ -72,6 +111,9 @@ class MaterialManager {
   std::map<std::string, Texture *> texture_map_;
   std::map<std::string, Material *> material_map_;
   AsyncLoader loader_;
+
+  // See set_gpu_texture_budget.
+  size_t gpu_texture_budget_;
 };
 
 }  // namespace fpl
@@ -13,42 +13,65 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#include "common.h"
 #include "mesh.h"
+#include "renderer.h"
 
 namespace fpl {
 
 void Mesh::SetAttributes(GLuint vbo, const Attribute *attributes, int stride,
                          const char *buffer) {
   GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+  // Enable (and lazily disable) attribute arrays through the state shadow,
+  // so a run of draws sharing a vertex format issues no enable calls.
+  uint32_t attrib_mask = 0;
+  for (const Attribute *attribute = attributes; *attribute != kEND;
+       ++attribute) {
+    switch (*attribute) {
+      case kPosition3f:
+        attrib_mask |= 1u << kAttributePosition;
+        break;
+      case kNormal3f:
+        attrib_mask |= 1u << kAttributeNormal;
+        break;
+      case kTangent4f:
+        attrib_mask |= 1u << kAttributeTangent;
+        break;
+      case kTexCoord2f:
+        attrib_mask |= 1u << kAttributeTexCoord;
+        break;
+      case kColor4ub:
+        attrib_mask |= 1u << kAttributeColor;
+        break;
+      case kEND:
+        break;
+    }
+  }
+  Renderer::EnableVertexAttribs(attrib_mask);
   size_t offset = 0;
   for (;;) {
     switch (*attributes++) {
       case kPosition3f:
-        GL_CALL(glEnableVertexAttribArray(kAttributePosition));
         GL_CALL(glVertexAttribPointer(kAttributePosition, 3, GL_FLOAT, false,
                                       stride, buffer + offset));
         offset += 3 * sizeof(float);
         break;
       case kNormal3f:
-        GL_CALL(glEnableVertexAttribArray(kAttributeNormal));
         GL_CALL(glVertexAttribPointer(kAttributeNormal, 3, GL_FLOAT, false,
                                       stride, buffer + offset));
         offset += 3 * sizeof(float);
         break;
       case kTangent4f:
-        GL_CALL(glEnableVertexAttribArray(kAttributeTangent));
         GL_CALL(glVertexAttribPointer(kAttributeTangent, 3, GL_FLOAT, false,
                                       stride, buffer + offset));
         offset += 4 * sizeof(float);
         break;
       case kTexCoord2f:
-        GL_CALL(glEnableVertexAttribArray(kAttributeTexCoord));
         GL_CALL(glVertexAttribPointer(kAttributeTexCoord, 2, GL_FLOAT, false,
                                       stride, buffer + offset));
         offset += 2 * sizeof(float);
         break;
       case kColor4ub:
-        GL_CALL(glEnableVertexAttribArray(kAttributeColor));
         GL_CALL(glVertexAttribPointer(kAttributeColor, 4, GL_UNSIGNED_BYTE,
                                       true, stride, buffer + offset));
         offset += 4;
@@ -59,28 +82,10 @@ void Mesh::SetAttributes(GLuint vbo, const Attribute *attributes, int stride,
   }
 }
 
-void Mesh::UnSetAttributes(const Attribute *attributes) {
-  for (;;) {
-    switch (*attributes++) {
-      case kPosition3f:
-        GL_CALL(glDisableVertexAttribArray(kAttributePosition));
-        break;
-      case kNormal3f:
-        GL_CALL(glDisableVertexAttribArray(kAttributeNormal));
-        break;
-      case kTangent4f:
-        GL_CALL(glDisableVertexAttribArray(kAttributeTangent));
-        break;
-      case kTexCoord2f:
-        GL_CALL(glDisableVertexAttribArray(kAttributeTexCoord));
-        break;
-      case kColor4ub:
-        GL_CALL(glDisableVertexAttribArray(kAttributeColor));
-        break;
-      case kEND:
-        return;
-    }
-  }
+void Mesh::UnSetAttributes(const Attribute * /*attributes*/) {
+  // Intentionally empty: arrays stay enabled in the GL state shadow, and
+  // the next SetAttributes disables the ones its format doesn't use. No
+  // draw happens between, so nothing ever samples a stale array.
 }
 
 Mesh::Mesh(const void *vertex_data, int count, int vertex_size,
@@ -95,19 +100,71 @@ Mesh::Mesh(const void *vertex_data, int count, int vertex_size,
 Mesh::~Mesh() {
   GL_CALL(glDeleteBuffers(1, &vbo_));
   for (auto it = indices_.begin(); it != indices_.end(); ++it) {
-    GL_CALL(glDeleteBuffers(1, &it->ibo));
+    if (it->owns_ibo) {
+      GL_CALL(glDeleteBuffers(1, &it->ibo));
+    }
   }
 }
 
+// The overwhelmingly common index data: independent quads, four vertices
+// and six indices each (see kQuadIndices in pie_noon_game.cpp). One static
+// IBO holds that pattern repeated kMaxSharedQuads times, and any AddIndices
+// call whose data is a prefix of it shares the buffer instead of creating
+// its own. Cardboard cutouts alone create two 6-index meshes per
+// renderable, and the merged static props regenerate their meshes on every
+// rebuild; sharing keeps the GL object count flat, which matters on old
+// Android drivers that charge real CPU per buffer object.
+static const int kSharedQuadIndicesPerQuad = 6;
+static const int kSharedQuadVertsPerQuad = 4;
+static const int kMaxSharedQuads = 4096;
+
+// The value the shared pattern has at index position 'i'.
+static unsigned short SharedQuadIndex(int i) {
+  static const unsigned short kQuadPattern[kSharedQuadIndicesPerQuad] = {
+      0, 1, 2, 2, 1, 3};
+  return static_cast<unsigned short>(
+      (i / kSharedQuadIndicesPerQuad) * kSharedQuadVertsPerQuad +
+      kQuadPattern[i % kSharedQuadIndicesPerQuad]);
+}
+
+// Returns the shared quad-pattern IBO when 'index_data' is a prefix of the
+// pattern, or 0 when it isn't (or is too long). The buffer is created on
+// first use and lives for the lifetime of the GL context.
+static GLuint SharedQuadIbo(const unsigned short *index_data, int count) {
+  if (count > kMaxSharedQuads * kSharedQuadIndicesPerQuad) return 0;
+  for (int i = 0; i < count; ++i) {
+    if (index_data[i] != SharedQuadIndex(i)) return 0;
+  }
+  static GLuint shared_ibo = 0;
+  if (shared_ibo == 0) {
+    std::vector<unsigned short> pattern(kMaxSharedQuads *
+                                        kSharedQuadIndicesPerQuad);
+    for (size_t i = 0; i < pattern.size(); ++i) {
+      pattern[i] = SharedQuadIndex(static_cast<int>(i));
+    }
+    GL_CALL(glGenBuffers(1, &shared_ibo));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shared_ibo));
+    GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         pattern.size() * sizeof(unsigned short),
+                         pattern.data(), GL_STATIC_DRAW));
+  }
+  return shared_ibo;
+}
+
 void Mesh::AddIndices(const unsigned short *index_data, int count,
                       Material *mat) {
   indices_.push_back(Indices());
   auto &idxs = indices_.back();
   idxs.count = count;
-  GL_CALL(glGenBuffers(1, &idxs.ibo));
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxs.ibo));
-  GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(int), index_data,
-                       GL_STATIC_DRAW));
+  idxs.ibo = SharedQuadIbo(index_data, count);
+  idxs.owns_ibo = idxs.ibo == 0;
+  if (idxs.owns_ibo) {
+    GL_CALL(glGenBuffers(1, &idxs.ibo));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxs.ibo));
+    GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                         count * sizeof(unsigned short), index_data,
+                         GL_STATIC_DRAW));
+  }
   idxs.mat = mat;
 }
 
@@ -117,16 +174,55 @@ void Mesh::Render(Renderer &renderer, bool ignore_material) {
     if (!ignore_material) it->mat->Set(renderer);
     GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, it->ibo));
     GL_CALL(glDrawElements(GL_TRIANGLES, it->count, GL_UNSIGNED_SHORT, 0));
+    Renderer::CountDrawCall(it->count / 3);
   }
   UnSetAttributes(format_);
 }
 
 void Mesh::RenderArray(GLenum primitive, int index_count,
                        const Attribute *format, int vertex_size,
-                       const char *vertices, const unsigned short *indices) {
-  SetAttributes(0, format, vertex_size, vertices);
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-  GL_CALL(glDrawElements(primitive, index_count, GL_UNSIGNED_SHORT, indices));
+                       const char *vertices, int vertex_count,
+                       const unsigned short *indices) {
+  // Stream the data through a small ring of buffer objects instead of
+  // drawing client-side arrays. Uploading with GL_STREAM_DRAW orphans the
+  // previous contents, so the driver keeps the last few frames' copies in
+  // flight without a sync; client arrays force some drivers (PowerVR in
+  // particular) to validate and copy the whole range at draw time.
+  // Persistent mapping isn't available on ES 2.0, so orphaned uploads are
+  // the streaming path used everywhere.
+  static const int kStreamBuffers = 4;
+  static GLuint stream_vbos[kStreamBuffers];
+  static GLuint stream_ibos[kStreamBuffers];
+  static int stream_index = 0;
+  if (stream_vbos[0] == 0) {
+    GL_CALL(glGenBuffers(kStreamBuffers, stream_vbos));
+    GL_CALL(glGenBuffers(kStreamBuffers, stream_ibos));
+  }
+  stream_index = (stream_index + 1) % kStreamBuffers;
+
+  GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream_vbos[stream_index]));
+  GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertex_count * vertex_size, vertices,
+                       GL_STREAM_DRAW));
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream_ibos[stream_index]));
+  GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                       index_count * sizeof(unsigned short), indices,
+                       GL_STREAM_DRAW));
+
+  SetAttributes(stream_vbos[stream_index], format, vertex_size, nullptr);
+  GL_CALL(glDrawElements(primitive, index_count, GL_UNSIGNED_SHORT, 0));
+  Renderer::CountDrawCall(index_count / 3);
+  UnSetAttributes(format);
+}
+
+void Mesh::RenderArrayBuffered(GLenum primitive, int index_count,
+                               const Attribute *format, int vertex_size,
+                               GLuint vbo, GLuint ibo, int index_offset) {
+  SetAttributes(vbo, format, vertex_size, nullptr);
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
+  GL_CALL(glDrawElements(
+      primitive, index_count, GL_UNSIGNED_SHORT,
+      reinterpret_cast<const void *>(index_offset * sizeof(unsigned short))));
+  Renderer::CountDrawCall(index_count / 3);
   UnSetAttributes(format);
 }
 
@@ -144,20 +240,134 @@ void Mesh::RenderAAQuadAlongX(const vec3 &bottom_left, const vec3 &top_right,
       top_right.z(),       tex_bottom_left.x(), tex_top_right.y(),
       top_right.x(),       top_right.y(),       top_right.z(),
       tex_top_right.x(),   tex_top_right.y()};
-  Mesh::RenderArray(GL_TRIANGLES, 6, format, sizeof(float) * 5,
-                    reinterpret_cast<const char *>(vertices), indices);
+
+  // Identical quads get requested hundreds of times per frame (GUI elements,
+  // the ground plane, cardboard cutouts), so keep recently used ones in
+  // persistent VBOs, keyed by their vertex data, rather than streaming the
+  // same four vertices over and over. The cache is small and evicted
+  // round-robin; the GL objects live for the lifetime of the context.
+  struct CachedQuad {
+    float key[PIE_ARRAYSIZE(vertices)];
+    GLuint vbo;
+  };
+  static const int kMaxCachedQuads = 64;
+  static CachedQuad cache[kMaxCachedQuads];
+  static int num_cached = 0;
+  static int next_evict = 0;
+  static GLuint quad_ibo = 0;
+
+  // All cached quads share one index buffer.
+  if (quad_ibo == 0) {
+    GL_CALL(glGenBuffers(1, &quad_ibo));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_ibo));
+    GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+                         GL_STATIC_DRAW));
+  }
+
+  CachedQuad *quad = nullptr;
+  for (int i = 0; i < num_cached; ++i) {
+    if (memcmp(cache[i].key, vertices, sizeof(vertices)) == 0) {
+      quad = &cache[i];
+      break;
+    }
+  }
+  if (quad == nullptr) {
+    if (num_cached < kMaxCachedQuads) {
+      quad = &cache[num_cached++];
+      GL_CALL(glGenBuffers(1, &quad->vbo));
+    } else {
+      quad = &cache[next_evict];
+      next_evict = (next_evict + 1) % kMaxCachedQuads;
+    }
+    memcpy(quad->key, vertices, sizeof(vertices));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, quad->vbo));
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
+                         GL_STATIC_DRAW));
+  }
+
+  SetAttributes(quad->vbo, format, sizeof(float) * 5, nullptr);
+  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_ibo));
+  GL_CALL(glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0));
+  Renderer::CountDrawCall(2);
+  UnSetAttributes(format);
+}
+
+void Mesh::RenderQuadBatch(const NormalMappedVertex *quad_vertices,
+                           const mathfu::mat4 *world_matrices,
+                           const mathfu::vec4 *colors, int count) {
+  static Attribute format[] = {kPosition3f, kTexCoord2f, kColor4ub, kEND};
+  // The expanded per-vertex data for one instance corner.
+  struct BatchVertex {
+    vec3_packed pos;
+    vec2_packed tc;
+    uint8_t color[4];
+  };
+  static const int kVertsPerQuad = 4;
+  static const int kIndicesPerQuad = 6;
+  // Stay well within 16-bit index range: 16k quads = 64k vertices.
+  static const int kMaxQuadsPerDraw = (1 << 16) / kVertsPerQuad;
+
+  // Scratch buffers are reused from call to call, so steady-state rendering
+  // doesn't allocate.
+  static std::vector<BatchVertex> vertices;
+  static std::vector<unsigned short> indices;
+
+  for (int first = 0; first < count; first += kMaxQuadsPerDraw) {
+    const int num_quads = std::min(count - first, kMaxQuadsPerDraw);
+    vertices.resize(num_quads * kVertsPerQuad);
+    indices.resize(num_quads * kIndicesPerQuad);
+    for (int i = 0; i < num_quads; ++i) {
+      const mathfu::mat4 &m = world_matrices[first + i];
+      const mathfu::vec4 &color = colors[first + i];
+      uint8_t color4ub[4];
+      for (int c = 0; c < 4; ++c) {
+        color4ub[c] = static_cast<uint8_t>(
+            mathfu::Clamp(color[c], 0.0f, 1.0f) * 255.0f);
+      }
+      BatchVertex *v = &vertices[i * kVertsPerQuad];
+      for (int j = 0; j < kVertsPerQuad; ++j) {
+        v[j].pos = (m * vec4(vec3(quad_vertices[j].pos), 1.0f)).xyz();
+        v[j].tc = quad_vertices[j].tc;
+        memcpy(v[j].color, color4ub, sizeof(color4ub));
+      }
+      unsigned short *idx = &indices[i * kIndicesPerQuad];
+      const unsigned short base =
+          static_cast<unsigned short>(i * kVertsPerQuad);
+      idx[0] = base + 0;
+      idx[1] = base + 1;
+      idx[2] = base + 2;
+      idx[3] = base + 1;
+      idx[4] = base + 2;
+      idx[5] = base + 3;
+    }
+    RenderArray(GL_TRIANGLES, num_quads * kIndicesPerQuad, format,
+                sizeof(BatchVertex),
+                reinterpret_cast<const char *>(vertices.data()),
+                num_quads * kVertsPerQuad, indices.data());
+  }
 }
 
 // Compute normals and tangents for a mesh based on positions and texcoords.
 void Mesh::ComputeNormalsTangents(NormalMappedVertex *vertices,
                                   const unsigned short *indices, int numverts,
                                   int numindices) {
+  // Accumulate into full-width scratch vectors, not into the packed vertex
+  // fields. Every triangle touches three vertices, and widening, adding and
+  // re-packing vec3_packed/vec4_packed each time forces all the math back
+  // through scalar loads and stores; with aligned vec3/vec4 scratch the
+  // whole accumulation runs in mathfu's vector registers (when
+  // MATHFU_COMPILE_WITH_SIMD is on), and each vertex is unpacked and
+  // repacked exactly once.
+  std::unique_ptr<vec3[]> positions(new vec3[numverts]);
+  std::unique_ptr<vec3[]> normals(new vec3[numverts]);
+  std::unique_ptr<vec4[]> tangents(new vec4[numverts]);
   std::unique_ptr<vec3[]> binormals(new vec3[numverts]);
 
-  // set all normals to 0, as we'll accumulate
+  // Unpack positions once, and zero the accumulators.
   for (int i = 0; i < numverts; i++) {
-    vertices[i].norm = mathfu::kZeros3f;
-    vertices[i].tangent = mathfu::kZeros4f;
+    positions[i] = vec3(vertices[i].pos);
+    normals[i] = mathfu::kZeros3f;
+    tangents[i] = mathfu::kZeros4f;
     binormals[i] = mathfu::kZeros3f;
   }
   // Go through each triangle and calculate tangent space for it, then
@@ -165,39 +375,37 @@ void Mesh::ComputeNormalsTangents(NormalMappedVertex *vertices,
   // For a description of the math see e.g.:
   // http://www.terathon.com/code/tangent.html
   for (int i = 0; i < numindices; i += 3) {
-    auto &v0 = vertices[indices[i + 0]];
-    auto &v1 = vertices[indices[i + 1]];
-    auto &v2 = vertices[indices[i + 2]];
+    const int i0 = indices[i + 0];
+    const int i1 = indices[i + 1];
+    const int i2 = indices[i + 2];
     // The cross product of two vectors along the triangle surface from the
     // first vertex gives us this triangle's normal.
-    auto q1 = vec3(v1.pos) - vec3(v0.pos);
-    auto q2 = vec3(v2.pos) - vec3(v0.pos);
+    auto q1 = positions[i1] - positions[i0];
+    auto q2 = positions[i2] - positions[i0];
     auto norm = normalize(cross(q1, q2));
     // Contribute the triangle normal into all 3 verts:
-    v0.norm = vec3(v0.norm) + norm;
-    v1.norm = vec3(v1.norm) + norm;
-    v2.norm = vec3(v2.norm) + norm;
+    normals[i0] += norm;
+    normals[i1] += norm;
+    normals[i2] += norm;
     // Similarly create uv space vectors:
-    auto uv1 = vec2(v1.tc) - vec2(v0.tc);
-    auto uv2 = vec2(v2.tc) - vec2(v0.tc);
+    auto uv1 = vec2(vertices[i1].tc) - vec2(vertices[i0].tc);
+    auto uv2 = vec2(vertices[i2].tc) - vec2(vertices[i0].tc);
     float m = 1 / (uv1.x() * uv2.y() - uv2.x() * uv1.y());
     auto tangent = vec4((uv2.y() * q1 - uv1.y() * q2) * m, 0);
     auto binorm = (uv1.x() * q2 - uv2.x() * q1) * m;
-    v0.tangent = vec4(v0.tangent) + tangent;
-    v1.tangent = vec4(v1.tangent) + tangent;
-    v2.tangent = vec4(v2.tangent) + tangent;
-    binormals[indices[i + 0]] = binorm;
-    binormals[indices[i + 1]] = binorm;
-    binormals[indices[i + 2]] = binorm;
+    tangents[i0] += tangent;
+    tangents[i1] += tangent;
+    tangents[i2] += tangent;
+    binormals[i0] = binorm;
+    binormals[i1] = binorm;
+    binormals[i2] = binorm;
   }
   // Normalize per vertex tangent space constributions, and pack tangent /
   // binormal into a 4 component tangent.
   for (int i = 0; i < numverts; i++) {
-    auto norm = vec3(vertices[i].norm);
-    auto tangent = vec4(vertices[i].tangent);
     // Renormalize all 3 axes:
-    norm = normalize(norm);
-    tangent = vec4(normalize(tangent.xyz()), 0);
+    auto norm = normalize(normals[i]);
+    auto tangent = vec4(normalize(tangents[i].xyz()), 0);
     binormals[i] = normalize(binormals[i]);
     tangent = vec4(
         // Gram-Schmidt orthogonalize xyz components:
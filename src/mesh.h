@@ -55,6 +55,9 @@ class Mesh {
   ~Mesh();
 
   // Create one IBO to be part of this mesh. May be called more than once.
+  // Index data following the standard quad pattern (kQuadIndices repeated
+  // with rebased vertices) shares one static IBO across all meshes instead
+  // of creating a buffer object per call.
   void AddIndices(const unsigned short *indices, int count, Material *mat);
 
   // Render itself. Uniforms must have been set before calling this.
@@ -63,12 +66,24 @@ class Mesh {
   // Get the material associated with the Nth IBO.
   Material *GetMaterial(int i) { return indices_[i].mat; }
 
-  // Renders primatives using vertex and index data directly in local memory.
-  // This is a convenient alternative to creating a Mesh instance for small
-  // amounts of data, or dynamic data.
+  // Convenience function for rendering a series of indexed primitives out of
+  // already-populated buffer objects instead of client-side arrays.
+  // index_offset is measured in indices (not bytes) into the index buffer,
+  // allowing several draws from different slices of a single ibo.
+  static void RenderArrayBuffered(GLenum primitive, int index_count,
+                                  const Attribute *format, int vertex_size,
+                                  GLuint vbo, GLuint ibo,
+                                  int index_offset = 0);
+
+  // Renders primitives from vertex and index data in local memory. This is
+  // a convenient alternative to creating a Mesh instance for small amounts
+  // of dynamic data. The data is streamed through a shared ring of orphaned
+  // buffer objects rather than drawn as client-side arrays, which several
+  // mobile drivers handle very badly.
   static void RenderArray(GLenum primitive, int index_count,
                           const Attribute *format, int vertex_size,
-                          const char *vertices, const unsigned short *indices);
+                          const char *vertices, int vertex_count,
+                          const unsigned short *indices);
 
   // Convenience method for rendering a Quad. bottom_left and top_right must
   // have their X coordinate be different, but either Y or Z can be the same.
@@ -76,6 +91,19 @@ class Mesh {
                                  const vec2 &tex_bottom_left = vec2(0, 0),
                                  const vec2 &tex_top_right = vec2(1, 1));
 
+  // Render 'count' copies of a textured quad with one draw call per ~16k
+  // instances. 'quad_vertices' holds the four untransformed corners of the
+  // quad (only pos and tc are used); each instance transforms those corners
+  // by its world matrix and tints them with its color.
+  // GLES2--our lowest-end target--has no instanced draw call, so instances
+  // are expanded into a single dynamic vertex array on the CPU. That still
+  // replaces N draw calls (and N uniform uploads) with one.
+  // The shader in use must consume the per-vertex color attribute, e.g.
+  // shaders/textured_colored.
+  static void RenderQuadBatch(const NormalMappedVertex *quad_vertices,
+                              const mathfu::mat4 *world_matrices,
+                              const mathfu::vec4 *colors, int count);
+
   // Compute normals and tangents given position and texcoords.
   static void ComputeNormalsTangents(NormalMappedVertex *vertices,
                                      const unsigned short *indices,
@@ -96,6 +124,7 @@ class Mesh {
   struct Indices {
     int count;
     GLuint ibo;
+    bool owns_ibo;  // False when ibo is the shared quad-pattern buffer.
     Material *mat;
   };
   std::vector<Indices> indices_;
@@ -22,8 +22,13 @@
 namespace fpl {
 namespace pie_noon {
 
+// Floor and headroom for the adaptive network grace window; see
+// NetworkGraceMilliseconds().
+static const WorldTime kMinNetworkGraceMilliseconds = 100;
+static const WorldTime kNetworkGraceHeadroomMilliseconds = 100;
+
 MultiplayerDirector::MultiplayerDirector()
-    : turn_timer_(0), debug_input_system_(nullptr) {}
+    : turn_timer_(0), playback_timer_(0), debug_input_system_(nullptr) {}
 
 void MultiplayerDirector::Initialize(GameState* gamestate,
                                      const Config* config) {
@@ -31,6 +36,7 @@ void MultiplayerDirector::Initialize(GameState* gamestate,
   config_ = config;
   turn_timer_ = 0;
   start_turn_timer_ = 0;
+  playback_timer_ = 0;
   seconds_per_turn_ =
       config_->multiscreen_options()->turn_length()->Get(0)->turn_seconds();
   turn_number_ = 0;
@@ -49,6 +55,7 @@ void MultiplayerDirector::StartGame() {
   game_running_ = true;
   turn_number_ = 0;
   turn_timer_ = 0;
+  playback_timer_ = 0;
   start_turn_timer_ =
       config_->multiscreen_options()->first_turn_delay_milliseconds();
   for (unsigned int i = 0; i < commands_.size(); i++) {
@@ -62,11 +69,18 @@ void MultiplayerDirector::StartGame() {
   for (unsigned int i = 0; i < character_splats_.size(); i++) {
     character_splats_[i] = 0;
   }
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  // Ack state is per game: until this game's clients acknowledge a full
+  // status, every status goes out full.
+  status_history_.clear();
+  acked_status_sequence_.assign(controllers_.size(), 0);
+#endif
 }
 
 void MultiplayerDirector::EndGame() {
   game_running_ = false;
   turn_timer_ = 0;
+  playback_timer_ = 0;
 }
 
 void MultiplayerDirector::AdvanceFrame(WorldTime delta_time) {
@@ -74,6 +88,11 @@ void MultiplayerDirector::AdvanceFrame(WorldTime delta_time) {
     DebugInput(debug_input_system_);
   }
 
+  if (playback_timer_ > 0) {
+    playback_timer_ -= delta_time;
+    if (playback_timer_ < 0) playback_timer_ = 0;
+  }
+
   if (start_turn_timer_ > 0) {
     start_turn_timer_ -= delta_time;
     if (start_turn_timer_ <= 0) {
@@ -87,6 +106,11 @@ void MultiplayerDirector::AdvanceFrame(WorldTime delta_time) {
       TriggerEndOfTurn();
     }
   }
+
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  // Everything queued above goes out as one payload.
+  FlushBroadcasts();
+#endif
 }
 
 void MultiplayerDirector::TriggerEndOfTurn() {
@@ -102,6 +126,9 @@ void MultiplayerDirector::TriggerEndOfTurn() {
     }
   }
 
+  // The longest scheduled action determines how long this turn's results
+  // take to play out on screen.
+  WorldTime playback_time = 0;
   for (int i = 0; i < static_cast<int>(controllers_.size()); i++) {
     int character_delay =
         i * config_->multiscreen_options()->char_delay_milliseconds();
@@ -119,11 +146,21 @@ void MultiplayerDirector::TriggerEndOfTurn() {
     }
     if (commands_[i].is_firing) {
       controllers_[i]->ThrowPie(pie_throw_delay + character_delay);
+      playback_time =
+          std::max(playback_time,
+                   static_cast<WorldTime>(pie_throw_delay + character_delay));
     } else if (commands_[i].is_blocking) {
       controllers_[i]->HoldBlock(blocking_delay + character_delay,
                                  blocking_hold);
+      playback_time = std::max(
+          playback_time, static_cast<WorldTime>(blocking_delay +
+                                                character_delay +
+                                                blocking_hold));
     } else {
       controllers_[i]->GrowPie(pie_grow_delay + character_delay);
+      playback_time =
+          std::max(playback_time,
+                   static_cast<WorldTime>(pie_grow_delay + character_delay));
     }
   }
 
@@ -132,13 +169,53 @@ void MultiplayerDirector::TriggerEndOfTurn() {
   }
 
   turn_timer_ = 0;
+  playback_timer_ = playback_time;
   if (debug_input_system_ == nullptr) {
-    // Schedule the next turn to start soon
-    start_turn_timer_ =
-        config_->multiscreen_options()->start_turn_delay_milliseconds();
+    if (config_->multiscreen_options()->pipeline_turns()) {
+      // Pipelined: start the next turn now, so the StartTurn broadcast
+      // leaves in the same payload as this turn's results and clients
+      // spend the playback window choosing their next commands instead
+      // of waiting through the start-turn delay plus a round trip.
+      TriggerStartOfTurn();
+    } else {
+      // Schedule the next turn to start soon
+      start_turn_timer_ =
+          config_->multiscreen_options()->start_turn_delay_milliseconds();
+    }
   }
 }
 
+WorldTime MultiplayerDirector::NetworkGraceMilliseconds() {
+  const WorldTime configured =
+      config_->multiscreen_options()->network_grace_milliseconds();
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  if (gpg_multiplayer_ != nullptr) {
+    // A turn's tail needs roughly one round trip: the StartTurn out plus
+    // the last command back. Take the worst client's conservative (p95)
+    // estimate; if any client hasn't been measured yet, keep the
+    // configured worst-case value.
+    int worst_rtt = -1;
+    const int num_players = gpg_multiplayer_->GetNumConnectedPlayers();
+    for (int i = 0; i < num_players; ++i) {
+      const std::string instance =
+          gpg_multiplayer_->GetInstanceIdByPlayerNumber(i);
+      if (instance.empty()) continue;  // Disconnected placeholder slot.
+      const int rtt = gpg_multiplayer_->GetInstanceRTT95(instance);
+      if (rtt < 0) return configured;
+      worst_rtt = std::max(worst_rtt, rtt);
+    }
+    if (worst_rtt >= 0) {
+      const WorldTime adaptive = static_cast<WorldTime>(worst_rtt) +
+                                 kNetworkGraceHeadroomMilliseconds;
+      // Never slower than the configured grace, never reckless either.
+      return std::min(configured,
+                      std::max(kMinNetworkGraceMilliseconds, adaptive));
+    }
+  }
+#endif  // PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  return configured;
+}
+
 unsigned int MultiplayerDirector::CalculateSecondsPerTurn(
     unsigned int turn_number) {
   for (auto turn_spec : *config_->multiscreen_options()->turn_length()) {
@@ -155,8 +232,13 @@ void MultiplayerDirector::TriggerStartOfTurn() {
   start_turn_timer_ = 0;
   turn_number_++;
   set_seconds_per_turn(CalculateSecondsPerTurn(turn_number_));
-  turn_timer_ = seconds_per_turn() * kMillisecondsPerSecond +
-                config_->multiscreen_options()->network_grace_milliseconds();
+  turn_timer_ =
+      seconds_per_turn() * kMillisecondsPerSecond + NetworkGraceMilliseconds();
+  // Cap pipelining at two turns in flight: this turn must not resolve
+  // before the previous turn's playback has finished, or late-game short
+  // turns would stack a third turn's actions on top of a block still
+  // being held.
+  turn_timer_ = std::max(turn_timer_, playback_timer_);
 #ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
   SendStartTurnMsg(seconds_per_turn());
 #endif
@@ -216,6 +298,19 @@ void MultiplayerDirector::InputPlayerCommand(
   command.is_firing = player_command.is_firing() != 0;
   command.is_blocking = player_command.is_blocking() != 0;
   commands_[id] = command;
+
+  // Optionally predict the aim part of the command right away. Aiming is
+  // cosmetic until the turn resolves, so applying it early gives the
+  // player immediate feedback on the shared screen; TriggerEndOfTurn
+  // re-applies the authoritative command, reconciling any later change.
+  // While the previous turn's playback is still running, a command is
+  // stored but not predicted, so one that raced the turn boundary can't
+  // re-aim a character whose pie is still in the air.
+  if (game_running_ && command.aim_at != kNoCharacter &&
+      playback_timer_ <= 0 &&
+      config_->multiscreen_options()->predict_player_aim()) {
+    controllers_[id]->AimAtCharacter(command.aim_at);
+  }
 }
 
 void MultiplayerDirector::ChooseAICommand(CharacterId id) {
@@ -497,7 +592,9 @@ void MultiplayerDirector::SendStartTurnMsg(unsigned int seconds) {
   flatbuffers::FlatBufferBuilder builder;
   auto health = builder.CreateVector(health_vec);
   auto splats = builder.CreateVector(splats_vec);
-  auto player_status = multiplayer::CreatePlayerStatus(builder, health, splats);
+  const unsigned short sequence = NextStatusSequence();
+  auto player_status =
+      multiplayer::CreatePlayerStatus(builder, health, splats, sequence);
   auto message_root = multiplayer::CreateMessageRoot(
       builder, multiplayer::Data_StartTurn,
       multiplayer::CreateStartTurn(builder, (unsigned short)seconds,
@@ -506,7 +603,13 @@ void MultiplayerDirector::SendStartTurnMsg(unsigned int seconds) {
 
   std::vector<uint8_t> message(builder.GetBufferPointer(),
                                builder.GetBufferPointer() + builder.GetSize());
-  gpg_multiplayer_->BroadcastMessage(message, true);
+  QueueBroadcastMsg(message, true);
+  // The embedded status supersedes any pending standalone status update.
+  player_status_dirty_ = false;
+  last_sent_health_ = health_vec;
+  last_sent_splats_ = splats_vec;
+  // Reliable and full: a natural delta baseline once the clients ack it.
+  RecordStatusSnapshot(sequence, health_vec, splats_vec);
 }
 
 void MultiplayerDirector::SendEndGameMsg() {
@@ -516,7 +619,9 @@ void MultiplayerDirector::SendEndGameMsg() {
   flatbuffers::FlatBufferBuilder builder;
   auto health = builder.CreateVector(health_vec);
   auto splats = builder.CreateVector(splats_vec);
-  auto player_status = multiplayer::CreatePlayerStatus(builder, health, splats);
+  auto player_status = multiplayer::CreatePlayerStatus(builder, health, splats,
+                                                       NextStatusSequence());
+  // No snapshot recorded: the game is over, nothing will delta against it.
   auto message_root = multiplayer::CreateMessageRoot(
       builder, multiplayer::Data_EndGame,
       multiplayer::CreateEndGame(builder, player_status).Union());
@@ -524,24 +629,173 @@ void MultiplayerDirector::SendEndGameMsg() {
 
   std::vector<uint8_t> message(builder.GetBufferPointer(),
                                builder.GetBufferPointer() + builder.GetSize());
-  gpg_multiplayer_->BroadcastMessage(message, true);
+  QueueBroadcastMsg(message, true);
+  player_status_dirty_ = false;
+  last_sent_health_ = health_vec;
+  last_sent_splats_ = splats_vec;
+  // The game is ending, so there may not be another AdvanceFrame to flush
+  // on our behalf; send right away.
+  FlushBroadcasts();
 }
 
 void MultiplayerDirector::SendPlayerStatusMsg() {
-  std::vector<uint8_t> health_vec = ReadPlayerHealth();
-  std::vector<uint8_t> splats_vec = ReadPlayerSplats();
+  // Just note that status needs to go out; FlushBroadcasts() reads the
+  // actual health/splats once per frame, so several pie hits in one frame
+  // cost a single message (and none at all if nothing really changed).
+  player_status_dirty_ = true;
+}
 
-  flatbuffers::FlatBufferBuilder builder;
-  auto health = builder.CreateVector(health_vec);
-  auto splats = builder.CreateVector(splats_vec);
-  auto message_root = multiplayer::CreateMessageRoot(
-      builder, multiplayer::Data_PlayerStatus,
-      multiplayer::CreatePlayerStatus(builder, health, splats).Union());
-  builder.Finish(message_root);
+void MultiplayerDirector::ReceiveStatusAck(CharacterId player,
+                                           unsigned short sequence) {
+  if (player < 0 ||
+      player >= static_cast<CharacterId>(acked_status_sequence_.size()) ||
+      sequence == 0) {
+    return;
+  }
+  // Acks ride the unreliable channel too; keep only the newest.
+  unsigned short& acked = acked_status_sequence_[player];
+  if (acked == 0 || static_cast<int16_t>(sequence - acked) > 0) {
+    acked = sequence;
+  }
+}
 
-  std::vector<uint8_t> message(builder.GetBufferPointer(),
-                               builder.GetBufferPointer() + builder.GetSize());
-  gpg_multiplayer_->BroadcastMessage(message, false);  // Send unreliably.
+void MultiplayerDirector::RecordStatusSnapshot(
+    unsigned short sequence, const std::vector<uint8_t>& health,
+    const std::vector<uint8_t>& splats) {
+  // A handful of entries is plenty: a baseline more than this many full
+  // sends old will never become the common ack.
+  static const size_t kStatusHistoryLimit = 8;
+  StatusSnapshot snapshot;
+  snapshot.sequence = sequence;
+  snapshot.health = health;
+  snapshot.splats = splats;
+  status_history_.push_back(snapshot);
+  if (status_history_.size() > kStatusHistoryLimit) {
+    status_history_.erase(status_history_.begin());
+  }
+}
+
+const MultiplayerDirector::StatusSnapshot*
+MultiplayerDirector::CommonAckedBaseline() {
+  // The baseline must be acknowledged by every human player; AI players
+  // run on the host and never ack. Any human player who hasn't acked a
+  // full status yet means no baseline (and full sends).
+  bool have_min = false;
+  unsigned short min_acked = 0;
+  for (size_t i = 0; i < acked_status_sequence_.size(); ++i) {
+    if (IsAIPlayer(static_cast<CharacterId>(i))) continue;
+    const unsigned short acked = acked_status_sequence_[i];
+    if (acked == 0) return nullptr;
+    if (!have_min || static_cast<int16_t>(acked - min_acked) < 0) {
+      min_acked = acked;
+      have_min = true;
+    }
+  }
+  if (!have_min) return nullptr;
+  // The newest recorded full status at or before the common ack.
+  for (size_t i = status_history_.size(); i-- > 0;) {
+    if (static_cast<int16_t>(status_history_[i].sequence - min_acked) <= 0) {
+      return &status_history_[i];
+    }
+  }
+  return nullptr;
+}
+
+void MultiplayerDirector::QueueBroadcastMsg(const std::vector<uint8_t>& message,
+                                            bool reliable) {
+  pending_broadcasts_.push_back(message);
+  if (reliable) pending_broadcasts_reliable_ = true;
+}
+
+void MultiplayerDirector::FlushBroadcasts() {
+  if (player_status_dirty_) {
+    player_status_dirty_ = false;
+    std::vector<uint8_t> health_vec = ReadPlayerHealth();
+    std::vector<uint8_t> splats_vec = ReadPlayerSplats();
+    // A status identical to the last one sent carries no information;
+    // drop it rather than waking the radio for it.
+    if (health_vec != last_sent_health_ || splats_vec != last_sent_splats_) {
+      // If every client has acknowledged a full status, send only the
+      // players that differ from it. An empty delta still means the state
+      // differs from the last send (someone reverted to the baseline
+      // value), so fall back to a full status rather than sending nothing.
+      const StatusSnapshot *baseline = CommonAckedBaseline();
+      std::vector<uint8_t> changed;
+      std::vector<uint8_t> delta_health;
+      std::vector<uint8_t> delta_splats;
+      if (baseline != nullptr && baseline->health.size() == health_vec.size() &&
+          baseline->splats.size() == splats_vec.size()) {
+        for (size_t i = 0; i < health_vec.size(); ++i) {
+          if (health_vec[i] != baseline->health[i] ||
+              splats_vec[i] != baseline->splats[i]) {
+            changed.push_back(static_cast<uint8_t>(i));
+            delta_health.push_back(health_vec[i]);
+            delta_splats.push_back(splats_vec[i]);
+          }
+        }
+      }
+      const bool send_delta = baseline != nullptr && !changed.empty() &&
+                              changed.size() < health_vec.size();
+
+      flatbuffers::FlatBufferBuilder builder;
+      const unsigned short sequence = NextStatusSequence();
+      flatbuffers::Offset<multiplayer::PlayerStatus> player_status;
+      if (send_delta) {
+        player_status = multiplayer::CreatePlayerStatus(
+            builder, builder.CreateVector(delta_health),
+            builder.CreateVector(delta_splats), sequence, baseline->sequence,
+            builder.CreateVector(changed));
+      } else {
+        player_status = multiplayer::CreatePlayerStatus(
+            builder, builder.CreateVector(health_vec),
+            builder.CreateVector(splats_vec), sequence);
+      }
+      auto message_root = multiplayer::CreateMessageRoot(
+          builder, multiplayer::Data_PlayerStatus, player_status.Union());
+      builder.Finish(message_root);
+
+      std::vector<uint8_t> message(
+          builder.GetBufferPointer(),
+          builder.GetBufferPointer() + builder.GetSize());
+      QueueBroadcastMsg(message, false);  // Status alone can go unreliably.
+      if (!send_delta) {
+        RecordStatusSnapshot(sequence, health_vec, splats_vec);
+      }
+      last_sent_health_ = health_vec;
+      last_sent_splats_ = splats_vec;
+    }
+  }
+
+  if (pending_broadcasts_.empty()) return;
+
+  if (pending_broadcasts_.size() == 1) {
+    gpg_multiplayer_->BroadcastMessage(pending_broadcasts_[0],
+                                       pending_broadcasts_reliable_);
+  } else {
+    // Several messages this frame: pack the finished buffers into a
+    // MessageBatch so they share one send.
+    flatbuffers::FlatBufferBuilder builder;
+    std::vector<flatbuffers::Offset<multiplayer::MessagePayload>> payloads;
+    payloads.reserve(pending_broadcasts_.size());
+    for (auto it = pending_broadcasts_.begin();
+         it != pending_broadcasts_.end(); ++it) {
+      payloads.push_back(
+          multiplayer::CreateMessagePayload(builder,
+                                            builder.CreateVector(*it)));
+    }
+    auto message_root = multiplayer::CreateMessageRoot(
+        builder, multiplayer::Data_MessageBatch,
+        multiplayer::CreateMessageBatch(builder, builder.CreateVector(payloads))
+            .Union());
+    builder.Finish(message_root);
+
+    std::vector<uint8_t> message(
+        builder.GetBufferPointer(),
+        builder.GetBufferPointer() + builder.GetSize());
+    gpg_multiplayer_->BroadcastMessage(message, pending_broadcasts_reliable_);
+  }
+  pending_broadcasts_.clear();
+  pending_broadcasts_reliable_ = false;
 }
 
 #endif  // PIE_NOON_USES_GOOGLE_PLAY_GAMES
@@ -74,8 +74,15 @@ class MultiplayerDirector {
   void SendStartTurnMsg(unsigned int turn_seconds);
   // Broadcast end-of-game message to the players.
   void SendEndGameMsg();
-  // Broadcast player health to the players.
+  // Broadcast player health to the players. The status isn't sent right
+  // away; it's coalesced with everything else queued this frame, and
+  // dropped entirely if nothing changed since the last send.
   void SendPlayerStatusMsg();
+  // A client acknowledged applying the full status with this sequence
+  // number. Once every human player has acknowledged a full status,
+  // standalone statuses go out as deltas against it instead of repeating
+  // every player's state.
+  void ReceiveStatusAck(CharacterId player, unsigned short sequence);
 #endif
 
   // Takes effect when the next turn starts.
@@ -122,6 +129,12 @@ class MultiplayerDirector {
   void TriggerEndOfTurn();
   unsigned int CalculateSecondsPerTurn(unsigned int turn_number);
 
+  // Extra milliseconds to wait at the end of a turn for the clients'
+  // commands to arrive. Adapts to the transport's measured round-trip
+  // times when they're available; the configured
+  // network_grace_milliseconds is the ceiling and the fallback.
+  WorldTime NetworkGraceMilliseconds();
+
   // Get all the players' healths so we can send them in an update
   std::vector<uint8_t> ReadPlayerHealth();
 
@@ -133,6 +146,44 @@ class MultiplayerDirector {
   // Get all the players' onscreen splats to send in an update
   std::vector<uint8_t> ReadPlayerSplats();
 
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+  // Add a finished MessageRoot buffer to this frame's outgoing batch.
+  void QueueBroadcastMsg(const std::vector<uint8_t> &message, bool reliable);
+
+  // Send everything queued this frame as a single payload. Multiple
+  // messages get wrapped in a MessageBatch; a lone message goes out as-is.
+  // Called once per AdvanceFrame.
+  void FlushBroadcasts();
+
+  // Next sequence number for an outgoing PlayerStatus. Standalone statuses
+  // go out unreliably, so clients use the sequence to keep only the newest;
+  // 0 is reserved to mean "unsequenced" and is skipped on wraparound.
+  unsigned short NextStatusSequence() {
+    if (++status_sequence_ == 0) ++status_sequence_;
+    return status_sequence_;
+  }
+
+  // The state a full status carried when it was sent, kept until every
+  // client has acknowledged a newer one. Deltas are computed against
+  // these.
+  struct StatusSnapshot {
+    unsigned short sequence;
+    std::vector<uint8_t> health;
+    std::vector<uint8_t> splats;
+  };
+
+  // Remember a full status that just went out, so it can serve as a delta
+  // baseline once the clients acknowledge it.
+  void RecordStatusSnapshot(unsigned short sequence,
+                            const std::vector<uint8_t> &health,
+                            const std::vector<uint8_t> &splats);
+
+  // The newest recorded full status that every human player has
+  // acknowledged, or nullptr if there isn't one yet (then statuses go out
+  // full).
+  const StatusSnapshot *CommonAckedBaseline();
+#endif
+
   GameState *gamestate_;  // Pointer to the gamestate object
   const Config *config_;  // Pointer to the config structure
 
@@ -142,6 +193,12 @@ class MultiplayerDirector {
   WorldTime turn_timer_;
   // In how long to start the next turn.
   WorldTime start_turn_timer_;
+  // How long the previous turn's actions still need to play out on the
+  // host's screen. With pipeline_turns enabled the next turn runs while
+  // this counts down; commands arriving during playback are stored as
+  // usual but not aim-predicted, so a late command can't re-aim a
+  // character whose last-turn action is still resolving.
+  WorldTime playback_timer_;
   unsigned int seconds_per_turn_;
   unsigned int turn_number_;
 
@@ -153,6 +210,34 @@ class MultiplayerDirector {
 
 #ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
   GPGMultiplayer *gpg_multiplayer_ = nullptr;
+
+  // Messages queued for this frame's single broadcast, and whether any of
+  // them need a reliable send.
+  std::vector<std::vector<uint8_t>> pending_broadcasts_;
+  bool pending_broadcasts_reliable_ = false;
+
+  // Set when player status should go out this frame; the status itself is
+  // read at flush time so several hits in one frame cost one message.
+  bool player_status_dirty_ = false;
+
+  // Last health/splats actually sent, so unchanged status updates can be
+  // dropped instead of re-broadcast.
+  std::vector<uint8_t> last_sent_health_;
+  std::vector<uint8_t> last_sent_splats_;
+
+  // Sequence counter for outgoing PlayerStatus messages; see
+  // NextStatusSequence().
+  unsigned short status_sequence_ = 0;
+
+  // Recent full statuses, oldest first, kept as candidate delta
+  // baselines. Bounded: entries older than the last common ack are
+  // useless and get trimmed.
+  std::vector<StatusSnapshot> status_history_;
+
+  // Per player, the sequence of the newest full status that client has
+  // acknowledged; 0 means none yet. AI players run on the host and never
+  // ack; they're skipped when computing the common baseline.
+  std::vector<unsigned short> acked_status_sequence_;
 #endif
 
   bool game_running_;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "particles.h"
 
 namespace fpl {
@@ -64,40 +65,55 @@ mathfu::vec3 Particle::CurrentScale() const {
               : 1.0f);
 }
 
+ParticleManager::ParticleManager() {
+  // Reserve the whole pool up front so CreateParticle never reallocates
+  // (and so pointers it returns stay valid while the caller populates them).
+  particles_.reserve(kMaxParticles);
+}
+
 void ParticleManager::AdvanceFrame(TimeStep delta_time) {
-  for (auto it = particle_list_.begin(); it != particle_list_.end();) {
-    (*it)->AdvanceFrame(delta_time);
-    if ((*it)->IsFinished()) {
-      inactive_particle_list_.push_back(*it);
-      it = particle_list_.erase(it);
+  // Swap-remove keeps the live particles dense. When a particle expires,
+  // the last particle takes its slot and the loop revisits that slot, so
+  // nothing gets advanced twice or skipped.
+  for (size_t i = 0; i < particles_.size();) {
+    particles_[i].AdvanceFrame(delta_time);
+    if (particles_[i].IsFinished()) {
+      particles_[i] = particles_.back();
+      particles_.pop_back();
     } else {
-      ++it;
+      ++i;
     }
   }
 }
 
 Particle* ParticleManager::CreateParticle() {
-  Particle* result;
-  if (inactive_particle_list_.size() > 0) {
-    result = inactive_particle_list_.back();
-    inactive_particle_list_.pop_back();
-  } else {
-    if (particle_list_.size() >= kMaxParticles) {
-      return nullptr;
-    }
-    result = new Particle();
+  if (particles_.size() >= kMaxParticles) {
+    return nullptr;
   }
+  particles_.push_back(Particle());
+  Particle* result = &particles_.back();
   result->set_age(0);
-  particle_list_.push_back(result);
   return result;
 }
 
-void ParticleManager::RemoveAllParticles() {
-  for (auto it = particle_list_.begin(); it != particle_list_.end();) {
-    inactive_particle_list_.push_back(*it);
-    it = particle_list_.erase(it);
+Particle* ParticleManager::CreateParticles(int count, int* created) {
+  const int available = kMaxParticles - static_cast<int>(particles_.size());
+  const int n = std::min(count, available);
+  *created = n;
+  if (n <= 0) {
+    return nullptr;
   }
+  // The full pool is reserved in the constructor, so resizing within it
+  // never reallocates and the returned pointer spans all n particles.
+  particles_.resize(particles_.size() + n);
+  Particle* first = &particles_[particles_.size() - n];
+  for (int i = 0; i < n; ++i) {
+    first[i].set_age(0);
+  }
+  return first;
 }
 
+void ParticleManager::RemoveAllParticles() { particles_.clear(); }
+
 }  // pie_noon
 }  // fpl
@@ -17,7 +17,7 @@
 
 #include "common.h"
 #include "scene_description.h"
-#include <list>
+#include <vector>
 
 namespace fpl {
 namespace pie_noon {
@@ -129,25 +129,37 @@ class Particle {
 
 class ParticleManager {
  public:
+  ParticleManager();
+
   void AdvanceFrame(TimeStep delta_time);
 
-  const std::list<Particle*>& get_particle_list() const {
-    return particle_list_;
-  }
+  // The dense array of live particles. Iteration order is not meaningful:
+  // expired particles are swap-removed, so ordering changes between frames.
+  const std::vector<Particle>& particles() const { return particles_; }
 
-  // Returns a pointer to a new particle, ready to be populated.
+  // Returns a pointer to a new particle, ready to be populated, or nullptr
+  // if the pool is full.
   // Note that this pointer is not guaranteed to be valid indefinitely!
   // Also note that the initial state of the particle is undetermined, so
   // users should either populate every field explicitly, or call
   // Particle::reset().
   Particle* CreateParticle();
 
+  // Allocates up to 'count' particles in one contiguous run, returning a
+  // pointer to the first and writing the number actually allocated (the
+  // pool may be nearly full) to 'created'. Returns nullptr when the pool
+  // is full. The same caveats as CreateParticle apply: the particles'
+  // initial state is undetermined and the pointer is only valid until the
+  // next AdvanceFrame.
+  Particle* CreateParticles(int count, int* created);
+
   // Removes all active particles.
   void RemoveAllParticles();
 
  private:
-  std::list<Particle*> particle_list_;
-  std::list<Particle*> inactive_particle_list_;
+  // Live particles, stored contiguously so the per-frame update streams
+  // straight through memory instead of chasing list nodes.
+  std::vector<Particle> particles_;
 };
 
 }  // pie_noon
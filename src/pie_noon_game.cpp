@@ -13,7 +13,12 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#if !defined(__ANDROID__)
+#include <sys/stat.h>
+#endif  // !defined(__ANDROID__)
+#include <thread>
 #include "SDL_timer.h"
+#include "alloc_tracker.h"
 #include "analytics_tracking.h"
 #include "audio_config_generated.h"
 #include "character_state_machine.h"
@@ -49,6 +54,42 @@ namespace pie_noon {
 static const int kQuadNumVertices = 4;
 static const int kQuadNumIndices = 6;
 
+// Cap on texture bytes uploaded to the GPU per frame while finalizing async
+// loads: roughly one 1024x512 RGBA texture. Keeps a burst of textures
+// finishing together from hitching a single frame.
+static const size_t kTextureUploadBudgetPerFrame = 2 * 1024 * 1024;
+
+// Queue priority for the handful of materials the loading screen itself
+// needs; everything else loads at the default priority of 0.
+static const int kLoadingScreenPriority = 1;
+
+// Most simulation steps the fixed-timestep loop will run in one frame.
+// Backlog beyond this is dropped, so a long hitch degrades to brief slow
+// motion instead of a spiral of ever-longer updates.
+static const int kMaxSimStepsPerFrame = 4;
+
+// Minimum time between hitch capture reports. One hitch usually arrives as
+// a cluster of slow frames, and each report already covers the profiler's
+// whole recent history.
+static const WorldTime kMinHitchCaptureInterval = 5000;
+
+static const char* kCategoryPerformance = "Performance";
+static const char* kActionFrameHitch = "Frame hitch";
+static const char* kLabelFrameMs = "Frame ms";
+static const char* kActionFramePacing = "Frame pacing";
+static const char* kLabelP50Ms = "p50 ms";
+static const char* kLabelP95Ms = "p95 ms";
+static const char* kLabelP99Ms = "p99 ms";
+static const char* kLabelHitchCount = "Hitch count";
+
+// How often the frame pacing summary is pushed through the analytics
+// layer; see ReportFramePacing.
+static const WorldTime kFramePacingReportInterval = 60 * 1000;
+
+// Hitch threshold for the pacing stats when the config's capture
+// threshold is disabled: two 60Hz frames.
+static const float kDefaultHitchThresholdMs = 33.0f;
+
 static const char* kCategoryUi = "Ui";
 static const char* kActionClickedButton = "Clicked button";
 static const char* kActionViewedTutorialSlide = "Viewed tutorial slide";
@@ -92,6 +133,14 @@ static const char kAssetsDir[] = "assets";
 
 static const char kConfigFileName[] = "config.bin";
 
+// How often desktop builds poll config.bin's modification time so that
+// edited tuning values can be hot reloaded without restarting.
+static const WorldTime kConfigPollPeriod = 1000;
+
+// Optional one-file bundle of the assets directory, built by
+// `scripts/build_assets.py bundle`. Must match ASSET_BUNDLE_NAME there.
+static const char kAssetBundleFileName[] = "asset_bundle.bin";
+
 #ifdef ANDROID_CARDBOARD
 static const char kCardboardConfigFileName[] = "cardboard_config.bin";
 #endif
@@ -127,24 +176,36 @@ static const char kVersion[] = "Pie Noon 1.1.0";
 PieNoonGame::PieNoonGame()
     : state_(kUninitialized),
       state_entry_time_(0),
+      config_mtime_(0),
+      next_config_poll_time_(0),
       matman_(renderer_),
       cardboard_fronts_(RenderableId_Count, nullptr),
       cardboard_backs_(RenderableId_Count, nullptr),
       stick_front_(nullptr),
       stick_back_(nullptr),
+      shader_cardboard_flat_(nullptr),
       shader_lit_textured_normal_(nullptr),
       shader_simple_shadow_(nullptr),
       shader_textured_(nullptr),
+      shader_textured_colored_(nullptr),
       shader_grayscale_(nullptr),
       shadow_mat_(nullptr),
+      merged_props_version_(0),
+      scene_write_buffer_(0),
       prev_world_time_(0),
+      sim_time_accumulator_(0),
       debug_previous_states_(),
       full_screen_fader_(&renderer_),
       fade_exit_state_(kUninitialized),
       ambience_channel_(nullptr),
       stinger_channel_(nullptr),
       music_channel_(nullptr),
-      next_achievement_index_(0) {
+      sounds_prewarmed_(false),
+      next_achievement_index_(0),
+      show_profiler_hud_(false),
+      hitch_captures_(0),
+      last_hitch_capture_time_(0),
+      next_pacing_report_time_(0) {
   version_ = kVersion;
 }
 
@@ -162,19 +223,124 @@ PieNoonGame::~PieNoonGame() {
 
   delete stick_back_;
   stick_back_ = nullptr;
+
+  for (size_t i = 0; i < merged_prop_meshes_.size(); ++i) {
+    delete merged_prop_meshes_[i].front;
+    delete merged_prop_meshes_[i].back;
+  }
+}
+
+// Modification time of the config file, or 0 when it can't be queried
+// (e.g. the config was served from the asset bundle or an apk).
+static time_t ConfigFileMtime() {
+#if !defined(__ANDROID__)
+  struct stat file_stat;
+  if (stat(kConfigFileName, &file_stat) == 0) return file_stat.st_mtime;
+#endif  // !defined(__ANDROID__)
+  return 0;
+}
+
+// Returns true when the two configs describe identical character
+// arrangements. Used by the hot-reload path to decide whether the change
+// requires a GameState::Reset (which restarts the current round) or can
+// take effect in place.
+static bool CharacterArrangementsEqual(const Config& a, const Config& b) {
+  const auto arrangements_a = a.character_arrangements();
+  const auto arrangements_b = b.character_arrangements();
+  if (arrangements_a->Length() != arrangements_b->Length()) return false;
+  for (unsigned int i = 0; i < arrangements_a->Length(); ++i) {
+    const auto characters_a = arrangements_a->Get(i)->character_data();
+    const auto characters_b = arrangements_b->Get(i)->character_data();
+    if (characters_a->Length() != characters_b->Length()) return false;
+    for (unsigned int j = 0; j < characters_a->Length(); ++j) {
+      const CharacterData* character_a = characters_a->Get(j);
+      const CharacterData* character_b = characters_b->Get(j);
+      if (LoadVec3(character_a->position()) !=
+              LoadVec3(character_b->position()) ||
+          character_a->left_jump() != character_b->left_jump()) {
+        return false;
+      }
+    }
+  }
+  return true;
 }
 
 bool PieNoonGame::InitializeConfig() {
-  if (!LoadFile(kConfigFileName, &config_source_)) {
+  if (!LoadFileMapped(kConfigFileName, &config_source_)) {
     SDL_LogError(SDL_LOG_CATEGORY_ERROR, "can't load config.bin\n");
     return false;
   }
+  // Verify the buffer on the first launch after an install; later launches
+  // find its hash in the verification cache and skip the walk.
+  const uint64_t hash =
+      HashBufferContents(config_source_.data(), config_source_.length());
+  if (!BufferPreviouslyVerified(hash)) {
+    flatbuffers::Verifier verifier(
+        reinterpret_cast<const uint8_t*>(config_source_.data()),
+        config_source_.length());
+    if (!VerifyConfigBuffer(verifier)) {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR, "config.bin failed verification\n");
+      return false;
+    }
+    RememberVerifiedBuffer(hash);
+  }
+  config_mtime_ = ConfigFileMtime();
   return true;
 }
 
+void PieNoonGame::CheckConfigHotReload(WorldTime world_time) {
+  // A zero mtime means there is no file to watch (bundled assets).
+  if (config_mtime_ == 0 || world_time < next_config_poll_time_) return;
+  next_config_poll_time_ = world_time + kConfigPollPeriod;
+
+  const time_t new_mtime = ConfigFileMtime();
+  if (new_mtime == 0 || new_mtime == config_mtime_) return;
+  config_mtime_ = new_mtime;
+
+  // Map the new buffer and verify it before touching anything; a malformed
+  // buffer (e.g. a build_assets run caught mid-write) leaves the running
+  // config untouched until the next poll sees another mtime change.
+  MappedFile new_source;
+  if (!LoadFileMapped(kConfigFileName, &new_source)) return;
+  flatbuffers::Verifier verifier(
+      reinterpret_cast<const uint8_t*>(new_source.data()),
+      new_source.length());
+  if (!VerifyConfigBuffer(verifier)) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "config.bin changed but failed verification; not reloading\n");
+    return;
+  }
+
+  const bool arrangements_changed = !CharacterArrangementsEqual(
+      GetConfig(), *fpl::pie_noon::GetConfig(new_source.data()));
+
+  // Retire the old buffer instead of freeing it: subsystems hold pointers
+  // into the buffer they were set up with and re-read the config at their
+  // own pace (e.g. GuiMenu on the next Setup).
+  retired_config_sources_.push_back(
+      std::unique_ptr<MappedFile>(new MappedFile()));
+  config_source_.Swap(retired_config_sources_.back().get());
+  config_source_.Swap(&new_source);
+
+  // GetConfig() now returns the new buffer; re-derive the dependent state
+  // that is cached rather than read per frame. Arrangement changes are the
+  // expensive case: characters sit at positions baked in by Reset, so only
+  // then do we pay for (and disrupt play with) a round restart.
+  const Config& config = GetConfig();
+  game_state_.set_config(&config);
+  // Pooled menu pages point into the retired buffer; drop them so menus
+  // rebuild from the new one on their next visit.
+  gui_menu_.ClearPagePool();
+  if (arrangements_changed) game_state_.Reset();
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "config.bin hot reloaded%s\n",
+              arrangements_changed ? " (arrangements changed; round reset)"
+                                   : "");
+}
+
 #ifdef ANDROID_CARDBOARD
 bool PieNoonGame::InitializeCardboardConfig() {
-  if (!LoadFile(kCardboardConfigFileName, &cardboard_config_source_)) {
+  if (!LoadFileMapped(kCardboardConfigFileName, &cardboard_config_source_)) {
     SDL_LogError(SDL_LOG_CATEGORY_ERROR, "can't load %s\n",
                  kCardboardConfigFileName);
     return false;
@@ -243,7 +409,8 @@ static void CreateVerticalQuad(const vec3& offset, const vec2& geo_size,
 // Returns a mesh with the quad and texture, or nullptr if anything went wrong.
 Mesh* PieNoonGame::CreateVerticalQuadMesh(
     const flatbuffers::String* material_name, const vec3& offset,
-    const vec2& pixel_bounds, float pixel_to_world_scale) {
+    const vec2& pixel_bounds, float pixel_to_world_scale,
+    NormalMappedVertex* out_vertices) {
   // Don't try to load obviously invalid materials. Suppresses error logs from
   // the material manager.
   if (material_name == nullptr || material_name->c_str()[0] == '\0')
@@ -267,6 +434,12 @@ Mesh* PieNoonGame::CreateVerticalQuadMesh(
   NormalMappedVertex vertices[kQuadNumVertices];
   CreateVerticalQuad(offset, geo_size, texture_coord_size, vertices);
 
+  // Give the caller a copy of the untransformed geometry, for render paths
+  // that bypass the VBO (e.g. the instanced quad batches).
+  if (out_vertices != nullptr) {
+    memcpy(out_vertices, vertices, sizeof(vertices));
+  }
+
   // Create mesh and add in quad indices.
   Mesh* mesh = new Mesh(vertices, kQuadNumVertices, sizeof(NormalMappedVertex),
                         kQuadMeshFormat);
@@ -288,15 +461,30 @@ bool PieNoonGame::InitializeRenderingAssets() {
     return false;
   }
 
-  // Force these textures to be queued up first, since we want to use them for
-  // the loading screen.
-  matman_.LoadMaterial(config.loading_material()->c_str());
-  matman_.LoadMaterial(config.loading_logo()->c_str());
-  matman_.LoadMaterial(config.fade_material()->c_str());
+  // Amortize texture uploads over several frames so finalization bursts
+  // don't hitch the loading screen (or mid-game loads).
+  matman_.set_finalize_budget(kTextureUploadBudgetPerFrame);
+
+  // Keep resident texture bytes under the config's GPU budget. Sessions
+  // that visit everything (tutorial, menus, multiscreen, gameplay) used to
+  // accumulate every texture ever touched until small devices hit
+  // GL_OUT_OF_MEMORY; now whatever fell out of use ages out and reloads
+  // through the async path if it comes back.
+  matman_.set_gpu_texture_budget(
+      static_cast<size_t>(config.gpu_texture_budget_kb()) * 1024);
+
+  // Queue these textures at elevated priority, since we want to use them for
+  // the loading screen before anything else has finished.
+  matman_.LoadMaterial(config.loading_material()->c_str(),
+                       kLoadingScreenPriority);
+  matman_.LoadMaterial(config.loading_logo()->c_str(), kLoadingScreenPriority);
+  matman_.LoadMaterial(config.fade_material()->c_str(), kLoadingScreenPriority);
 
   // Create a mesh for the front and back of each cardboard cutout.
   const vec3 front_z_offset(0.0f, 0.0f, config.cardboard_front_z_offset());
   const vec3 back_z_offset(0.0f, 0.0f, config.cardboard_back_z_offset());
+  cardboard_front_vertices_.resize(RenderableId_Count * kQuadNumVertices);
+  cardboard_back_vertices_.resize(RenderableId_Count * kQuadNumVertices);
   for (int id = 0; id < RenderableId_Count; ++id) {
     auto renderable = config.renderables()->Get(id);
     const vec3 offset = renderable->offset() == nullptr
@@ -311,13 +499,14 @@ bool PieNoonGame::InitializeRenderingAssets() {
     const float pixel_to_world_scale =
         renderable->geometry_scale() * config.pixel_to_world_scale();
 
-    cardboard_fronts_[id] =
-        CreateVerticalQuadMesh(renderable->cardboard_front(), front_offset,
-                               pixel_bounds, pixel_to_world_scale);
+    cardboard_fronts_[id] = CreateVerticalQuadMesh(
+        renderable->cardboard_front(), front_offset, pixel_bounds,
+        pixel_to_world_scale,
+        &cardboard_front_vertices_[id * kQuadNumVertices]);
 
-    cardboard_backs_[id] =
-        CreateVerticalQuadMesh(renderable->cardboard_back(), back_offset,
-                               pixel_bounds, pixel_to_world_scale);
+    cardboard_backs_[id] = CreateVerticalQuadMesh(
+        renderable->cardboard_back(), back_offset, pixel_bounds,
+        pixel_to_world_scale, &cardboard_back_vertices_[id * kQuadNumVertices]);
   }
 
   // We default to the invalid texture, so it has to exist.
@@ -331,22 +520,67 @@ bool PieNoonGame::InitializeRenderingAssets() {
                                 config.stick_front_z_offset());
   const vec3 stick_back_offset(0.0f, config.stick_y_offset(),
                                config.stick_back_z_offset());
+  NormalMappedVertex stick_vertices[kQuadNumVertices];
   stick_front_ = CreateVerticalQuadMesh(
       config.stick_front(), stick_front_offset, LoadVec2(config.stick_bounds()),
-      config.pixel_to_world_scale());
+      config.pixel_to_world_scale(), stick_vertices);
   stick_back_ = CreateVerticalQuadMesh(config.stick_back(), stick_back_offset,
                                        LoadVec2(config.stick_bounds()),
                                        config.pixel_to_world_scale());
 
+  // Compute a local-space bounding sphere for each renderable from its quad
+  // geometry, so off-screen renderables can be frustum culled at render
+  // time. The sphere encloses the front quad and, when the renderable is
+  // propped up by a popsicle stick, the stick too.
+  renderable_bounds_.assign(RenderableId_Count, mathfu::kZeros4f);
+  for (int id = 0; id < RenderableId_Count; ++id) {
+    // Ids without a front mesh render the pajama quad, so bound that.
+    const int source_id =
+        cardboard_fronts_[id] != nullptr ? id : RenderableId_Invalid;
+    const NormalMappedVertex* verts =
+        &cardboard_front_vertices_[source_id * kQuadNumVertices];
+    vec3 min_point(verts[0].pos);
+    vec3 max_point(min_point);
+    for (int i = 1; i < kQuadNumVertices; ++i) {
+      const vec3 p(verts[i].pos);
+      min_point = vec3(std::min(min_point.x(), p.x()),
+                       std::min(min_point.y(), p.y()),
+                       std::min(min_point.z(), p.z()));
+      max_point = vec3(std::max(max_point.x(), p.x()),
+                       std::max(max_point.y(), p.y()),
+                       std::max(max_point.z(), p.z()));
+    }
+    if (config.renderables()->Get(id)->stick() && stick_front_ != nullptr) {
+      for (int i = 0; i < kQuadNumVertices; ++i) {
+        const vec3 p(stick_vertices[i].pos);
+        min_point = vec3(std::min(min_point.x(), p.x()),
+                         std::min(min_point.y(), p.y()),
+                         std::min(min_point.z(), p.z()));
+        max_point = vec3(std::max(max_point.x(), p.x()),
+                         std::max(max_point.y(), p.y()),
+                         std::max(max_point.z(), p.z()));
+      }
+    }
+    const vec3 center = (min_point + max_point) * 0.5f;
+    const float radius = ((max_point - min_point) * 0.5f).Length();
+    renderable_bounds_[id] = vec4(center, radius);
+  }
+
   // Load all shaders we use:
   shader_lit_textured_normal_ =
       matman_.LoadShader("shaders/lit_textured_normal");
-  shader_cardboard = matman_.LoadShader("shaders/cardboard");
+  // The normal-mapped variant is the common case; the flat variant binds
+  // for any cardboard material that ships without a normal map.
+  shader_cardboard = matman_.LoadShader(
+      "shaders/cardboard", std::vector<std::string>{"NORMAL_MAPS"});
+  shader_cardboard_flat_ = matman_.LoadShader("shaders/cardboard");
   shader_simple_shadow_ = matman_.LoadShader("shaders/simple_shadow");
   shader_textured_ = matman_.LoadShader("shaders/textured");
+  shader_textured_colored_ = matman_.LoadShader("shaders/textured_colored");
   shader_grayscale_ = matman_.LoadShader("shaders/grayscale");
   if (!(shader_lit_textured_normal_ && shader_cardboard &&
-        shader_simple_shadow_ && shader_textured_ && shader_grayscale_))
+        shader_cardboard_flat_ && shader_simple_shadow_ && shader_textured_ &&
+        shader_textured_colored_ && shader_grayscale_))
     return false;
 
   // Load shadow material:
@@ -377,6 +611,22 @@ bool PieNoonGame::InitializeRenderingAssets() {
       matman_.FindMaterial(config.fade_material()->c_str()));
   full_screen_fader_.set_shader(shader_textured_);
 
+  // Arm dynamic resolution scaling if the config asks for it; it stays
+  // dormant (no offscreen pass) until the GPU actually misses budget.
+  if (config.dynamic_resolution()) {
+    dynamic_resolution_.Initialize(&renderer_, shader_textured_,
+                                   config.dynamic_resolution_target_ms(),
+                                   config.dynamic_resolution_min_scale());
+  }
+
+  // Warm the HUD font while the loading screen is up: the face file is
+  // several megabytes, and opening it lazily would stall the first frame
+  // that draws text with it.
+  font_manager_.SetRenderer(renderer_);
+  if (config.prewarm_font() != nullptr && config.prewarm_font()->Length() > 0) {
+    font_manager_.OpenAsync(config.prewarm_font()->c_str(), &matman_.loader());
+  }
+
   // Start the thread that actually loads all assets we requested above.
   matman_.StartLoadingTextures();
 
@@ -399,7 +649,8 @@ bool PieNoonGame::InitializeGameState() {
   motive::MatrixInit::Register();
 
   // Load flatbuffer into buffer.
-  if (!LoadFile("character_state_machine_def.bin", &state_machine_source_)) {
+  if (!LoadFileMapped("character_state_machine_def.bin",
+                      &state_machine_source_)) {
     SDL_LogError(SDL_LOG_CATEGORY_ERROR,
                  "Error loading character state machine.\n");
     return false;
@@ -492,31 +743,77 @@ class AudioEngineVolumeControl {
 // Initialize each member in turn. This is logically just one function, since
 // the order of initialization cannot be changed. However, it's nice for
 // debugging and readability to have each section lexographically separate.
+// The one exception to the strict ordering is audio startup, which has no
+// dependency on the GL members and runs overlapped with them; see below.
 bool PieNoonGame::Initialize(const char* const binary_directory) {
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "PieNoon initializing...\n");
 
   if (!ChangeToUpstreamDir(binary_directory, kAssetsDir)) return false;
 
+  // When the asset bundle exists, every LoadFile below is served from its
+  // single mapping instead of opening dozens of individual files. A missing
+  // bundle is fine; loose files still load as before.
+  LoadAssetBundle(kAssetBundleFileName);
+
   if (!InitializeConfig()) return false;
 #ifdef ANDROID_CARDBOARD
   if (!InitializeCardboardConfig()) return false;
 #endif
-  if (!InitializeRenderer()) return false;
 
-  if (!InitializeRenderingAssets()) return false;
+  // Arm the per-subsystem heap budgets before the load burst starts, so
+  // overruns are attributed while they happen rather than at the autopsy.
+  const Config& config = GetConfig();
+  AllocTracker::SetBudget(AllocTracker::kTagTextures,
+                          config.texture_memory_budget_kb() * size_t(1024));
+  AllocTracker::SetBudget(AllocTracker::kTagFonts,
+                          config.font_memory_budget_kb() * size_t(1024));
+  AllocTracker::SetBudget(AllocTracker::kTagEntities,
+                          config.entity_memory_budget_kb() * size_t(1024));
+  AllocTracker::SetBudget(AllocTracker::kTagAudio,
+                          config.audio_memory_budget_kb() * size_t(1024));
+
+  // Audio startup--device open plus sound bank decode--touches no GL state
+  // and no member that the rendering path reads, so it runs on a worker
+  // thread overlapped with the GL context creation, shader compilation,
+  // and texture load kickoff below: the longest strictly serial stretch of
+  // startup. (Config loading stays serial because the renderer reads the
+  // window parameters from it; fonts and textures are already overlapped
+  // through the material manager's async loader.) The thread is joined
+  // before anything touches the audio engine.
+  bool sound_bank_loaded = false;
+  std::thread audio_thread([this, &sound_bank_loaded]() {
+    // Some people are having trouble loading the audio engine, and it's not
+    // strictly necessary for gameplay, so don't die if the audio engine
+    // fails to initialize.
+    if (!audio_engine_.Initialize(GetConfig().audio())) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to initialize audio engine.\n");
+    }
+
+    if (!audio_engine_.LoadSoundBank("sound_banks/sound_assets.bin")) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Failed to load sound bank.\n");
+    } else {
+      sound_bank_loaded = true;
+    }
+  });
+
+  const bool renderer_initialized =
+      InitializeRenderer() && InitializeRenderingAssets();
 
   input_.Initialize();
 
-  // Some people are having trouble loading the audio engine, and it's not
-  // strictly necessary for gameplay, so don't die if the audio engine fails to
-  // initialize.
-  if (!audio_engine_.Initialize(GetConfig().audio())) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "Failed to initialize audio engine.\n");
-  }
+  audio_thread.join();
+  if (!renderer_initialized) return false;
 
-  if (!audio_engine_.LoadSoundBank("sound_banks/sound_assets.bin")) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load sound bank.\n");
+  if (sound_bank_loaded) {
+    // Pindrop's sample buffers aren't visible from here, so account the
+    // bank file itself as a floor for the audio tag. AllocTracker isn't
+    // thread-safe, so this stays on this side of the join.
+    std::string bank_contents;
+    if (LoadFile("sound_banks/sound_assets.bin", &bank_contents)) {
+      AllocTracker::Track(AllocTracker::kTagAudio, bank_contents.length());
+    }
   }
 
   input_.AddAppEventCallback(AudioEngineVolumeControl(&audio_engine_));
@@ -566,20 +863,342 @@ Mesh* PieNoonGame::GetCardboardFront(int renderable_id) {
                      : cardboard_fronts_[RenderableId_Invalid];
 }
 
-void PieNoonGame::RenderCardboard(const SceneDescription& scene,
-                                  const mat4& camera_transform) {
+static const int kNumFrustumPlanes = 6;
+
+// Extract the six clip planes from a combined view-projection matrix, using
+// the Gribb-Hartmann method. Planes are stored as (nx, ny, nz, d),
+// normalized, with normals facing into the frustum: a point p is inside a
+// plane when dot(n, p) + d >= 0.
+static void ExtractFrustumPlanes(const mat4& m, vec4* planes) {
+  const vec4 row3(m(3, 0), m(3, 1), m(3, 2), m(3, 3));
+  for (int i = 0; i < 3; ++i) {
+    const vec4 row(m(i, 0), m(i, 1), m(i, 2), m(i, 3));
+    planes[i * 2 + 0] = row3 + row;
+    planes[i * 2 + 1] = row3 - row;
+  }
+  for (int i = 0; i < kNumFrustumPlanes; ++i) {
+    planes[i] = planes[i] * (1.0f / planes[i].xyz().Length());
+  }
+}
+
+// Returns true if the sphere is completely on the outside of one of the
+// frustum planes, i.e. definitely not visible.
+static bool SphereOutsideFrustum(const vec4* planes, const vec3& center,
+                                 float radius) {
+  for (int i = 0; i < kNumFrustumPlanes; ++i) {
+    if (vec3::DotProduct(planes[i].xyz(), center) + planes[i].w() < -radius)
+      return true;
+  }
+  return false;
+}
+
+// The largest scale the matrix applies along any axis. Used to bring
+// bounding sphere radii into world space.
+static float MaxScale(const mat4& m) {
+  const float x = vec3(m(0, 0), m(1, 0), m(2, 0)).LengthSquared();
+  const float y = vec3(m(0, 1), m(1, 1), m(2, 1)).LengthSquared();
+  const float z = vec3(m(0, 2), m(1, 2), m(2, 2)).LengthSquared();
+  return sqrt(std::max(x, std::max(y, z)));
+}
+
+// Returns true if the renderable's front material blends against the
+// framebuffer, and so must be drawn in the back-to-front pass. Materials
+// with blending off (or alpha test only) can go in the front-to-back
+// opaque pass, where the depth test rejects hidden fill.
+bool PieNoonGame::RenderableNeedsBlending(int renderable_id) {
+  const int blend_mode =
+      GetCardboardFront(renderable_id)->GetMaterial(0)->blend_mode();
+  return blend_mode != kBlendModeOff && blend_mode != kBlendModeTest;
+}
+
+// Returns true when 'color' is exactly white, i.e. the draw doesn't rely
+// on the per-renderable color uniform.
+static bool IsWhite(const vec4& color) {
+  return color.x() == 1.0f && color.y() == 1.0f && color.z() == 1.0f &&
+         color.w() == 1.0f;
+}
+
+// Build an ordering of scene.renderables() that drops renderables whose
+// bounding spheres fall entirely outside the view frustum, then splits the
+// survivors into two passes by their front material's blend mode: opaque
+// renderables first, front-to-back, so early depth rejection saves fill on
+// anything they occlude; blended renderables after, back-to-front, so
+// their alpha composites in the right order. Both sorts are stable so that
+// renderables at equal depth keep their insertion order.
+void PieNoonGame::SortSceneRenderOrder(const SceneDescription& scene,
+                                       const mat4* camera_transforms,
+                                       int num_views) {
+  assert(num_views >= 1 && num_views <= 2);
+  vec4 frustum_planes[2][kNumFrustumPlanes];
+  for (int e = 0; e < num_views; ++e) {
+    ExtractFrustumPlanes(camera_transforms[e], frustum_planes[e]);
+  }
+
+  const size_t num_renderables = scene.renderables().size();
+  scene_render_order_.clear();
+  scene_render_order_.reserve(num_renderables);
+  scene_render_translucent_.clear();
+  scene_render_depth_.resize(num_renderables);
+  for (size_t i = 0; i < num_renderables; ++i) {
+    const Renderable& renderable = scene.renderables()[i];
+    const int id = renderable.id();
+    // Renderables covered by a merged static mesh draw there (see
+    // RenderMergedStaticProps); drop their individual entries. The checks
+    // mirror the bake eligibility in UpdateMergedStaticProps, so a tagged
+    // renderable that wasn't baked (e.g. a tinted one) still draws
+    // normally.
+    if (renderable.merged_static() && 0 <= id &&
+        id < static_cast<int>(merged_prop_id_.size()) &&
+        merged_prop_id_[id] && IsWhite(renderable.color())) {
+      continue;
+    }
+    const mat4& world_matrix = renderable.world_matrix();
+    vec3 center = world_matrix.TranslationVector3D();
+    if (0 <= id && id < static_cast<int>(renderable_bounds_.size())) {
+      const vec4& bounds = renderable_bounds_[id];
+      center = world_matrix * bounds.xyz();
+      const float radius = bounds.w() * MaxScale(world_matrix);
+      // Cull only what's outside every view's frustum; in stereo a
+      // renderable can be visible to one eye but not the other.
+      bool outside_all_views = true;
+      for (int e = 0; e < num_views; ++e) {
+        if (!SphereOutsideFrustum(frustum_planes[e], center, radius)) {
+          outside_all_views = false;
+          break;
+        }
+      }
+      if (outside_all_views) continue;
+    }
+    // View depth of the bounding sphere center. For our perspective
+    // projection, the clip-space w of a point is its distance along the
+    // camera's forward axis. Sorting in the first view is close enough for
+    // the second: stereo eyes share a forward axis.
+    scene_render_depth_[i] =
+        (camera_transforms[0] * vec4(center, 1.0f)).w();
+    if (RenderableNeedsBlending(id)) {
+      scene_render_translucent_.push_back(static_cast<int>(i));
+    } else {
+      scene_render_order_.push_back(static_cast<int>(i));
+    }
+  }
+  const std::vector<float>& depth = scene_render_depth_;
+  std::stable_sort(scene_render_order_.begin(), scene_render_order_.end(),
+                   [&depth](int a, int b) { return depth[a] < depth[b]; });
+  std::stable_sort(scene_render_translucent_.begin(),
+                   scene_render_translucent_.end(),
+                   [&depth](int a, int b) { return depth[a] > depth[b]; });
+  scene_render_order_.insert(scene_render_order_.end(),
+                             scene_render_translucent_.begin(),
+                             scene_render_translucent_.end());
+}
+
+// Appends 'quad' (kQuadNumVertices corners) transformed into world space
+// by 'world_matrix' to 'vertices', with the quad's indices rebased onto
+// the appended corners.
+static void AppendWorldSpaceQuad(const NormalMappedVertex* quad,
+                                 const mat4& world_matrix,
+                                 std::vector<NormalMappedVertex>* vertices,
+                                 std::vector<unsigned short>* indices) {
+  const unsigned short base = static_cast<unsigned short>(vertices->size());
+  for (int i = 0; i < kQuadNumVertices; ++i) {
+    NormalMappedVertex v = quad[i];
+    v.pos = world_matrix * vec3(quad[i].pos);
+    // Rotate the lighting basis with the upper 3x3. Props scale close
+    // enough to uniformly that the renormalized vectors stay correct.
+    v.norm =
+        (world_matrix * vec4(vec3(quad[i].norm), 0.0f)).xyz().Normalized();
+    const vec4 tangent(quad[i].tangent);
+    v.tangent =
+        vec4((world_matrix * vec4(tangent.xyz(), 0.0f)).xyz().Normalized(),
+             tangent.w());
+    vertices->push_back(v);
+  }
+  for (int i = 0; i < kQuadNumIndices; ++i) {
+    indices->push_back(static_cast<unsigned short>(base + kQuadIndices[i]));
+  }
+}
+
+// Bake every merge-eligible static prop into a combined world-space mesh
+// per renderable id, so an arena of dozens of motionless props costs a
+// couple of draw calls per distinct prop material instead of several per
+// prop. Merged geometry skips per-renderable frustum culling and far-LOD;
+// static props ring the arena and are nearly always in view, so culling
+// them one by one bought little.
+void PieNoonGame::UpdateMergedStaticProps(const SceneDescription& scene) {
+  if (scene.static_version() == merged_props_version_) return;
+  merged_props_version_ = scene.static_version();
+
+  for (size_t i = 0; i < merged_prop_meshes_.size(); ++i) {
+    delete merged_prop_meshes_[i].front;
+    delete merged_prop_meshes_[i].back;
+  }
+  merged_prop_meshes_.clear();
+  merged_prop_id_.assign(RenderableId_Count, 0);
+
   const Config& config = GetConfig();
 
-  for (size_t i = 0; i < scene.renderables().size(); ++i) {
-    const auto& renderable = scene.renderables()[i];
-    const int id = renderable->id();
+  // Gather the world-space geometry of the eligible props, grouped by
+  // renderable id.
+  struct Group {
+    std::vector<NormalMappedVertex> front_vertices;
+    std::vector<unsigned short> front_indices;
+    std::vector<NormalMappedVertex> back_vertices;
+    std::vector<unsigned short> back_indices;
+  };
+  std::map<int, Group> groups;
+  const std::vector<Renderable>& renderables = scene.renderables();
+  for (size_t i = 0; i < renderables.size(); ++i) {
+    const Renderable& renderable = renderables[i];
+    const int id = renderable.id();
+    // Only renderables whose draw is nothing but the front and back quads
+    // can merge: sticks and shadows draw per renderable, alpha blending
+    // needs the global back-to-front sort, and a tint needs the color
+    // uniform.
+    if (!renderable.merged_static() || !IsWhite(renderable.color())) continue;
+    if (id < 0 || id >= RenderableId_Count ||
+        cardboard_fronts_[id] == nullptr) {
+      continue;
+    }
+    auto def = config.renderables()->Get(id);
+    if (def->stick() || def->shadow() || RenderableNeedsBlending(id)) continue;
+    Group& group = groups[id];
+    AppendWorldSpaceQuad(&cardboard_front_vertices_[id * kQuadNumVertices],
+                         renderable.world_matrix(), &group.front_vertices,
+                         &group.front_indices);
+    if (cardboard_backs_[id] != nullptr) {
+      AppendWorldSpaceQuad(&cardboard_back_vertices_[id * kQuadNumVertices],
+                           renderable.world_matrix(), &group.back_vertices,
+                           &group.back_indices);
+    }
+  }
+
+  for (auto it = groups.begin(); it != groups.end(); ++it) {
+    const int id = it->first;
+    const Group& group = it->second;
+    MergedPropMesh merged;
+    merged.id = id;
+    merged.front =
+        new Mesh(group.front_vertices.data(),
+                 static_cast<int>(group.front_vertices.size()),
+                 sizeof(NormalMappedVertex), kQuadMeshFormat);
+    merged.front->AddIndices(group.front_indices.data(),
+                             static_cast<int>(group.front_indices.size()),
+                             cardboard_fronts_[id]->GetMaterial(0));
+    merged.back = nullptr;
+    if (!group.back_vertices.empty()) {
+      merged.back =
+          new Mesh(group.back_vertices.data(),
+                   static_cast<int>(group.back_vertices.size()),
+                   sizeof(NormalMappedVertex), kQuadMeshFormat);
+      merged.back->AddIndices(group.back_indices.data(),
+                              static_cast<int>(group.back_indices.size()),
+                              cardboard_backs_[id]->GetMaterial(0));
+    }
+    merged_prop_meshes_.push_back(merged);
+    merged_prop_id_[id] = 1;
+  }
+}
+
+// Draw the merged static prop meshes. Their vertices are already in world
+// space, so the world matrix is the identity: object space equals world
+// space, the lighting positions pass through untransformed, and the mvp
+// is just the camera transform.
+void PieNoonGame::RenderMergedStaticProps(const SceneDescription& scene,
+                                          const RenderView* views,
+                                          const mat4* camera_transforms,
+                                          int num_views) {
+  if (merged_prop_meshes_.empty()) return;
+  const Config& config = GetConfig();
+
+  renderer_.camera_pos() = game_state_.camera().Position();
+  renderer_.light_pos() = *scene.lights()[0];
+  renderer_.color() = mathfu::kOnes4f;
+
+  // The cardboard material constants for every draw below come straight
+  // from the config; upload them to both shader variants up front.
+  Shader* const cardboard_variants[] = {shader_cardboard,
+                                        shader_cardboard_flat_};
+  for (size_t i = 0; i < PIE_ARRAYSIZE(cardboard_variants); ++i) {
+    Shader* shader = cardboard_variants[i];
+    shader->SetUniform("ambient_material",
+                       LoadVec3(config.cardboard_ambient_material()));
+    shader->SetUniform("diffuse_material",
+                       LoadVec3(config.cardboard_diffuse_material()));
+    shader->SetUniform("specular_material",
+                       LoadVec3(config.cardboard_specular_material()));
+    shader->SetUniform("shininess", config.cardboard_shininess());
+    shader->SetUniform("normalmap_scale", config.cardboard_normalmap_scale());
+  }
+
+  for (size_t i = 0; i < merged_prop_meshes_.size(); ++i) {
+    const MergedPropMesh& merged = merged_prop_meshes_[i];
+    // Back before front, matching the per-renderable draw order.
+    if (merged.back != nullptr) {
+      Shader* back_shader =
+          merged.back->GetMaterial(0)->textures().size() > 1
+              ? shader_cardboard
+              : shader_cardboard_flat_;
+      for (int e = 0; e < num_views; ++e) {
+        SetEyeViewport(views[e], num_views);
+        renderer_.model_view_projection() = camera_transforms[e];
+        back_shader->Set(renderer_);
+        merged.back->Render(renderer_);
+      }
+    }
+    const bool cardboard =
+        config.renderables()->Get(merged.id)->cardboard() != 0;
+    Shader* front_shader =
+        cardboard ? (merged.front->GetMaterial(0)->textures().size() > 1
+                         ? shader_cardboard
+                         : shader_cardboard_flat_)
+                  : shader_textured_;
+    for (int e = 0; e < num_views; ++e) {
+      SetEyeViewport(views[e], num_views);
+      renderer_.model_view_projection() = camera_transforms[e];
+      front_shader->Set(renderer_);
+      merged.front->Render(renderer_);
+    }
+  }
+}
+
+// Point GL at the view's viewport. A no-op for mono rendering, which draws
+// into whatever viewport the platform set up.
+void PieNoonGame::SetEyeViewport(const RenderView& view, int num_views) {
+  if (num_views < 2) return;
+  GL_CALL(glViewport(view.viewport_offset.x(), view.viewport_offset.y(),
+                     view.viewport_size.x(), view.viewport_size.y()));
+}
+
+void PieNoonGame::RenderCardboard(const SceneDescription& scene,
+                                  const RenderView* views,
+                                  const mat4* camera_transforms,
+                                  int num_views) {
+  const Config& config = GetConfig();
 
-    // Set up vertex transformation into projection space.
-    const mat4 mvp = camera_transform * renderable->world_matrix();
-    renderer_.model_view_projection() = mvp;
+  // The motionless arena props draw first, combined into a few big
+  // meshes. They're opaque, so drawing them before the front-to-back
+  // opaque pass below costs at worst a little early-depth fill.
+  RenderMergedStaticProps(scene, views, camera_transforms, num_views);
+
+  int previous_id = -1;
+  for (size_t i = 0; i < scene_render_order_.size(); ++i) {
+    const Renderable& renderable = scene.renderables()[scene_render_order_[i]];
+    const int id = renderable.id();
+    const bool id_changed = id != previous_id;
+    previous_id = id;
+
+    // Set up vertex transformation into projection space, once per view.
+    // Everything else about the renderable is view-independent and set only
+    // once; each part below is then drawn into every view before moving on.
+    // Re-Setting a shader per view re-uploads just the mvp, thanks to the
+    // uniform shadowing in Shader::Set.
+    mat4 mvps[2];
+    for (int e = 0; e < num_views; ++e) {
+      mvps[e] = camera_transforms[e] * renderable.world_matrix();
+    }
 
     // Set the camera and light positions in object space.
-    const mat4 world_matrix_inverse = renderable->world_matrix().Inverse();
+    const mat4 world_matrix_inverse = renderable.world_matrix().Inverse();
     renderer_.camera_pos() =
         world_matrix_inverse * game_state_.camera().Position();
 
@@ -594,37 +1213,94 @@ void PieNoonGame::RenderCardboard(const SceneDescription& scene,
     //
     // If we have a back, draw the back too, slightly offset.
     // The back is the *inside* of the cardboard, representing corrugation.
-    if (cardboard_backs_[id]) {
-      shader_cardboard->Set(renderer_);
-      cardboard_backs_[id]->Render(renderer_);
+    // Far-LOD renderables skip the back and stick entirely; see
+    // GameState::PopulateScene for where the LOD is selected.
+    if (cardboard_backs_[id] && !renderable.far_lod()) {
+      Shader* back_shader =
+          cardboard_backs_[id]->GetMaterial(0)->textures().size() > 1
+              ? shader_cardboard
+              : shader_cardboard_flat_;
+      for (int e = 0; e < num_views; ++e) {
+        SetEyeViewport(views[e], num_views);
+        renderer_.model_view_projection() = mvps[e];
+        back_shader->Set(renderer_);
+        cardboard_backs_[id]->Render(renderer_);
+      }
     }
 
     // Draw the popsicle stick that props up the cardboard.
-    if (config.renderables()->Get(id)->stick() && stick_front_ != nullptr &&
-        stick_back_ != nullptr) {
-      shader_textured_->Set(renderer_);
-      stick_front_->Render(renderer_);
-      stick_back_->Render(renderer_);
+    if (config.renderables()->Get(id)->stick() && !renderable.far_lod() &&
+        stick_front_ != nullptr && stick_back_ != nullptr) {
+      for (int e = 0; e < num_views; ++e) {
+        SetEyeViewport(views[e], num_views);
+        renderer_.model_view_projection() = mvps[e];
+        shader_textured_->Set(renderer_);
+        stick_front_->Render(renderer_);
+        stick_back_->Render(renderer_);
+      }
     }
 
-    renderer_.color() = renderable->color();
+    renderer_.color() = renderable.color();
 
-    if (config.renderables()->Get(id)->cardboard()) {
-      shader_cardboard->Set(renderer_);
-      shader_cardboard->SetUniform(
+    const bool cardboard = config.renderables()->Get(id)->cardboard() != 0;
+    Mesh* front = GetCardboardFront(id);
+    // Bind the variant the material calls for: fronts without a normal map
+    // use the specialization with the sampling compiled out, instead of a
+    // shader that reads an unbound texture unit.
+    Shader* front_shader =
+        cardboard ? (front->GetMaterial(0)->textures().size() > 1
+                         ? shader_cardboard
+                         : shader_cardboard_flat_)
+                  : shader_textured_;
+    // The material constants are identical for every renderable with the
+    // same id, and looking them up is expensive, so only upload them when
+    // the id changes. Uniform values persist in the program object, so
+    // one upload covers every view. The flat variant has no
+    // normalmap_scale; SetUniform skips uniforms that don't exist.
+    if (cardboard && id_changed) {
+      front_shader->SetUniform(
           "ambient_material", LoadVec3(config.cardboard_ambient_material()));
-      shader_cardboard->SetUniform(
+      front_shader->SetUniform(
           "diffuse_material", LoadVec3(config.cardboard_diffuse_material()));
-      shader_cardboard->SetUniform(
+      front_shader->SetUniform(
           "specular_material", LoadVec3(config.cardboard_specular_material()));
-      shader_cardboard->SetUniform("shininess", config.cardboard_shininess());
-      shader_cardboard->SetUniform("normalmap_scale",
-                                   config.cardboard_normalmap_scale());
-    } else {
-      shader_textured_->Set(renderer_);
+      front_shader->SetUniform("shininess", config.cardboard_shininess());
+      front_shader->SetUniform("normalmap_scale",
+                               config.cardboard_normalmap_scale());
     }
+    for (int e = 0; e < num_views; ++e) {
+      SetEyeViewport(views[e], num_views);
+      renderer_.model_view_projection() = mvps[e];
+      front_shader->Set(renderer_);
+      front->Render(renderer_);
+    }
+  }
+
+  // Draw the flat quads that were collected into per-material instance
+  // batches: one draw call per renderable id instead of one per quad.
+  const auto& batches = scene.quad_batches();
+  for (size_t i = 0; i < batches.size(); ++i) {
+    const QuadInstanceBatch& batch = *batches[i];
+    const int id = batch.id();
     Mesh* front = GetCardboardFront(id);
-    front->Render(renderer_);
+    // Fall back to the pajama quad's geometry when the id has no front mesh,
+    // to match what GetCardboardFront returns.
+    const bool valid_front = 0 <= id && id < RenderableId_Count &&
+                             cardboard_fronts_[id] != nullptr;
+    const int vertex_id = valid_front ? id : RenderableId_Invalid;
+    // World transforms and tints are baked into the batch's vertices, so the
+    // shader only applies the view-projection transform.
+    renderer_.color() = mathfu::kOnes4f;
+    front->GetMaterial(0)->Set(renderer_);
+    for (int e = 0; e < num_views; ++e) {
+      SetEyeViewport(views[e], num_views);
+      renderer_.model_view_projection() = camera_transforms[e];
+      shader_textured_colored_->Set(renderer_);
+      Mesh::RenderQuadBatch(
+          &cardboard_front_vertices_[vertex_id * kQuadNumVertices],
+          batch.world_matrices().data(), batch.colors().data(),
+          batch.instance_count());
+    }
   }
 }
 
@@ -639,41 +1315,55 @@ void PieNoonGame::Render(const SceneDescription& scene) {
 }
 
 void PieNoonGame::RenderForDefault(const SceneDescription& scene) {
-  RenderScene(scene, mat4::Identity(), renderer_.window_size());
+  RenderView view;
+  view.eye_transform = mat4::Identity();
+  view.viewport_offset = vec2i(0, 0);
+  view.viewport_size = renderer_.window_size();
+  RenderScene(scene, &view, 1, renderer_.window_size());
 }
 
 void PieNoonGame::RenderForCardboard(const SceneDescription& scene) {
 #ifdef ANDROID_CARDBOARD
-  mat4 left_eye_transform, right_eye_transform;
-  GetCardboardTransforms(left_eye_transform, right_eye_transform);
+  RenderView views[2];
+  GetCardboardTransforms(views[0].eye_transform, views[1].eye_transform);
   // Convert the transforms from cardboard space to game space
-  CorrectCardboardCamera(left_eye_transform);
-  CorrectCardboardCamera(right_eye_transform);
-  // Perform two render passes, one for each half of the screen
+  CorrectCardboardCamera(views[0].eye_transform);
+  CorrectCardboardCamera(views[1].eye_transform);
+  // One render pass that draws into each half of the screen: the scene is
+  // traversed and its state set up once, with only the viewport and mvp
+  // switched per eye at the draw level.
   vec2i size = AndroidGetScalerResolution();
   const vec2i viewport_size =
       size.x() && size.y() ? size : renderer_.window_size();
-  float window_width = viewport_size.x();
-  float half_width = window_width / 2.0f;
-  float window_height = viewport_size.y();
+  const int half_width = viewport_size.x() / 2;
+  views[0].viewport_offset = vec2i(0, 0);
+  views[1].viewport_offset = vec2i(half_width, 0);
+  views[0].viewport_size = vec2i(half_width, viewport_size.y());
+  views[1].viewport_size = views[0].viewport_size;
   auto res = renderer_.window_size();
-  vec2i half_res(res.x() / 2.0f, res.y());
-  GL_CALL(glViewport(0, 0, half_width, window_height));
-  RenderScene(scene, left_eye_transform, half_res);
-  GL_CALL(glViewport(half_width, 0, half_width, window_height));
-  RenderScene(scene, right_eye_transform, half_res);
+  const vec2i half_res(res.x() / 2, res.y());
+  RenderScene(scene, views, 2, half_res);
 #else
   (void)scene;
 #endif  // ANDROID_CARDBOARD
 }
 
 void PieNoonGame::RenderScene(const SceneDescription& scene,
-                              const mat4& additional_camera_changes,
+                              const RenderView* views, int num_views,
                               const vec2i& resolution) {
   const Config& config = GetConfig();
+  renderer_.BeginGpuZone("gpu scene");
+
+  // Mono rendering may draw the scene pass at reduced resolution and
+  // upscale at the end; the 2D pass below stays at native resolution.
+  // The aspect ratio is unchanged, so the projection needs no adjustment.
+  // Cardboard manages its own resolution via the Android scaler.
+  const bool scaled_scene =
+      num_views == 1 && dynamic_resolution_.BeginScenePass();
 #ifdef ANDROID_CARDBOARD
   const Config& cardboard_config = GetCardboardConfig();
 #endif
+  assert(num_views >= 1 && num_views <= 2);
 
   // Final matrix that applies the view frustum to bring into screen space.
   mat4 perspective_matrix_ = mat4::Perspective(
@@ -681,15 +1371,16 @@ void PieNoonGame::RenderScene(const SceneDescription& scene,
       resolution.x() / static_cast<float>(resolution.y()),
       config.viewport_near_plane(), config.viewport_far_plane(), -1.0f);
 
-  const mat4 camera_transform =
-      perspective_matrix_ * (additional_camera_changes * scene.camera());
+  mat4 camera_transforms[2];
+  for (int e = 0; e < num_views; ++e) {
+    camera_transforms[e] =
+        perspective_matrix_ * (views[e].eye_transform * scene.camera());
+  }
 
   // Render a ground plane.
   // TODO: Replace with a regular environment prop. Calculate scale_bias from
   // environment prop size.
-  renderer_.model_view_projection() = camera_transform;
   renderer_.color() = mathfu::kOnes4f;
-  shader_textured_->Set(renderer_);
   auto ground_mat = matman_.LoadMaterial("materials/floor.bin");
   assert(ground_mat);
   ground_mat->Set(renderer_);
@@ -704,42 +1395,67 @@ void PieNoonGame::RenderScene(const SceneDescription& scene,
   const float ground_width = config.ground_plane_width();
   const float ground_depth = config.ground_plane_depth();
 #endif
-  Mesh::RenderAAQuadAlongX(vec3(-ground_width, 0, 0),
-                           vec3(ground_width, 0, ground_depth), vec2(0, 0),
-                           vec2(1.0f, 1.0f));
+  for (int e = 0; e < num_views; ++e) {
+    SetEyeViewport(views[e], num_views);
+    renderer_.model_view_projection() = camera_transforms[e];
+    shader_textured_->Set(renderer_);
+    Mesh::RenderAAQuadAlongX(vec3(-ground_width, 0, 0),
+                             vec3(ground_width, 0, ground_depth), vec2(0, 0),
+                             vec2(1.0f, 1.0f));
+  }
   const vec4 world_scale_bias(1.0f / (2.0f * ground_width), 1.0f / ground_depth,
                               0.5f, 0.0f);
 
   // Render shadows for all Renderables first, with depth testing off so
   // they blend properly.
   renderer_.DepthTest(false);
-  renderer_.model_view_projection() = camera_transform;
   renderer_.light_pos() = *scene.lights()[0];  // TODO: check amount of lights.
   shader_simple_shadow_->SetUniform("world_scale_bias", world_scale_bias);
-  for (size_t i = 0; i < scene.renderables().size(); ++i) {
-    const auto& renderable = scene.renderables()[i];
-    const int id = renderable->id();
+  // Rebuild the merged static prop meshes if the static scene changed
+  // generation, so the sort below drops the renderables they cover.
+  UpdateMergedStaticProps(scene);
+  SortSceneRenderOrder(scene, camera_transforms, num_views);
+  int previous_shadow_id = -1;
+  for (size_t i = 0; i < scene_render_order_.size(); ++i) {
+    const Renderable& renderable = scene.renderables()[scene_render_order_[i]];
+    const int id = renderable.id();
     Mesh* front = GetCardboardFront(id);
     if (config.renderables()->Get(id)->shadow()) {
-      renderer_.model() = renderable->world_matrix();
-      shader_simple_shadow_->Set(renderer_);
+      renderer_.model() = renderable.world_matrix();
       // The first texture of the shadow shader has to be that of the
-      // billboard.
-      shadow_mat_->textures()[0] = front->GetMaterial(0)->textures()[0];
+      // billboard; it only needs re-fetching when the id changes.
+      if (id != previous_shadow_id) {
+        shadow_mat_->textures()[0] = front->GetMaterial(0)->textures()[0];
+        previous_shadow_id = id;
+      }
       shadow_mat_->Set(renderer_);
-      front->Render(renderer_, true);
+      for (int e = 0; e < num_views; ++e) {
+        SetEyeViewport(views[e], num_views);
+        renderer_.model_view_projection() = camera_transforms[e];
+        shader_simple_shadow_->Set(renderer_);
+        front->Render(renderer_, true);
+      }
     }
   }
   renderer_.DepthTest(true);
 
   // Now render the Renderables normally, on top of the shadows.
-  RenderCardboard(scene, camera_transform);
+  RenderCardboard(scene, views, camera_transforms, num_views);
+
+  // The upscale blit is part of the scene pass's GPU cost, so it stays
+  // inside the zone the resolution controller is steering on.
+  if (scaled_scene) dynamic_resolution_.EndScenePass();
+  renderer_.EndGpuZone();
 
   // Render any UI/HUD/Splash on top
-  Render2DElements();
+  for (int e = 0; e < num_views; ++e) {
+    SetEyeViewport(views[e], num_views);
+    Render2DElements();
+  }
 }
 
 void PieNoonGame::Render2DElements() {
+  renderer_.BeginGpuZone("gpu ui");
   // Set up an ortho camera for all 2D elements, with (0, 0) in the top left,
   // and the bottom right the windows size in pixels.
   auto res = renderer_.window_size();
@@ -771,11 +1487,243 @@ void PieNoonGame::Render2DElements() {
   // Loop through the 2D elements. Draw each subsequent one slightly closer
   // to the camera so that they appear on top of the previous ones.
   gui_menu_.Render(&renderer_);
+  renderer_.EndGpuZone();
+}
+
+// Draw the profiler's recent averages as imgui labels in the top left
+// corner. Toggled with F3; see the Profiler member for details.
+void PieNoonGame::RenderProfilerHUD() {
+  // The face is normally warmed during loading (config's prewarm_font).
+  // If it wasn't, kick off the load now and skip the HUD until it lands;
+  // a few textless frames beat blocking this one on the face file.
+  if (!font_manager_.FontLoaded()) {
+    if (!font_manager_.FontLoadPending()) {
+      font_manager_.OpenAsync("fonts/NotoSansCJKjp-Bold.otf",
+                              &matman_.loader());
+    }
+    return;
+  }
+
+  // The labels persist across the two layout/render passes gui::Run makes,
+  // so format them once per frame into static storage.
+  static const int kLineLength = 64;
+  static char lines[Profiler::kMaxZones + 1][kLineLength];
+  snprintf(lines[0], kLineLength, "frame %5.2fms (max %5.2f)",
+           profiler_.FrameAverageMs(), profiler_.FrameMaxMs());
+  const int zone_count = profiler_.zone_count();
+  for (int i = 0; i < zone_count; ++i) {
+    const int indent = profiler_.zone_depth(i) * 2;
+    snprintf(lines[i + 1], kLineLength, "%*s%s %5.2fms (max %5.2f)", indent,
+             "", profiler_.zone_name(i), profiler_.ZoneAverageMs(i),
+             profiler_.ZoneMaxMs(i));
+  }
+
+  static char draw_line[kLineLength];
+  int draw_calls = 0;
+  int triangles = 0;
+  for (int i = 0; i < renderer_.gpu_zone_count(); ++i) {
+    draw_calls += renderer_.gpu_zone(i).draw_calls;
+    triangles += renderer_.gpu_zone(i).triangles;
+  }
+  snprintf(draw_line, kLineLength, "draws %d  tris %d", draw_calls, triangles);
+
+  // Pacing percentiles cover the current analytics interval, not just the
+  // profiler's short ring, so the HUD shows the same numbers the next
+  // report will carry.
+  static char pacing_line[kLineLength];
+  const Profiler::FramePacingStats pacing =
+      profiler_.GetFramePacingStats(HitchThresholdMs());
+  snprintf(pacing_line, kLineLength,
+           "p50 %4.1f  p95 %4.1f  p99 %4.1f  hitches %d", pacing.p50_ms,
+           pacing.p95_ms, pacing.p99_ms, pacing.hitch_count);
+
+  gui::Run(matman_, font_manager_, input_, [&]() {
+    gui::PositionUI(renderer_.window_size(), 1000, gui::LAYOUT_HORIZONTAL_TOP,
+                    gui::LAYOUT_VERTICAL_LEFT);
+    gui::StartGroup(gui::LAYOUT_VERTICAL_LEFT, 2, "profiler_hud");
+    for (int i = 0; i < zone_count + 1; ++i) {
+      gui::Label(lines[i], 20);
+    }
+    gui::Label(draw_line, 20);
+    gui::Label(pacing_line, 20);
+    gui::EndGroup();
+  });
+}
+
+// When the frame the profiler just closed out breached the configured
+// threshold, write a hitch report: the profiler's recent per-frame zone
+// history as hitch_N.csv, a hitch_N.txt sidecar recording what the
+// engine was doing at the time, and a hitch_N_replay.bin dump of the
+// input recording leading up to it. The report files stay on the device, but a
+// tracker event carrying the frame time goes through the analytics layer,
+// so we learn how often players hitch even without pulling files.
+void PieNoonGame::CheckFrameHitch(WorldTime world_time) {
+  const int threshold = GetConfig().hitch_capture_threshold_ms();
+  if (threshold <= 0) return;
+  const float frame_ms = profiler_.LastFrameMs();
+  if (frame_ms < static_cast<float>(threshold)) return;
+  if (last_hitch_capture_time_ != 0 &&
+      world_time - last_hitch_capture_time_ < kMinHitchCaptureInterval) {
+    return;
+  }
+  last_hitch_capture_time_ = world_time;
+
+  char filename[64];
+  snprintf(filename, sizeof(filename), "hitch_%d.csv", hitch_captures_);
+  profiler_.DumpCSV(filename);
+
+  char report[512];
+  snprintf(report, sizeof(report),
+           "frame_ms: %.1f\n"
+           "state: %d\n"
+           "world_time: %d\n"
+           "pending_load_jobs: %d\n"
+           "characters: %d\n"
+           "active_characters: %d\n"
+           "gl_renderer: %s\n"
+           "gl_version: %s\n",
+           frame_ms, static_cast<int>(state_), world_time,
+           matman_.NumPendingLoadJobs(),
+           static_cast<int>(game_state_.characters().size()),
+           game_state_.NumActiveCharacters(),
+           reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+           reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+  snprintf(filename, sizeof(filename), "hitch_%d.txt", hitch_captures_);
+  SDL_RWops* file = SDL_RWFromFile(filename, "w");
+  if (file != nullptr) {
+    SDL_RWwrite(file, report, 1, strlen(report));
+    SDL_RWclose(file);
+  } else {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "hitch: can't write %s: %s",
+                 filename, SDL_GetError());
+  }
+  // Attach the input recording leading up to the hitch; serialized and
+  // written from the recorder's background thread.
+  snprintf(filename, sizeof(filename), "hitch_%d_replay.bin", hitch_captures_);
+  replay_recorder_.DumpAsync(filename);
+
+  hitch_captures_++;
+
+  SendTrackerEvent(kCategoryPerformance, kActionFrameHitch, kLabelFrameMs,
+                   static_cast<int>(frame_ms));
+}
+
+// Threshold above which a frame counts as a hitch in the pacing stats:
+// the config's capture threshold when one is set, so the HUD, the capture
+// reports, and the analytics all agree on what a hitch is.
+float PieNoonGame::HitchThresholdMs() const {
+  const int configured = GetConfig().hitch_capture_threshold_ms();
+  return configured > 0 ? static_cast<float>(configured)
+                        : kDefaultHitchThresholdMs;
+}
+
+// Once per reporting interval, summarize the profiler's pacing histogram,
+// push it through the analytics layer, and start a fresh interval. The
+// tracker batches and sends off-thread, so this costs four queued events
+// a minute; the payloads are integer milliseconds (and a count), which is
+// what lets production dashboards correlate device model with pacing.
+void PieNoonGame::ReportFramePacing(WorldTime world_time) {
+  if (next_pacing_report_time_ == 0) {
+    // Arm the first interval; don't report the partial stretch before it.
+    next_pacing_report_time_ = world_time + kFramePacingReportInterval;
+    return;
+  }
+  if (world_time < next_pacing_report_time_) return;
+  next_pacing_report_time_ = world_time + kFramePacingReportInterval;
+
+  const Profiler::FramePacingStats stats =
+      profiler_.GetFramePacingStats(HitchThresholdMs());
+  if (stats.frame_count == 0) return;
+  SendTrackerEvent(kCategoryPerformance, kActionFramePacing, kLabelP50Ms,
+                   static_cast<int>(stats.p50_ms));
+  SendTrackerEvent(kCategoryPerformance, kActionFramePacing, kLabelP95Ms,
+                   static_cast<int>(stats.p95_ms));
+  SendTrackerEvent(kCategoryPerformance, kActionFramePacing, kLabelP99Ms,
+                   static_cast<int>(stats.p99_ms));
+  SendTrackerEvent(kCategoryPerformance, kActionFramePacing, kLabelHitchCount,
+                   stats.hitch_count);
+  profiler_.ResetFramePacingStats();
+}
+
+#ifdef __ANDROID__
+// Zero-copy channel for the per-frame eye views. Java writes both eye
+// matrices into this buffer (shared with it once as a direct ByteBuffer),
+// so reading them each frame is two memcpys instead of a JNI transition
+// with array allocation and pinning -- those transitions cost ~0.5ms/frame
+// in Cardboard traces. The sequence word is a seqlock: the writer bumps it
+// to an odd value before writing and the next even value after, so a
+// reader that sees the word change mid-copy retries instead of using a
+// torn matrix.
+struct EyeViewBuffer {
+  SDL_atomic_t sequence;
+  float left[16];
+  float right[16];
+};
+static EyeViewBuffer g_eye_view_buffer;
+
+// Hand the buffer to the activity. Activities without SetEyeViewBuffer
+// (no Cardboard support, or an older Java side) leave the channel
+// unregistered and eye views fall back to the per-frame JNI call.
+static bool RegisterEyeViewBuffer() {
+  // Identity eye views until the first Java write lands.
+  for (int i = 0; i < 16; ++i) {
+    const float diagonal = (i % 5) == 0 ? 1.0f : 0.0f;
+    g_eye_view_buffer.left[i] = diagonal;
+    g_eye_view_buffer.right[i] = diagonal;
+  }
+  JNIEnv* env = reinterpret_cast<JNIEnv*>(SDL_AndroidGetJNIEnv());
+  jobject activity = reinterpret_cast<jobject>(SDL_AndroidGetActivity());
+  jclass fpl_class = env->GetObjectClass(activity);
+  jmethodID set_eye_view_buffer = env->GetMethodID(
+      fpl_class, "SetEyeViewBuffer", "(Ljava/nio/ByteBuffer;)V");
+  bool registered = false;
+  if (set_eye_view_buffer != nullptr) {
+    jobject buffer = env->NewDirectByteBuffer(&g_eye_view_buffer,
+                                              sizeof(g_eye_view_buffer));
+    env->CallVoidMethod(activity, set_eye_view_buffer, buffer);
+    env->DeleteLocalRef(buffer);
+    registered = true;
+  } else {
+    env->ExceptionClear();
+  }
+  env->DeleteLocalRef(fpl_class);
+  env->DeleteLocalRef(activity);
+  return registered;
 }
+#endif  // __ANDROID__
 
 void PieNoonGame::GetCardboardTransforms(mat4& left_eye_transform,
                                          mat4& right_eye_transform) {
 #ifdef __ANDROID__
+  static enum {
+    kEyeViewUntried,
+    kEyeViewShared,
+    kEyeViewJni
+  } channel = kEyeViewUntried;
+  if (channel == kEyeViewUntried) {
+    channel = RegisterEyeViewBuffer() ? kEyeViewShared : kEyeViewJni;
+  }
+
+  if (channel == kEyeViewShared) {
+    // Seqlock read: retry while the writer is mid-update (odd sequence)
+    // or updated the buffer underneath the copy. The write is a handful
+    // of stores, so a couple of attempts always suffice in practice; a
+    // torn final attempt only means reusing matrices one frame stale.
+    float left[16], right[16];
+    for (int attempt = 0; attempt < 4; ++attempt) {
+      const int sequence = SDL_AtomicGet(&g_eye_view_buffer.sequence);
+      memcpy(left, g_eye_view_buffer.left, sizeof(left));
+      memcpy(right, g_eye_view_buffer.right, sizeof(right));
+      if (!(sequence & 1) &&
+          SDL_AtomicGet(&g_eye_view_buffer.sequence) == sequence) {
+        break;
+      }
+    }
+    left_eye_transform = mat4(left);
+    right_eye_transform = mat4(right);
+    return;
+  }
+
   JNIEnv* env = reinterpret_cast<JNIEnv*>(SDL_AndroidGetJNIEnv());
   jobject activity = reinterpret_cast<jobject>(SDL_AndroidGetActivity());
   jclass fpl_class = env->GetObjectClass(activity);
@@ -834,18 +1782,18 @@ void PieNoonGame::DebugPrintPieStates() {
 }
 
 const Config& PieNoonGame::GetConfig() const {
-  return *fpl::pie_noon::GetConfig(config_source_.c_str());
+  return *fpl::pie_noon::GetConfig(config_source_.data());
 }
 
 #ifdef ANDROID_CARDBOARD
 const Config& PieNoonGame::GetCardboardConfig() const {
-  return *fpl::pie_noon::GetConfig(cardboard_config_source_.c_str());
+  return *fpl::pie_noon::GetConfig(cardboard_config_source_.data());
 }
 #endif
 
 const CharacterStateMachineDef* PieNoonGame::GetStateMachine() const {
   return fpl::pie_noon::GetCharacterStateMachineDef(
-      state_machine_source_.c_str());
+      state_machine_source_.data());
 }
 
 struct ButtonToTranslation {
@@ -971,6 +1919,12 @@ PieNoonState PieNoonGame::UpdatePieNoonState() {
       break;
     }
     case kLoading: {
+      // Warm the gameplay samples while the loading screen is up, so the
+      // first impact in a match doesn't pay first-use decode cost.
+      if (!sounds_prewarmed_) {
+        PrewarmSounds();
+        sounds_prewarmed_ = true;
+      }
       // When we initialized assets, we kicked off a thread to load all
       // textures. Here we check if those have finished loading.
       // We also leave the loading screen up for a minimum amount of time.
@@ -1024,7 +1978,8 @@ PieNoonState PieNoonGame::UpdatePieNoonState() {
 
       if (game_state_.IsGameOver() && stinger_channel_.Valid() &&
           !stinger_channel_.Playing()) {
-        game_state_.PostGameLogging();
+        // Analytics and stats were submitted when the stinger started;
+        // see the game-over check in Run.
         if (game_state_.is_multiscreen() && multiplayer_director_ != nullptr) {
 #ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
           multiplayer_director_->SendEndGameMsg();
@@ -1171,10 +2126,53 @@ void PieNoonGame::UpdateCountdownImage(WorldTime time) {
   }
 }
 
+// Names of the PieNoonState values, indexed by the enum. Used to match
+// config-driven tables like state_prefetch.
+static const char* kPieNoonStateNames[] = {
+    "Uninitialized", "LoadingInitialMaterials", "Loading", "Tutorial",
+    "Joining",       "Playing",                 "Paused",  "Finished",
+    "MultiplayerWaiting", "MultiscreenClient",
+};
+static_assert(PIE_ARRAYSIZE(kPieNoonStateNames) == kMultiscreenClient + 1,
+              "update kPieNoonStateNames");
+
+// Queue background loads for the materials the config predicts will be
+// needed soon after entering 'state' (usually by the state that normally
+// follows it). The loads go through the async loader and are finalized by
+// the frame loop's TryFinalize calls, so a predictable transition doesn't
+// pay a first-use load when it lands.
+void PieNoonGame::PrefetchStateAssets(PieNoonState state) {
+  const Config& config = GetConfig();
+  if (config.state_prefetch() == nullptr) return;
+  const char* state_name = kPieNoonStateNames[state];
+  for (size_t i = 0; i < config.state_prefetch()->size(); ++i) {
+    const StatePrefetch* prefetch = config.state_prefetch()->Get(i);
+    if (prefetch->state() == nullptr ||
+        strcmp(prefetch->state()->c_str(), state_name) != 0 ||
+        prefetch->materials() == nullptr) {
+      continue;
+    }
+    for (size_t j = 0; j < prefetch->materials()->size(); ++j) {
+      matman_.LoadMaterial(prefetch->materials()->Get(j)->c_str());
+    }
+  }
+}
+
 void PieNoonGame::TransitionToPieNoonState(PieNoonState next_state) {
   assert(state_ != next_state);  // Must actually transition.
   const Config& config = GetConfig();
 
+  // Leaving the tutorial: evict whatever is left of the slide window (the
+  // slide on screen plus the lookahead loads). Slides behind the window
+  // were already unloaded as we advanced past them, but without this the
+  // last few stayed resident for the rest of the session.
+  if (state_ == kTutorial) {
+    for (size_t i = 0; i < tutorial_slides_.size(); ++i) {
+      matman_.UnloadMaterial(tutorial_slides_[i].c_str());
+    }
+    tutorial_slides_.clear();
+  }
+
   switch (next_state) {
     case kLoadingInitialMaterials: {
       break;
@@ -1262,9 +2260,9 @@ void PieNoonGame::TransitionToPieNoonState(PieNoonState next_state) {
         }
       }
       // This should only happen if we just finished a game, not if we
-      // end up in this state after loading.
+      // end up in this state after loading. The stat upload itself
+      // already happened when the game-over stinger started.
       if (state_ == kPlaying) {
-        UploadEvents();
         // For now, we always show leaderboards when a single player round ends:
         if (!game_state_.is_multiscreen()) {
           UploadAndShowLeaderboards();
@@ -1300,6 +2298,10 @@ void PieNoonGame::TransitionToPieNoonState(PieNoonState next_state) {
       assert(false);
   }
 
+  // Kick off background loads for whatever the config predicts the new
+  // state will need next.
+  PrefetchStateAssets(next_state);
+
   state_ = next_state;
   state_entry_time_ = prev_world_time_;
 }
@@ -1487,64 +2489,7 @@ void PieNoonGame::ProcessMultiplayerMessages() {
 
       // Make sure the message has valid data.
       if (multiplayer::VerifyMessageRootBuffer(verifier)) {
-        if (message->data_type() == multiplayer::Data_PlayerAssignment) {
-          const multiplayer::PlayerAssignment* player_assignment =
-              (const multiplayer::PlayerAssignment*)message->data();
-          SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                      "Process a player assignment: %d\n",
-                      player_assignment->player_id());
-          StartMultiscreenGameAsClient(
-              (CharacterId)player_assignment->player_id());
-        } else if (message->data_type() == multiplayer::Data_PlayerCommand) {
-          const multiplayer::PlayerCommand* player_command =
-              (const multiplayer::PlayerCommand*)message->data();
-          // process a player command
-          if (game_state_.is_multiscreen() &&
-              multiplayer_director_ != nullptr) {
-            int player_id =
-                gpg_multiplayer_.GetPlayerNumberByInstanceId(sender);
-            if (player_id >= 0) {
-              multiplayer_director_->InputPlayerCommand(player_id,
-                                                        *player_command);
-            }
-          }
-        } else if (message->data_type() == multiplayer::Data_StartTurn) {
-          const multiplayer::StartTurn* start_turn =
-              (const multiplayer::StartTurn*)message->data();
-          SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                      "Multiplayer message: StartTurn.");
-          multiscreen_turn_number_++;
-          // start the countdown for another turn
-          multiscreen_turn_end_time_ =
-              CurrentWorldTime() +
-              start_turn->seconds() * kMillisecondsPerSecond;
-
-          ProcessPlayerStatusMessage(*start_turn->player_status());
-
-#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
-          SendMultiscreenPlayerCommand();
-#endif
-          // Reload the current menu to reset all the buttons.
-          ReloadMultiscreenMenu();
-          UpdateMultiscreenMenuIcons();
-          InitCountdownImage(start_turn->seconds());
-
-        } else if (message->data_type() == multiplayer::Data_EndGame) {
-          const multiplayer::EndGame* end_game =
-              (const multiplayer::EndGame*)message->data();
-          SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                      "Multiplayer message: EndGame.");
-          ProcessPlayerStatusMessage(*end_game->player_status());
-          // The game is over, go to the wait screen.
-          TransitionToPieNoonState(kMultiplayerWaiting);
-        } else if (message->data_type() == multiplayer::Data_PlayerStatus) {
-          const multiplayer::PlayerStatus* player_status =
-              (const multiplayer::PlayerStatus*)message->data();
-          ProcessPlayerStatusMessage(*player_status);
-        } else {
-          SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                      "Multiplayer message has a data type of NONE.");
-        }
+        HandleMultiplayerMessage(sender, message);
       } else {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "Got a malformed multiplayer message!");
@@ -1572,24 +2517,163 @@ void PieNoonGame::ProcessMultiplayerMessages() {
   }
 }
 
+// Dispatch one (already-verified) multiplayer message. Split out from
+// ProcessMultiplayerMessages so batched messages can recurse through the
+// same dispatch.
+void PieNoonGame::HandleMultiplayerMessage(
+    const std::string& sender, const multiplayer::MessageRoot* message) {
+  if (message->data_type() == multiplayer::Data_PlayerAssignment) {
+    const multiplayer::PlayerAssignment* player_assignment =
+        (const multiplayer::PlayerAssignment*)message->data();
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Process a player assignment: %d\n",
+                player_assignment->player_id());
+    StartMultiscreenGameAsClient((CharacterId)player_assignment->player_id());
+  } else if (message->data_type() == multiplayer::Data_PlayerCommand) {
+    const multiplayer::PlayerCommand* player_command =
+        (const multiplayer::PlayerCommand*)message->data();
+    // process a player command
+    if (game_state_.is_multiscreen() && multiplayer_director_ != nullptr) {
+      int player_id = gpg_multiplayer_.GetPlayerNumberByInstanceId(sender);
+      if (player_id >= 0) {
+        multiplayer_director_->InputPlayerCommand(player_id, *player_command);
+      }
+    }
+  } else if (message->data_type() == multiplayer::Data_StatusAck) {
+    const multiplayer::StatusAck* status_ack =
+        (const multiplayer::StatusAck*)message->data();
+    // A client acknowledged a full player status; the director can delta
+    // later statuses against it.
+    if (game_state_.is_multiscreen() && multiplayer_director_ != nullptr) {
+      int player_id = gpg_multiplayer_.GetPlayerNumberByInstanceId(sender);
+      if (player_id >= 0) {
+        multiplayer_director_->ReceiveStatusAck(player_id,
+                                                status_ack->sequence());
+      }
+    }
+  } else if (message->data_type() == multiplayer::Data_StartTurn) {
+    const multiplayer::StartTurn* start_turn =
+        (const multiplayer::StartTurn*)message->data();
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Multiplayer message: StartTurn.");
+    multiscreen_turn_number_++;
+    // start the countdown for another turn
+    multiscreen_turn_end_time_ =
+        CurrentWorldTime() + start_turn->seconds() * kMillisecondsPerSecond;
+
+    ProcessPlayerStatusMessage(*start_turn->player_status());
+
+#ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
+    SendMultiscreenPlayerCommand();
+#endif
+    // Reload the current menu to reset all the buttons.
+    ReloadMultiscreenMenu();
+    UpdateMultiscreenMenuIcons();
+    InitCountdownImage(start_turn->seconds());
+
+  } else if (message->data_type() == multiplayer::Data_EndGame) {
+    const multiplayer::EndGame* end_game =
+        (const multiplayer::EndGame*)message->data();
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Multiplayer message: EndGame.");
+    ProcessPlayerStatusMessage(*end_game->player_status());
+    // The game is over, go to the wait screen.
+    TransitionToPieNoonState(kMultiplayerWaiting);
+  } else if (message->data_type() == multiplayer::Data_PlayerStatus) {
+    const multiplayer::PlayerStatus* player_status =
+        (const multiplayer::PlayerStatus*)message->data();
+    ProcessPlayerStatusMessage(*player_status);
+  } else if (message->data_type() == multiplayer::Data_MessageBatch) {
+    // A frame's worth of coalesced messages; apply them in order. Each
+    // nested buffer gets its own verification since the outer verify only
+    // covers it as an opaque byte vector.
+    const multiplayer::MessageBatch* batch =
+        (const multiplayer::MessageBatch*)message->data();
+    if (batch->messages() != nullptr) {
+      for (auto it = batch->messages()->begin(); it != batch->messages()->end();
+           ++it) {
+        const auto* payload = it->message();
+        if (payload == nullptr) continue;
+        flatbuffers::Verifier verifier(payload->Data(), payload->Length());
+        if (multiplayer::VerifyMessageRootBuffer(verifier)) {
+          HandleMultiplayerMessage(
+              sender, multiplayer::GetMessageRoot(payload->Data()));
+        } else {
+          SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                      "Got a malformed message inside a batch!");
+        }
+      }
+    }
+  } else {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Multiplayer message has a data type of NONE.");
+  }
+}
+
 void PieNoonGame::ProcessPlayerStatusMessage(
     const multiplayer::PlayerStatus& status) {
-  // Iterate through characters and player healths.
-  auto c = game_state_.characters().begin();
-  auto h = status.player_health()->begin();
-  for (; c != game_state_.characters().end() &&
-         h != status.player_health()->end();
-       ++c, ++h) {
-    (*c)->set_health(*h);
+  // Standalone statuses come in on the unreliable channel, so a stale one
+  // can arrive after a newer one. Latest wins: drop anything not newer
+  // than the last status applied, comparing with a signed 16-bit
+  // difference so the ushort sequence can wrap mid-game. Sequence 0 is an
+  // unsequenced (older) host; always apply those.
+  const unsigned short sequence = status.sequence();
+  if (sequence != 0) {
+    if (multiscreen_last_status_sequence_ != 0 &&
+        static_cast<int16_t>(
+            sequence - multiscreen_last_status_sequence_) <= 0) {
+      return;
+    }
+    multiscreen_last_status_sequence_ = sequence;
+  }
+  const bool is_delta =
+      status.base_sequence() != 0 && status.changed_players() != nullptr;
+  if (is_delta) {
+    // Sparse update: entry i applies to player changed_players()->Get(i).
+    // The host only deltas against a full status we acknowledged, so the
+    // unlisted players already show the right state. (If we applied a
+    // newer full status than the delta's baseline, a value that reverted
+    // in between could stay stale briefly; the next turn's full status
+    // corrects it.)
+    const auto* changed = status.changed_players();
+    for (flatbuffers::uoffset_t i = 0; i < changed->Length(); ++i) {
+      const int player = changed->Get(i);
+      if (player >= static_cast<int>(game_state_.characters().size())) {
+        continue;
+      }
+      if (i < status.player_health()->Length()) {
+        game_state_.characters()[player]->set_health(
+            status.player_health()->Get(i));
+      }
+      if (player < static_cast<int>(multiscreen_player_splats_.size()) &&
+          i < status.player_splats()->Length()) {
+        multiscreen_player_splats_[player] = status.player_splats()->Get(i);
+      }
+    }
+  } else {
+    // Iterate through characters and player healths.
+    auto c = game_state_.characters().begin();
+    auto h = status.player_health()->begin();
+    for (; c != game_state_.characters().end() &&
+           h != status.player_health()->end();
+         ++c, ++h) {
+      (*c)->set_health(*h);
+    }
+    multiscreen_player_splats_.assign(status.player_splats()->begin(),
+                                      status.player_splats()->end());
+    // Acknowledge applied full statuses so the host can start sending
+    // deltas against them.
+    if (sequence != 0) {
+      SendMultiscreenStatusAck(sequence);
+    }
   }
   unsigned char splats;
   if (multiscreen_my_player_id_ >=
-          static_cast<int>(status.player_splats()->Length()) ||
+          static_cast<int>(multiscreen_player_splats_.size()) ||
       game_state_.characters()[multiscreen_my_player_id_]->health() <= 0) {
     // we're an invalid player (or a dead one), don't show our splats.
     splats = 0;
   } else {
-    splats = status.player_splats()->Get(multiscreen_my_player_id_);
+    splats = multiscreen_player_splats_[multiscreen_my_player_id_];
   }
 
   int new_splats = 0;
@@ -1956,6 +3040,8 @@ void PieNoonGame::StartMultiscreenGameAsClient(CharacterId id) {
   multiscreen_action_aim_at_ = (id + 1) % num_players;
   multiscreen_turn_number_ = 0;
   multiscreen_turn_end_time_ = 0;
+  multiscreen_last_status_sequence_ = 0;
+  multiscreen_player_splats_.clear();
   SendMultiscreenPlayerCommand();
   UpdateMultiscreenMenuIcons();
   TransitionToPieNoonState(kMultiscreenClient);
@@ -1984,6 +3070,21 @@ void PieNoonGame::SendMultiscreenPlayerCommand() {
   gpg_multiplayer_.BroadcastMessage(message, true);
 }
 
+// Tell the host the newest full PlayerStatus we've applied, so it can
+// send later statuses as deltas against it. Unreliable on purpose: a
+// lost ack only delays delta compression, never correctness.
+void PieNoonGame::SendMultiscreenStatusAck(unsigned short sequence) {
+  flatbuffers::FlatBufferBuilder builder;
+  auto message_root = multiplayer::CreateMessageRoot(
+      builder, multiplayer::Data_StatusAck,
+      multiplayer::CreateStatusAck(builder, sequence).Union());
+  builder.Finish(message_root);
+
+  std::vector<uint8_t> message(builder.GetBufferPointer(),
+                               builder.GetBufferPointer() + builder.GetSize());
+  gpg_multiplayer_.BroadcastMessage(message, false);
+}
+
 #endif  // PIE_NOON_USES_GOOGLE_PLAY_GAMES
 
 void PieNoonGame::ReloadMultiscreenMenu() {
@@ -2156,9 +3257,25 @@ void PieNoonGame::SetupWaitingForPlayersMenu() {
 // and care about.  (Not all are connected to players, but we want
 // to keep them up to date so we can check their inputs as needed.)
 void PieNoonGame::UpdateControllers(WorldTime delta_time) {
-  for (size_t i = 0; i < active_controllers_.size(); i++) {
-    if (active_controllers_[i].get() != nullptr) {
-      active_controllers_[i]->AdvanceFrame(delta_time);
+  // Update in type order rather than slot order: consecutive virtual calls
+  // then share one AdvanceFrame target, so the indirect branch predicts,
+  // and all the AI controllers think as one contiguous batch (which is
+  // what lets the staggered AI scheduler spread its cost evenly across
+  // frames). Controllers are independent -- each only writes its own
+  // logical inputs -- so the order is free to choose, and with at most a
+  // handful of controllers the extra passes over the vector are noise.
+  static const Controller::ControllerType kUpdateOrder[] = {
+      Controller::kTypeAI,          Controller::kTypePlayer,
+      Controller::kTypeTouchScreen, Controller::kTypeGamepad,
+      Controller::kTypeCardboard,   Controller::kTypeMultiplayer,
+      Controller::kTypeUndefined};
+  for (size_t type = 0; type < PIE_ARRAYSIZE(kUpdateOrder); type++) {
+    for (size_t i = 0; i < active_controllers_.size(); i++) {
+      Controller* controller = active_controllers_[i].get();
+      if (controller != nullptr &&
+          controller->controller_type() == kUpdateOrder[type]) {
+        controller->AdvanceFrame(delta_time);
+      }
     }
   }
 }
@@ -2183,6 +3300,23 @@ void PieNoonGame::UpdateTouchButtons(WorldTime delta_time) {
   }
 }
 
+// Run each sound in the config's prewarm_sounds list through a play/stop
+// cycle. Starting a sound pulls its sample data through pindrop's load and
+// decode path; stopping it in the same frame, before the engine next mixes,
+// keeps it inaudible. Afterwards the samples sit warm in the engine's
+// caches, so the first real play (the first pie impact) doesn't hitch.
+void PieNoonGame::PrewarmSounds() {
+  const Config& config = GetConfig();
+  if (config.prewarm_sounds() == nullptr) return;
+  for (size_t i = 0; i < config.prewarm_sounds()->Length(); ++i) {
+    pindrop::Channel channel =
+        audio_engine_.PlaySound(config.prewarm_sounds()->Get(i)->c_str());
+    if (channel.Valid()) channel.Stop();
+  }
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "prewarmed %d sounds",
+              static_cast<int>(config.prewarm_sounds()->Length()));
+}
+
 pindrop::Channel PieNoonGame::PlayStinger() {
   auto& characters = game_state_.characters();
   int player_winners = 0;
@@ -2316,17 +3450,74 @@ void PieNoonGame::Run() {
     }
 #endif
 
+    // Pick up edits to config.bin before anything reads the config this
+    // frame, so the swap is atomic from the simulation's point of view.
+    CheckConfigHotReload(world_time);
+
+    profiler_.BeginFrame();
+
+    // GPU pass timings resolve a few frames after submission; fold the
+    // most recently resolved numbers into the same history as the CPU
+    // zones so the HUD and CSV show both.
+    float gpu_frame_ms = 0.0f;
+    for (int i = 0; i < renderer_.gpu_zone_count(); ++i) {
+      const Renderer::GpuZoneStats& gpu_zone = renderer_.gpu_zone(i);
+      profiler_.RecordExternalMs(gpu_zone.name, gpu_zone.elapsed_ms);
+      gpu_frame_ms += gpu_zone.elapsed_ms;
+    }
+    // Steer the dynamic resolution controller on the summed GPU pass
+    // times (a few frames stale, as timer queries resolve late).
+    dynamic_resolution_.AdvanceFrame(gpu_frame_ms);
+
+    // Capture a report if the frame just closed out was a hitch, and
+    // periodically ship the rolling pacing summary to analytics.
+    CheckFrameHitch(world_time);
+    ReportFramePacing(world_time);
+
     // TODO: Can we move these to 'Render'?
     renderer_.AdvanceFrame(input_.minimized_);
     renderer_.ClearFrameBuffer(mathfu::kZeros4f);
 
-    // Process input device messages since the last game loop.
-    // Update render window size.
-    input_.AdvanceFrame(&renderer_.window_size());
+    // One texture residency step per frame: finalize finished reloads,
+    // requeue evicted textures that came back on screen, and evict the
+    // least recently bound textures while over the GPU budget.
+    matman_.AdvanceTextureResidencyFrame();
+
+    {
+      ScopedProfileZone zone(&profiler_, "input");
+      // Process input device messages since the last game loop.
+      // Update render window size.
+      input_.AdvanceFrame(&renderer_.window_size());
+
+      UpdateGamepadControllers();
+      // During replay playback the recorder drives the characters'
+      // controllers; live updates would fight it.
+      if (!replay_recorder_.playing_back()) {
+        UpdateControllers(delta_time);
+      }
+      UpdateTouchButtons(delta_time);
+    }
+
+    if (input_.GetButton(SDLK_F3).went_down()) {
+      show_profiler_hud_ = !show_profiler_hud_;
+    }
+
+    // F4 replays the recorded last ~30s of gameplay through the
+    // simulation; pressing it again stops early. No-op when nothing has
+    // been recorded yet.
+    if (input_.GetButton(SDLK_F4).went_down()) {
+      if (replay_recorder_.playing_back()) {
+        replay_recorder_.StopPlayback();
+      } else {
+        replay_recorder_.StartPlayback(&game_state_);
+      }
+    }
 
-    UpdateGamepadControllers();
-    UpdateControllers(delta_time);
-    UpdateTouchButtons(delta_time);
+    // Hold F2 to capture frames (store assets, visual QA). Tapping grabs a
+    // single frame; see Renderer::RequestScreenshot for where they land.
+    if (input_.GetButton(SDLK_F2).is_down()) {
+      renderer_.RequestScreenshot();
+    }
 
     // Update the full screen fader dimensions.
     const auto res = renderer_.window_size();
@@ -2525,47 +3716,98 @@ void PieNoonGame::Run() {
         }
 #endif
 
-        if (state_ != kPaused && state_ != kMultiscreenClient) {
-          // Update game logic by a variable number of milliseconds.
-          game_state_.AdvanceFrame(delta_time, &audio_engine_);
-        } else {
-          // We are the client, we only update a few small things.
-          game_state_.particle_manager().AdvanceFrame(
-              static_cast<TimeStep>(delta_time));
-          game_state_.engine().AdvanceFrame(delta_time);
+        {
+          ScopedProfileZone zone(&profiler_, "gamestate");
+          const WorldTime timestep = config.simulation_timestep();
+          if (state_ != kPaused && state_ != kMultiscreenClient) {
+            if (timestep > 0) {
+              // Advance the simulation in fixed steps, then tell the game
+              // state how far into the next step rendering is so it can
+              // interpolate transforms. Simulation behavior stays identical
+              // at any frame rate.
+              sim_time_accumulator_ = std::min(
+                  sim_time_accumulator_ + delta_time,
+                  static_cast<WorldTime>(timestep * kMaxSimStepsPerFrame));
+              while (sim_time_accumulator_ >= timestep) {
+                // Record (or, during playback, re-apply) this step's
+                // controller bitmaps before the simulation consumes them.
+                if (replay_recorder_.playing_back()) {
+                  replay_recorder_.PlaybackStep(&game_state_);
+                } else if (state_ == kPlaying) {
+                  replay_recorder_.RecordStep(&game_state_);
+                }
+                game_state_.AdvanceFrame(timestep, &audio_engine_);
+                sim_time_accumulator_ -= timestep;
+              }
+              game_state_.set_render_interpolant(
+                  static_cast<float>(sim_time_accumulator_) / timestep);
+            } else {
+              // Update game logic by a variable number of milliseconds.
+              game_state_.AdvanceFrame(delta_time, &audio_engine_);
+            }
+          } else {
+            // We are the client, we only update a few small things.
+            game_state_.particle_manager().AdvanceFrame(
+                static_cast<TimeStep>(delta_time));
+            game_state_.engine().AdvanceFrame(delta_time);
+          }
         }
 
         if (state_ == kPlaying && !stinger_channel_.Valid() &&
             game_state_.IsGameOver()) {
           game_state_.DetermineWinnersAndLosers();
           stinger_channel_ = PlayStinger();
+          // The stinger buys a few seconds before the transition out of
+          // kPlaying. Use them: the stats are final once the winners are
+          // determined, so log and submit them now, and start streaming
+          // in the next state's assets, so the transition frame itself
+          // has nothing heavy left to do.
+          game_state_.PostGameLogging();
+          if (game_state_.is_multiscreen() &&
+              multiplayer_director_ != nullptr) {
+            PrefetchStateAssets(kMultiplayerWaiting);
+          } else {
+            UploadEvents();
+            PrefetchStateAssets(kFinished);
+          }
         }
 
-        // Update audio engine state.
-        audio_engine_.AdvanceFrame(world_time);
+        {
+          ScopedProfileZone zone(&profiler_, "audio");
+          // Update audio engine state.
+          audio_engine_.AdvanceFrame(world_time);
+        }
 
         // Issue draw calls for the 'scene'.
         if (state_ != kMultiscreenClient) {
-          // Populate 'scene' from the game state--all the positions,
-          // orientations, and renderable-ids (which specify materials) of the
-          // characters and props. Also specify the camera matrix.
-          game_state_.PopulateScene(&scene_);
+          // Alternate between the two scene buffers so the buffer being
+          // populated is never the one being submitted.
+          SceneDescription& scene = scene_buffers_[scene_write_buffer_];
+          scene_write_buffer_ ^= 1;
+          {
+            ScopedProfileZone zone(&profiler_, "scene");
+            // Populate 'scene' from the game state--all the positions,
+            // orientations, and renderable-ids (which specify materials) of
+            // the characters and props. Also specify the camera matrix.
+            game_state_.PopulateScene(&scene);
+          }
 
           // Issue draw calls for the 'scene'.
-          Render(scene_);
+          ScopedProfileZone zone(&profiler_, "render");
+          Render(scene);
         } else {
+          ScopedProfileZone zone(&profiler_, "render");
           Render2DElements();
         }
 
 // TEMP: testing GUI on top of everything else.
 #if IMGUI_TEST
-        // Open OpenType font
-        static FontManager fontman;
-        if (!fontman.FontLoaded()) {
-          fontman.Open("fonts/NotoSansCJKjp-Bold.otf");
-          fontman.SetRenderer(renderer_);
+        // FreeType is a singleton within FontManager, so share the game's
+        // instance (its face is opened asynchronously; see
+        // RenderProfilerHUD).
+        if (font_manager_.FontLoaded()) {
+          gui::TestGUI(matman_, font_manager_, input_);
         }
-        gui::TestGUI(matman_, fontman, input_);
 #endif  // IMGUI_TEST
 
         // Output debug information.
@@ -2707,7 +3949,30 @@ void PieNoonGame::Run() {
       default:
         assert(false);
     }
+
+    if (show_profiler_hud_) {
+      RenderProfilerHUD();
+    }
+
+    // Idle governor. A menu or the pause screen left alone for a while is
+    // effectively static (the background scene only idle-animates), so arm
+    // the input system's event wait for the next frame: the loop drops to
+    // roughly one update per menu_idle_update_time ms and the process
+    // sleeps in the OS between them. Any input ends the wait immediately,
+    // and the grace period keeps the full rate through button and fader
+    // animations, which are always kicked off by an event.
+    const WorldTime idle_update_time = config.menu_idle_update_time();
+    if (idle_update_time > 0 &&
+        (state_ == kPaused || state_ == kFinished) &&
+        full_screen_fader_.Finished(world_time) &&
+        world_time - input_.last_event_time() >=
+            config.menu_idle_grace_time()) {
+      input_.set_idle_wait_time(idle_update_time);
+    }
   }
+
+  profiler_.DumpCSV("profile.csv");
+  AllocTracker::LogStatus();
 }
 
 }  // pie_noon
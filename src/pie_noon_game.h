@@ -19,8 +19,12 @@
 #define PIE_NOON_USES_GOOGLE_PLAY_GAMES
 #endif
 
+#include <ctime>
+
 #include "ai_controller.h"
 #include "cardboard_controller.h"
+#include "dynamic_resolution.h"
+#include "font_manager.h"
 #include "full_screen_fader.h"
 #include "game_state.h"
 #include "gui_menu.h"
@@ -30,10 +34,13 @@
 #include "multiplayer_director.h"
 #include "pindrop/pindrop.h"
 #include "player_controller.h"
+#include "profiler.h"
 #include "renderer.h"
+#include "replay.h"
 #include "scene_description.h"
 #include "touchscreen_button.h"
 #include "touchscreen_controller.h"
+#include "utilities.h"
 
 #ifdef ANDROID_GAMEPAD
 #include "gamepad_controller.h"
@@ -75,21 +82,46 @@ class PieNoonGame {
 #ifdef ANDROID_CARDBOARD
   bool InitializeCardboardConfig();
 #endif
+  // Development aid: poll config.bin for edits and, when it changes, swap
+  // in a freshly verified buffer between frames so designers can tune
+  // values without restarting. Desktop builds only.
+  void CheckConfigHotReload(WorldTime world_time);
   bool InitializeRenderer();
   Mesh* CreateVerticalQuadMesh(const flatbuffers::String* material_name,
                                const vec3& offset, const vec2& pixel_bounds,
-                               float pixel_to_world_scale);
+                               float pixel_to_world_scale,
+                               NormalMappedVertex* out_vertices = nullptr);
   bool InitializeRenderingAssets();
   bool InitializeGameState();
-  void RenderCardboard(const SceneDescription& scene,
-                       const mat4& camera_transform);
+  // One view of the scene: a per-eye camera adjustment and the viewport it
+  // draws into. Mono rendering uses a single view; Cardboard uses one per
+  // eye, and the render loops set each piece of state once and then draw it
+  // into every view back to back, instead of traversing the whole scene per
+  // eye.
+  struct RenderView {
+    mat4 eye_transform;     // Applied between the scene camera and projection.
+    vec2i viewport_offset;  // In pixels.
+    vec2i viewport_size;    // In pixels.
+  };
+  void SetEyeViewport(const RenderView& view, int num_views);
+  void SortSceneRenderOrder(const SceneDescription& scene,
+                            const mat4* camera_transforms, int num_views);
+  void UpdateMergedStaticProps(const SceneDescription& scene);
+  void RenderMergedStaticProps(const SceneDescription& scene,
+                               const RenderView* views,
+                               const mat4* camera_transforms, int num_views);
+  void RenderCardboard(const SceneDescription& scene, const RenderView* views,
+                       const mat4* camera_transforms, int num_views);
   void Render(const SceneDescription& scene);
   void RenderForDefault(const SceneDescription& scene);
   void RenderForCardboard(const SceneDescription& scene);
-  void RenderScene(const SceneDescription& scene,
-                   const mat4& additional_camera_changes,
-                   const vec2i& resolution);
+  void RenderScene(const SceneDescription& scene, const RenderView* views,
+                   int num_views, const vec2i& resolution);
   void Render2DElements();
+  void RenderProfilerHUD();
+  void CheckFrameHitch(WorldTime world_time);
+  float HitchThresholdMs() const;
+  void ReportFramePacing(WorldTime world_time);
   void GetCardboardTransforms(mat4& left_eye_transform,
                               mat4& right_eye_transform);
   void CorrectCardboardCamera(mat4& cardboard_camera);
@@ -102,6 +134,7 @@ class PieNoonGame {
 #endif
   const CharacterStateMachineDef* GetStateMachine() const;
   Mesh* GetCardboardFront(int renderable_id);
+  bool RenderableNeedsBlending(int renderable_id);
   PieNoonState UpdatePieNoonState();
   void TransitionToPieNoonState(PieNoonState next_state);
   PieNoonState UpdatePieNoonStateAndTransition();
@@ -114,7 +147,6 @@ class PieNoonGame {
   int FindAiPlayer();
   ControllerId AddController(Controller* new_controller);
   Controller* GetController(ControllerId id);
-  ControllerId FindNextUniqueControllerId();
   void HandlePlayersJoining(Controller* controller);
   void HandlePlayersJoining();
   void AttachMultiplayerControllers();
@@ -124,6 +156,7 @@ class PieNoonGame {
   void UpdateTouchButtons(WorldTime delta_time);
 
   pindrop::Channel PlayStinger();
+  void PrewarmSounds();
   void InitCountdownImage(int seconds);
   void UpdateCountdownImage(WorldTime time);
 
@@ -132,10 +165,13 @@ class PieNoonGame {
   bool AnyControllerPresses();
   void LoadTutorialSlide(int slide_index);
   void LoadInitialTutorialSlides();
+  void PrefetchStateAssets(PieNoonState state);
   void RenderInMiddleOfScreen(const mathfu::mat4& ortho_mat, float x_scale,
                               Material* material);
 
   void ProcessMultiplayerMessages();
+  void HandleMultiplayerMessage(const std::string& sender,
+                                const multiplayer::MessageRoot* message);
   void ProcessPlayerStatusMessage(const multiplayer::PlayerStatus&);
 
   // returns true if a new splat was displayed
@@ -151,6 +187,7 @@ class PieNoonGame {
   void StartMultiscreenGameAsHost();
   void StartMultiscreenGameAsClient(CharacterId id);
   void SendMultiscreenPlayerCommand();
+  void SendMultiscreenStatusAck(unsigned short sequence);
 #endif
   void ReloadMultiscreenMenu();
   void UpdateMultiscreenMenuIcons();
@@ -164,12 +201,25 @@ class PieNoonGame {
   // prev_world_time_.
   WorldTime state_entry_time_;
 
-  // Hold configuration binary data.
-  std::string config_source_;
+  // Hold configuration binary data, mapped (or read) directly from disk.
+  // FlatBuffers are accessed in place, so no parse-time copy is made.
+  MappedFile config_source_;
 #ifdef ANDROID_CARDBOARD
-  std::string cardboard_config_source_;
+  MappedFile cardboard_config_source_;
 #endif
 
+  // Previous generations of the config buffer, retired by hot reloads but
+  // kept alive because subsystems cache pointers into the buffer they were
+  // set up with (menu defs, the current character arrangement). Those
+  // pointers stay valid until the subsystem naturally re-reads the config.
+  std::vector<std::unique_ptr<MappedFile>> retired_config_sources_;
+
+  // Modification time of config.bin when it was last (re)loaded, and the
+  // next time we'll poll it. Zero mtime disables polling (e.g. when the
+  // config was served from an asset bundle and there is no file to watch).
+  time_t config_mtime_;
+  WorldTime next_config_poll_time_;
+
   // Report touches, button presses, keyboard presses.
   InputSystem input_;
 
@@ -190,18 +240,73 @@ class PieNoonGame {
   Mesh* stick_front_;
   Mesh* stick_back_;
 
-  // Shaders we use.
+  // Shaders we use. The two cardboard entries are variants of one source:
+  // with and without the normal-map code compiled in. RenderCardboard
+  // picks per material, so fronts that ship no normal map never pay for
+  // the sampling.
   Shader* shader_cardboard;
+  Shader* shader_cardboard_flat_;
   Shader* shader_lit_textured_normal_;
   Shader* shader_simple_shadow_;
   Shader* shader_textured_;
+  Shader* shader_textured_colored_;
   Shader* shader_grayscale_;
 
   // Shadow material.
   Material* shadow_mat_;
 
-  // Hold state machine binary data.
-  std::string state_machine_source_;
+  // Local-space bounding sphere for each renderable id: xyz is the sphere
+  // center, w the radius. Computed from the quad geometry (including the
+  // popsicle stick, when present) and used to frustum cull renderables.
+  std::vector<mathfu::vec4> renderable_bounds_;
+
+  // Untransformed corner vertices of each cardboard front quad, four per
+  // renderable id. Used by the instanced quad batch path, which transforms
+  // the corners on the CPU rather than going through the Mesh VBO.
+  std::vector<NormalMappedVertex> cardboard_front_vertices_;
+
+  // Same for the cardboard back quads, for ids that have one. Used by the
+  // static prop merge below.
+  std::vector<NormalMappedVertex> cardboard_back_vertices_;
+
+  // Arena props that can never move (see SceneObjectData::merge_static),
+  // baked per renderable id into one world-space mesh: one draw for the
+  // fronts and one for the backs, instead of a draw per prop. Rebuilt by
+  // UpdateMergedStaticProps whenever the static scene cache changes
+  // generation. Ids whose draw needs per-renderable state (a stick, a
+  // shadow, alpha blending, a non-white tint) stay on the regular path.
+  struct MergedPropMesh {
+    int id;
+    Mesh* front;  // Owned. Never null.
+    Mesh* back;   // Owned. Null when the id has no back mesh.
+  };
+  std::vector<MergedPropMesh> merged_prop_meshes_;
+
+  // Per renderable id: nonzero when a merged mesh exists for the id, so
+  // SortSceneRenderOrder can drop the individual renderables it covers.
+  // Sized RenderableId_Count once the merge has run; empty before then.
+  std::vector<uint8_t> merged_prop_id_;
+
+  // static_version() of the scene the merged meshes were built from.
+  uint32_t merged_props_version_;
+
+  // Indices into SceneDescription::renderables(), in submission order:
+  // opaque renderables front-to-back, then blended renderables
+  // back-to-front. Rebuilt by SortSceneRenderOrder each frame; a member so
+  // the allocation is reused.
+  std::vector<int> scene_render_order_;
+
+  // Scratch list of the blended renderables' indices, appended to
+  // scene_render_order_ once both passes are sorted.
+  std::vector<int> scene_render_translucent_;
+
+  // View depth of each renderable this frame, indexed like
+  // SceneDescription::renderables(). Only entries for renderables that
+  // survive culling are meaningful.
+  std::vector<float> scene_render_depth_;
+
+  // Hold state machine binary data, mapped like the config above.
+  MappedFile state_machine_source_;
 
   // Hold characters, pies, camera state.
   GameState game_state_;
@@ -221,13 +326,28 @@ class PieNoonGame {
   // player starts aimed at the next player (or p3 is aimed back at p0).
   CharacterId multiscreen_action_aim_at_;
   int multiscreen_turn_number_;
+  // On the client, the sequence number of the last PlayerStatus applied.
+  // Standalone statuses arrive unreliably, so older ones may land after
+  // newer ones; anything not newer than this is dropped. 0 means none
+  // applied yet (and is never a real sequence number).
+  unsigned short multiscreen_last_status_sequence_;
+  // On the client, the current splat bitmask per player, accumulated from
+  // full and delta PlayerStatus messages. Deltas only list the players
+  // that changed, so the rest must be remembered here.
+  std::vector<uint8_t> multiscreen_player_splats_;
   // Animation for the multiscreen splats that appear.
   float multiscreen_splat_param;
   float multiscreen_splat_param_speed;
 
   // Description of the scene to be rendered. Isolates gameplay and rendering
   // code with a type-light structure. Recreated every frame.
-  SceneDescription scene_;
+  // Scene snapshots, double buffered: the simulation populates one buffer
+  // while the other one is submitted to the renderer. Both halves still
+  // run in sequence on the main thread, but nothing ever reads the buffer
+  // being written, so moving submission to a dedicated thread only
+  // requires putting a signal in the middle of the handoff.
+  SceneDescription scene_buffers_[2];
+  int scene_write_buffer_;
 
   // World time of previous update. We use this to calculate the delta_time
   // of the current update. This value is tied to the real-world clock.
@@ -236,6 +356,11 @@ class PieNoonGame {
   // prev_world_time_ will keep chugging.
   WorldTime prev_world_time_;
 
+  // Frame time not yet consumed by the fixed-timestep simulation loop.
+  // Always less than one simulation_timestep after an update; unused when
+  // the config leaves simulation_timestep at 0.
+  WorldTime sim_time_accumulator_;
+
   // Debug data. For displaying when a character's state has changed.
   std::vector<int> debug_previous_states_;
   std::vector<Angle> debug_previous_angles_;
@@ -265,6 +390,10 @@ class PieNoonGame {
   // Channel for the menu music or in-game music.
   pindrop::Channel music_channel_;
 
+  // Whether the config's prewarm_sounds list has been run through during
+  // the loading state; it only needs to happen once per launch.
+  bool sounds_prewarmed_;
+
   // Tutorial slides we are in the midst of displaying.
   std::vector<std::string> tutorial_slides_;
 
@@ -293,6 +422,37 @@ class PieNoonGame {
   // The Worldtime when the game was paused, used just for analytics.
   WorldTime pause_time_;
 
+  // Frame-time breakdown of the main loop's phases. The HUD (toggled with
+  // F3 on platforms with a keyboard) shows the recent averages; the full
+  // history is dumped as CSV when the game exits.
+  Profiler profiler_;
+  bool show_profiler_hud_;
+
+  // Renders the profiler HUD's text. The face is opened asynchronously
+  // (warmed during loading via the config's prewarm_font), so toggling
+  // the HUD mid-session never stalls a frame on reading the face file.
+  FontManager font_manager_;
+
+  // Renders the 3D scene at reduced resolution when the GPU falls behind
+  // (e.g. thermal throttling), upscaling in a final blit; the UI stays at
+  // native resolution. Steered by the GPU timer-query feedback; see the
+  // config's dynamic_resolution fields.
+  DynamicResolution dynamic_resolution_;
+
+  // Hitch capture (see CheckFrameHitch): number of reports written this
+  // session, and when the last one was written, for rate limiting.
+  int hitch_captures_;
+  WorldTime last_hitch_capture_time_;
+
+  // When the next frame pacing summary goes to the analytics layer; see
+  // ReportFramePacing. Zero until the first interval is armed.
+  WorldTime next_pacing_report_time_;
+
+  // Rolling recording of the last ~30s of gameplay inputs. F4 replays it
+  // in-game (platforms with a keyboard); hitch captures attach a dump of
+  // it to the report. See replay.h.
+  ReplayRecorder replay_recorder_;
+
 #ifdef PIE_NOON_USES_GOOGLE_PLAY_GAMES
   GPGManager gpg_manager;
 
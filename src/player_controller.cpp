@@ -23,7 +23,12 @@
 namespace fpl {
 namespace pie_noon {
 
-PlayerController::PlayerController() : Controller(kTypePlayer) {}
+PlayerController::PlayerController() : Controller(kTypePlayer) {
+  for (int i = 0; i < kMaxLogicalInputBits; ++i) {
+    went_down_millis_[i] = kNoInputEvent;
+    went_up_millis_[i] = kNoInputEvent;
+  }
+}
 
 void PlayerController::Initialize(InputSystem* input_system,
                                   const ControlScheme* scheme) {
@@ -31,19 +36,47 @@ void PlayerController::Initialize(InputSystem* input_system,
   scheme_ = scheme;
 }
 
+int PlayerController::BitIndex(uint32_t logical_input) {
+  assert(logical_input != 0 && (logical_input & (logical_input - 1)) == 0);
+  int index = 0;
+  while ((logical_input & 1) == 0) {
+    logical_input >>= 1;
+    index++;
+  }
+  return index;
+}
+
 void PlayerController::AdvanceFrame(WorldTime /*delta_time*/) {
   ClearAllLogicalInputs();
+  for (int i = 0; i < kMaxLogicalInputBits; ++i) {
+    went_down_millis_[i] = kNoInputEvent;
+    went_up_millis_[i] = kNoInputEvent;
+  }
   for (size_t i = 0; i < scheme_->keybinds.size(); ++i) {
     const Keybind& keybind = scheme_->keybinds[i];
-    if (input_system_->GetButton(keybind.physical_input).is_down()) {
+    const Button& button = input_system_->GetButton(keybind.physical_input);
+    if (button.is_down()) {
       is_down_ |= keybind.logical_input;
     }
-    if (input_system_->GetButton(keybind.physical_input).went_down()) {
+    if (button.went_down()) {
       went_down_ |= keybind.logical_input;
     }
-    if (input_system_->GetButton(keybind.physical_input).went_up()) {
+    if (button.went_up()) {
       went_up_ |= keybind.logical_input;
     }
+    // Record the earliest transition time per logical input, so consumers
+    // can order same-frame presses and assign them to simulation sub-steps.
+    const std::vector<ButtonEvent>& events = button.events();
+    if (!events.empty()) {
+      const int bit = BitIndex(keybind.logical_input);
+      for (size_t e = 0; e < events.size(); ++e) {
+        int* slot =
+            events[e].down ? &went_down_millis_[bit] : &went_up_millis_[bit];
+        if (*slot == kNoInputEvent || events[e].millis < *slot) {
+          *slot = events[e].millis;
+        }
+      }
+    }
   }
 }
 
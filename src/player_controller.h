@@ -54,6 +54,10 @@ class ControlScheme {
 // of the physical inputs that map to logical actions.
 class PlayerController : public Controller {
  public:
+  // Returned by went_down_millis()/went_up_millis() when the logical input
+  // made no such transition this frame.
+  static const int kNoInputEvent = -1;
+
   PlayerController();
 
   // Set up a controller using the given input system and control scheme.
@@ -64,12 +68,37 @@ class PlayerController : public Controller {
   // Map the input from the physical inputs to logical game inputs.
   virtual void AdvanceFrame(WorldTime delta_time);
 
+  // The earliest time this frame at which 'logical_input' went down or up,
+  // on the SDL_GetTicks clock in milliseconds, or kNoInputEvent if it made
+  // no such transition. 'logical_input' must be a single LogicalInputs bit.
+  // The went_down/went_up bitmasks collapse everything that happened in a
+  // frame into flags; these times recover the exact order of same-frame
+  // presses, and let a fixed-timestep consumer assign a press to the
+  // simulation sub-step it belongs in.
+  int went_down_millis(uint32_t logical_input) const {
+    return went_down_millis_[BitIndex(logical_input)];
+  }
+  int went_up_millis(uint32_t logical_input) const {
+    return went_up_millis_[BitIndex(logical_input)];
+  }
+
  private:
+  // One slot per possible bit in the logical input bitmask.
+  static const int kMaxLogicalInputBits = 32;
+
+  // The index of the (single) set bit in 'logical_input'.
+  static int BitIndex(uint32_t logical_input);
+
   // A pointer to the object to query for the current input state.
   InputSystem* input_system_;
 
   // The control scheme for this controller.
   const ControlScheme* scheme_;
+
+  // Per-logical-input transition times for the current frame, indexed by
+  // bit position. kNoInputEvent where no transition happened.
+  int went_down_millis_[kMaxLogicalInputBits];
+  int went_up_millis_[kMaxLogicalInputBits];
 };
 
 }  // pie_noon
@@ -0,0 +1,246 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include <cstring>
+#include "profiler.h"
+
+namespace fpl {
+
+const int Profiler::kHistoryFrames;
+const int Profiler::kMaxZones;
+const int Profiler::kPacingBuckets;
+const int Profiler::kPacingBucketsPerMs;
+
+Profiler::Profiler()
+    : open_count_(0),
+      frame_(0),
+      frames_recorded_(0),
+      frame_start_tick_(0),
+      ticks_to_ms_(0.0) {
+  zones_.reserve(kMaxZones);
+  samples_.resize(kHistoryFrames * (kMaxZones + 1), 0.0f);
+  ResetFramePacingStats();
+}
+
+void Profiler::BeginFrame() {
+  // Lazily pick up the counter frequency; SDL may not have been
+  // initialized when the constructor ran.
+  if (ticks_to_ms_ == 0.0) {
+    ticks_to_ms_ = 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+  }
+
+  const uint64_t now = SDL_GetPerformanceCounter();
+  if (frame_start_tick_ != 0) {
+    // Close out the previous frame and advance the ring.
+    const float frame_ms =
+        static_cast<float>((now - frame_start_tick_) * ticks_to_ms_);
+    FrameRow(frame_)[kMaxZones] = frame_ms;
+    frame_ = (frame_ + 1) % kHistoryFrames;
+    if (frames_recorded_ < kHistoryFrames) frames_recorded_++;
+
+    // Bin the frame into the pacing histogram as well; unlike the ring,
+    // the histogram is not bounded in time, so percentiles can cover a
+    // whole reporting interval.
+    int bucket = static_cast<int>(frame_ms *
+                                  static_cast<float>(kPacingBucketsPerMs));
+    if (bucket < 0) bucket = 0;
+    if (bucket > kPacingBuckets) bucket = kPacingBuckets;
+    pacing_counts_[bucket]++;
+    pacing_frames_++;
+    pacing_max_ms_ = std::max(pacing_max_ms_, frame_ms);
+  }
+  memset(FrameRow(frame_), 0, (kMaxZones + 1) * sizeof(float));
+  frame_start_tick_ = now;
+  open_count_ = 0;  // Unbalanced opens shouldn't wedge the stack forever.
+}
+
+int Profiler::OpenZone(const char *name) {
+  int index = -1;
+  for (size_t i = 0; i < zones_.size(); ++i) {
+    if (zones_[i].name == name || strcmp(zones_[i].name, name) == 0) {
+      index = static_cast<int>(i);
+      break;
+    }
+  }
+  if (index < 0) {
+    if (zone_count() >= kMaxZones) return -1;  // Table full; record nothing.
+    Zone zone;
+    zone.name = name;
+    zone.depth = open_count_;
+    index = zone_count();
+    zones_.push_back(zone);
+  }
+
+  if (open_count_ >= kMaxZones) return -1;
+  open_stack_[open_count_].index = index;
+  open_stack_[open_count_].start_tick = SDL_GetPerformanceCounter();
+  open_count_++;
+  return index;
+}
+
+void Profiler::CloseZone(int zone_index) {
+  if (open_count_ <= 0) return;
+  const OpenedZone &open = open_stack_[open_count_ - 1];
+  assert(open.index == zone_index);
+  (void)zone_index;
+  const uint64_t now = SDL_GetPerformanceCounter();
+  // += rather than =, so a zone opened several times per frame accumulates.
+  FrameRow(frame_)[open.index] +=
+      static_cast<float>((now - open.start_tick) * ticks_to_ms_);
+  open_count_--;
+}
+
+void Profiler::RecordExternalMs(const char *name, float ms) {
+  int index = -1;
+  for (size_t i = 0; i < zones_.size(); ++i) {
+    if (zones_[i].name == name || strcmp(zones_[i].name, name) == 0) {
+      index = static_cast<int>(i);
+      break;
+    }
+  }
+  if (index < 0) {
+    if (zone_count() >= kMaxZones) return;
+    Zone zone;
+    zone.name = name;
+    zone.depth = 0;
+    index = zone_count();
+    zones_.push_back(zone);
+  }
+  FrameRow(frame_)[index] += ms;
+}
+
+float Profiler::ColumnAverageMs(int column) const {
+  if (frames_recorded_ == 0) return 0.0f;
+  float sum = 0.0f;
+  for (int f = 0; f < frames_recorded_; ++f) {
+    sum += FrameRow(f)[column];
+  }
+  return sum / static_cast<float>(frames_recorded_);
+}
+
+float Profiler::ColumnMaxMs(int column) const {
+  float max = 0.0f;
+  for (int f = 0; f < frames_recorded_; ++f) {
+    max = std::max(max, FrameRow(f)[column]);
+  }
+  return max;
+}
+
+float Profiler::ZoneAverageMs(int zone_index) const {
+  return ColumnAverageMs(zone_index);
+}
+
+float Profiler::ZoneMaxMs(int zone_index) const {
+  return ColumnMaxMs(zone_index);
+}
+
+float Profiler::FrameAverageMs() const { return ColumnAverageMs(kMaxZones); }
+
+float Profiler::FrameMaxMs() const { return ColumnMaxMs(kMaxZones); }
+
+float Profiler::LastFrameMs() const {
+  if (frames_recorded_ == 0) return 0.0f;
+  const int last = (frame_ + kHistoryFrames - 1) % kHistoryFrames;
+  return FrameRow(last)[kMaxZones];
+}
+
+// Find the duration below which 'fraction' of the counted frames fall, by
+// walking the cumulative histogram. Linear interpolation within the
+// terminal bucket; the overflow bucket has no upper edge, so percentiles
+// landing there report the interval's worst frame instead.
+float Profiler::PacingPercentileMs(float fraction) const {
+  const float target = fraction * static_cast<float>(pacing_frames_);
+  float cumulative = 0.0f;
+  for (int i = 0; i < kPacingBuckets; ++i) {
+    const float count = static_cast<float>(pacing_counts_[i]);
+    if (cumulative + count >= target && count > 0.0f) {
+      const float within = (target - cumulative) / count;
+      return (static_cast<float>(i) + within) /
+             static_cast<float>(kPacingBucketsPerMs);
+    }
+    cumulative += count;
+  }
+  return pacing_max_ms_;
+}
+
+Profiler::FramePacingStats Profiler::GetFramePacingStats(
+    float hitch_threshold_ms) const {
+  FramePacingStats stats;
+  stats.frame_count = pacing_frames_;
+  if (pacing_frames_ == 0) {
+    stats.p50_ms = stats.p95_ms = stats.p99_ms = 0.0f;
+    stats.hitch_count = 0;
+    return stats;
+  }
+  stats.p50_ms = PacingPercentileMs(0.50f);
+  stats.p95_ms = PacingPercentileMs(0.95f);
+  stats.p99_ms = PacingPercentileMs(0.99f);
+
+  int first_hitch_bucket = static_cast<int>(
+      hitch_threshold_ms * static_cast<float>(kPacingBucketsPerMs));
+  if (first_hitch_bucket < 0) first_hitch_bucket = 0;
+  if (first_hitch_bucket > kPacingBuckets) first_hitch_bucket = kPacingBuckets;
+  int hitches = 0;
+  for (int i = first_hitch_bucket; i <= kPacingBuckets; ++i) {
+    hitches += static_cast<int>(pacing_counts_[i]);
+  }
+  stats.hitch_count = hitches;
+  return stats;
+}
+
+void Profiler::ResetFramePacingStats() {
+  memset(pacing_counts_, 0, sizeof(pacing_counts_));
+  pacing_frames_ = 0;
+  pacing_max_ms_ = 0.0f;
+}
+
+bool Profiler::DumpCSV(const char *filename) const {
+  std::string out;
+  for (int i = 0; i < zone_count(); ++i) {
+    out += zones_[i].name;
+    out += ',';
+  }
+  out += "total\n";
+
+  // Rows come out oldest first. Once the ring has wrapped, the oldest
+  // frame is the one the ring index points at next.
+  const int start = frames_recorded_ < kHistoryFrames
+                        ? 0
+                        : (frame_ + 1) % kHistoryFrames;
+  char number[32];
+  for (int f = 0; f < frames_recorded_; ++f) {
+    const float *row = FrameRow((start + f) % kHistoryFrames);
+    for (int i = 0; i < zone_count(); ++i) {
+      snprintf(number, sizeof(number), "%.3f,", row[i]);
+      out += number;
+    }
+    snprintf(number, sizeof(number), "%.3f\n", row[kMaxZones]);
+    out += number;
+  }
+
+  SDL_RWops *file = SDL_RWFromFile(filename, "w");
+  if (file == nullptr) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "profiler: can't write %s: %s",
+                 filename, SDL_GetError());
+    return false;
+  }
+  SDL_RWwrite(file, out.c_str(), 1, out.length());
+  SDL_RWclose(file);
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "profiler: wrote %d frames to %s",
+              frames_recorded_, filename);
+  return true;
+}
+
+}  // namespace fpl
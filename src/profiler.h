@@ -0,0 +1,187 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PIE_NOON_PROFILER_H
+#define PIE_NOON_PROFILER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace fpl {
+
+// Lightweight frame profiler for triaging hitches.
+//
+// The main loop calls BeginFrame() once per frame and brackets the phases
+// it cares about (input, game state, scene population, render, audio) in
+// ScopedProfileZone instances. Zones register themselves by name on first
+// use and may nest; the nesting depth is recorded so displays can indent
+// children under their parent. Per-frame zone durations are kept in a
+// fixed ring buffer of the last kHistoryFrames frames, so sampling costs
+// two performance-counter reads per zone and never allocates after the
+// constructor.
+//
+// The recent history can be summarized for an on-screen HUD (average and
+// worst milliseconds per zone) or dumped as CSV - one row per frame, one
+// column per zone - for offline triage.
+//
+// Separately from the ring, every completed frame's duration is also
+// binned into a small fixed histogram, so pacing percentiles cover
+// arbitrarily long stretches (an analytics reporting interval, a whole
+// session) rather than just the last kHistoryFrames frames. See
+// GetFramePacingStats.
+class Profiler {
+ public:
+  // How many frames of history the ring buffer keeps (~2s at 60Hz).
+  static const int kHistoryFrames = 120;
+  // Maximum number of distinct zones; opens beyond this are ignored.
+  static const int kMaxZones = 15;
+  // Frame pacing histogram: kPacingBuckets buckets of
+  // 1/kPacingBucketsPerMs milliseconds each (covering 0..32ms), plus an
+  // overflow bucket for anything slower.
+  static const int kPacingBuckets = 64;
+  static const int kPacingBucketsPerMs = 2;
+
+  Profiler();
+
+  // Call at the top of the main loop: closes out the previous frame's
+  // samples and starts recording a new frame.
+  void BeginFrame();
+
+  // Start timing the named zone. 'name' must outlive the profiler (use a
+  // string literal). Returns the zone index to pass to CloseZone, or -1
+  // if the zone table is full. Prefer ScopedProfileZone over calling
+  // these directly.
+  int OpenZone(const char *name);
+
+  // Stop timing the zone and add the elapsed time to this frame's sample.
+  void CloseZone(int zone_index);
+
+  // Record a sample measured outside the profiler's own timers, e.g. a GPU
+  // pass resolved from a timer query. Registers the zone like OpenZone;
+  // the sample lands in the current frame's row.
+  void RecordExternalMs(const char *name, float ms);
+
+  // Number of zones seen so far.
+  int zone_count() const { return static_cast<int>(zones_.size()); }
+
+  // Name and nesting depth of a registered zone.
+  const char *zone_name(int zone_index) const {
+    return zones_[zone_index].name;
+  }
+  int zone_depth(int zone_index) const { return zones_[zone_index].depth; }
+
+  // Average / worst duration of one zone over the recorded history, in
+  // milliseconds.
+  float ZoneAverageMs(int zone_index) const;
+  float ZoneMaxMs(int zone_index) const;
+
+  // Average / worst whole-frame duration over the recorded history, in
+  // milliseconds.
+  float FrameAverageMs() const;
+  float FrameMaxMs() const;
+
+  // Duration of the most recently completed frame, in milliseconds. Zero
+  // until the first frame has been closed out by BeginFrame().
+  float LastFrameMs() const;
+
+  // Summary of frame pacing since construction or the last
+  // ResetFramePacingStats(). Percentiles are read from the histogram, so
+  // they're accurate to one bucket (interpolated within the bucket);
+  // percentiles that land in the overflow bucket report the worst frame
+  // actually observed.
+  struct FramePacingStats {
+    float p50_ms;
+    float p95_ms;
+    float p99_ms;
+    // Frames at or above 'hitch_threshold_ms', rounded to bucket
+    // granularity.
+    int hitch_count;
+    // Frames the summary covers.
+    int frame_count;
+  };
+
+  // Summarize the pacing histogram. Cheap enough for a per-frame HUD (one
+  // pass over kPacingBuckets counters); the analytics batcher calls it
+  // once per reporting interval and then resets.
+  FramePacingStats GetFramePacingStats(float hitch_threshold_ms) const;
+
+  // Start a fresh pacing interval, e.g. after reporting one.
+  void ResetFramePacingStats();
+
+  // Write the recorded history as CSV: a header row of zone names plus
+  // "total", then one row per frame, oldest first. Returns false (and
+  // logs) if the file can't be written.
+  bool DumpCSV(const char *filename) const;
+
+ private:
+  struct Zone {
+    const char *name;
+    int depth;  // Nesting depth at first open; used for display indent.
+  };
+  struct OpenedZone {
+    int index;
+    uint64_t start_tick;
+  };
+
+  // Sample row for frame 'f': samples_[f * (kMaxZones + 1)], one column
+  // per zone plus a final column for the whole frame.
+  float *FrameRow(int frame) {
+    return &samples_[frame * (kMaxZones + 1)];
+  }
+  const float *FrameRow(int frame) const {
+    return &samples_[frame * (kMaxZones + 1)];
+  }
+
+  // Average / max of one sample column over the recorded history.
+  float ColumnAverageMs(int column) const;
+  float ColumnMaxMs(int column) const;
+
+  // Duration below which 'fraction' of the histogram's frames fall.
+  float PacingPercentileMs(float fraction) const;
+
+  std::vector<Zone> zones_;
+  std::vector<float> samples_;  // kHistoryFrames rows, see FrameRow().
+  // Pacing histogram: counts of completed frames per duration bucket,
+  // with the last entry collecting everything past the range. Maintained
+  // by BeginFrame, summarized by GetFramePacingStats.
+  uint32_t pacing_counts_[kPacingBuckets + 1];
+  int pacing_frames_;
+  float pacing_max_ms_;  // Worst frame in the current pacing interval.
+  OpenedZone open_stack_[kMaxZones];
+  int open_count_;
+  int frame_;            // Ring index of the frame being recorded.
+  int frames_recorded_;  // Completed frames, saturates at kHistoryFrames.
+  uint64_t frame_start_tick_;
+  double ticks_to_ms_;  // Performance counter period, lazily initialized.
+};
+
+// Times a profiler zone for the duration of a scope. A null profiler is
+// allowed and records nothing.
+class ScopedProfileZone {
+ public:
+  ScopedProfileZone(Profiler *profiler, const char *name)
+      : profiler_(profiler),
+        zone_index_(profiler != nullptr ? profiler->OpenZone(name) : -1) {}
+  ~ScopedProfileZone() {
+    if (zone_index_ >= 0) profiler_->CloseZone(zone_index_);
+  }
+
+ private:
+  Profiler *profiler_;
+  int zone_index_;
+};
+
+}  // namespace fpl
+
+#endif  // PIE_NOON_PROFILER_H
@@ -16,10 +16,72 @@
 #include "renderer.h"
 #include "utilities.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "webp/decode.h"
+#include "webp/encode.h"
 
 namespace fpl {
 
+// The program binary entry points are extensions everywhere we run
+// (GL_ARB_get_program_binary on desktop, GL_OES_get_program_binary on GLES2),
+// so they're resolved separately from the mandatory GLEXT list and may stay
+// null. Shader caching is simply disabled when they do.
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#if defined(PLATFORM_MOBILE)
+#define PIE_GL_APIENTRYP GL_APIENTRYP
+#elif defined(APIENTRYP)
+#define PIE_GL_APIENTRYP APIENTRYP
+#else
+#define PIE_GL_APIENTRYP *
+#endif
+typedef void(PIE_GL_APIENTRYP GetProgramBinaryFunction)(
+    GLuint program, GLsizei buf_size, GLsizei *length, GLenum *binary_format,
+    void *binary);
+typedef void(PIE_GL_APIENTRYP ProgramBinaryFunction)(GLuint program,
+                                                     GLenum binary_format,
+                                                     const void *binary,
+                                                     GLsizei length);
+static GetProgramBinaryFunction gl_get_program_binary = nullptr;
+static ProgramBinaryFunction gl_program_binary = nullptr;
+
+// Timer queries are optional too (GL_EXT_disjoint_timer_query on GLES2,
+// GL_ARB_timer_query on desktop). When they're missing, GPU zones still
+// count draw calls but report zero elapsed time.
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE_EXT
+#define GL_QUERY_RESULT_AVAILABLE_EXT 0x8867
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+typedef void(PIE_GL_APIENTRYP GenQueriesFunction)(GLsizei n, GLuint *ids);
+typedef void(PIE_GL_APIENTRYP BeginQueryFunction)(GLenum target, GLuint id);
+typedef void(PIE_GL_APIENTRYP EndQueryFunction)(GLenum target);
+typedef void(PIE_GL_APIENTRYP GetQueryObjectuivFunction)(GLuint id,
+                                                         GLenum pname,
+                                                         GLuint *params);
+typedef void(PIE_GL_APIENTRYP GetQueryObjectui64vFunction)(GLuint id,
+                                                           GLenum pname,
+                                                           uint64_t *params);
+static GenQueriesFunction gl_gen_queries = nullptr;
+static BeginQueryFunction gl_begin_query = nullptr;
+static EndQueryFunction gl_end_query = nullptr;
+static GetQueryObjectuivFunction gl_get_query_objectuiv = nullptr;
+static GetQueryObjectui64vFunction gl_get_query_objectui64v = nullptr;
+
+int Renderer::current_draw_calls_ = 0;
+int Renderer::current_triangles_ = 0;
+
 bool Renderer::Initialize(const vec2i &window_size, const char *window_title) {
   // Basic SDL initialization, does not actually initialize a Window or OpenGL,
   // typically should not fail.
@@ -123,7 +185,112 @@ bool Renderer::Initialize(const vec2i &window_size, const char *window_title) {
 #undef GLEXT
 #endif
 
-      blend_mode_ = kBlendModeOff;
+// Resolve the optional program binary entry points, used to cache linked
+// shaders across runs. Absence is not an error. Apple exposes neither the
+// ARB nor the OES variant, so don't bother looking there.
+#if !defined(__APPLE__)
+  {
+    auto extensions =
+        reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS));
+#ifdef PLATFORM_MOBILE
+    const bool have_extension =
+        extensions && strstr(extensions, "GL_OES_get_program_binary");
+    const char *get_name = "glGetProgramBinaryOES";
+    const char *set_name = "glProgramBinaryOES";
+#else
+    const bool have_extension =
+        extensions && strstr(extensions, "GL_ARB_get_program_binary");
+    const char *get_name = "glGetProgramBinary";
+    const char *set_name = "glProgramBinary";
+#endif
+    if (have_extension) {
+      union {
+        void *data;
+        GetProgramBinaryFunction function;
+      } get_union;
+      union {
+        void *data;
+        ProgramBinaryFunction function;
+      } set_union;
+      get_union.data = SDL_GL_GetProcAddress(get_name);
+      set_union.data = SDL_GL_GetProcAddress(set_name);
+      if (get_union.data && set_union.data) {
+        gl_get_program_binary = get_union.function;
+        gl_program_binary = set_union.function;
+        supports_program_binary_ = true;
+      }
+    }
+  }
+#endif  // !defined(__APPLE__)
+
+// Resolve the timer query entry points, used by the GPU profiler zones.
+// Absence is not an error: zones just never resolve a time.
+#if !defined(__APPLE__)
+  {
+    auto extensions =
+        reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS));
+#ifdef PLATFORM_MOBILE
+    const bool have_queries =
+        extensions && strstr(extensions, "GL_EXT_disjoint_timer_query");
+    const char *suffix = "EXT";
+#else
+    const bool have_queries =
+        extensions && strstr(extensions, "GL_ARB_timer_query");
+    const char *suffix = "";
+#endif
+    if (have_queries) {
+      union {
+        void *data;
+        GenQueriesFunction function;
+      } gen_union;
+      union {
+        void *data;
+        BeginQueryFunction function;
+      } begin_union;
+      union {
+        void *data;
+        EndQueryFunction function;
+      } end_union;
+      union {
+        void *data;
+        GetQueryObjectuivFunction function;
+      } getuiv_union;
+      union {
+        void *data;
+        GetQueryObjectui64vFunction function;
+      } getui64v_union;
+      char name[64];
+      snprintf(name, sizeof(name), "glGenQueries%s", suffix);
+      gen_union.data = SDL_GL_GetProcAddress(name);
+      snprintf(name, sizeof(name), "glBeginQuery%s", suffix);
+      begin_union.data = SDL_GL_GetProcAddress(name);
+      snprintf(name, sizeof(name), "glEndQuery%s", suffix);
+      end_union.data = SDL_GL_GetProcAddress(name);
+      snprintf(name, sizeof(name), "glGetQueryObjectuiv%s", suffix);
+      getuiv_union.data = SDL_GL_GetProcAddress(name);
+      snprintf(name, sizeof(name), "glGetQueryObjectui64v%s", suffix);
+      getui64v_union.data = SDL_GL_GetProcAddress(name);
+      if (gen_union.data && begin_union.data && end_union.data &&
+          getuiv_union.data && getui64v_union.data) {
+        gl_gen_queries = gen_union.function;
+        gl_begin_query = begin_union.function;
+        gl_end_query = end_union.function;
+        gl_get_query_objectuiv = getuiv_union.function;
+        gl_get_query_objectui64v = getui64v_union.function;
+        supports_timer_queries_ = true;
+      }
+    }
+  }
+#endif  // !defined(__APPLE__)
+
+  blend_mode_ = kBlendModeOff;
+
+  screenshot_requested_ = false;
+  capture_frame_count_ = 0;
+  for (int i = 0; i < kCaptureFrames; ++i) {
+    capture_pbos_[i] = 0;
+    capture_issue_frame_[i] = -1;
+  }
   return true;
 }
 
@@ -132,8 +299,12 @@ void Renderer::AdvanceFrame(bool minimized) {
     // Save some cpu / battery:
     SDL_Delay(10);
   } else {
+    // Read back the finished frame (if a capture was requested) before the
+    // swap invalidates the back buffer.
+    ProcessScreenshots();
     SDL_GL_SwapWindow(window_);
   }
+  PollGpuZones();
   // Get window size again, just in case it has changed.
   SDL_GetWindowSize(window_, &window_size_.x(), &window_size_.y());
 #ifdef __ANDROID__
@@ -145,6 +316,100 @@ void Renderer::AdvanceFrame(bool minimized) {
   GL_CALL(glViewport(0, 0, window_size_.x(), window_size_.y()));
 #endif
   DepthTest(true);
+  // Start each frame with a clean slate so any out-of-band GL calls made
+  // since the last frame can't leave the shadow lying.
+  InvalidateGlStateShadow();
+}
+
+void Renderer::BeginGpuZone(const char *name) {
+  // Find the zone, or register it on first use.
+  int index = -1;
+  for (int i = 0; i < gpu_zone_count_; ++i) {
+    if (gpu_zones_[i].stats.name == name ||
+        strcmp(gpu_zones_[i].stats.name, name) == 0) {
+      index = i;
+      break;
+    }
+  }
+  if (index < 0) {
+    if (gpu_zone_count_ >= kMaxGpuZones) return;
+    index = gpu_zone_count_++;
+    GpuZone &zone = gpu_zones_[index];
+    zone.stats.name = name;
+    zone.stats.elapsed_ms = 0.0f;
+    zone.stats.draw_calls = 0;
+    zone.stats.triangles = 0;
+    for (int i = 0; i < kGpuQueryFrames; ++i) zone.in_flight[i] = false;
+    if (supports_timer_queries_) {
+      GL_CALL(gl_gen_queries(kGpuQueryFrames, zone.queries));
+    }
+  }
+
+  if (open_gpu_zone_ >= 0) return;  // The extensions forbid nesting.
+  open_gpu_zone_ = index;
+  current_draw_calls_ = 0;
+  current_triangles_ = 0;
+
+  // Only start a query if the slot we'd reuse has been harvested; on a
+  // slow GPU we simply skip a measurement rather than stall.
+  GpuZone &zone = gpu_zones_[index];
+  if (supports_timer_queries_ && !zone.in_flight[gpu_query_frame_]) {
+    GL_CALL(gl_begin_query(GL_TIME_ELAPSED_EXT, zone.queries[gpu_query_frame_]));
+    gpu_query_open_ = true;
+  }
+}
+
+void Renderer::EndGpuZone() {
+  if (open_gpu_zone_ < 0) return;
+  GpuZone &zone = gpu_zones_[open_gpu_zone_];
+  zone.stats.draw_calls = current_draw_calls_;
+  zone.stats.triangles = current_triangles_;
+  if (gpu_query_open_) {
+    GL_CALL(gl_end_query(GL_TIME_ELAPSED_EXT));
+    zone.in_flight[gpu_query_frame_] = true;
+    gpu_query_open_ = false;
+  }
+  open_gpu_zone_ = -1;
+}
+
+void Renderer::PollGpuZones() {
+  if (!supports_timer_queries_) return;
+
+  // The ring slot about to be reused next frame is the oldest one.
+  gpu_query_frame_ = (gpu_query_frame_ + 1) % kGpuQueryFrames;
+
+#ifdef PLATFORM_MOBILE
+  // A disjoint event (clock change, thermal throttle) invalidates every
+  // measurement in flight; harvest them but throw the values away.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+#else
+  const GLint disjoint = 0;
+#endif
+
+  for (int i = 0; i < gpu_zone_count_; ++i) {
+    GpuZone &zone = gpu_zones_[i];
+    for (int f = 0; f < kGpuQueryFrames; ++f) {
+      if (!zone.in_flight[f]) continue;
+      GLuint available = 0;
+      GL_CALL(gl_get_query_objectuiv(zone.queries[f],
+                                     GL_QUERY_RESULT_AVAILABLE_EXT,
+                                     &available));
+      if (!available) continue;
+      uint64_t elapsed_ns = 0;
+      GL_CALL(gl_get_query_objectui64v(zone.queries[f], GL_QUERY_RESULT_EXT,
+                                       &elapsed_ns));
+      zone.in_flight[f] = false;
+      if (!disjoint) {
+        zone.stats.elapsed_ms = static_cast<float>(elapsed_ns * 1e-6);
+      }
+    }
+  }
+}
+
+void Renderer::CountDrawCall(int triangles) {
+  current_draw_calls_++;
+  current_triangles_ += triangles;
 }
 
 void Renderer::ShutDown() {
@@ -212,6 +477,7 @@ Shader *Renderer::CompileAndLinkShader(const char *vs_source,
       if (status == GL_TRUE) {
         auto shader = new Shader(program, vs, ps);
         GL_CALL(glUseProgram(program));
+        InvalidateGlStateShadow();
         shader->InitializeUniforms();
         return shader;
       }
@@ -227,6 +493,59 @@ Shader *Renderer::CompileAndLinkShader(const char *vs_source,
   return nullptr;
 }
 
+bool Renderer::GetProgramBinary(GLuint program, std::string *out) {
+  if (!supports_program_binary_) return false;
+  GLint binary_length = 0;
+  GL_CALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length));
+  if (binary_length <= 0) return false;
+  out->assign(sizeof(GLenum) + binary_length, 0);
+  GLenum binary_format = 0;
+  GLsizei written = 0;
+  GL_CALL(gl_get_program_binary(program, binary_length, &written,
+                                &binary_format, &(*out)[sizeof(GLenum)]));
+  if (written <= 0) {
+    out->clear();
+    return false;
+  }
+  memcpy(&(*out)[0], &binary_format, sizeof(GLenum));
+  out->resize(sizeof(GLenum) + written);
+  return true;
+}
+
+Shader *Renderer::CreateShaderFromBinary(const void *binary, size_t size) {
+  if (!supports_program_binary_ || size <= sizeof(GLenum)) return nullptr;
+  GLenum binary_format;
+  memcpy(&binary_format, binary, sizeof(GLenum));
+  auto program = glCreateProgram();
+  // Attribute bindings were baked in when the source program linked, so
+  // there's no need to re-bind aPosition et al here.
+  gl_program_binary(program, binary_format,
+                    static_cast<const char *>(binary) + sizeof(GLenum),
+                    static_cast<GLsizei>(size - sizeof(GLenum)));
+  // Swallow any GL error the driver raised while rejecting the binary; the
+  // caller falls back to compiling from source.
+  glGetError();
+  GLint status = GL_FALSE;
+  GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+  if (status != GL_TRUE) {
+    GL_CALL(glDeleteProgram(program));
+    return nullptr;
+  }
+  auto shader = new Shader(program, 0, 0);
+  GL_CALL(glUseProgram(program));
+  InvalidateGlStateShadow();
+  shader->InitializeUniforms();
+  return shader;
+}
+
+std::string Renderer::DriverVersionString() const {
+  auto vendor = reinterpret_cast<const char *>(glGetString(GL_VENDOR));
+  auto renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+  auto version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  return std::string(vendor ? vendor : "") + "/" +
+         (renderer ? renderer : "") + "/" + (version ? version : "");
+}
+
 uint16_t *Renderer::Convert8888To5551(const uint8_t *buffer,
                                       const vec2i &size) {
   auto buffer16 = new uint16_t[size.x() * size.y()];
@@ -261,6 +580,7 @@ GLuint Renderer::CreateTexture(const uint8_t *buffer, const vec2i &size,
   GL_CALL(glGenTextures(1, &texture_id));
   GL_CALL(glActiveTexture(GL_TEXTURE0));
   GL_CALL(glBindTexture(GL_TEXTURE_2D, texture_id));
+  InvalidateGlStateShadow();
   GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
   GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
   GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
@@ -322,6 +642,130 @@ GLuint Renderer::CreateTexture(const uint8_t *buffer, const vec2i &size,
   return texture_id;
 }
 
+// Compressed internal formats our cooked containers may use. Not all GL
+// headers we compile against define these.
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_8x8_KHR
+#define GL_COMPRESSED_RGBA_ASTC_8x8_KHR 0x93B7
+#endif
+
+// Header layout of a KTX (version 1) container. See
+// https://www.khronos.org/registry/KTX/specs/1.0/ktxspec_v1.html
+struct KTXHeader {
+  uint8_t identifier[12];
+  uint32_t endianness;
+  uint32_t gl_type;
+  uint32_t gl_type_size;
+  uint32_t gl_format;
+  uint32_t gl_internal_format;
+  uint32_t gl_base_internal_format;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t number_of_array_elements;
+  uint32_t number_of_faces;
+  uint32_t number_of_mipmap_levels;
+  uint32_t bytes_of_key_value_data;
+};
+
+static const uint8_t kKTXIdentifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31,
+                                           0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+GLuint Renderer::CreateTextureFromKTX(const uint8_t *ktx_buf, size_t size,
+                                      vec2i *dimensions, bool *has_alpha) {
+  KTXHeader header;
+  if (size < sizeof(header)) {
+    last_error() = "KTX: file too small for header";
+    return 0;
+  }
+  memcpy(&header, ktx_buf, sizeof(header));
+  // We only cook little-endian files, so no need to byte-swap.
+  if (memcmp(header.identifier, kKTXIdentifier, sizeof(kKTXIdentifier)) != 0 ||
+      header.endianness != 0x04030201) {
+    last_error() = "KTX: bad identifier or endianness";
+    return 0;
+  }
+  // Only simple 2D textures: no texture arrays, cubemaps, or 3D textures.
+  if (header.pixel_depth > 1 || header.number_of_array_elements > 0 ||
+      header.number_of_faces != 1) {
+    last_error() = "KTX: only simple 2D textures supported";
+    return 0;
+  }
+
+  *dimensions = vec2i(header.pixel_width, header.pixel_height);
+  *has_alpha = header.gl_base_internal_format == GL_RGBA;
+
+  // gl_type == 0 marks a block-compressed format per the KTX spec.
+  const bool compressed = header.gl_type == 0;
+  const uint32_t num_mips = std::max(header.number_of_mipmap_levels, 1u);
+  const uint8_t *data =
+      ktx_buf + sizeof(header) + header.bytes_of_key_value_data;
+  const uint8_t *end = ktx_buf + size;
+
+  GLuint texture_id;
+  GL_CALL(glGenTextures(1, &texture_id));
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, texture_id));
+  InvalidateGlStateShadow();
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                          GL_LINEAR_MIPMAP_NEAREST));
+
+  uint32_t width = header.pixel_width;
+  uint32_t height = std::max(header.pixel_height, 1u);
+  for (uint32_t level = 0; level < num_mips; ++level) {
+    uint32_t image_size;
+    if (data + sizeof(image_size) > end) {
+      last_error() = "KTX: truncated mip data";
+      GL_CALL(glDeleteTextures(1, &texture_id));
+      return 0;
+    }
+    memcpy(&image_size, data, sizeof(image_size));
+    data += sizeof(image_size);
+    if (data + image_size > end) {
+      last_error() = "KTX: truncated mip data";
+      GL_CALL(glDeleteTextures(1, &texture_id));
+      return 0;
+    }
+    if (compressed) {
+      GL_CALL(glCompressedTexImage2D(GL_TEXTURE_2D, level,
+                                     header.gl_internal_format, width, height,
+                                     0, image_size, data));
+    } else {
+      // Raw fallback. Cooked raw files use internalformat == format so they
+      // stay GLES2-legal.
+      GL_CALL(glTexImage2D(GL_TEXTURE_2D, level, header.gl_format, width,
+                           height, 0, header.gl_format, header.gl_type, data));
+    }
+    // Mip data is 4-byte aligned in the container.
+    data += (image_size + 3) & ~3;
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+
+  // If the container only ships the base level, fall back to GL-side mip
+  // generation, which only works for uncompressed data.
+  if (num_mips == 1) {
+    if (compressed) {
+      GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                              GL_LINEAR));
+    } else {
+      GL_CALL(glGenerateMipmap(GL_TEXTURE_2D));
+    }
+  }
+  return texture_id;
+}
+
 uint8_t *Renderer::UnpackTGA(const void *tga_buf, vec2i *dimensions,
                              bool *has_alpha) {
   struct TGA {
@@ -371,18 +815,36 @@ uint8_t *Renderer::UnpackTGA(const void *tga_buf, vec2i *dimensions,
 
 uint8_t *Renderer::UnpackWebP(const void *webp_buf, size_t size,
                               vec2i *dimensions, bool *has_alpha) {
-  WebPBitstreamFeatures features;
-  auto status =
-      WebPGetFeatures(static_cast<const uint8_t *>(webp_buf), size, &features);
+  WebPDecoderConfig config;
+  if (!WebPInitDecoderConfig(&config)) return nullptr;
+  auto status = WebPGetFeatures(static_cast<const uint8_t *>(webp_buf), size,
+                                &config.input);
   if (status != VP8_STATUS_OK) return nullptr;
-  *has_alpha = features.has_alpha != 0;
-  if (features.has_alpha) {
-    return WebPDecodeRGBA(static_cast<const uint8_t *>(webp_buf), size,
-                          &dimensions->x(), &dimensions->y());
-  } else {
-    return WebPDecodeRGB(static_cast<const uint8_t *>(webp_buf), size,
-                         &dimensions->x(), &dimensions->y());
+  *has_alpha = config.input.has_alpha != 0;
+  *dimensions = vec2i(config.input.width, config.input.height);
+
+  // Let libwebp split the decode over multiple threads; this substantially
+  // cuts decode time for our larger textures on multi-core devices.
+  config.options.use_threads = 1;
+
+  // Decode into a buffer we allocate ourselves, since callers free() the
+  // result.
+  const int bytes_per_pixel = *has_alpha ? 4 : 3;
+  const size_t buffer_size = static_cast<size_t>(config.input.width) *
+                             config.input.height * bytes_per_pixel;
+  auto buffer = static_cast<uint8_t *>(malloc(buffer_size));
+  if (!buffer) return nullptr;
+  config.output.colorspace = *has_alpha ? MODE_RGBA : MODE_RGB;
+  config.output.u.RGBA.rgba = buffer;
+  config.output.u.RGBA.stride = config.input.width * bytes_per_pixel;
+  config.output.u.RGBA.size = buffer_size;
+  config.output.is_external_memory = 1;
+  status = WebPDecode(static_cast<const uint8_t *>(webp_buf), size, &config);
+  if (status != VP8_STATUS_OK) {
+    free(buffer);
+    return nullptr;
   }
+  return buffer;
 }
 
 uint8_t *Renderer::LoadAndUnpackTexture(const char *filename, vec2i *dimensions,
@@ -411,6 +873,188 @@ uint8_t *Renderer::LoadAndUnpackTexture(const char *filename, vec2i *dimensions,
   return nullptr;
 }
 
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+// Where captured frames land: under SDL's per-user writable path, like the
+// shader cache, since the assets directory may be read-only.
+static std::string ScreenshotFilename(int index) {
+  char *pref_path = SDL_GetPrefPath("google", "pienoon");
+  if (!pref_path) return "";
+  char name[32];
+  snprintf(name, sizeof(name), "screenshot_%04d.webp", index);
+  std::string filename = std::string(pref_path) + name;
+  SDL_free(pref_path);
+  return filename;
+}
+
+// Background WebP encoder for captured frames. Encoding takes tens of
+// milliseconds, far too long for the render thread; captured pixels are
+// handed over here and encoded at low priority. The queue depth is bounded
+// by the PBO ring, so it never grows past a few frames.
+class ScreenshotEncoder {
+ public:
+  ScreenshotEncoder() : exit_(false), started_(false), next_index_(0) {}
+
+  ~ScreenshotEncoder() {
+    if (!started_) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  // Takes the contents of 'rgba' (bottom-up rows, as glReadPixels returns
+  // them); the caller's vector is left empty.
+  void Encode(std::vector<uint8_t> *rgba, const vec2i &size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!started_) {
+        thread_ = std::thread(&ScreenshotEncoder::Run, this);
+        started_ = true;
+      }
+      jobs_.push_back(Job());
+      jobs_.back().rgba.swap(*rgba);
+      jobs_.back().size = size;
+      jobs_.back().index = next_index_++;
+    }
+    wake_.notify_one();
+  }
+
+ private:
+  struct Job {
+    std::vector<uint8_t> rgba;
+    vec2i size;
+    int index;
+  };
+
+  void Run() {
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this]() { return exit_ || !jobs_.empty(); });
+        if (jobs_.empty()) return;  // Only on exit.
+        job.rgba.swap(jobs_.front().rgba);
+        job.size = jobs_.front().size;
+        job.index = jobs_.front().index;
+        jobs_.erase(jobs_.begin());
+      }
+      Write(&job);
+    }
+  }
+
+  void Write(Job *job) {
+    const int width = job->size.x();
+    const int height = job->size.y();
+    const size_t stride = static_cast<size_t>(width) * 4;
+    // glReadPixels returns rows bottom-up; flip to image order.
+    std::vector<uint8_t> row(stride);
+    for (int y = 0; y < height / 2; ++y) {
+      uint8_t *top = &job->rgba[y * stride];
+      uint8_t *bottom = &job->rgba[(height - 1 - y) * stride];
+      memcpy(&row[0], top, stride);
+      memcpy(top, bottom, stride);
+      memcpy(bottom, &row[0], stride);
+    }
+    uint8_t *encoded = nullptr;
+    const size_t encoded_size = WebPEncodeLosslessRGBA(
+        &job->rgba[0], width, height, static_cast<int>(stride), &encoded);
+    if (encoded_size == 0) return;
+    const std::string filename = ScreenshotFilename(job->index);
+    if (!filename.empty()) {
+      SDL_RWops *handle = SDL_RWFromFile(filename.c_str(), "wb");
+      if (handle) {
+        SDL_RWwrite(handle, encoded, 1, encoded_size);
+        SDL_RWclose(handle);
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "captured %s",
+                    filename.c_str());
+      }
+    }
+    free(encoded);
+  }
+
+  std::vector<Job> jobs_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread thread_;
+  bool exit_;
+  bool started_;
+  int next_index_;
+};
+
+static ScreenshotEncoder &Encoder() {
+  static ScreenshotEncoder encoder;
+  return encoder;
+}
+
+void Renderer::ProcessScreenshots() {
+  ++capture_frame_count_;
+#if !defined(PLATFORM_MOBILE)
+  // Drain captures whose readback has had kCaptureFrames frames to
+  // complete; by now the transfer is long done and the map doesn't stall.
+  for (int i = 0; i < kCaptureFrames; ++i) {
+    if (capture_issue_frame_[i] < 0 ||
+        capture_frame_count_ - capture_issue_frame_[i] < kCaptureFrames) {
+      continue;
+    }
+    GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbos_[i]));
+    const size_t bytes =
+        static_cast<size_t>(capture_sizes_[i].x()) * capture_sizes_[i].y() * 4;
+    const uint8_t *pixels = static_cast<const uint8_t *>(
+        glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+    if (pixels) {
+      std::vector<uint8_t> rgba(pixels, pixels + bytes);
+      GL_CALL(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+      Encoder().Encode(&rgba, capture_sizes_[i]);
+    }
+    GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    capture_issue_frame_[i] = -1;
+  }
+  if (!screenshot_requested_) return;
+  screenshot_requested_ = false;
+  // Queue the read into an idle slot; if the ring is full (shouldn't
+  // happen with the drain above), drop the frame rather than stall.
+  for (int i = 0; i < kCaptureFrames; ++i) {
+    if (capture_issue_frame_[i] >= 0) continue;
+    if (!capture_pbos_[i]) GL_CALL(glGenBuffers(1, &capture_pbos_[i]));
+    const size_t bytes =
+        static_cast<size_t>(window_size_.x()) * window_size_.y() * 4;
+    GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbos_[i]));
+    GL_CALL(glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr,
+                         GL_STREAM_READ));
+    // With a pack buffer bound, the data argument is an offset and the
+    // call returns as soon as the transfer is queued.
+    GL_CALL(glReadPixels(0, 0, window_size_.x(), window_size_.y(), GL_RGBA,
+                         GL_UNSIGNED_BYTE, nullptr));
+    GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    capture_sizes_[i] = window_size_;
+    capture_issue_frame_[i] = capture_frame_count_;
+    break;
+  }
+#else
+  // GLES2 has no pixel pack buffers: read synchronously. Fine for single
+  // shots, too slow for continuous capture.
+  if (!screenshot_requested_) return;
+  screenshot_requested_ = false;
+  std::vector<uint8_t> rgba(static_cast<size_t>(window_size_.x()) *
+                            window_size_.y() * 4);
+  GL_CALL(glReadPixels(0, 0, window_size_.x(), window_size_.y(), GL_RGBA,
+                       GL_UNSIGNED_BYTE, &rgba[0]));
+  Encoder().Encode(&rgba, window_size_);
+#endif  // !defined(PLATFORM_MOBILE)
+}
+
 void Renderer::DepthTest(bool on) {
   if (on) {
     GL_CALL(glEnable(GL_DEPTH_TEST));
@@ -419,6 +1063,59 @@ void Renderer::DepthTest(bool on) {
   }
 }
 
+// Shadowed GL bind state. Global rather than per-Renderer because GL state
+// belongs to the (single) context, and the static draw helpers in Mesh
+// have no Renderer at hand. Zero-initialization matches a fresh context's
+// defaults (no program, no textures, all attribute arrays disabled).
+static const GLuint kInvalidShadowName = static_cast<GLuint>(-1);
+static const int kShadowTextureUnits = 8;
+static const int kShadowVertexAttribs = Mesh::kAttributeColor + 1;
+static GLuint g_shadow_program;
+static GLuint g_shadow_textures[kShadowTextureUnits];
+static uint32_t g_shadow_attrib_mask;
+static bool g_shadow_attribs_known = true;
+
+void Renderer::UseProgram(GLuint program) {
+  if (program == g_shadow_program) return;
+  GL_CALL(glUseProgram(program));
+  g_shadow_program = program;
+}
+
+void Renderer::BindTexture(size_t unit, GLuint texture) {
+  assert(unit < static_cast<size_t>(kShadowTextureUnits));
+  if (texture == g_shadow_textures[unit]) return;
+  GL_CALL(glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + unit)));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D, texture));
+  g_shadow_textures[unit] = texture;
+}
+
+void Renderer::EnableVertexAttribs(uint32_t mask) {
+  assert(mask < (1u << kShadowVertexAttribs));
+  const uint32_t changed =
+      g_shadow_attribs_known ? mask ^ g_shadow_attrib_mask
+                             : static_cast<uint32_t>(-1);
+  if (changed == 0) return;
+  for (int i = 0; i < kShadowVertexAttribs; ++i) {
+    const uint32_t bit = 1u << i;
+    if ((changed & bit) == 0) continue;
+    if (mask & bit) {
+      GL_CALL(glEnableVertexAttribArray(i));
+    } else {
+      GL_CALL(glDisableVertexAttribArray(i));
+    }
+  }
+  g_shadow_attrib_mask = mask;
+  g_shadow_attribs_known = true;
+}
+
+void Renderer::InvalidateGlStateShadow() {
+  g_shadow_program = kInvalidShadowName;
+  for (int i = 0; i < kShadowTextureUnits; ++i) {
+    g_shadow_textures[i] = kInvalidShadowName;
+  }
+  g_shadow_attribs_known = false;
+}
+
 void Renderer::SetBlendMode(BlendMode blend_mode, float amount) {
   if (blend_mode == blend_mode_) return;
 
@@ -51,11 +51,37 @@ class Renderer {
   // aTexCoord and aColor to match whatever attributes your vertex data has.
   Shader *CompileAndLinkShader(const char *vs_source, const char *ps_source);
 
+  // True when the driver can hand back linked program binaries
+  // (GL_ARB_get_program_binary on desktop, GL_OES_get_program_binary on ES).
+  bool SupportsProgramBinary() const { return supports_program_binary_; }
+
+  // Serialize a linked program into 'out': the driver's binary format enum
+  // followed by the opaque binary. Returns false if the driver declines.
+  bool GetProgramBinary(GLuint program, std::string *out);
+
+  // Recreate a shader from a blob previously captured with GetProgramBinary.
+  // Returns nullptr if the driver rejects the binary (e.g. after a driver
+  // update); callers should fall back to CompileAndLinkShader.
+  Shader *CreateShaderFromBinary(const void *binary, size_t size);
+
+  // Identifies the GL implementation (vendor/renderer/version). Cache keys
+  // for program binaries must include this, since binaries don't survive
+  // driver updates.
+  std::string DriverVersionString() const;
+
   // Create a texture from a memory buffer containing xsize * ysize RGBA pixels.
   // Return 0 if not a power of two in size.
   GLuint CreateTexture(const uint8_t *buffer, const vec2i &size, bool has_alpha,
                        TextureFormat desired = kFormatAuto);
 
+  // Create a texture from a memory buffer containing a KTX container, our
+  // offline-cooked texture format: a pre-generated mip chain, either
+  // ETC2/ASTC-compressed or raw as a fallback. Each mip level uploads
+  // directly from the buffer with no CPU-side decode. Returns 0 (with a
+  // message in last_error()) if the container is malformed.
+  GLuint CreateTextureFromKTX(const uint8_t *ktx_buf, size_t size,
+                              vec2i *dimensions, bool *has_alpha);
+
   // Unpacks a memory buffer containing a TGA format file.
   // May only be uncompressed RGB or RGBA data, Y-flipped or not.
   // Returns RGBA array of returned dimensions or nullptr if the
@@ -90,6 +116,68 @@ class Renderer {
   // Set to compare fragment against Z-buffer before writing, or not.
   void DepthTest(bool on);
 
+  // Queue an asynchronous capture of the frame being presented. Desktop
+  // builds read the pixels back through a small ring of pixel buffer
+  // objects a couple of frames later -- the classic ~40ms glReadPixels
+  // stall becomes a queued transfer -- and a background thread encodes
+  // WebP and writes screenshot_NNNN.webp under SDL's pref path. Call every
+  // frame for continuous capture. GLES2 has no pack buffers, so mobile
+  // falls back to a synchronous read (usable, just not cheap).
+  void RequestScreenshot() { screenshot_requested_ = true; }
+
+  // GL bind-state shadow. The bound program, per-unit textures, and vertex
+  // attribute enables funnel through these so a redundant bind -- the
+  // common case once draws are sorted by material -- costs an integer
+  // compare instead of a driver call. Static because there is exactly one
+  // GL context. Code that touches these bind points directly (texture
+  // uploads, shader compilation) must call InvalidateGlStateShadow
+  // afterwards; AdvanceFrame also resets the shadow once per frame as a
+  // backstop.
+  static void UseProgram(GLuint program);
+  static void BindTexture(size_t unit, GLuint texture);
+
+  // Bit n of 'mask' enables vertex attribute location n; clear bits are
+  // disabled. Disabling is lazy: Mesh::UnSetAttributes leaves arrays
+  // enabled, and the next call here turns off the ones the new format
+  // doesn't use, so back-to-back draws with the same format issue no
+  // enable/disable calls at all.
+  static void EnableVertexAttribs(uint32_t mask);
+  static void InvalidateGlStateShadow();
+
+  // True when the driver exposes GPU timer queries
+  // (GL_EXT_disjoint_timer_query on GLES2, GL_ARB_timer_query on desktop).
+  // GPU zones still count draw calls without them; they just report zero
+  // elapsed time.
+  bool SupportsGpuTimerQueries() const { return supports_timer_queries_; }
+
+  // Per-pass GPU timing and draw statistics. Zones register by name on
+  // first use, like the CPU profiler's, but may not nest: the timer query
+  // extensions allow only one elapsed-time query at a time. Timings
+  // resolve a few frames after submission, so elapsed_ms lags the draw
+  // counters slightly.
+  static const int kMaxGpuZones = 8;
+  struct GpuZoneStats {
+    const char *name;
+    float elapsed_ms;  // Most recently resolved GPU time for this pass.
+    int draw_calls;    // Draw calls issued during the pass last frame.
+    int triangles;     // Triangles submitted during the pass last frame.
+  };
+
+  // Bracket a render pass. 'name' must outlive the renderer (use a string
+  // literal). A BeginGpuZone while another zone is open is a no-op (beyond
+  // registering the name): the extensions forbid nested queries, so the
+  // nested pass's draws are attributed to the outer zone.
+  void BeginGpuZone(const char *name);
+  void EndGpuZone();
+
+  int gpu_zone_count() const { return gpu_zone_count_; }
+  const GpuZoneStats &gpu_zone(int i) const { return gpu_zones_[i].stats; }
+
+  // Called by Mesh for every draw call it issues so per-pass counters stay
+  // accurate regardless of which helper submitted the geometry. Static
+  // because several Mesh entry points are static too.
+  static void CountDrawCall(int triangles);
+
   Renderer()
       : model_view_projection_(mat4::Identity()),
         model_(mat4::Identity()),
@@ -98,7 +186,13 @@ class Renderer {
         camera_pos_(mathfu::kZeros3f),
         window_size_(mathfu::kZeros2i),
         window_(nullptr),
-        context_(nullptr) {}
+        context_(nullptr),
+        supports_program_binary_(false),
+        supports_timer_queries_(false),
+        gpu_zone_count_(0),
+        open_gpu_zone_(-1),
+        gpu_query_open_(false),
+        gpu_query_frame_(0) {}
   ~Renderer() { ShutDown(); }
 
   // Shader uniform: model_view_projection
@@ -134,6 +228,32 @@ class Renderer {
  private:
   GLuint CompileShader(GLenum stage, GLuint program, const GLchar *source);
 
+  // Query objects are read back this many frames after submission, so the
+  // CPU never stalls waiting on the GPU.
+  static const int kGpuQueryFrames = 4;
+  struct GpuZone {
+    GpuZoneStats stats;
+    GLuint queries[kGpuQueryFrames];
+    bool in_flight[kGpuQueryFrames];
+  };
+
+  // Harvest any timer query results that have become available. Called
+  // once per frame from AdvanceFrame.
+  void PollGpuZones();
+
+  // Issue a requested capture into the next pixel buffer object, and hand
+  // any capture whose readback has had kCaptureFrames frames to complete
+  // over to the encoder thread. Called from AdvanceFrame just before the
+  // swap, mirroring how the GPU timer queries are drained.
+  void ProcessScreenshots();
+
+  static const int kCaptureFrames = 2;
+  bool screenshot_requested_;
+  GLuint capture_pbos_[kCaptureFrames];
+  vec2i capture_sizes_[kCaptureFrames];
+  int capture_issue_frame_[kCaptureFrames];  // -1 = slot idle.
+  int capture_frame_count_;
+
   // The mvp. Use the Ortho() and Perspective() methods in mathfu::Matrix
   // to conveniently change the camera.
   mat4 model_view_projection_;
@@ -152,6 +272,20 @@ class Renderer {
   BlendMode blend_mode_;
 
   bool use_16bpp_;
+
+  bool supports_program_binary_;
+
+  bool supports_timer_queries_;
+  GpuZone gpu_zones_[kMaxGpuZones];
+  int gpu_zone_count_;
+  int open_gpu_zone_;    // Zone currently recording, or -1.
+  bool gpu_query_open_;  // True while a timer query is active.
+  int gpu_query_frame_;  // Ring index into each zone's query objects.
+
+  // Draw counters for the zone currently open. Static so the static Mesh
+  // render helpers can bump them; there is only one Renderer anyway.
+  static int current_draw_calls_;
+  static int current_triangles_;
 };
 
 }  // namespace fpl
@@ -0,0 +1,315 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include <cstring>
+#include "character.h"
+#include "controller.h"
+#include "replay.h"
+
+namespace fpl {
+namespace pie_noon {
+
+const int ReplayRecorder::kStepsPerChunk;
+const int ReplayRecorder::kMaxChunks;
+
+// Serialized stream magic and version; bumped whenever the raw struct
+// layouts below change.
+static const char kReplayMagic[4] = {'P', 'N', 'R', 'P'};
+static const uint32_t kReplayVersion = 1;
+
+// Marker byte for the run-length encoder below.
+static const uint8_t kRleMarker = 0xFF;
+
+ReplayRecorder::ReplayRecorder()
+    : last_time_(0),
+      playback_active_(false),
+      playback_chunk_(0),
+      playback_step_(0),
+      playback_event_(0),
+      dump_pending_(false),
+      dump_exit_(false) {}
+
+ReplayRecorder::~ReplayRecorder() {
+  if (dump_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(dump_mutex_);
+      dump_exit_ = true;
+    }
+    dump_signal_.notify_one();
+    dump_thread_.join();
+  }
+}
+
+void ReplayRecorder::DiscardRecording() {
+  // Park the chunks on the free list rather than destroying them, so
+  // their vectors (and the keyframes') keep their storage and the ring
+  // refills after a reset without allocating.
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    free_chunks_.push_back(std::move(chunks_[i]));
+  }
+  chunks_.clear();
+  last_time_ = 0;
+}
+
+void ReplayRecorder::BeginChunk(GameState* game_state) {
+  std::unique_ptr<Chunk> chunk;
+  if (chunks_.size() >= static_cast<size_t>(kMaxChunks)) {
+    // Recycle the oldest chunk; its vectors (and the keyframe's) keep
+    // their storage, so a full ring records without allocating.
+    chunk = std::move(chunks_.front());
+    chunks_.erase(chunks_.begin());
+  } else if (!free_chunks_.empty()) {
+    chunk = std::move(free_chunks_.back());
+    free_chunks_.pop_back();
+  } else {
+    chunk = std::unique_ptr<Chunk>(new Chunk());
+  }
+  game_state->SaveSnapshot(&chunk->keyframe);
+  chunk->start_bits = last_bits_;
+  chunk->events.clear();
+  chunk->num_steps = 0;
+  chunks_.push_back(std::move(chunk));
+}
+
+void ReplayRecorder::RecordStep(GameState* game_state) {
+  if (playback_active_) return;
+
+  const std::vector<std::unique_ptr<Character>>& characters =
+      game_state->characters();
+  // A reset (time going backwards, or a roster change) invalidates every
+  // keyframe in the ring; start over.
+  if (game_state->time() < last_time_ ||
+      last_bits_.size() != characters.size()) {
+    DiscardRecording();
+    last_bits_.assign(characters.size(), 0);
+  }
+  last_time_ = game_state->time();
+
+  if (chunks_.empty() || chunks_.back()->num_steps >= kStepsPerChunk) {
+    BeginChunk(game_state);
+  }
+  Chunk& chunk = *chunks_.back();
+  for (size_t i = 0; i < characters.size(); ++i) {
+    const Controller* controller = characters[i]->controller();
+    const uint32_t bits = controller != nullptr ? controller->is_down() : 0;
+    if (bits != last_bits_[i]) {
+      InputEvent event;
+      event.step = static_cast<uint16_t>(chunk.num_steps);
+      event.controller = static_cast<uint8_t>(i);
+      event.bits = bits;
+      chunk.events.push_back(event);
+      last_bits_[i] = bits;
+    }
+  }
+  chunk.num_steps++;
+}
+
+void ReplayRecorder::ApplyBits(Controller* controller, uint32_t bits) {
+  const uint32_t previous = controller->is_down();
+  controller->SetLogicalInputs(bits & ~previous, true);
+  controller->SetLogicalInputs(previous & ~bits, false);
+}
+
+bool ReplayRecorder::StartPlayback(GameState* game_state) {
+  if (chunks_.empty()) return false;
+  // The ring was recorded on this roster; a mismatch means a reset slipped
+  // in since the last RecordStep.
+  if (last_bits_.size() != game_state->characters().size()) return false;
+  playback_active_ = true;
+  playback_chunk_ = 0;
+  playback_step_ = 0;
+  playback_event_ = 0;
+  return true;
+}
+
+bool ReplayRecorder::PlaybackStep(GameState* game_state) {
+  if (!playback_active_) return false;
+  if (playback_chunk_ >= chunks_.size()) {
+    StopPlayback();
+    return false;
+  }
+  Chunk& chunk = *chunks_[playback_chunk_];
+  const std::vector<std::unique_ptr<Character>>& characters =
+      game_state->characters();
+
+  if (playback_step_ == 0) {
+    // Chunk boundary: re-pin the gameplay state to the keyframe and the
+    // controllers to their absolute bitmaps.
+    game_state->RestoreSnapshot(chunk.keyframe);
+    for (size_t i = 0; i < characters.size(); ++i) {
+      Controller* controller = characters[i]->controller();
+      if (controller != nullptr) {
+        controller->ClearTransientInputs();
+        ApplyBits(controller, chunk.start_bits[i]);
+      }
+    }
+  } else {
+    // Live controller updates are suspended during playback, so last
+    // step's edges are still latched; clear them before re-deriving this
+    // step's through ApplyBits.
+    for (size_t i = 0; i < characters.size(); ++i) {
+      Controller* controller = characters[i]->controller();
+      if (controller != nullptr) controller->ClearTransientInputs();
+    }
+  }
+
+  while (playback_event_ < chunk.events.size() &&
+         chunk.events[playback_event_].step == playback_step_) {
+    const InputEvent& event = chunk.events[playback_event_];
+    if (event.controller < characters.size()) {
+      Controller* controller = characters[event.controller]->controller();
+      if (controller != nullptr) ApplyBits(controller, event.bits);
+    }
+    playback_event_++;
+  }
+
+  playback_step_++;
+  if (playback_step_ >= chunk.num_steps) {
+    playback_chunk_++;
+    playback_step_ = 0;
+    playback_event_ = 0;
+  }
+  return true;
+}
+
+void ReplayRecorder::StopPlayback() {
+  playback_active_ = false;
+  // The rewind forked the timeline: the ring's chunks no longer lead up
+  // to the live present, so recording restarts clean.
+  DiscardRecording();
+}
+
+// --- Serialization, on the dump thread from here down. ---
+
+// Append a plain struct (or array of them) to 'out' byte for byte. The
+// stream is consumed by offline tooling on the same platform, so raw
+// layouts (including any SIMD padding in the vectors) are fine.
+template <typename T>
+static void AppendRaw(std::vector<uint8_t>* out, const T* data,
+                      size_t count) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  out->insert(out->end(), bytes, bytes + count * sizeof(T));
+}
+
+template <typename T>
+static void AppendValue(std::vector<uint8_t>* out, const T& value) {
+  AppendRaw(out, &value, 1);
+}
+
+// Byte-oriented run-length encoding. Snapshot payloads are mostly zero
+// bytes (cleared fields, SIMD padding), so runs of four or more of any
+// byte become (marker, count, byte); everything else copies through, with
+// a literal marker byte escaped as a zero-count run. Typically shrinks a
+// ring dump by 3-4x, which is plenty for a report attachment.
+static void RleCompress(const std::vector<uint8_t>& in,
+                        std::vector<uint8_t>* out) {
+  out->clear();
+  out->reserve(in.size() / 2);
+  size_t i = 0;
+  while (i < in.size()) {
+    const uint8_t value = in[i];
+    size_t run = 1;
+    while (i + run < in.size() && in[i + run] == value && run < 255) {
+      run++;
+    }
+    if (run >= 4 || value == kRleMarker) {
+      out->push_back(kRleMarker);
+      out->push_back(static_cast<uint8_t>(value == kRleMarker && run < 4
+                                              ? 0
+                                              : run));
+      out->push_back(value);
+      if (value == kRleMarker && run < 4) run = 1;
+    } else {
+      for (size_t j = 0; j < run; ++j) out->push_back(value);
+    }
+    i += run;
+  }
+}
+
+void ReplayRecorder::DumpWorker() {
+  for (;;) {
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::string filename;
+    {
+      std::unique_lock<std::mutex> lock(dump_mutex_);
+      dump_signal_.wait(lock, [this]() { return dump_pending_ || dump_exit_; });
+      if (dump_exit_ && !dump_pending_) return;
+      chunks.swap(dump_chunks_);
+      filename = dump_filename_;
+      dump_pending_ = false;
+    }
+
+    std::vector<uint8_t> raw;
+    AppendRaw(&raw, kReplayMagic, sizeof(kReplayMagic));
+    AppendValue(&raw, kReplayVersion);
+    AppendValue(&raw, static_cast<uint32_t>(chunks.size()));
+    for (size_t c = 0; c < chunks.size(); ++c) {
+      const Chunk& chunk = *chunks[c];
+      AppendValue(&raw, static_cast<uint32_t>(chunk.num_steps));
+      AppendValue(&raw, static_cast<uint32_t>(chunk.start_bits.size()));
+      AppendRaw(&raw, chunk.start_bits.data(), chunk.start_bits.size());
+      AppendValue(&raw, chunk.keyframe.time);
+      AppendValue(&raw, chunk.keyframe.countdown_timer);
+      AppendValue(&raw, chunk.keyframe.camera_base);
+      AppendValue(&raw,
+                  static_cast<uint32_t>(chunk.keyframe.characters.size()));
+      AppendRaw(&raw, chunk.keyframe.characters.data(),
+                chunk.keyframe.characters.size());
+      AppendValue(&raw, static_cast<uint32_t>(chunk.keyframe.pies.size()));
+      AppendRaw(&raw, chunk.keyframe.pies.data(), chunk.keyframe.pies.size());
+      AppendValue(&raw, static_cast<uint32_t>(chunk.events.size()));
+      AppendRaw(&raw, chunk.events.data(), chunk.events.size());
+    }
+
+    std::vector<uint8_t> compressed;
+    RleCompress(raw, &compressed);
+
+    SDL_RWops* file = SDL_RWFromFile(filename.c_str(), "wb");
+    if (file != nullptr) {
+      SDL_RWwrite(file, compressed.data(), 1, compressed.size());
+      SDL_RWclose(file);
+      SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                  "replay: wrote %d chunks (%d -> %d bytes) to %s",
+                  static_cast<int>(chunks.size()), static_cast<int>(raw.size()),
+                  static_cast<int>(compressed.size()), filename.c_str());
+    } else {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "replay: can't write %s: %s",
+                   filename.c_str(), SDL_GetError());
+    }
+  }
+}
+
+void ReplayRecorder::DumpAsync(const char* filename) {
+  if (chunks_.empty()) return;
+  if (!dump_thread_.joinable()) {
+    dump_thread_ = std::thread(&ReplayRecorder::DumpWorker, this);
+  }
+  {
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    if (dump_pending_) return;  // One dump in flight is plenty.
+    // Deep-copy the ring so the worker reads a stable image while
+    // recording continues; tens of kilobytes, so a memcpy-scale cost.
+    dump_chunks_.clear();
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+      dump_chunks_.push_back(std::unique_ptr<Chunk>(new Chunk(*chunks_[i])));
+    }
+    dump_filename_ = filename;
+    dump_pending_ = true;
+  }
+  dump_signal_.notify_one();
+}
+
+}  // pie_noon
+}  // fpl
@@ -0,0 +1,151 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PIE_NOON_REPLAY_H
+#define PIE_NOON_REPLAY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "game_state.h"
+
+namespace fpl {
+namespace pie_noon {
+
+// Rolling gameplay recorder, for reproducing field bugs.
+//
+// The fixed-timestep loop calls RecordStep once per simulation step while
+// a round is playing. Each step stores the controllers' is_down bitmaps as
+// deltas -- an event is written only when a controller's bits change -- so
+// a step usually costs one compare per character and nothing else. Steps
+// are grouped into chunks, each opening with a GameStateSnapshot keyframe,
+// and a small ring of chunks keeps roughly the last half minute of play.
+// All storage is reused once the ring has filled, so steady-state
+// recording does not allocate.
+//
+// Playback runs through the same deterministic GameState::AdvanceFrame as
+// live play: StartPlayback rewinds to the ring's oldest keyframe and each
+// PlaybackStep re-applies that step's recorded bitmaps to the characters'
+// controllers (keyframe restores at chunk boundaries re-pin the gameplay
+// state, so cosmetic drift never accumulates past one chunk). The caller
+// must stop feeding live controller updates while playing back.
+//
+// DumpAsync attaches the ring to a bug report: it deep-copies the chunks
+// (tens of kilobytes) and hands them to a background thread, which
+// serializes, run-length compresses, and writes them, so the frame that
+// hitched never waits on compression or the file system.
+//
+// Limits worth knowing: bitmaps are sampled once per step, so a press and
+// release landing inside one step collapses; and the format is a raw
+// struct dump for offline tooling on the same platform, not an archival
+// interchange format.
+class ReplayRecorder {
+ public:
+  // Simulation steps per chunk: one keyframe every ~2s at the default
+  // 16ms timestep.
+  static const int kStepsPerChunk = 128;
+  // Chunks kept in the ring: with kStepsPerChunk this covers ~32s.
+  static const int kMaxChunks = 16;
+
+  ReplayRecorder();
+  ~ReplayRecorder();
+
+  // Record one simulation step's inputs, opening chunks and recycling the
+  // ring as needed. Detects a GameState::Reset (time going backwards) and
+  // restarts the ring, since keyframes don't survive a reset.
+  void RecordStep(GameState* game_state);
+
+  // Rewind 'game_state' to the ring's oldest keyframe and start playing.
+  // Returns false if nothing has been recorded. Recording is suspended
+  // while playing back.
+  bool StartPlayback(GameState* game_state);
+
+  // Apply one recorded step's inputs to the characters' controllers; the
+  // caller then advances the simulation as usual. Returns false once the
+  // recording is exhausted (playback stops by itself).
+  bool PlaybackStep(GameState* game_state);
+
+  // Abandon playback. The ring is discarded either way -- the rewind
+  // forked the timeline, so the old chunks no longer lead up to the
+  // present -- and recording restarts clean on the next RecordStep.
+  void StopPlayback();
+
+  bool playing_back() const { return playback_active_; }
+
+  // Write the ring to 'filename' from the background thread: serialized,
+  // run-length compressed, and fire-and-forget (failures are logged). A
+  // dump already in flight makes this a no-op rather than a queue.
+  void DumpAsync(const char* filename);
+
+ private:
+  // One controller's bits changing on one step.
+  struct InputEvent {
+    uint16_t step;       // Step index within the chunk.
+    uint8_t controller;  // Character slot.
+    uint32_t bits;       // The controller's new is_down bitmap.
+  };
+
+  // A keyframe plus the input deltas for the steps that follow it.
+  struct Chunk {
+    GameStateSnapshot keyframe;
+    std::vector<uint32_t> start_bits;  // Absolute bitmaps at the keyframe.
+    std::vector<InputEvent> events;
+    int num_steps;
+  };
+
+  // Open a fresh chunk: from the free list if a discarded one is waiting,
+  // recycling the oldest once the ring is full, allocating otherwise.
+  void BeginChunk(GameState* game_state);
+
+  // Empty the ring, parking its chunks on the free list so their storage
+  // survives resets and playback stops.
+  void DiscardRecording();
+
+  // Set 'controller' to the absolute bitmap 'bits' through
+  // SetLogicalInputs, so went_down/went_up edges come out exactly as they
+  // would from live input.
+  static void ApplyBits(Controller* controller, uint32_t bits);
+
+  void DumpWorker();
+
+  std::vector<std::unique_ptr<Chunk>> chunks_;  // Ring, oldest first.
+  // Discarded chunks waiting to be reopened; keeps their vectors' storage.
+  std::vector<std::unique_ptr<Chunk>> free_chunks_;
+  std::vector<uint32_t> last_bits_;  // Previous step's bitmaps, per slot.
+  WorldTime last_time_;  // Of the last recorded step; detects resets.
+
+  bool playback_active_;
+  size_t playback_chunk_;
+  int playback_step_;
+  size_t playback_event_;
+
+  // Background dump thread, started lazily by the first DumpAsync.
+  std::thread dump_thread_;
+  std::mutex dump_mutex_;
+  std::condition_variable dump_signal_;
+  std::vector<std::unique_ptr<Chunk>> dump_chunks_;  // Deep copy to write.
+  std::string dump_filename_;
+  bool dump_pending_;
+  bool dump_exit_;
+};
+
+}  // pie_noon
+}  // fpl
+
+#endif  // PIE_NOON_REPLAY_H
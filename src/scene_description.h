@@ -16,16 +16,79 @@
 #define PIE_NOON_SCENE_DESCRIPTION_H
 
 #include "mathfu/glsl_mappings.h"
+#include "mathfu/utilities.h"
+#include <cassert>
 #include <memory>
+#include <new>
 #include <vector>
 
 namespace fpl {
 
+// A bump allocator for objects that live exactly one frame.
+// Allocate() hands out space from fixed-size blocks; Reset() rewinds to the
+// start of the first block without returning anything to the heap, so after
+// the first few frames the scene is rebuilt with no allocations at all.
+// Destructors are never run: only allocate trivially-destructible types here.
+class FrameArena {
+ public:
+  FrameArena() : current_block_(0), offset_(0) {}
+
+  ~FrameArena() {
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      mathfu::FreeAligned(blocks_[i]);
+    }
+  }
+
+  // Returns 'size' bytes, aligned to kAlignment. Never fails; grows by one
+  // block when the current block is full.
+  void* Allocate(size_t size) {
+    assert(size <= kBlockSize);
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (blocks_.empty() || offset_ + size > kBlockSize) {
+      if (!blocks_.empty()) ++current_block_;
+      if (current_block_ >= blocks_.size()) {
+        blocks_.push_back(static_cast<char*>(
+            mathfu::AllocateAligned(kBlockSize)));
+      }
+      offset_ = 0;
+    }
+    void* result = blocks_[current_block_] + offset_;
+    offset_ += size;
+    return result;
+  }
+
+  // Make everything allocated since the last Reset available for reuse.
+  // Blocks are kept, not freed, so the arena warms up to the high-water mark.
+  void Reset() {
+    current_block_ = 0;
+    offset_ = 0;
+  }
+
+ private:
+  // Big enough that a typical frame fits in one block; small enough that the
+  // last, partially-used block doesn't waste much.
+  static const size_t kBlockSize = 16 * 1024;
+
+  // mathfu matrices want SIMD alignment.
+  static const size_t kAlignment = 16;
+
+  std::vector<char*> blocks_;
+  size_t current_block_;
+  size_t offset_;
+
+  FrameArena(const FrameArena&);      // DISALLOW_COPY
+  void operator=(const FrameArena&);  // DISALLOW_ASSIGN
+};
+
 class Renderable {
  public:
   Renderable(uint16_t id, const mathfu::mat4& world_matrix,
              const mathfu::vec4& color = mathfu::vec4(1, 1, 1, 1))
-      : id_(id), world_matrix_(world_matrix), color_(color) {}
+      : id_(id),
+        far_lod_(false),
+        merged_static_(false),
+        world_matrix_(world_matrix),
+        color_(color) {}
 
   uint16_t id() const { return id_; }
   void set_id(uint16_t id) { id_ = id; }
@@ -36,49 +99,161 @@ class Renderable {
   const mathfu::vec4& color() const { return color_; }
   void set_color(const mathfu::vec4& c) { color_ = c; }
 
+  bool far_lod() const { return far_lod_; }
+  void set_far_lod(bool far_lod) { far_lod_ = far_lod; }
+
+  bool merged_static() const { return merged_static_; }
+  void set_merged_static(bool merged_static) { merged_static_ = merged_static; }
+
  private:
   // Unique identifier for item to be rendered.
   // See renderable_id in timeline_generated.h.
   uint16_t id_;
 
+  // True when the item is far enough from the camera that only its front
+  // quad should be drawn. Set per-frame by GameState::PopulateScene.
+  bool far_lod_;
+
+  // True when the item's world matrix is fixed for the life of the static
+  // scene cache (an unshakeable arena prop), making it a candidate for the
+  // renderer's merged static geometry; see
+  // PieNoonGame::UpdateMergedStaticProps.
+  bool merged_static_;
+
   // Position and orientation of item.
   mathfu::mat4 world_matrix_;
 
   mathfu::vec4 color_;
 };
 
+// A group of identically-textured quads to be drawn in one call.
+// Instances are keyed by renderable id: every instance in a batch shares the
+// material that id maps to, and carries only its own world transform and
+// color. See Mesh::RenderQuadBatch for how a batch gets submitted.
+class QuadInstanceBatch {
+ public:
+  explicit QuadInstanceBatch(uint16_t id) : id_(id) {}
+
+  uint16_t id() const { return id_; }
+
+  void AddInstance(const mathfu::mat4& world_matrix,
+                   const mathfu::vec4& color) {
+    world_matrices_.push_back(world_matrix);
+    colors_.push_back(color);
+  }
+
+  int instance_count() const {
+    return static_cast<int>(world_matrices_.size());
+  }
+
+  const std::vector<mathfu::mat4>& world_matrices() const {
+    return world_matrices_;
+  }
+  const std::vector<mathfu::vec4>& colors() const { return colors_; }
+
+ private:
+  // Renderable id shared by every instance. Determines the material.
+  uint16_t id_;
+
+  // Per-instance world transforms and colors, in insertion order.
+  std::vector<mathfu::mat4> world_matrices_;
+  std::vector<mathfu::vec4> colors_;
+};
+
 class SceneDescription {
  public:
+  SceneDescription() : static_version_(0) {}
+
   const mathfu::mat4& camera() const { return camera_; }
   void set_camera(const mathfu::mat4& camera) { camera_ = camera; }
 
-  std::vector<std::unique_ptr<Renderable>>& renderables() {
-    return renderables_;
+  // Generation counter of the static scene cache the merged-static
+  // renderables in this description came from. The renderer rebuilds
+  // geometry derived from them (see PieNoonGame::UpdateMergedStaticProps)
+  // only when it changes. Deliberately not reset by Clear(): it describes
+  // the source of the next population, not this frame's contents.
+  uint32_t static_version() const { return static_version_; }
+  void set_static_version(uint32_t version) { static_version_ = version; }
+
+  const std::vector<Renderable>& renderables() const { return renderables_; }
+  std::vector<Renderable>& renderables() { return renderables_; }
+
+  const std::vector<mathfu::vec3*>& lights() const { return lights_; }
+
+  // Add an item to the render list. Renderables are stored by value in one
+  // packed vector, so render traversal is a linear scan with no pointer
+  // chasing, and the vector's retained capacity means no allocations once
+  // it has grown to a typical frame's count.
+  void AddRenderable(uint16_t id, const mathfu::mat4& world_matrix,
+                     const mathfu::vec4& color = mathfu::vec4(1, 1, 1, 1)) {
+    renderables_.push_back(Renderable(id, world_matrix, color));
   }
-  const std::vector<std::unique_ptr<Renderable>>& renderables() const {
-    return renderables_;
+
+  // Add a copy of an already-built Renderable, e.g. one cached across
+  // frames.
+  void AddRenderable(const Renderable& renderable) {
+    renderables_.push_back(renderable);
+  }
+
+  // Add a point light. Arena-allocated, like renderables.
+  void AddLight(const mathfu::vec3& position) {
+    lights_.push_back(
+        new (arena_.Allocate(sizeof(mathfu::vec3))) mathfu::vec3(position));
   }
 
-  std::vector<std::unique_ptr<mathfu::vec3>>& lights() { return lights_; }
-  const std::vector<std::unique_ptr<mathfu::vec3>>& lights() const {
-    return lights_;
+  // Add one quad to the instance batch for 'id', creating the batch if this
+  // is the first instance with that id this frame. Batched quads bypass the
+  // per-renderable draw path, so only use this for flat quads that need no
+  // shadow, stick, or cardboard backing.
+  void AddQuadInstance(uint16_t id, const mathfu::mat4& world_matrix,
+                       const mathfu::vec4& color) {
+    for (size_t i = 0; i < quad_batches_.size(); ++i) {
+      if (quad_batches_[i]->id() == id) {
+        quad_batches_[i]->AddInstance(world_matrix, color);
+        return;
+      }
+    }
+    quad_batches_.push_back(
+        std::unique_ptr<QuadInstanceBatch>(new QuadInstanceBatch(id)));
+    quad_batches_.back()->AddInstance(world_matrix, color);
+  }
+
+  const std::vector<std::unique_ptr<QuadInstanceBatch>>& quad_batches() const {
+    return quad_batches_;
   }
 
   // Clear out the render list. Should be called once per frame.
+  // The renderable vector keeps its capacity and the lights are trivially
+  // destructible, so rewinding the arena releases them all; no destructors
+  // need to run.
   void Clear() {
     renderables_.clear();
     lights_.clear();
+    quad_batches_.clear();
+    arena_.Reset();
   }
 
  private:
   // The camera position, orientation, fov.
   mathfu::mat4 camera_;
 
-  // Array of items to be rendered and their positions.
-  std::vector<std::unique_ptr<Renderable>> renderables_;
+  // See static_version() above.
+  uint32_t static_version_;
+
+  // Backing store for the lights added since the last Clear().
+  FrameArena arena_;
+
+  // Items to be rendered and their positions, packed by value so the
+  // sort and submission stages stream through contiguous memory.
+  std::vector<Renderable> renderables_;
+
+  // Array of positions for where to place point lights. Owned by arena_.
+  std::vector<mathfu::vec3*> lights_;
 
-  // Array of positions for where to place point lights.
-  std::vector<std::unique_ptr<mathfu::vec3>> lights_;
+  // Quads collected into per-material instance batches. One batch per
+  // renderable id, in order of first appearance. Small enough (a handful of
+  // accessory materials) that batch lookup is a linear scan.
+  std::vector<std::unique_ptr<QuadInstanceBatch>> quad_batches_;
 };
 
 }  // namespace fpl
@@ -45,20 +45,47 @@ void Shader::InitializeUniforms() {
   }
 }
 
+// Copies 'value' into 'cached' and returns true if the two differed (or the
+// cache isn't valid yet); returns false if the upload can be skipped.
+static bool UpdateCachedUniform(float *cached, const float *value, int count,
+                                bool cache_valid) {
+  if (cache_valid && memcmp(cached, value, count * sizeof(float)) == 0)
+    return false;
+  memcpy(cached, value, count * sizeof(float));
+  return true;
+}
+
 void Shader::Set(const Renderer &renderer) const {
-  GL_CALL(glUseProgram(program_));
+  Renderer::UseProgram(program_);
 
-  if (uniform_model_view_projection_ >= 0)
+  // Only upload the standard uniforms whose values have changed since this
+  // program's last Set(). Values like the light position and color are
+  // shared across most draws in a frame, so in steady state only the mvp
+  // (and model) matrices actually get uploaded per draw.
+  if (uniform_model_view_projection_ >= 0 &&
+      UpdateCachedUniform(cached_model_view_projection_,
+                          &renderer.model_view_projection()[0], 16,
+                          uniform_cache_valid_))
     GL_CALL(glUniformMatrix4fv(uniform_model_view_projection_, 1, false,
                                &renderer.model_view_projection()[0]));
-  if (uniform_model_ >= 0)
+  if (uniform_model_ >= 0 &&
+      UpdateCachedUniform(cached_model_, &renderer.model()[0], 16,
+                          uniform_cache_valid_))
     GL_CALL(glUniformMatrix4fv(uniform_model_, 1, false, &renderer.model()[0]));
-  if (uniform_color_ >= 0)
+  if (uniform_color_ >= 0 &&
+      UpdateCachedUniform(cached_color_, &renderer.color()[0], 4,
+                          uniform_cache_valid_))
     GL_CALL(glUniform4fv(uniform_color_, 1, &renderer.color()[0]));
-  if (uniform_light_pos_ >= 0)
+  if (uniform_light_pos_ >= 0 &&
+      UpdateCachedUniform(cached_light_pos_, &renderer.light_pos()[0], 3,
+                          uniform_cache_valid_))
     GL_CALL(glUniform3fv(uniform_light_pos_, 1, &renderer.light_pos()[0]));
-  if (uniform_camera_pos_ >= 0)
+  if (uniform_camera_pos_ >= 0 &&
+      UpdateCachedUniform(cached_camera_pos_, &renderer.camera_pos()[0], 3,
+                          uniform_cache_valid_))
     GL_CALL(glUniform3fv(uniform_camera_pos_, 1, &renderer.camera_pos()[0]));
+
+  uniform_cache_valid_ = true;
 }
 
 }  // namespace fpl
@@ -41,7 +41,8 @@ class Shader {
         uniform_model_(-1),
         uniform_color_(-1),
         uniform_light_pos_(-1),
-        uniform_camera_pos_(-1) {}
+        uniform_camera_pos_(-1),
+        uniform_cache_valid_(false) {}
 
   ~Shader() {
     if (vs_) GL_CALL(glDeleteShader(vs_));
@@ -103,6 +104,9 @@ class Shader {
 
   void InitializeUniforms();
 
+  // The underlying GL program object, e.g. for retrieving program binaries.
+  GLuint program() const { return program_; }
+
  private:
   GLuint program_, vs_, ps_;
 
@@ -111,6 +115,20 @@ class Shader {
   GLint uniform_color_;
   GLint uniform_light_pos_;
   GLint uniform_camera_pos_;
+
+  // Shadow copies of the standard uniform values most recently uploaded to
+  // the program. Uniform values persist in the program object across binds,
+  // so Set() can skip the glUniform call when a value hasn't changed. This
+  // gives us the "upload shared values once per frame" behavior of a uniform
+  // block without requiring UBO support, which GLES2 lacks.
+  // Only meaningful when 'uniform_cache_valid_' is true. Mutable because
+  // tracking what's been uploaded doesn't change the shader's logical state.
+  mutable bool uniform_cache_valid_;
+  mutable float cached_model_view_projection_[16];
+  mutable float cached_model_[16];
+  mutable float cached_color_[4];
+  mutable float cached_light_pos_[3];
+  mutable float cached_camera_pos_[3];
 };
 
 }  // namespace fpl
@@ -12,7 +12,22 @@ TouchscreenButton::TouchscreenButton()
       is_active_(true),
       is_visible_(true),
       is_highlighted_(false),
-      one_over_cannonical_window_height_(0.0f) {}
+      one_over_cannonical_window_height_(0.0f),
+      screen_rect_min_(mathfu::kZeros2f),
+      screen_rect_max_(mathfu::kZeros2f),
+      screen_rect_window_size_(mathfu::kZeros2f) {}
+
+void TouchscreenButton::ResetState() {
+  button_ = Button();
+  elapsed_time_ = 0;
+  up_current_ = 0;
+  color_ = mathfu::kOnes4f;
+  up_offset_ = mathfu::kZeros2f;
+  down_offset_ = mathfu::kZeros2f;
+  is_active_ = button_def_ == nullptr || button_def_->starts_active() != 0;
+  is_visible_ = true;
+  is_highlighted_ = true;
+}
 
 ButtonId TouchscreenButton::GetId() const {
   if (button_def_ != nullptr) {
@@ -24,16 +39,24 @@ ButtonId TouchscreenButton::GetId() const {
 
 bool TouchscreenButton::WillCapturePointer(const Pointer& pointer,
                                            vec2 window_size) {
-  if (is_visible_ &&
-      pointer.mousepos.x() / window_size.x() >= button_def_->top_left()->x() &&
-      pointer.mousepos.y() / window_size.y() >= button_def_->top_left()->y() &&
-      pointer.mousepos.x() / window_size.x() <=
-          button_def_->bottom_right()->x() &&
-      pointer.mousepos.y() / window_size.y() <=
-          button_def_->bottom_right()->y()) {
-    return true;
+  if (!is_visible_) return false;
+  // The def stores the rectangle in normalized screen coordinates; cache
+  // it in pixels so the per-pointer test is four compares with no divides
+  // or flatbuffer reads. The cache invalidates itself on window resize.
+  if (window_size.x() != screen_rect_window_size_.x() ||
+      window_size.y() != screen_rect_window_size_.y()) {
+    screen_rect_min_ =
+        vec2(button_def_->top_left()->x(), button_def_->top_left()->y()) *
+        window_size;
+    screen_rect_max_ = vec2(button_def_->bottom_right()->x(),
+                            button_def_->bottom_right()->y()) *
+                       window_size;
+    screen_rect_window_size_ = window_size;
   }
-  return false;
+  return pointer.mousepos.x() >= screen_rect_min_.x() &&
+         pointer.mousepos.y() >= screen_rect_min_.y() &&
+         pointer.mousepos.x() <= screen_rect_max_.x() &&
+         pointer.mousepos.y() <= screen_rect_max_.y();
 }
 
 void TouchscreenButton::AdvanceFrame(WorldTime delta_time, InputSystem* input,
@@ -54,6 +77,12 @@ void TouchscreenButton::AdvanceFrame(WorldTime delta_time, InputSystem* input,
   button_.Update(down);
 }
 
+void TouchscreenButton::AdvanceFrame(WorldTime delta_time, bool down) {
+  elapsed_time_ += delta_time;
+  button_.AdvanceFrame();
+  button_.Update(down);
+}
+
 bool TouchscreenButton::IsTriggered() {
   return (button_def_->event_trigger() == ButtonEvent_ButtonHold &&
           button_.is_down()) ||
@@ -90,9 +119,10 @@ void TouchscreenButton::Render(Renderer& renderer) {
     base_size += mathfu::kOnes2f * pulse * 0.05f;
   }
 
+  const vec2 image_size = vec2(mat->image_size(0));
   vec3 texture_size =
-      texture_scale * vec3(mat->textures()[0]->size().x() * base_size.x(),
-                           -mat->textures()[0]->size().y() * base_size.y(), 0);
+      texture_scale * vec3(image_size.x() * base_size.x(),
+                           -image_size.y() * base_size.y(), 0);
 
   vec3 position = vec3(button_def()->texture_position()->x() * window_size.x(),
                        button_def()->texture_position()->y() * window_size.y(),
@@ -104,9 +134,12 @@ void TouchscreenButton::Render(Renderer& renderer) {
     inactive_shader_->Set(renderer);
   }
   mat->Set(renderer);
+  // uv() is (u0, v0, u1, v1) with v increasing downwards; the quad's
+  // texture coordinates run bottom-left to top-right, hence the swizzle.
+  const vec4 uv = mat->uv(0);
   Mesh::RenderAAQuadAlongX(position - (texture_size / 2.0f),
-                           position + (texture_size / 2.0f), vec2(0, 1),
-                           vec2(1, 0));
+                           position + (texture_size / 2.0f),
+                           vec2(uv.x(), uv.w()), vec2(uv.z(), uv.y()));
 }
 
 StaticImage::StaticImage()
@@ -135,6 +168,14 @@ void StaticImage::Initialize(const StaticImageDef& image_def,
   assert(Valid());
 }
 
+void StaticImage::ResetState() {
+  current_material_index_ = 0;
+  scale_ = LoadVec2(image_def_->draw_scale());
+  texture_position_ = LoadVec2(image_def_->texture_position());
+  color_ = mathfu::kOnes4f;
+  is_visible_ = image_def_->visible() != 0;
+}
+
 bool StaticImage::Valid() const {
   return image_def_ != nullptr &&
          current_material_index_ < static_cast<int>(materials_.size()) &&
@@ -151,7 +192,7 @@ void StaticImage::Render(Renderer& renderer) {
   const float texture_scale =
       window_size.y() * one_over_cannonical_window_height_;
   const vec2 texture_size =
-      texture_scale * vec2(material->textures()[0]->size()) * scale_;
+      texture_scale * vec2(material->image_size(0)) * scale_;
   const vec2 position_percent = texture_position_;
   const vec2 position = window_size * position_percent;
 
@@ -161,9 +202,10 @@ void StaticImage::Render(Renderer& renderer) {
   shader_->Set(renderer);
   material->Set(renderer);
 
+  const vec4 uv = material->uv(0);
   Mesh::RenderAAQuadAlongX(position3d - texture_size3d * 0.5f,
-                           position3d + texture_size3d * 0.5f, vec2(0, 1),
-                           vec2(1, 0));
+                           position3d + texture_size3d * 0.5f,
+                           vec2(uv.x(), uv.w()), vec2(uv.z(), uv.y()));
 }
 
 }  // pie_noon
@@ -32,9 +32,13 @@ class TouchscreenButton {
 
   void AdvanceFrame(WorldTime delta_time, InputSystem* input, vec2 window_size);
 
+  // Advance animation state and feed the button a pre-resolved pressed
+  // state, for callers (like GuiMenu's hit grid) that have already done
+  // the pointer-to-button resolution themselves.
+  void AdvanceFrame(WorldTime delta_time, bool down);
+
   // bool HandlePointer(Pointer pointer, vec2 window_size);
   void Render(Renderer& renderer);
-  void AdvanceFrame(WorldTime delta_time);
   ButtonId GetId() const;
   bool WillCapturePointer(const Pointer& pointer, vec2 window_size);
   bool IsTriggered();
@@ -51,6 +55,7 @@ class TouchscreenButton {
     assert(which < up_materials_.size());
     up_current_ = which;
   }
+  size_t current_up_material() const { return up_current_; }
 
   Material* down_material() const { return down_material_; }
   void set_down_material(Material* down_material) {
@@ -64,7 +69,11 @@ class TouchscreenButton {
   void set_down_offset(mathfu::vec2 down_offset) { down_offset_ = down_offset; }
 
   const ButtonDef* button_def() const { return button_def_; }
-  void set_button_def(const ButtonDef* button_def) { button_def_ = button_def; }
+  void set_button_def(const ButtonDef* button_def) {
+    button_def_ = button_def;
+    // Invalidate the cached screen-space rectangle.
+    screen_rect_window_size_ = mathfu::kZeros2f;
+  }
 
   Shader* inactive_shader() const { return inactive_shader_; }
   void set_inactive_shader(Shader* inactive_shader) {
@@ -92,6 +101,11 @@ class TouchscreenButton {
     one_over_cannonical_window_height_ = 1.0f / static_cast<float>(height);
   }
 
+  // Restore the per-visit state (press state, highlight, timers, color) to
+  // what a freshly set up button has, keeping the def, materials and
+  // shaders. Used when GuiMenu reactivates a pooled menu page.
+  void ResetState();
+
  private:
   Button button_;
   WorldTime elapsed_time_;
@@ -120,6 +134,13 @@ class TouchscreenButton {
   // Scale the textures by the y-axis so that they are (proportionally)
   // the same height on every platform.
   float one_over_cannonical_window_height_;
+
+  // Screen-space hit rectangle, cached so that pointer tests don't re-read
+  // the flatbuffer def and renormalize every time. Recomputed when the
+  // window size differs from the size it was cached at (zero = invalid).
+  mathfu::vec2 screen_rect_min_;
+  mathfu::vec2 screen_rect_max_;
+  mathfu::vec2 screen_rect_window_size_;
 };
 
 class StaticImage {
@@ -134,9 +155,11 @@ class StaticImage {
     return image_def_ == nullptr ? ButtonId_Undefined : image_def_->ID();
   }
   const StaticImageDef* image_def() const { return image_def_; }
+  const std::vector<Material*>& materials() const { return materials_; }
   const mathfu::vec2& scale() const { return scale_; }
   void set_scale(const mathfu::vec2& scale) { scale_ = scale; }
   void set_current_material_index(int i) { current_material_index_ = i; }
+  int current_material_index() const { return current_material_index_; }
 
   void set_is_visible(bool b) { is_visible_ = b; }
   bool is_visible() { return is_visible_; }
@@ -151,6 +174,11 @@ class StaticImage {
   }
   const mathfu::vec2& texture_position() { return texture_position_; }
 
+  // Restore the per-visit state Initialize() derives from the def, keeping
+  // the def, materials and shader. Used when GuiMenu reactivates a pooled
+  // menu page.
+  void ResetState();
+
  private:
   // Flatbuffer's definition of this image.
   const StaticImageDef* image_def_;
@@ -16,9 +16,129 @@
 
 #include "utilities.h"
 
+#if !defined(__ANDROID__) && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif  // !defined(__ANDROID__) && !defined(_WIN32)
+
 namespace fpl {
 
+// On-disk layout of the asset bundle produced by
+// `scripts/build_assets.py bundle`: a 16-byte header (magic, version, file
+// count), then file_count of these entries sorted by name, then a string
+// table of NUL-terminated names, then the concatenated file contents.
+// All fields are little-endian; offsets are from the start of the bundle.
+struct AssetBundleEntry {
+  uint32_t name_offset;
+  uint32_t name_length;
+  uint32_t data_offset;
+  uint32_t data_length;
+};
+
+static const char kAssetBundleMagic[] = "PNBUNDLE";
+static const uint32_t kAssetBundleVersion = 1;
+
+// The mapping for the currently loaded bundle, if any. Entries stay valid
+// for the lifetime of the process; the game loads the bundle once at
+// startup and never releases it.
+static MappedFile g_asset_bundle;
+static const AssetBundleEntry* g_bundle_entries = nullptr;
+static uint32_t g_bundle_entry_count = 0;
+
+// Binary search the bundle's sorted name table. Returns nullptr when no
+// bundle is loaded or the file isn't in it.
+static const AssetBundleEntry* FindBundleEntry(const char* filename) {
+  uint32_t lo = 0;
+  uint32_t hi = g_bundle_entry_count;
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    const AssetBundleEntry& entry = g_bundle_entries[mid];
+    const int cmp =
+        strcmp(g_asset_bundle.data() + entry.name_offset, filename);
+    if (cmp == 0) return &entry;
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return nullptr;
+}
+
+bool LoadAssetBundle(const char* filename) {
+  // g_bundle_entry_count is still 0 here, so this read comes from the file
+  // system, not from a half-initialized bundle.
+  MappedFile bundle;
+  if (!LoadFileMapped(filename, &bundle)) return false;
+
+  const size_t kHeaderSize = sizeof(kAssetBundleMagic) - 1 + 2 * sizeof(uint32_t);
+  if (bundle.length() < kHeaderSize ||
+      memcmp(bundle.data(), kAssetBundleMagic, sizeof(kAssetBundleMagic) - 1) !=
+          0) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "%s is not an asset bundle",
+                 filename);
+    return false;
+  }
+  uint32_t version, file_count;
+  memcpy(&version, bundle.data() + sizeof(kAssetBundleMagic) - 1,
+         sizeof(version));
+  memcpy(&file_count, bundle.data() + sizeof(kAssetBundleMagic) - 1 +
+                          sizeof(version),
+         sizeof(file_count));
+  if (version != kAssetBundleVersion) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR,
+                 "asset bundle %s has version %u, expected %u", filename,
+                 version, kAssetBundleVersion);
+    return false;
+  }
+  if (bundle.length() <
+      kHeaderSize + file_count * sizeof(AssetBundleEntry)) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "asset bundle %s is truncated",
+                 filename);
+    return false;
+  }
+  const AssetBundleEntry* entries = reinterpret_cast<const AssetBundleEntry*>(
+      bundle.data() + kHeaderSize);
+  for (uint32_t i = 0; i < file_count; ++i) {
+    const AssetBundleEntry& entry = entries[i];
+    if (entry.name_offset + entry.name_length >= bundle.length() ||
+        entry.data_offset + entry.data_length > bundle.length() ||
+        bundle.data()[entry.name_offset + entry.name_length] != '\0') {
+      SDL_LogError(SDL_LOG_CATEGORY_ERROR,
+                   "asset bundle %s entry %u is out of bounds", filename, i);
+      return false;
+    }
+  }
+
+  // Transfer ownership of the mapping to the global and publish the table.
+  g_asset_bundle.Release();
+  g_asset_bundle.data_ = bundle.data_;
+  g_asset_bundle.length_ = bundle.length_;
+  g_asset_bundle.mapped_ = bundle.mapped_;
+  bundle.data_ = nullptr;
+  bundle.length_ = 0;
+  bundle.mapped_ = false;
+  g_bundle_entries =
+      reinterpret_cast<const AssetBundleEntry*>(g_asset_bundle.data() +
+                                                kHeaderSize);
+  g_bundle_entry_count = file_count;
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+              "loaded asset bundle %s: %u files, %u bytes", filename,
+              file_count, static_cast<uint32_t>(g_asset_bundle.length()));
+  return true;
+}
+
 bool LoadFile(const char* filename, std::string* dest) {
+  const AssetBundleEntry* entry = FindBundleEntry(filename);
+  if (entry != nullptr) {
+    // Same contract as the file-system path below: contents plus a
+    // trailing NUL.
+    dest->assign(entry->data_length + 1, 0);
+    memcpy(&(*dest)[0], g_asset_bundle.data() + entry->data_offset,
+           entry->data_length);
+    return entry->data_length > 0;
+  }
   auto handle = SDL_RWFromFile(filename, "rb");
   if (!handle) {
     SDL_LogError(SDL_LOG_CATEGORY_ERROR, "LoadFile fail on %s", filename);
@@ -32,6 +152,157 @@ bool LoadFile(const char* filename, std::string* dest) {
   return len == rlen && len > 0;
 }
 
+// The verification cache, sorted for binary search. Loaded lazily on the
+// first query so processes that never verify a buffer never touch the
+// file.
+static std::vector<uint64_t> g_verified_hashes;
+static bool g_verified_hashes_loaded = false;
+
+// The cache lives under SDL's per-user writable path, like the shader
+// binary cache, since the assets directory may be read-only.
+static std::string VerificationCacheFilename() {
+  char* pref_path = SDL_GetPrefPath("google", "pienoon");
+  if (!pref_path) return "";
+  std::string filename = std::string(pref_path) + "verified_flatbuffers.bin";
+  SDL_free(pref_path);
+  return filename;
+}
+
+uint64_t HashBufferContents(const char* data, size_t length) {
+  // FNV-1a, matching the shader cache's string hash.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static void LoadVerificationCache() {
+  g_verified_hashes_loaded = true;
+  const std::string filename = VerificationCacheFilename();
+  if (filename.empty()) return;
+  SDL_RWops* handle = SDL_RWFromFile(filename.c_str(), "rb");
+  if (!handle) return;  // First run; the cache starts empty.
+  uint64_t hash;
+  while (SDL_RWread(handle, &hash, sizeof(hash), 1) == 1) {
+    g_verified_hashes.push_back(hash);
+  }
+  SDL_RWclose(handle);
+  std::sort(g_verified_hashes.begin(), g_verified_hashes.end());
+}
+
+bool BufferPreviouslyVerified(uint64_t hash) {
+  if (!g_verified_hashes_loaded) LoadVerificationCache();
+  return std::binary_search(g_verified_hashes.begin(), g_verified_hashes.end(),
+                            hash);
+}
+
+void RememberVerifiedBuffer(uint64_t hash) {
+  if (BufferPreviouslyVerified(hash)) return;
+  g_verified_hashes.insert(
+      std::lower_bound(g_verified_hashes.begin(), g_verified_hashes.end(),
+                       hash),
+      hash);
+  const std::string filename = VerificationCacheFilename();
+  if (filename.empty()) return;
+  SDL_RWops* handle = SDL_RWFromFile(filename.c_str(), "ab");
+  if (!handle) return;  // Not fatal: we just re-verify next launch.
+  SDL_RWwrite(handle, &hash, sizeof(hash), 1);
+  SDL_RWclose(handle);
+}
+
+void MappedFile::Swap(MappedFile* other) {
+  std::swap(data_, other->data_);
+  std::swap(length_, other->length_);
+  std::swap(mapped_, other->mapped_);
+  std::swap(owned_, other->owned_);
+}
+
+void MappedFile::Release() {
+  if (data_ == nullptr) return;
+  if (!owned_) {
+    // A view into the asset bundle; the bundle keeps the storage.
+    data_ = nullptr;
+    length_ = 0;
+    owned_ = true;
+    return;
+  }
+#if !defined(__ANDROID__) && !defined(_WIN32)
+  if (mapped_) {
+    munmap(data_, length_);
+    data_ = nullptr;
+    length_ = 0;
+    mapped_ = false;
+    return;
+  }
+#endif  // !defined(__ANDROID__) && !defined(_WIN32)
+  free(data_);
+  data_ = nullptr;
+  length_ = 0;
+}
+
+bool LoadFileMapped(const char* filename, MappedFile* dest) {
+  dest->Release();
+  const AssetBundleEntry* entry = FindBundleEntry(filename);
+  if (entry != nullptr) {
+    // Zero-copy view into the bundle's mapping; Release on a non-owning
+    // view just forgets the pointer.
+    dest->data_ = const_cast<char*>(g_asset_bundle.data()) + entry->data_offset;
+    dest->length_ = entry->data_length;
+    dest->mapped_ = false;
+    dest->owned_ = false;
+    return true;
+  }
+#if !defined(__ANDROID__) && !defined(_WIN32)
+  const int fd = open(filename, O_RDONLY);
+  if (fd >= 0) {
+    struct stat file_info;
+    const bool statted = fstat(fd, &file_info) == 0 && file_info.st_size > 0;
+    void* mapping = statted ? mmap(nullptr, file_info.st_size, PROT_READ,
+                                   MAP_PRIVATE, fd, 0)
+                            : MAP_FAILED;
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (mapping != MAP_FAILED) {
+      dest->data_ = static_cast<char*>(mapping);
+      dest->length_ = static_cast<size_t>(file_info.st_size);
+      dest->mapped_ = true;
+      return true;
+    }
+  }
+#endif  // !defined(__ANDROID__) && !defined(_WIN32)
+  // Fallback: read into a heap buffer through SDL, which also handles
+  // assets packed inside the apk on Android.
+  auto handle = SDL_RWFromFile(filename, "rb");
+  if (!handle) {
+    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "LoadFileMapped fail on %s",
+                 filename);
+    return false;
+  }
+  auto len = static_cast<size_t>(SDL_RWseek(handle, 0, RW_SEEK_END));
+  SDL_RWseek(handle, 0, RW_SEEK_SET);
+  auto buffer = static_cast<char*>(malloc(len));
+  size_t rlen = static_cast<size_t>(SDL_RWread(handle, buffer, 1, len));
+  SDL_RWclose(handle);
+  if (len != rlen || len == 0) {
+    free(buffer);
+    return false;
+  }
+  dest->data_ = buffer;
+  dest->length_ = len;
+  dest->mapped_ = false;
+  return true;
+}
+
+bool CanBatchRenderable(const pie_noon::Config* config,
+                        uint16_t renderable_id) {
+  auto renderable = config->renderables()->Get(renderable_id);
+  const bool has_back = renderable->cardboard_back() != nullptr &&
+                        renderable->cardboard_back()->c_str()[0] != '\0';
+  return !renderable->cardboard() && !renderable->stick() &&
+         !renderable->shadow() && !has_back;
+}
+
 #if defined(_WIN32)
 inline char* getcwd(char* buffer, int maxlen) {
   return _getcwd(buffer, maxlen);
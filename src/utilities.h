@@ -28,6 +28,60 @@ namespace fpl {
 
 bool LoadFile(const char* filename, std::string* dest);
 
+// A read-only view of a file's contents, backed by mmap where the platform
+// supports it, with a heap-buffer fallback elsewhere (e.g. Android, where
+// assets live inside the apk). FlatBuffers are designed for in-place access,
+// so mapping a .bin file avoids the copies LoadFile makes.
+// The view releases its mapping (or buffer) on destruction; anything parsed
+// out of data() must not outlive the MappedFile.
+class MappedFile {
+ public:
+  MappedFile() : data_(nullptr), length_(0), mapped_(false), owned_(true) {}
+  ~MappedFile() { Release(); }
+
+  const char* data() const { return data_; }
+  size_t length() const { return length_; }
+  bool valid() const { return data_ != nullptr; }
+
+  // Unmap or free the contents. Safe to call on an empty file.
+  void Release();
+
+  // Exchange contents with 'other'. Lets callers retire one mapping while
+  // installing another (e.g. the config hot-reload path) even though
+  // MappedFile is not copyable.
+  void Swap(MappedFile* other);
+
+ private:
+  friend bool LoadFileMapped(const char* filename, MappedFile* dest);
+  friend bool LoadAssetBundle(const char* filename);
+
+  char* data_;
+  size_t length_;
+  bool mapped_;
+
+  // False when data_ points into storage owned by someone else (the asset
+  // bundle's mapping); Release then just forgets the pointer.
+  bool owned_;
+
+  MappedFile(const MappedFile&);       // DISALLOW_COPY
+  void operator=(const MappedFile&);   // DISALLOW_ASSIGN
+};
+
+// Map (or, on platforms without mmap-able assets, read) the file into
+// 'dest'. Returns false and leaves 'dest' empty on failure.
+bool LoadFileMapped(const char* filename, MappedFile* dest);
+
+// Load 'filename' as an asset bundle: one file holding an offset table and
+// the concatenated contents of many assets, built by
+// `scripts/build_assets.py bundle`. While a bundle is loaded, LoadFile and
+// LoadFileMapped serve any file recorded in it straight from the bundle's
+// single mapping, so startup does one open instead of dozens --- a large
+// win on Android, where every open of a packed asset pays seek and
+// decompression overhead. Files not present in the bundle fall through to
+// the file system as before. Returns false (and changes nothing) if the
+// bundle is missing or malformed.
+bool LoadAssetBundle(const char* filename);
+
 inline const mathfu::vec3 LoadVec3(const pie_noon::Vec3* v) {
   // Note: eschew the constructor that loads contiguous floats. It's faster
   // than the x, y, z constructor we use here, but doesn't account for the
@@ -53,6 +107,29 @@ inline const mathfu::vec3 LoadAxis(pie_noon::Axis axis) {
                                                            : mathfu::kAxisZ3f;
 }
 
+// Persistent cache of FlatBuffer buffers that passed flatbuffers::Verifier
+// in an earlier run. Verification chases every offset in the buffer, and
+// the assets it guards only change with an install, so warm starts skip it
+// for buffers whose content hash is already recorded. The cache is a flat
+// file of host-endian hashes under SDL's per-user pref path (it never
+// travels between devices, so endianness doesn't matter).
+uint64_t HashBufferContents(const char* data, size_t length);
+
+// True when a buffer with this hash passed verification in this or an
+// earlier run.
+bool BufferPreviouslyVerified(uint64_t hash);
+
+// Record that the buffer with this hash passed verification. Appends to
+// the on-disk cache immediately; a cold start adds at most a few dozen
+// eight-byte records.
+void RememberVerifiedBuffer(uint64_t hash);
+
+// Returns true when the renderable is a plain flat quad that can be drawn
+// through the instanced quad batch path: nothing extra (shadow, popsicle
+// stick, cardboard back) is drawn with it.
+bool CanBatchRenderable(const pie_noon::Config* config,
+                        uint16_t renderable_id);
+
 bool ChangeToUpstreamDir(const char* const binary_dir,
                          const char* const target_dir);
 
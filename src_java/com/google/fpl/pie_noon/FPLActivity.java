@@ -182,6 +182,39 @@ public class FPLActivity extends SDLActivity {
   }
 
 
+  // Zero-copy channel for per-frame eye views. C++ shares a direct
+  // ByteBuffer wrapping native memory (one int sequence word, then two
+  // 16-float eye matrices); cardboard-enabled subclasses write into it
+  // from their sensor callback via writeEyeViews, and the native side
+  // reads it every frame without a JNI transition.
+  private java.nio.ByteBuffer eyeViewBuffer = null;
+
+  // Called from C++ once at startup.
+  public void SetEyeViewBuffer(java.nio.ByteBuffer buffer) {
+    buffer.order(java.nio.ByteOrder.nativeOrder());
+    eyeViewBuffer = buffer;
+  }
+
+  // Publishes new eye views. The sequence word goes odd before the floats
+  // are written and back to even after, so a native reader that catches
+  // the write mid-flight notices the change and retries (a seqlock).
+  protected void writeEyeViews(float[] leftEye, float[] rightEye) {
+    java.nio.ByteBuffer buffer = eyeViewBuffer;
+    if (buffer == null || leftEye.length != 16 || rightEye.length != 16) {
+      return;
+    }
+    int sequence = buffer.getInt(0);
+    buffer.putInt(0, sequence + 1);
+    int offset = 4;
+    for (int i = 0; i < 16; ++i, offset += 4) {
+      buffer.putFloat(offset, leftEye[i]);
+    }
+    for (int i = 0; i < 16; ++i, offset += 4) {
+      buffer.putFloat(offset, rightEye[i]);
+    }
+    buffer.putInt(0, sequence + 2);
+  }
+
   // Capture motionevents and keyevents to check for gamepad movement.  Any events we catch
   // (That look like they were from a gamepad or joystick) get sent to C++ via JNI, where
   // they are stored, so C++ can deal with them next time it updates the game state.
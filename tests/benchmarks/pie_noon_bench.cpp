@@ -0,0 +1,245 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Microbenchmarks for per-frame hot paths. Unlike the gtest binaries these
+// are not pass/fail: run them by hand (or from a release checklist) and
+// compare the printed numbers against the previous release. Each benchmark
+// warms up first and reports the best of several timed repeats, so a
+// steady-state figure survives a noisy machine.
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "SDL.h"
+#include "character_state_machine.h"
+#include "character_state_machine_def_generated.h"
+#include "entity/vector_pool.h"
+#include "flatbuffers/flatbuffers.h"
+#include "glyph_cache.h"
+#include "mesh.h"
+#include "particles.h"
+#include "timeline_generated.h"
+
+namespace pn = ::fpl::pie_noon;
+namespace fb = ::flatbuffers;
+
+// Times 'op' over 'iterations' calls, repeated kRepeats times after a
+// warm-up pass, and prints the best repeat as microseconds per iteration
+// plus iterations per second. 'units_per_iteration' scales the throughput
+// figure to a per-item count (particles, vertices, ...); pass 1 when the
+// iteration itself is the interesting unit.
+template <typename Op>
+void RunBenchmark(const char* name, int iterations, int units_per_iteration,
+                  Op op) {
+  static const int kRepeats = 5;
+  const double ticks_to_seconds =
+      1.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+
+  // Warm up caches, branch predictors and any lazy initialization.
+  for (int i = 0; i < iterations / 10 + 1; ++i) op();
+
+  double best_seconds = 0.0;
+  for (int repeat = 0; repeat < kRepeats; ++repeat) {
+    const uint64_t start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < iterations; ++i) op();
+    const double seconds =
+        (SDL_GetPerformanceCounter() - start) * ticks_to_seconds;
+    if (repeat == 0 || seconds < best_seconds) best_seconds = seconds;
+  }
+
+  const double per_iteration_us = best_seconds * 1e6 / iterations;
+  const double units_per_second =
+      iterations * static_cast<double>(units_per_iteration) / best_seconds;
+  printf("%-32s %10.3f us/iter %14.0f units/s  (%d iters x %d repeats)\n",
+         name, per_iteration_us, units_per_second, iterations, kRepeats);
+}
+
+// Builds the same kind of in-memory state machine definition the unit tests
+// use: every state has one transition to the next, fired by ThrowPie.
+static void BuildStateMachineDef(fb::FlatBufferBuilder* builder) {
+  std::vector<fb::Offset<pn::CharacterState>> states;
+  for (uint8_t i = 0; i < pn::StateId_Count; i++) {
+    std::vector<fb::Offset<pn::Transition>> trans_vec;
+    uint8_t target_id = (i + 1) % pn::StateId_Count;
+    uint16_t conditions = pn::LogicalInputs_ThrowPie;
+    trans_vec.push_back(pn::CreateTransition(
+        *builder, static_cast<pn::StateId>(target_id), conditions));
+
+    auto trans = builder->CreateVector<fb::Offset<pn::Transition>>(
+        &trans_vec.front(), trans_vec.size());
+    auto timeline = fpl::CreateTimeline(*builder);
+    states.push_back(pn::CreateCharacterState(
+        *builder, static_cast<pn::StateId>(i), trans, timeline));
+  }
+  auto state_machine_offset = pn::CreateCharacterStateMachineDef(
+      *builder, builder->CreateVector<fb::Offset<pn::CharacterState>>(
+                    &states.front(), states.size()),
+      pn::StateId_Idling);
+  builder->Finish(state_machine_offset);
+}
+
+static void BenchCharacterStateMachineUpdate() {
+  fb::FlatBufferBuilder builder;
+  BuildStateMachineDef(&builder);
+  auto def = pn::GetCharacterStateMachineDef(builder.GetBufferPointer());
+  pn::CharacterStateMachine state_machine(def);
+
+  pn::ConditionInputs inputs;
+  inputs.is_down = pn::LogicalInputs_ThrowPie;
+  inputs.went_down = 0;
+  inputs.went_up = 0;
+  inputs.animation_time = 0;
+  inputs.current_time = 0;
+  inputs.is_multiscreen = false;
+
+  // Every update fires a transition, the worst case for this path.
+  RunBenchmark("CharacterStateMachine::Update", 1000000, 1, [&]() {
+    inputs.current_time++;
+    state_machine.Update(inputs);
+  });
+}
+
+static void BenchVectorPoolIteration() {
+  struct Element {
+    float x, y, z, w;
+  };
+  static const int kElements = 10000;
+  fpl::VectorPool<Element> pool;
+  std::vector<size_t> element_indices;
+  for (int i = 0; i < kElements; ++i) {
+    auto ref = pool.GetNewElement(fpl::kAddToBack);
+    ref->x = static_cast<float>(i);
+    ref->y = ref->z = ref->w = 0.0f;
+    element_indices.push_back(ref.index());
+  }
+  // Leave holes so the iterator has to skip dead elements, as the entity
+  // system's pools do after churn.
+  for (size_t i = 0; i < element_indices.size(); i += 3) {
+    pool.FreeElement(element_indices[i]);
+  }
+
+  float sum = 0.0f;
+  RunBenchmark("VectorPool iteration", 1000, kElements, [&]() {
+    for (auto it = pool.begin(); it != pool.end(); ++it) {
+      sum += it->x;
+    }
+  });
+  if (sum == 0.0f) printf("unexpected zero sum\n");  // Defeat optimization.
+}
+
+static void BenchGlyphCacheSetFind() {
+  static const int kImageSize = 31;
+  static const int kCodePoints = 512;  // More than fits: exercises eviction.
+  mathfu::vec2i cache_size = mathfu::vec2i(256, 256);
+  std::unique_ptr<uint8_t[]> image(new uint8_t[kImageSize * kImageSize]());
+
+  fpl::GlyphCache<uint8_t> cache(cache_size);
+  fpl::GlyphCacheEntry entry;
+  entry.set_size(mathfu::vec2i(kImageSize, kImageSize));
+
+  int32_t code_point = 0;
+  RunBenchmark("GlyphCache::Set (evicting)", 10000, 1, [&]() {
+    entry.set_code_point(code_point);
+    cache.Set(image.get(), kImageSize, entry);
+    code_point = (code_point + 1) % kCodePoints;
+  });
+
+  // Refill with a set that fits, then measure pure lookups.
+  fpl::GlyphCache<uint8_t> warm_cache(cache_size);
+  for (int32_t i = 0; i < 64; ++i) {
+    entry.set_code_point(i);
+    warm_cache.Set(image.get(), kImageSize, entry);
+  }
+  code_point = 0;
+  RunBenchmark("GlyphCache::Find (hit)", 1000000, 1, [&]() {
+    warm_cache.Find(code_point, kImageSize);
+    code_point = (code_point + 1) % 64;
+  });
+}
+
+static void BenchParticleManagerAdvanceFrame() {
+  static const int kParticles = 1000;
+  pn::ParticleManager manager;
+
+  RunBenchmark("ParticleManager::AdvanceFrame", 1000, kParticles, [&]() {
+    // Top the pool back up to kParticles; expired ones are swap-removed
+    // by AdvanceFrame, so the population stays roughly steady.
+    for (int i = static_cast<int>(manager.particles().size());
+         i < kParticles; ++i) {
+      pn::Particle* p = manager.CreateParticle();
+      if (p == nullptr) break;
+      p->reset();
+      p->set_base_position(mathfu::vec3(0.0f, 10.0f, 0.0f));
+      p->set_base_velocity(mathfu::vec3(0.01f, 0.02f, 0.0f));
+      p->set_acceleration(mathfu::vec3(0.0f, -0.001f, 0.0f));
+      p->set_duration(static_cast<pn::TimeStep>(100 + i % 400));
+      p->set_duration_of_fade_out(static_cast<pn::TimeStep>(50));
+    }
+    manager.AdvanceFrame(static_cast<pn::TimeStep>(16));
+  });
+}
+
+static void BenchComputeNormalsTangents() {
+  // A character-sized quad grid, tessellated enough to be interesting.
+  static const int kGridSize = 32;
+  static const int kNumVerts = kGridSize * kGridSize;
+  std::vector<fpl::NormalMappedVertex> vertices(kNumVerts);
+  for (int y = 0; y < kGridSize; ++y) {
+    for (int x = 0; x < kGridSize; ++x) {
+      fpl::NormalMappedVertex& v = vertices[y * kGridSize + x];
+      v.pos = mathfu::vec3(static_cast<float>(x), static_cast<float>(y),
+                           sinf(static_cast<float>(x + y) * 0.1f));
+      v.tc = mathfu::vec2(static_cast<float>(x) / kGridSize,
+                          static_cast<float>(y) / kGridSize);
+    }
+  }
+  std::vector<unsigned short> indices;
+  for (int y = 0; y < kGridSize - 1; ++y) {
+    for (int x = 0; x < kGridSize - 1; ++x) {
+      const unsigned short i0 = static_cast<unsigned short>(y * kGridSize + x);
+      const unsigned short i1 = static_cast<unsigned short>(i0 + 1);
+      const unsigned short i2 = static_cast<unsigned short>(i0 + kGridSize);
+      const unsigned short i3 = static_cast<unsigned short>(i2 + 1);
+      indices.push_back(i0);
+      indices.push_back(i2);
+      indices.push_back(i1);
+      indices.push_back(i1);
+      indices.push_back(i2);
+      indices.push_back(i3);
+    }
+  }
+
+  RunBenchmark("Mesh::ComputeNormalsTangents", 1000, kNumVerts, [&]() {
+    fpl::Mesh::ComputeNormalsTangents(vertices.data(), indices.data(),
+                                      kNumVerts,
+                                      static_cast<int>(indices.size()));
+  });
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  printf("pie_noon_bench: best of repeated runs, lower us/iter is better\n");
+  BenchCharacterStateMachineUpdate();
+  BenchVectorPoolIteration();
+  BenchGlyphCacheSetFind();
+  BenchParticleManagerAdvanceFrame();
+  BenchComputeNormalsTangents();
+  return 0;
+}
@@ -0,0 +1,153 @@
+/*
+* Copyright (c) 2015 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Headless simulation driver. Runs complete all-AI games -- game state,
+// character state machines, entity system, motive animation -- at maximum
+// speed with no window, renderer, input or audio, and reports simulated
+// frames per second. Reads the same compiled assets the game ships
+// (config.bin, character_state_machine_def.bin), so it exercises the real
+// tuning data. Run it per commit and compare the frames/s figure against
+// the previous build to catch simulation-side performance regressions.
+//
+// Usage: pie_noon_sim [num_games]
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "SDL.h"
+#include "ai_controller.h"
+#include "character.h"
+#include "character_state_machine.h"
+#include "character_state_machine_def_generated.h"
+#include "config_generated.h"
+#include "game_state.h"
+#include "mathfu/utilities.h"
+#include "motive/init.h"
+#include "utilities.h"
+
+namespace pn = ::fpl::pie_noon;
+
+// Number of games simulated when no count is given on the command line.
+static const int kDefaultNumGames = 20;
+
+// Hard per-game frame cap so a pathological AI stalemate degrades to a
+// long sample instead of hanging a CI run.
+static const int kMaxFramesPerGame = 100000;
+
+// Step used when the config leaves simulation_timestep at 0 (variable
+// timestep); with no renderer there is no frame time to derive one from.
+static const fpl::WorldTime kFallbackTimestep = 16;
+
+// GameState::IsGameOver treats "no human players active" as an ended game,
+// which is true on frame zero of an all-AI roster. The part of the survival
+// end condition that is meaningful without humans: at most one character
+// left standing and no pies still in flight.
+static bool SimGameOver(const pn::GameState& game_state) {
+  return game_state.pies().empty() &&
+         game_state.NumActiveCharacters(false) <= 1;
+}
+
+int main(int argc, char* argv[]) {
+  const int num_games = argc > 1 ? atoi(argv[1]) : kDefaultNumGames;
+  if (num_games <= 0) {
+    fprintf(stderr, "usage: pie_noon_sim [num_games]\n");
+    return 1;
+  }
+
+  if (!fpl::ChangeToUpstreamDir(argc > 0 ? argv[0] : "", "assets")) {
+    fprintf(stderr, "pie_noon_sim: can't find assets directory\n");
+    return 1;
+  }
+
+  fpl::MappedFile config_source;
+  if (!fpl::LoadFileMapped("config.bin", &config_source)) {
+    fprintf(stderr, "pie_noon_sim: can't load config.bin\n");
+    return 1;
+  }
+  const pn::Config& config = *pn::GetConfig(config_source.data());
+
+  fpl::MappedFile state_machine_source;
+  if (!fpl::LoadFileMapped("character_state_machine_def.bin",
+                           &state_machine_source)) {
+    fprintf(stderr,
+            "pie_noon_sim: can't load character_state_machine_def.bin\n");
+    return 1;
+  }
+  const pn::CharacterStateMachineDef* state_machine_def =
+      pn::GetCharacterStateMachineDef(state_machine_source.data());
+  if (!pn::CharacterStateMachineDef_Validate(state_machine_def)) {
+    fprintf(stderr, "pie_noon_sim: state machine is invalid\n");
+    return 1;
+  }
+
+  // Mirrors PieNoonGame::InitializeGameState, minus every controller type
+  // that needs input hardware: the whole roster is AI.
+  motive::OvershootInit::Register();
+  motive::SmoothInit::Register();
+  motive::MatrixInit::Register();
+
+  pn::GameState game_state;
+  game_state.set_config(&config);
+  std::vector<std::unique_ptr<pn::AiController>> controllers;
+  for (unsigned int i = 0; i < config.character_count(); ++i) {
+    pn::AiController* controller = new pn::AiController();
+    controller->Initialize(&game_state, &config, i);
+    controllers.push_back(std::unique_ptr<pn::AiController>(controller));
+    game_state.characters().push_back(std::unique_ptr<pn::Character>(
+        new pn::Character(i, controller, config, state_machine_def)));
+  }
+
+  const fpl::WorldTime timestep = config.simulation_timestep() > 0
+                                      ? config.simulation_timestep()
+                                      : kFallbackTimestep;
+
+  printf("pie_noon_sim: %d games, %u characters, %d ms timestep\n", num_games,
+         config.character_count(), timestep);
+
+  const double ticks_to_seconds =
+      1.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+  int64_t total_frames = 0;
+  const uint64_t start = SDL_GetPerformanceCounter();
+  for (int game = 0; game < num_games; ++game) {
+    game_state.Reset(pn::GameState::kNoAnalytics);
+    int frames = 0;
+    while (frames < kMaxFramesPerGame) {
+      for (size_t i = 0; i < controllers.size(); ++i) {
+        controllers[i]->AdvanceFrame(timestep);
+      }
+      // A null audio engine runs the full simulation with sound muted.
+      game_state.AdvanceFrame(timestep, nullptr);
+      ++frames;
+      if (SimGameOver(game_state)) break;
+    }
+    total_frames += frames;
+    printf("game %3d: %6d frames (%d simulated seconds)\n", game, frames,
+           frames * timestep / 1000);
+  }
+  const double seconds =
+      (SDL_GetPerformanceCounter() - start) * ticks_to_seconds;
+
+  printf("%lld frames in %.3f s: %.0f frames/s (%.3f ms/frame)\n",
+         static_cast<long long>(total_frames), seconds, total_frames / seconds,
+         seconds * 1000.0 / total_frames);
+  return 0;
+}
+
+MATHFU_DEFINE_GLOBAL_SIMD_AWARE_NEW_DELETE